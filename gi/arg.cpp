@@ -35,9 +35,14 @@
 #include "value.h"
 #include "gerror.h"
 #include "gjs/byteArray.h"
+#include "gjs/context-private.h"
 #include "gjs/jsapi-wrapper.h"
 #include <util/log.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 bool
 _gjs_flags_value_is_valid(JSContext   *context,
                           GType        gtype,
@@ -697,6 +702,140 @@ gjs_array_to_gboolean_array(JSContext      *cx,
     return true;
 }
 
+/* Plain JS arrays are converted in batches: the elements are first fetched
+ * into a temporary buffer of int32 or double, and then narrowed in bulk. */
+#define BULK_CONVERT_BATCH 256
+
+static void
+narrow_int32_to_int16(const gint32 *src,
+                      gint16       *dest,
+                      gsize         n)
+{
+    gsize i = 0;
+
+#ifdef __SSE2__
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 4));
+
+        /* Sign-extend the low 16 bits, so that the saturating pack below
+         * truncates like a C cast does */
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        _mm_storeu_si128((__m128i *) (dest + i), _mm_packs_epi32(a, b));
+    }
+#endif
+
+    for (; i < n; i++)
+        dest[i] = (gint16) src[i];
+}
+
+static void
+narrow_int32_to_int8(const gint32 *src,
+                     gint8        *dest,
+                     gsize         n)
+{
+    gsize i = 0;
+
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 4));
+        __m128i c = _mm_loadu_si128((const __m128i *) (src + i + 8));
+        __m128i d = _mm_loadu_si128((const __m128i *) (src + i + 12));
+
+        /* See narrow_int32_to_int16() */
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 24), 24);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 24), 24);
+        c = _mm_srai_epi32(_mm_slli_epi32(c, 24), 24);
+        d = _mm_srai_epi32(_mm_slli_epi32(d, 24), 24);
+        _mm_storeu_si128((__m128i *) (dest + i),
+                         _mm_packs_epi16(_mm_packs_epi32(a, b),
+                                         _mm_packs_epi32(c, d)));
+    }
+#endif
+
+    for (; i < n; i++)
+        dest[i] = (gint8) src[i];
+}
+
+static void
+narrow_double_to_float(const double *src,
+                       float        *dest,
+                       gsize         n)
+{
+    gsize i = 0;
+
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+        _mm_storeu_ps(dest + i, _mm_movelh_ps(lo, hi));
+    }
+#endif
+
+    for (; i < n; i++)
+        dest[i] = (float) src[i];
+}
+
+/* Fetches @n elements of @array starting at @start, converted as with
+ * JS::ToInt32(). The low 32 bits are the same as JS::ToInt64() or
+ * JS::ToUint64() would give, so this is fine for any integer type of 32
+ * bits or less. */
+static bool
+gather_int32_elements(JSContext       *context,
+                      JS::HandleObject array,
+                      unsigned         start,
+                      unsigned         n,
+                      gint32          *dest)
+{
+    JS::RootedValue elem(context);
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        if (!JS_GetElement(context, array, start + i, &elem)) {
+            gjs_throw(context, "Missing array element %u", start + i);
+            return false;
+        }
+
+        if (elem.isInt32()) {
+            dest[i] = elem.toInt32();
+        } else if (!JS::ToInt32(context, elem, &dest[i])) {
+            gjs_throw(context, "Invalid element in int array");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+gather_double_elements(JSContext       *context,
+                       JS::HandleObject array,
+                       unsigned         start,
+                       unsigned         n,
+                       double          *dest)
+{
+    JS::RootedValue elem(context);
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        if (!JS_GetElement(context, array, start + i, &elem)) {
+            gjs_throw(context, "Missing array element %u", start + i);
+            return false;
+        }
+
+        if (elem.isNumber()) {
+            dest[i] = elem.toNumber();
+        } else if (!JS::ToNumber(context, elem, &dest[i])) {
+            gjs_throw(context, "Invalid element in array");
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static bool
 gjs_array_to_intarray(JSContext   *context,
                       JS::Value    array_value,
@@ -708,13 +847,39 @@ gjs_array_to_intarray(JSContext   *context,
     /* nasty union types in an attempt to unify the various int types */
     union { uint64_t u; int64_t i; } intval;
     void *result;
-    unsigned i;
+    unsigned i, n;
     JS::RootedObject array(context, array_value.toObjectOrNull());
     JS::RootedValue elem(context);
 
     /* add one so we're always zero terminated */
     result = g_malloc0((length+1) * intsize);
 
+    if (intsize <= 4) {
+        gint32 batch[BULK_CONVERT_BATCH];
+
+        for (i = 0; i < length; i += n) {
+            n = MIN(length - i, BULK_CONVERT_BATCH);
+
+            /* 32-bit ints need no narrowing, fetch them in place */
+            gint32 *dest = intsize == 4 ? ((gint32 *) result) + i : batch;
+            if (!gather_int32_elements(context, array, i, n, dest)) {
+                g_free(result);
+                return false;
+            }
+
+            /* Note that this is truncating assignment. */
+            if (intsize == 2)
+                narrow_int32_to_int16(batch, ((gint16 *) result) + i, n);
+            else if (intsize == 1)
+                narrow_int32_to_int8(batch, ((gint8 *) result) + i, n);
+        }
+
+        *arr_p = result;
+        return true;
+    }
+
+    g_assert(intsize == 8);
+
     for (i = 0; i < length; ++i) {
         bool success;
 
@@ -738,19 +903,8 @@ gjs_array_to_intarray(JSContext   *context,
                       "Invalid element in int array");
             return false;
         }
-        /* Note that this is truncating assignment. */
-        switch (intsize) {
-        case 1:
-            ((guint8*)result)[i] = (gint8) intval.u; break;
-        case 2:
-            ((guint16*)result)[i] = (gint16) intval.u; break;
-        case 4:
-            ((guint32*)result)[i] = (gint32) intval.u; break;
-        case 8:
-            ((uint64_t *)result)[i] = (int64_t) intval.u; break;
-        default:
-            g_assert_not_reached();
-        }
+
+        ((uint64_t *)result)[i] = intval.u;
     }
 
     *arr_p = result;
@@ -758,6 +912,90 @@ gjs_array_to_intarray(JSContext   *context,
     return true;
 }
 
+/* Returns the typed array type whose elements have exactly the same C
+ * representation as @element_type, or TYPE_MAX if there is none.
+ */
+static js::ArrayBufferView::ViewType
+typed_array_type_for_tag(GITypeTag element_type)
+{
+    switch (element_type) {
+    case GI_TYPE_TAG_INT8:
+        return js::ArrayBufferView::TYPE_INT8;
+    case GI_TYPE_TAG_UINT8:
+        return js::ArrayBufferView::TYPE_UINT8;
+    case GI_TYPE_TAG_INT16:
+        return js::ArrayBufferView::TYPE_INT16;
+    case GI_TYPE_TAG_UINT16:
+        return js::ArrayBufferView::TYPE_UINT16;
+    case GI_TYPE_TAG_INT32:
+        return js::ArrayBufferView::TYPE_INT32;
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_UNICHAR:
+        return js::ArrayBufferView::TYPE_UINT32;
+    case GI_TYPE_TAG_FLOAT:
+        return js::ArrayBufferView::TYPE_FLOAT32;
+    case GI_TYPE_TAG_DOUBLE:
+        return js::ArrayBufferView::TYPE_FLOAT64;
+    default:
+        return js::ArrayBufferView::TYPE_MAX;
+    }
+}
+
+/* If @array_obj is a typed array of exactly the C element type, copy it
+ * with a single memcpy instead of converting element by element. Returns
+ * false, without throwing, if the slow path must be used instead.
+ *
+ * We always copy rather than pass a pointer to the typed array's storage,
+ * since in-arrays are freed after the call and the storage of small typed
+ * arrays lives inside the JSObject, where the GC may move it.
+ */
+static bool
+gjs_typed_array_to_array(JSObject    *array_obj,
+                         unsigned int length,
+                         GITypeTag    element_type,
+                         void       **arr_p)
+{
+    js::ArrayBufferView::ViewType type, wanted_type;
+    gsize element_size;
+    void *result;
+
+    wanted_type = typed_array_type_for_tag(element_type);
+    if (wanted_type == js::ArrayBufferView::TYPE_MAX ||
+        !JS_IsTypedArrayObject(array_obj))
+        return false;
+
+    type = JS_GetArrayBufferViewType(array_obj);
+    if (type == js::ArrayBufferView::TYPE_UINT8_CLAMPED)
+        type = js::ArrayBufferView::TYPE_UINT8;
+    if (type != wanted_type || JS_GetTypedArrayLength(array_obj) != length)
+        return false;
+
+    switch (type) {
+    case js::ArrayBufferView::TYPE_INT8:
+    case js::ArrayBufferView::TYPE_UINT8:
+        element_size = 1;
+        break;
+    case js::ArrayBufferView::TYPE_INT16:
+    case js::ArrayBufferView::TYPE_UINT16:
+        element_size = 2;
+        break;
+    case js::ArrayBufferView::TYPE_FLOAT64:
+        element_size = 8;
+        break;
+    default:
+        element_size = 4;
+        break;
+    }
+
+    /* add one so we're always zero terminated */
+    result = g_malloc0((length + 1) * element_size);
+    if (length > 0)
+        memcpy(result, JS_GetArrayBufferViewData(array_obj), length * element_size);
+
+    *arr_p = result;
+    return true;
+}
+
 static bool
 gjs_gtypearray_to_array(JSContext   *context,
                         JS::Value    array_value,
@@ -810,45 +1048,26 @@ gjs_array_to_floatarray(JSContext   *context,
                         void       **arr_p,
                         bool         is_double)
 {
-    unsigned int i;
+    unsigned int i, n;
     void *result;
     JS::RootedObject array(context, array_value.toObjectOrNull());
-    JS::RootedValue elem(context);
+    double batch[BULK_CONVERT_BATCH];
 
     /* add one so we're always zero terminated */
     result = g_malloc0((length+1) * (is_double ? sizeof(double) : sizeof(float)));
 
-    for (i = 0; i < length; ++i) {
-        double val;
-        bool success;
-
-        elem = JS::UndefinedValue();
-        if (!JS_GetElement(context, array, i, &elem)) {
-            g_free(result);
-            gjs_throw(context,
-                      "Missing array element %u",
-                      i);
-            return false;
-        }
-
-        /* do whatever sign extension is appropriate */
-        success = JS::ToNumber(context, elem, &val);
+    for (i = 0; i < length; i += n) {
+        n = MIN(length - i, BULK_CONVERT_BATCH);
 
-        if (!success) {
+        /* doubles need no narrowing, fetch them in place */
+        double *dest = is_double ? ((double *) result) + i : batch;
+        if (!gather_double_elements(context, array, i, n, dest)) {
             g_free(result);
-            gjs_throw(context,
-                      "Invalid element in array");
             return false;
         }
 
-        /* Note that this is truncating assignment. */
-        if (is_double) {
-            double *darray = (double*)result;
-            darray[i] = val;
-        } else {
-            float *farray = (float*)result;
-            farray[i] = val;
-        }
+        if (!is_double)
+            narrow_double_to_float(batch, ((float *) result) + i, n);
     }
 
     *arr_p = result;
@@ -1038,6 +1257,11 @@ gjs_array_to_array(JSContext   *context,
         g_base_info_unref(interface_info);
     }
 
+    if (array_value.isObject() &&
+        gjs_typed_array_to_array(&array_value.toObject(), length,
+                                 element_type, arr_p))
+        return true;
+
     switch (element_type) {
     case GI_TYPE_TAG_UTF8:
         return gjs_array_to_strv (context, array_value, length, arr_p);
@@ -1234,16 +1458,16 @@ throw_invalid_argument(JSContext      *context,
     g_free(display_name);
 }
 
-static bool
-gjs_array_to_explicit_array_internal(JSContext       *context,
-                                     JS::HandleValue  value,
-                                     GITypeInfo      *type_info,
-                                     const char      *arg_name,
-                                     GjsArgumentType  arg_type,
-                                     GITransfer       transfer,
-                                     bool             may_be_null,
-                                     gpointer        *contents,
-                                     gsize           *length_p)
+bool
+gjs_array_to_explicit_array(JSContext       *context,
+                            JS::HandleValue  value,
+                            GITypeInfo      *type_info,
+                            const char      *arg_name,
+                            GjsArgumentType  arg_type,
+                            GITransfer       transfer,
+                            bool             may_be_null,
+                            gpointer        *contents,
+                            gsize           *length_p)
 {
     bool ret = false;
     GITypeInfo *param_info;
@@ -1608,7 +1832,10 @@ gjs_value_to_g_argument(JSContext      *context,
 
                     if (g_type_is_a(gtype, G_TYPE_BYTES)
                         && gjs_typecheck_bytearray(context, obj, false)) {
-                        arg->v_pointer = gjs_byte_array_get_bytes(context, obj);
+                        /* borrowed from the ByteArray, and copied below if
+                         * ownership is transferred; function calls take
+                         * their own reference for the duration of the call */
+                        arg->v_pointer = gjs_byte_array_peek_bytes(context, obj);
                     } else if (g_type_is_a(gtype, G_TYPE_ERROR)) {
                         if (!gjs_typecheck_gerror(context, obj, true)) {
                             arg->v_pointer = NULL;
@@ -1903,15 +2130,15 @@ gjs_value_to_g_argument(JSContext      *context,
             }
         }
 
-        if (!gjs_array_to_explicit_array_internal(context,
-                                                  value,
-                                                  type_info,
-                                                  arg_name,
-                                                  arg_type,
-                                                  transfer,
-                                                  may_be_null,
-                                                  &data,
-                                                  &length)) {
+        if (!gjs_array_to_explicit_array(context,
+                                         value,
+                                         type_info,
+                                         arg_name,
+                                         arg_type,
+                                         transfer,
+                                         may_be_null,
+                                         &data,
+                                         &length)) {
             wrong = true;
             break;
         }
@@ -2131,15 +2358,15 @@ gjs_value_to_explicit_array (JSContext      *context,
 
     g_arg_info_load_type(arg_info, &type_info);
 
-    return gjs_array_to_explicit_array_internal(context,
-                                                value,
-                                                &type_info,
-                                                g_base_info_get_name((GIBaseInfo*) arg_info),
-                                                GJS_ARGUMENT_ARGUMENT,
-                                                g_arg_info_get_ownership_transfer(arg_info),
-                                                g_arg_info_may_be_null(arg_info),
-                                                &arg->v_pointer,
-                                                length_p);
+    return gjs_array_to_explicit_array(context,
+                                       value,
+                                       &type_info,
+                                       g_base_info_get_name((GIBaseInfo*) arg_info),
+                                       GJS_ARGUMENT_ARGUMENT,
+                                       g_arg_info_get_ownership_transfer(arg_info),
+                                       g_arg_info_may_be_null(arg_info),
+                                       &arg->v_pointer,
+                                       length_p);
 }
 
 static bool
@@ -2188,6 +2415,60 @@ gjs_array_from_g_list (JSContext             *context,
     return true;
 }
 
+/* Creates a typed array holding a copy of @array, if @element_type has a
+ * matching typed array type. Returns NULL without throwing if it has none.
+ */
+static JSObject *
+gjs_typed_array_from_array(JSContext *context,
+                           GITypeTag  element_type,
+                           guint      length,
+                           gpointer   array)
+{
+    JSObject *obj;
+    gsize element_size;
+
+    switch (element_type) {
+    case GI_TYPE_TAG_INT8:
+        obj = JS_NewInt8Array(context, length);
+        element_size = sizeof(gint8);
+        break;
+    case GI_TYPE_TAG_INT16:
+        obj = JS_NewInt16Array(context, length);
+        element_size = sizeof(gint16);
+        break;
+    case GI_TYPE_TAG_UINT16:
+        obj = JS_NewUint16Array(context, length);
+        element_size = sizeof(guint16);
+        break;
+    case GI_TYPE_TAG_INT32:
+        obj = JS_NewInt32Array(context, length);
+        element_size = sizeof(gint32);
+        break;
+    case GI_TYPE_TAG_UINT32:
+        obj = JS_NewUint32Array(context, length);
+        element_size = sizeof(guint32);
+        break;
+    case GI_TYPE_TAG_FLOAT:
+        obj = JS_NewFloat32Array(context, length);
+        element_size = sizeof(gfloat);
+        break;
+    case GI_TYPE_TAG_DOUBLE:
+        obj = JS_NewFloat64Array(context, length);
+        element_size = sizeof(gdouble);
+        break;
+    default:
+        return NULL;
+    }
+
+    if (obj == NULL)
+        return NULL;
+
+    if (length > 0)
+        memcpy(JS_GetArrayBufferViewData(obj), array, length * element_size);
+
+    return obj;
+}
+
 static bool
 gjs_array_from_carray_internal (JSContext             *context,
                                 JS::MutableHandleValue value_p,
@@ -2223,6 +2504,17 @@ gjs_array_from_carray_internal (JSContext             *context,
     if (element_type == GI_TYPE_TAG_UNICHAR)
         return gjs_string_from_ucs4(context, (gunichar *) array, length, value_p);
 
+    if (_gjs_context_get_typed_arrays((GjsContext *) JS_GetContextPrivate(context))) {
+        JSObject *typed_array = gjs_typed_array_from_array(context, element_type,
+                                                           length, array);
+        if (typed_array != NULL) {
+            value_p.setObject(*typed_array);
+            return true;
+        }
+        if (JS_IsExceptionPending(context))
+            return false;
+    }
+
     JS::AutoValueVector elems(context);
     elems.resize(length);
 
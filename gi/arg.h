@@ -54,6 +54,16 @@ bool gjs_value_to_explicit_array(JSContext       *context,
                                  GIArgument      *arg,
                                  size_t          *length_p);
 
+bool gjs_array_to_explicit_array(JSContext       *context,
+                                 JS::HandleValue  value,
+                                 GITypeInfo      *type_info,
+                                 const char      *arg_name,
+                                 GjsArgumentType  arg_type,
+                                 GITransfer       transfer,
+                                 bool             may_be_null,
+                                 gpointer        *contents,
+                                 gsize           *length_p);
+
 void gjs_g_argument_init_default (JSContext      *context,
                                   GITypeInfo     *type_info,
                                   GArgument      *arg);
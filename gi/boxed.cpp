@@ -28,6 +28,7 @@
 #include "boxed.h"
 #include "arg.h"
 #include "object.h"
+#include "gjs/gc-scheduler.h"
 #include "gjs/jsapi-wrapper.h"
 #include "gjs/mem.h"
 #include "repo.h"
@@ -36,9 +37,12 @@
 #include "gtype.h"
 
 #include <util/log.h>
+#include <util/misc.h>
 
 #include <girepository.h>
 
+struct BoxedFields;
+
 typedef struct {
     /* prototype info */
     GIBoxedInfo *info;
@@ -50,20 +54,76 @@ typedef struct {
 
     /* instance info */
     void *gboxed; /* NULL if we are the prototype and not an instance */
-    GHashTable *field_map;
+    BoxedFields *fields; /* shared by the prototype and its instances */
+    gsize native_size; /* bytes reported to the GC scheduler */
 
     guint can_allocate_directly : 1;
+    guint can_allocate_inline : 1;
     guint allocated_directly : 1;
+    guint has_inline_storage : 1; /* allocated as a BoxedInline */
     guint not_owning_gboxed : 1; /* if set, the JS wrapper does not own
                                     the reference to the C gboxed */
 } Boxed;
 
-static bool struct_is_simple(GIStructInfo *info);
+/* Simple structs of up to this size that we allocate ourselves, such as
+ * points and rectangles, are stored right after their Boxed in a single
+ * allocation, which saves a malloc/free pair per instance and keeps the
+ * struct next to the wrapper's private data. */
+#define BOXED_INLINE_MAX_SIZE 64
+
+typedef struct {
+    Boxed priv;
+    union {
+        guint8  data[1];  /* really as long as the struct */
+        guint64 align_int;
+        double  align_double;
+        void   *align_pointer;
+    } inline_struct;
+} BoxedInline;
+
+#define BOXED_INLINE_SIZE(struct_size) \
+    (G_STRUCT_OFFSET(BoxedInline, inline_struct) + MAX((struct_size), sizeof(guint64)))
+
+struct BoxedField;
+
+typedef bool (*BoxedFieldGetFunc)(JSContext             *context,
+                                  JS::HandleObject       obj,
+                                  Boxed                 *priv,
+                                  BoxedField            *field,
+                                  JS::MutableHandleValue value);
+typedef bool (*BoxedFieldSetFunc)(JSContext      *context,
+                                  Boxed          *priv,
+                                  BoxedField     *field,
+                                  JS::HandleValue value);
+
+/* Everything we need to read or write one field, computed when the
+ * class is defined */
+struct BoxedField {
+    JS::Heap<jsid> id;
+    GIFieldInfo *info;
+    GITypeInfo *type_info;
+    GITypeTag type_tag;
+    int offset;
+
+    /* set if the field is a simple struct embedded in its parent */
+    GIStructInfo *nested_info;
+    JS::Heap<JSObject*> nested_proto; /* looked up on first use */
+
+    BoxedFieldGetFunc get;
+    BoxedFieldSetFunc set;
+};
 
-static bool boxed_set_field_from_value(JSContext      *context,
-                                       Boxed          *priv,
-                                       GIFieldInfo    *field_info,
-                                       JS::HandleValue value);
+/* Structs with more fields than this are looked up in by_id */
+#define BOXED_FIELDS_MAX_LINEAR 8
+
+struct BoxedFields {
+    int refcount;
+    int n_fields;
+    BoxedField *fields;
+    GHashTable *by_id; /* jsid bits -> BoxedField*, or NULL */
+};
+
+static bool struct_is_simple(GIStructInfo *info);
 
 extern struct JSClass gjs_boxed_class;
 
@@ -116,10 +176,10 @@ boxed_new_resolve(JSContext *context,
                   JS::MutableHandleObject objp)
 {
     Boxed *priv;
-    char *name;
+    const char *name;
     bool ret = false;
 
-    if (!gjs_get_string_id(context, id, &name))
+    if (!gjs_borrow_string_id(context, id, &name))
         return true; /* not resolved, but no error */
 
     priv = priv_from_js(context, obj);
@@ -175,7 +235,7 @@ boxed_new_resolve(JSContext *context,
     ret = true;
 
  out:
-    g_free(name);
+    gjs_release_string_id(context, name);
     return ret;
 }
 
@@ -205,12 +265,102 @@ boxed_get_copy_source(JSContext *context,
     return true;
 }
 
+static BoxedFields *
+boxed_fields_ref(BoxedFields *fields)
+{
+    fields->refcount++;
+    return fields;
+}
+
+static void
+boxed_fields_unref(BoxedFields *fields)
+{
+    int i;
+
+    if (--fields->refcount > 0)
+        return;
+
+    for (i = 0; i < fields->n_fields; i++) {
+        BoxedField *field = &fields->fields[i];
+
+        g_base_info_unref((GIBaseInfo *) field->info);
+        g_base_info_unref((GIBaseInfo *) field->type_info);
+        if (field->nested_info)
+            g_base_info_unref((GIBaseInfo *) field->nested_info);
+    }
+
+    if (fields->by_id)
+        g_hash_table_destroy(fields->by_id);
+    delete[] fields->fields;
+    g_slice_free(BoxedFields, fields);
+}
+
+/* Field ids are interned when the table is built, and structs rarely have
+ * more than a handful of fields, so for those comparing ids beats hashing.
+ */
+static BoxedField *
+get_field (JSContext *context,
+           Boxed     *priv,
+           jsid       id)
+{
+    const char *name;
+    int i;
+
+    if (priv->fields != NULL && priv->fields->by_id != NULL) {
+        BoxedField *field = (BoxedField *)
+            g_hash_table_lookup(priv->fields->by_id,
+                                GSIZE_TO_POINTER(JSID_BITS(id)));
+        if (field != NULL)
+            return field;
+    } else if (priv->fields != NULL) {
+        for (i = 0; i < priv->fields->n_fields; i++) {
+            if (priv->fields->fields[i].id.get() == id)
+                return &priv->fields->fields[i];
+        }
+    }
+
+    if (gjs_borrow_string_id(context, id, &name)) {
+        gjs_throw(context, "No field %s on boxed type %s",
+                  name, g_base_info_get_name((GIBaseInfo *)priv->info));
+        gjs_release_string_id(context, name);
+    }
+
+    return NULL;
+}
+
+/* Makes the private data of a new instance from that of its prototype */
+static Boxed *
+boxed_new_instance_priv(Boxed *proto_priv,
+                        bool   with_inline_storage)
+{
+    Boxed *priv;
+
+    if (with_inline_storage)
+        priv = (Boxed *)
+            g_slice_alloc0(BOXED_INLINE_SIZE(g_struct_info_get_size(proto_priv->info)));
+    else
+        priv = g_slice_new0(Boxed);
+
+    *priv = *proto_priv;
+    priv->has_inline_storage = with_inline_storage;
+    g_base_info_ref( (GIBaseInfo*) priv->info);
+    if (priv->fields)
+        boxed_fields_ref(priv->fields);
+
+    return priv;
+}
+
 static void
 boxed_new_direct(Boxed       *priv)
 {
     g_assert(priv->can_allocate_directly);
 
-    priv->gboxed = g_slice_alloc0(g_struct_info_get_size (priv->info));
+    if (priv->has_inline_storage) {
+        /* already zeroed along with priv */
+        priv->gboxed = ((BoxedInline *) priv)->inline_struct.data;
+    } else {
+        priv->gboxed = g_slice_alloc0(g_struct_info_get_size (priv->info));
+    }
     priv->allocated_directly = true;
 
     gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
@@ -218,27 +368,17 @@ boxed_new_direct(Boxed       *priv)
                         g_base_info_get_name ((GIBaseInfo *)priv->info));
 }
 
-/* When initializing a boxed object from a hash of properties, we don't want
- * to do n O(n) lookups, so put put the fields into a hash table and store it on proto->priv
- * for fast lookup. 
- */
-static GHashTable *
-get_field_map(GIStructInfo *struct_info)
+/* Reports the memory of a C struct that we now own to the GC scheduler;
+ * inline storage is part of the private data like any other wrapper's */
+static void
+boxed_track_native_memory(Boxed *priv)
 {
-    GHashTable *result;
-    int n_fields;
-    int i;
-
-    result = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                   NULL, (GDestroyNotify)g_base_info_unref);
-    n_fields = g_struct_info_get_n_fields(struct_info);
-
-    for (i = 0; i < n_fields; i++) {
-        GIFieldInfo *field_info = g_struct_info_get_field(struct_info, i);
-        g_hash_table_insert(result, (char *)g_base_info_get_name((GIBaseInfo *)field_info), field_info);
-    }
+    if (priv->gboxed == NULL || priv->not_owning_gboxed ||
+        priv->has_inline_storage || priv->native_size != 0)
+        return;
 
-    return result;
+    priv->native_size = g_struct_info_get_size(priv->info);
+    gjs_gc_track_native_memory(GJS_GC_NATIVE_BOXED, priv->native_size);
 }
 
 /* Initialize a newly created Boxed from an object that is a "hash" of
@@ -266,36 +406,22 @@ boxed_init_from_props(JSContext   *context,
         return false;
     }
 
-    if (!priv->field_map)
-        priv->field_map = get_field_map(priv->info);
-
     JS::RootedId prop_id(context, JSID_VOID);
     if (!JS_NextProperty(context, iter, prop_id.address()))
         goto out;
 
     while (!JSID_IS_VOID(prop_id)) {
-        GIFieldInfo *field_info;
-        char *name;
+        BoxedField *field;
         JS::RootedValue value(context);
 
-        if (!gjs_get_string_id(context, prop_id, &name))
+        field = get_field(context, priv, prop_id);
+        if (field == NULL)
             goto out;
 
-        field_info = (GIFieldInfo *) g_hash_table_lookup(priv->field_map, name);
-        if (field_info == NULL) {
-            gjs_throw(context, "No field %s on boxed type %s",
-                      name, g_base_info_get_name((GIBaseInfo *)priv->info));
-            g_free(name);
+        if (!gjs_object_require_property(context, props, "property list", prop_id, &value))
             goto out;
-        }
 
-        if (!gjs_object_require_property(context, props, "property list", prop_id, &value)) {
-            g_free(name);
-            goto out;
-        }
-        g_free(name);
-
-        if (!boxed_set_field_from_value(context, priv, field_info, value))
+        if (!field->set(context, priv, field, value))
             goto out;
 
         prop_id = JSID_VOID;
@@ -420,17 +546,6 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
 
     GJS_NATIVE_CONSTRUCTOR_PRELUDE(boxed);
 
-    priv = g_slice_new0(Boxed);
-
-    GJS_INC_COUNTER(boxed);
-
-    g_assert(priv_from_js(context, object) == NULL);
-    JS_SetPrivate(object, priv);
-
-    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
-                        "boxed constructor, obj %p priv %p",
-                        object.get(), priv);
-
     JS_GetPrototype(context, object, &proto);
     gjs_debug_lifecycle(GJS_DEBUG_GBOXED, "boxed instance __proto__ is %p",
                         proto.get());
@@ -445,8 +560,17 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
         return false;
     }
 
-    *priv = *proto_priv;
-    g_base_info_ref( (GIBaseInfo*) priv->info);
+    priv = boxed_new_instance_priv(proto_priv,
+                                   proto_priv->can_allocate_inline);
+
+    GJS_INC_COUNTER(boxed);
+
+    g_assert(priv_from_js(context, object) == NULL);
+    JS_SetPrivate(object, priv);
+
+    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
+                        "boxed constructor, obj %p priv %p",
+                        object.get(), priv);
 
     /* Short-circuit copy-construction in the case where we can use g_boxed_copy or memcpy */
     if (argc == 1 &&
@@ -454,6 +578,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
 
         if (g_type_is_a (priv->gtype, G_TYPE_BOXED)) {
             priv->gboxed = g_boxed_copy(priv->gtype, source_priv->gboxed);
+            boxed_track_native_memory(priv);
 
             GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
             return true;
@@ -461,6 +586,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
             boxed_new_direct (priv);
             memcpy(priv->gboxed, source_priv->gboxed,
                    g_struct_info_get_size (priv->info));
+            boxed_track_native_memory(priv);
 
             GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
             return true;
@@ -473,6 +599,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
 
     argv.rval().setUndefined();
     retval = boxed_new(context, object, priv, argv);
+    boxed_track_native_memory(priv);
 
     if (argv.rval().isUndefined())
         GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
@@ -485,6 +612,7 @@ boxed_finalize(JSFreeOp *fop,
                JSObject *obj)
 {
     Boxed *priv;
+    gsize inline_struct_size = 0;
 
     priv = (Boxed *) JS_GetPrivate(obj);
     gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
@@ -492,9 +620,15 @@ boxed_finalize(JSFreeOp *fop,
     if (priv == NULL)
         return; /* wrong class? */
 
+    if (priv->has_inline_storage)
+        inline_struct_size = g_struct_info_get_size(priv->info);
+
     if (priv->gboxed && !priv->not_owning_gboxed) {
+        gjs_gc_track_native_memory(GJS_GC_NATIVE_BOXED, -(gssize) priv->native_size);
+
         if (priv->allocated_directly) {
-            g_slice_free1(g_struct_info_get_size (priv->info), priv->gboxed);
+            if (!priv->has_inline_storage)
+                g_slice_free1(g_struct_info_get_size (priv->info), priv->gboxed);
         } else {
             if (g_type_is_a (priv->gtype, G_TYPE_BOXED))
                 g_boxed_free (priv->gtype,  priv->gboxed);
@@ -512,74 +646,116 @@ boxed_finalize(JSFreeOp *fop,
         priv->info = NULL;
     }
 
-    if (priv->field_map) {
-        g_hash_table_destroy(priv->field_map);
-    }
+    if (priv->fields)
+        boxed_fields_unref(priv->fields);
 
     GJS_DEC_COUNTER(boxed);
-    g_slice_free(Boxed, priv);
+    if (priv->has_inline_storage)
+        g_slice_free1(BOXED_INLINE_SIZE(inline_struct_size), priv);
+    else
+        g_slice_free(Boxed, priv);
 }
 
-static GIFieldInfo *
-get_field_info (JSContext *context,
-                Boxed     *priv,
-                jsid       id)
+/* Looks up the prototype of a nested struct's type the first time the
+ * field is used; it is kept alive by boxed_trace() on our prototype.
+ */
+static JSObject *
+get_nested_proto (JSContext  *context,
+                  BoxedField *field)
 {
-    GIFieldInfo *field_info;
-    char *name;
+    if (!field->nested_proto)
+        field->nested_proto = gjs_lookup_generic_prototype(context,
+                                                           (GIBaseInfo *) field->nested_info);
 
-    if (!priv->field_map)
-        priv->field_map = get_field_map(priv->info);
+    if (!field->nested_proto && !JS_IsExceptionPending(context))
+        gjs_throw(context, "Could not find the prototype of %s.%s",
+                  g_base_info_get_namespace((GIBaseInfo *) field->nested_info),
+                  g_base_info_get_name((GIBaseInfo *) field->nested_info));
 
-    if (!gjs_get_string_id(context, id, &name))
-        goto out;
-
-    field_info = (GIFieldInfo *) g_hash_table_lookup(priv->field_map, name);
-    if (field_info == NULL) {
-        gjs_throw(context, "No field %s on boxed type %s",
-                  name, g_base_info_get_name((GIBaseInfo *)priv->info));
-        g_free(name);
-        goto out;
-    }
+    return field->nested_proto;
+}
 
-    g_free(name);
+static bool
+boxed_field_get_unsupported (JSContext             *context,
+                             JS::HandleObject       obj,
+                             Boxed                 *priv,
+                             BoxedField            *field,
+                             JS::MutableHandleValue value)
+{
+    gjs_throw(context, "Reading field %s.%s is not supported",
+              g_base_info_get_name ((GIBaseInfo *)priv->info),
+              g_base_info_get_name ((GIBaseInfo *)field->info));
+    return false;
+}
 
-    return field_info;
+static bool
+boxed_field_get_primitive (JSContext             *context,
+                           JS::HandleObject       obj,
+                           Boxed                 *priv,
+                           BoxedField            *field,
+                           JS::MutableHandleValue value)
+{
+    void *p = ((char *)priv->gboxed) + field->offset;
+
+    /* Same conversions as gjs_value_from_g_argument() */
+    switch (field->type_tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+        value.setBoolean(!!*(gboolean *) p);
+        break;
+    case GI_TYPE_TAG_INT8:
+        value.setInt32(*(gint8 *) p);
+        break;
+    case GI_TYPE_TAG_UINT8:
+        value.setInt32(*(guint8 *) p);
+        break;
+    case GI_TYPE_TAG_INT16:
+        value.setInt32(*(gint16 *) p);
+        break;
+    case GI_TYPE_TAG_UINT16:
+        value.setInt32(*(guint16 *) p);
+        break;
+    case GI_TYPE_TAG_INT32:
+        value.setInt32(*(gint32 *) p);
+        break;
+    case GI_TYPE_TAG_UINT32:
+        value.setNumber(*(guint32 *) p);
+        break;
+    case GI_TYPE_TAG_INT64:
+        value.set(JS::NumberValue(*(gint64 *) p));
+        break;
+    case GI_TYPE_TAG_UINT64:
+        value.set(JS::NumberValue(*(guint64 *) p));
+        break;
+    case GI_TYPE_TAG_FLOAT:
+        value.setNumber(*(gfloat *) p);
+        break;
+    case GI_TYPE_TAG_DOUBLE:
+        value.setNumber(*(gdouble *) p);
+        break;
+    default:
+        g_assert_not_reached();
+    }
 
- out:
-    return NULL;
+    return true;
 }
 
 static bool
-get_nested_interface_object (JSContext   *context,
-                             JSObject    *parent_obj,
-                             Boxed       *parent_priv,
-                             GIFieldInfo *field_info,
-                             GITypeInfo  *type_info,
-                             GIBaseInfo  *interface_info,
-                             JS::Value   *value)
+boxed_field_get_nested (JSContext             *context,
+                        JS::HandleObject       parent_obj,
+                        Boxed                 *parent_priv,
+                        BoxedField            *field,
+                        JS::MutableHandleValue value)
 {
     JSObject *obj;
-    int offset;
     Boxed *priv;
     Boxed *proto_priv;
 
-    if (!struct_is_simple ((GIStructInfo *)interface_info)) {
-        gjs_throw(context, "Reading field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)parent_priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-
+    JS::RootedObject proto(context, get_nested_proto(context, field));
+    if (!proto)
         return false;
-    }
-
-    JS::RootedObject global(context, gjs_get_import_global(context));
-    JS::RootedObject proto(context,
-                           gjs_lookup_generic_prototype(context,
-                                                        (GIBoxedInfo*) interface_info));
     proto_priv = priv_from_js(context, proto);
 
-    offset = g_field_info_get_offset (field_info);
-
+    JS::RootedObject global(context, gjs_get_import_global(context));
     obj = JS_NewObjectWithGivenProto(context, JS_GetClass(proto), proto, global);
 
     if (obj == NULL)
@@ -588,13 +764,14 @@ get_nested_interface_object (JSContext   *context,
     GJS_INC_COUNTER(boxed);
     priv = g_slice_new0(Boxed);
     JS_SetPrivate(obj, priv);
-    priv->info = (GIBoxedInfo*) interface_info;
+    priv->info = (GIBoxedInfo*) field->nested_info;
     g_base_info_ref( (GIBaseInfo*) priv->info);
-    priv->gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo*) interface_info);
+    priv->gtype = proto_priv->gtype;
     priv->can_allocate_directly = proto_priv->can_allocate_directly;
+    priv->fields = boxed_fields_ref(proto_priv->fields);
 
     /* A structure nested inside a parent object; doesn't have an independent allocation */
-    priv->gboxed = ((char *)parent_priv->gboxed) + offset;
+    priv->gboxed = ((char *)parent_priv->gboxed) + field->offset;
     priv->not_owning_gboxed = true;
 
     /* We never actually read the reserved slot, but we put the parent object
@@ -602,10 +779,25 @@ get_nested_interface_object (JSContext   *context,
      */
     JS_SetReservedSlot(obj, 0, JS::ObjectValue(*parent_obj));
 
-    *value = JS::ObjectValue(*obj);
+    value.setObject(*obj);
     return true;
 }
 
+static bool
+boxed_field_get_value (JSContext             *context,
+                       JS::HandleObject       obj,
+                       Boxed                 *priv,
+                       BoxedField            *field,
+                       JS::MutableHandleValue value)
+{
+    GArgument arg;
+
+    if (!g_field_info_get_field (field->info, priv->gboxed, &arg))
+        return boxed_field_get_unsupported(context, obj, priv, field, value);
+
+    return gjs_value_from_g_argument(context, value, field->type_info, &arg, true);
+}
+
 static bool
 boxed_field_getter (JSContext              *context,
                     JS::HandleObject        obj,
@@ -613,89 +805,191 @@ boxed_field_getter (JSContext              *context,
                     JS::MutableHandleValue  value)
 {
     Boxed *priv;
-    GIFieldInfo *field_info;
-    GITypeInfo *type_info;
-    GArgument arg;
-    bool success = false;
+    BoxedField *field;
 
     priv = priv_from_js(context, obj);
     if (!priv)
         return false;
 
-    field_info = get_field_info(context, priv, id);
-    if (!field_info)
+    field = get_field(context, priv, id);
+    if (!field)
         return false;
 
-    type_info = g_field_info_get_type (field_info);
-
     if (priv->gboxed == NULL) { /* direct access to proto field */
         gjs_throw(context, "Can't get field %s.%s from a prototype",
                   g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-        goto out;
+                  g_base_info_get_name ((GIBaseInfo *)field->info));
+        return false;
     }
 
-    if (!g_type_info_is_pointer (type_info) &&
-        g_type_info_get_tag (type_info) == GI_TYPE_TAG_INTERFACE) {
+    return field->get(context, obj, priv, field, value);
+}
 
-        GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+static bool
+boxed_field_set_unsupported (JSContext      *context,
+                             Boxed          *priv,
+                             BoxedField     *field,
+                             JS::HandleValue value)
+{
+    gjs_throw(context, "Writing field %s.%s is not supported",
+              g_base_info_get_name ((GIBaseInfo *)priv->info),
+              g_base_info_get_name ((GIBaseInfo *)field->info));
+    return false;
+}
 
-        if (g_base_info_get_type (interface_info) == GI_INFO_TYPE_STRUCT ||
-            g_base_info_get_type (interface_info) == GI_INFO_TYPE_BOXED) {
+/* Like the fast converters in function.cpp, numbers and booleans that
+ * obviously fit are converted here; anything else goes through
+ * gjs_value_to_g_argument(), which knows how to coerce and report errors.
+ */
+static bool
+boxed_field_value_to_primitive (JSContext      *context,
+                                BoxedField     *field,
+                                JS::HandleValue value,
+                                GArgument      *arg)
+{
+    if (value.isInt32()) {
+        gint32 i = value.toInt32();
 
-            success = get_nested_interface_object (context, obj, priv,
-                                                   field_info, type_info, interface_info,
-                                                   value.address());
+        switch (field->type_tag) {
+        case GI_TYPE_TAG_INT8:
+            if (i >= G_MININT8 && i <= G_MAXINT8) {
+                arg->v_int8 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_UINT8:
+            if (i >= 0 && i <= G_MAXUINT8) {
+                arg->v_uint8 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_INT16:
+            if (i >= G_MININT16 && i <= G_MAXINT16) {
+                arg->v_int16 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_UINT16:
+            if (i >= 0 && i <= G_MAXUINT16) {
+                arg->v_uint16 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_INT32:
+            arg->v_int32 = i;
+            return true;
+        case GI_TYPE_TAG_UINT32:
+            if (i >= 0) {
+                arg->v_uint32 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_INT64:
+            arg->v_int64 = i;
+            return true;
+        case GI_TYPE_TAG_UINT64:
+            if (i >= 0) {
+                arg->v_uint64 = i;
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
 
-            g_base_info_unref ((GIBaseInfo *)interface_info);
+    if (value.isNumber()) {
+        double v = value.toNumber();
 
-            goto out;
+        if (field->type_tag == GI_TYPE_TAG_DOUBLE) {
+            arg->v_double = v;
+            return true;
+        }
+        if (field->type_tag == GI_TYPE_TAG_FLOAT &&
+            v <= G_MAXFLOAT && v >= - G_MAXFLOAT) {
+            arg->v_float = (gfloat) v;
+            return true;
         }
-
-        g_base_info_unref ((GIBaseInfo *)interface_info);
     }
 
-    if (!g_field_info_get_field (field_info, priv->gboxed, &arg)) {
-        gjs_throw(context, "Reading field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-        goto out;
+    if (field->type_tag == GI_TYPE_TAG_BOOLEAN) {
+        arg->v_boolean = JS::ToBoolean(value);
+        return true;
     }
 
-    if (!gjs_value_from_g_argument(context, value, type_info, &arg, true))
-        goto out;
+    return gjs_value_to_g_argument(context, value,
+                                   field->type_info,
+                                   g_base_info_get_name ((GIBaseInfo *)field->info),
+                                   GJS_ARGUMENT_FIELD,
+                                   GI_TRANSFER_NOTHING,
+                                   true, arg);
+}
 
-    success = true;
+static bool
+boxed_field_set_primitive (JSContext      *context,
+                           Boxed          *priv,
+                           BoxedField     *field,
+                           JS::HandleValue value)
+{
+    void *p = ((char *)priv->gboxed) + field->offset;
+    GArgument arg;
 
-out:
-    g_base_info_unref ((GIBaseInfo *)type_info);
+    if (!boxed_field_value_to_primitive(context, field, value, &arg))
+        return false;
 
-    return success;
+    switch (field->type_tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+        *(gboolean *) p = arg.v_boolean;
+        break;
+    case GI_TYPE_TAG_INT8:
+        *(gint8 *) p = arg.v_int8;
+        break;
+    case GI_TYPE_TAG_UINT8:
+        *(guint8 *) p = arg.v_uint8;
+        break;
+    case GI_TYPE_TAG_INT16:
+        *(gint16 *) p = arg.v_int16;
+        break;
+    case GI_TYPE_TAG_UINT16:
+        *(guint16 *) p = arg.v_uint16;
+        break;
+    case GI_TYPE_TAG_INT32:
+        *(gint32 *) p = arg.v_int32;
+        break;
+    case GI_TYPE_TAG_UINT32:
+        *(guint32 *) p = arg.v_uint32;
+        break;
+    case GI_TYPE_TAG_INT64:
+        *(gint64 *) p = arg.v_int64;
+        break;
+    case GI_TYPE_TAG_UINT64:
+        *(guint64 *) p = arg.v_uint64;
+        break;
+    case GI_TYPE_TAG_FLOAT:
+        *(gfloat *) p = arg.v_float;
+        break;
+    case GI_TYPE_TAG_DOUBLE:
+        *(gdouble *) p = arg.v_double;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    return true;
 }
 
 static bool
-set_nested_interface_object (JSContext      *context,
-                             Boxed          *parent_priv,
-                             GIFieldInfo    *field_info,
-                             GITypeInfo     *type_info,
-                             GIBaseInfo     *interface_info,
-                             JS::HandleValue value)
+boxed_field_set_nested (JSContext      *context,
+                        Boxed          *parent_priv,
+                        BoxedField     *field,
+                        JS::HandleValue value)
 {
-    int offset;
     Boxed *proto_priv;
     Boxed *source_priv;
 
-    if (!struct_is_simple ((GIStructInfo *)interface_info)) {
-        gjs_throw(context, "Writing field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)parent_priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-
+    JS::RootedObject proto(context, get_nested_proto(context, field));
+    if (!proto)
         return false;
-    }
-
-    JS::RootedObject proto(context,
-                           gjs_lookup_generic_prototype(context,
-                                                        (GIBoxedInfo*) interface_info));
     proto_priv = priv_from_js(context, proto);
 
     /* If we can't directly copy from the source object we need
@@ -714,8 +1008,7 @@ set_nested_interface_object (JSContext      *context,
             return false;
     }
 
-    offset = g_field_info_get_offset (field_info);
-    memcpy(((char *)parent_priv->gboxed) + offset,
+    memcpy(((char *)parent_priv->gboxed) + field->offset,
            source_priv->gboxed,
            g_struct_info_get_size (source_priv->info));
 
@@ -723,65 +1016,30 @@ set_nested_interface_object (JSContext      *context,
 }
 
 static bool
-boxed_set_field_from_value(JSContext      *context,
-                           Boxed          *priv,
-                           GIFieldInfo    *field_info,
-                           JS::HandleValue value)
+boxed_field_set_value (JSContext      *context,
+                       Boxed          *priv,
+                       BoxedField     *field,
+                       JS::HandleValue value)
 {
-    GITypeInfo *type_info;
     GArgument arg;
     bool success = false;
-    bool need_release = false;
-
-    type_info = g_field_info_get_type (field_info);
-
-    if (!g_type_info_is_pointer (type_info) &&
-        g_type_info_get_tag (type_info) == GI_TYPE_TAG_INTERFACE) {
-
-        GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
-
-        if (g_base_info_get_type (interface_info) == GI_INFO_TYPE_STRUCT ||
-            g_base_info_get_type (interface_info) == GI_INFO_TYPE_BOXED) {
-
-            success = set_nested_interface_object (context, priv,
-                                                   field_info, type_info,
-                                                   interface_info, value);
-
-            g_base_info_unref ((GIBaseInfo *)interface_info);
-
-            goto out;
-        }
-
-        g_base_info_unref ((GIBaseInfo *)interface_info);
-
-    }
 
     if (!gjs_value_to_g_argument(context, value,
-                                 type_info,
-                                 g_base_info_get_name ((GIBaseInfo *)field_info),
+                                 field->type_info,
+                                 g_base_info_get_name ((GIBaseInfo *)field->info),
                                  GJS_ARGUMENT_FIELD,
                                  GI_TRANSFER_NOTHING,
                                  true, &arg))
-        goto out;
-
-    need_release = true;
-
-    if (!g_field_info_set_field (field_info, priv->gboxed, &arg)) {
-        gjs_throw(context, "Writing field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-        goto out;
-    }
-
-    success = true;
+        return false;
 
-out:
-    if (need_release)
-        gjs_g_argument_release (context, GI_TRANSFER_NOTHING,
-                                type_info,
-                                &arg);
+    if (g_field_info_set_field (field->info, priv->gboxed, &arg))
+        success = true;
+    else
+        boxed_field_set_unsupported(context, priv, field, value);
 
-    g_base_info_unref ((GIBaseInfo *)type_info);
+    gjs_g_argument_release (context, GI_TRANSFER_NOTHING,
+                            field->type_info,
+                            &arg);
 
     return success;
 }
@@ -794,28 +1052,100 @@ boxed_field_setter (JSContext              *context,
                     JS::MutableHandleValue  value)
 {
     Boxed *priv;
-    GIFieldInfo *field_info;
-    bool success = false;
+    BoxedField *field;
 
     priv = priv_from_js(context, obj);
     if (!priv)
         return false;
-    field_info = get_field_info(context, priv, id);
-    if (!field_info)
+    field = get_field(context, priv, id);
+    if (!field)
         return false;
 
     if (priv->gboxed == NULL) { /* direct access to proto field */
         gjs_throw(context, "Can't set field %s.%s on prototype",
                   g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-        goto out;
+                  g_base_info_get_name ((GIBaseInfo *)field->info));
+        return false;
     }
 
-    success = boxed_set_field_from_value (context, priv, field_info, value);
+    return field->set(context, priv, field, value);
+}
 
-out:
+static bool
+type_tag_is_primitive(GITypeTag tag)
+{
+    switch (tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+    case GI_TYPE_TAG_INT8:
+    case GI_TYPE_TAG_UINT8:
+    case GI_TYPE_TAG_INT16:
+    case GI_TYPE_TAG_UINT16:
+    case GI_TYPE_TAG_INT32:
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_INT64:
+    case GI_TYPE_TAG_UINT64:
+    case GI_TYPE_TAG_FLOAT:
+    case GI_TYPE_TAG_DOUBLE:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    return success;
+/* Works out once per type where each field lives and how to convert it,
+ * so that the getters and setters don't have to ask the typelib again.
+ * Set GJS_DISABLE_FAST_PATHS to convert every field through GArgument.
+ */
+static void
+fill_boxed_field (JSContext   *context,
+                  BoxedField  *field,
+                  GIFieldInfo *field_info,
+                  bool         use_fast_paths)
+{
+    GIFieldInfoFlags flags = g_field_info_get_flags (field_info);
+
+    field->id = gjs_intern_string_to_id(context,
+                                        g_base_info_get_name ((GIBaseInfo *)field_info));
+    field->info = field_info;
+    field->type_info = g_field_info_get_type (field_info);
+    field->type_tag = g_type_info_get_tag (field->type_info);
+    field->offset = g_field_info_get_offset (field_info);
+    field->get = boxed_field_get_value;
+    field->set = boxed_field_set_value;
+
+    if (g_type_info_is_pointer (field->type_info))
+        return;
+
+    if (field->type_tag == GI_TYPE_TAG_INTERFACE) {
+        GIBaseInfo *interface_info = g_type_info_get_interface(field->type_info);
+
+        if (g_base_info_get_type (interface_info) == GI_INFO_TYPE_STRUCT ||
+            g_base_info_get_type (interface_info) == GI_INFO_TYPE_BOXED) {
+            if (struct_is_simple ((GIStructInfo *)interface_info)) {
+                field->nested_info = (GIStructInfo *) interface_info;
+                field->get = boxed_field_get_nested;
+                field->set = boxed_field_set_nested;
+                return;
+            }
+
+            field->get = boxed_field_get_unsupported;
+            field->set = boxed_field_set_unsupported;
+        }
+
+        g_base_info_unref (interface_info);
+        return;
+    }
+
+    /* bitfields are left to girepository */
+    if (!use_fast_paths || !type_tag_is_primitive(field->type_tag) ||
+        g_field_info_get_size (field_info) != 0)
+        return;
+
+    /* the general converters report unreadable and unwritable fields */
+    if (flags & GI_FIELD_IS_READABLE)
+        field->get = boxed_field_get_primitive;
+    if (flags & GI_FIELD_IS_WRITABLE)
+        field->set = boxed_field_set_primitive;
 }
 
 static bool
@@ -824,8 +1154,34 @@ define_boxed_class_fields (JSContext       *context,
                            JS::HandleObject proto)
 {
     int n_fields = g_struct_info_get_n_fields (priv->info);
+    bool use_fast_paths = !gjs_environment_variable_is_set("GJS_DISABLE_FAST_PATHS");
     int i;
 
+    /* Every field is in the table, so that all of them can still be set
+     * from a hash of properties passed to the constructor. */
+    priv->fields = g_slice_new0(BoxedFields);
+    priv->fields->refcount = 1;
+    priv->fields->n_fields = n_fields;
+    priv->fields->fields = new BoxedField[n_fields]();
+
+    for (i = 0; i < n_fields; i++)
+        fill_boxed_field(context, &priv->fields->fields[i],
+                         g_struct_info_get_field (priv->info, i),
+                         use_fast_paths);
+
+    if (n_fields > BOXED_FIELDS_MAX_LINEAR) {
+        /* backwards, so that the first of two fields with the same name
+         * wins, as when searching the array */
+        priv->fields->by_id = g_hash_table_new(g_direct_hash, g_direct_equal);
+        for (i = n_fields - 1; i >= 0; i--) {
+            BoxedField *field = &priv->fields->fields[i];
+
+            g_hash_table_insert(priv->fields->by_id,
+                                GSIZE_TO_POINTER(JSID_BITS(field->id.get())),
+                                field);
+        }
+    }
+
     /* We define all fields as read/write so that the user gets an
      * error message. If we omitted fields or defined them read-only
      * we'd:
@@ -848,17 +1204,12 @@ define_boxed_class_fields (JSContext       *context,
     }
 
     for (i = 0; i < n_fields; i++) {
-        GIFieldInfo *field = g_struct_info_get_field (priv->info, i);
+        GIFieldInfo *field = priv->fields->fields[i].info;
         const char *field_name = g_base_info_get_name ((GIBaseInfo *)field);
-        bool result;
-
-        result = JS_DefineProperty(context, proto, field_name, JS::NullHandleValue,
-                                   JSPROP_PERMANENT | JSPROP_SHARED,
-                                   boxed_field_getter, boxed_field_setter);
 
-        g_base_info_unref ((GIBaseInfo *)field);
-
-        if (!result)
+        if (!JS_DefineProperty(context, proto, field_name, JS::NullHandleValue,
+                               JSPROP_PERMANENT | JSPROP_SHARED,
+                               boxed_field_getter, boxed_field_setter))
             return false;
     }
 
@@ -888,6 +1239,19 @@ boxed_trace(JSTracer *tracer,
                         "Boxed::zero_args_constructor_name");
     JS_CallHeapIdTracer(tracer, &priv->default_constructor_name,
                         "Boxed::default_constructor_name");
+
+    /* The field table belongs to the prototype; instances keep it alive */
+    if (priv->gboxed == NULL && priv->fields != NULL) {
+        int i;
+
+        for (i = 0; i < priv->fields->n_fields; i++) {
+            BoxedField *field = &priv->fields->fields[i];
+
+            JS_CallHeapIdTracer(tracer, &field->id, "BoxedField::id");
+            JS_CallHeapObjectTracer(tracer, &field->nested_proto,
+                                    "BoxedField::nested_proto");
+        }
+    }
 }
 
 /* The bizarre thing about this vtable is that it applies to both
@@ -902,6 +1266,7 @@ boxed_trace(JSTracer *tracer,
 struct JSClass gjs_boxed_class = {
     "GObject_Boxed",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE |
     JSCLASS_HAS_RESERVED_SLOTS(1),
     JS_PropertyStub,
@@ -1162,6 +1527,13 @@ gjs_define_boxed_class(JSContext       *context,
 
     priv->can_allocate_directly = struct_is_simple (priv->info);
 
+    /* Only where the constructor would allocate the struct itself; set
+     * GJS_DISABLE_FAST_PATHS to compare against separate allocations */
+    priv->can_allocate_inline = priv->can_allocate_directly &&
+        priv->zero_args_constructor < 0 &&
+        g_struct_info_get_size (priv->info) <= BOXED_INLINE_MAX_SIZE &&
+        !gjs_environment_variable_is_set("GJS_DISABLE_FAST_PATHS");
+
     define_boxed_class_fields (context, priv, prototype);
     gjs_define_static_methods (context, constructor, priv->gtype, priv->info);
 
@@ -1195,10 +1567,11 @@ gjs_boxed_from_c_struct(JSContext             *context,
     obj = JS_NewObjectWithGivenProto(context, JS_GetClass(proto), proto, global);
 
     GJS_INC_COUNTER(boxed);
-    priv = g_slice_new0(Boxed);
-
-    *priv = *proto_priv;
-    g_base_info_ref( (GIBaseInfo*) priv->info);
+    /* registered boxed types are copied with g_boxed_copy() below */
+    priv = boxed_new_instance_priv(proto_priv,
+                                   proto_priv->can_allocate_inline &&
+                                   (flags & GJS_BOXED_CREATION_NO_COPY) == 0 &&
+                                   !g_type_is_a(proto_priv->gtype, G_TYPE_BOXED));
 
     JS_SetPrivate(obj, priv);
 
@@ -1222,6 +1595,8 @@ gjs_boxed_from_c_struct(JSContext             *context,
                       "Can't create a Javascript object for %s; no way to copy",
                       g_base_info_get_name( (GIBaseInfo*) priv->info));
         }
+
+        boxed_track_native_memory(priv);
     }
 
     return obj;
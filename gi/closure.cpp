@@ -23,6 +23,7 @@
 
 #include <config.h>
 
+#include <new>
 #include <string.h>
 #include <limits.h>
 #include <util/log.h>
@@ -36,7 +37,7 @@ typedef struct {
     GClosure base;
     JSRuntime *runtime;
     JSContext *context;
-    JSObject *obj;
+    JS::Heap<JSObject *> obj;
     guint unref_on_global_object_finalized : 1;
 } Closure;
 
@@ -80,6 +81,7 @@ invalidate_js_pointers(Closure *c)
     if (c->obj == NULL)
         return;
 
+    gjs_heap_object_pre_barrier(c->obj);
     c->obj = NULL;
     c->context = NULL;
     c->runtime = NULL;
@@ -101,7 +103,7 @@ global_context_finalized(JSObject *obj,
 
     gjs_debug_closure("Context global object destroy notifier on closure %p "
                       "which calls object %p",
-                      c, c->obj);
+                      c, c->obj.get());
 
     /* invalidate_js_pointers() could free us so check flag now to avoid
      * invalid memory access
@@ -110,7 +112,7 @@ global_context_finalized(JSObject *obj,
     c->unref_on_global_object_finalized = false;
 
     if (c->obj != NULL) {
-        g_assert(c->obj == obj);
+        g_assert(c->obj.get() == obj);
 
         invalidate_js_pointers(c);
     }
@@ -139,7 +141,7 @@ check_context_valid(Closure *c)
 
     gjs_debug_closure("Context %p no longer exists, invalidating "
                       "closure %p which calls object %p",
-                      c->context, c, c->obj);
+                      c->context, c, c->obj.get());
 
     /* Did not find the context. */
     invalidate_js_pointers(c);
@@ -166,7 +168,7 @@ closure_invalidated(gpointer data,
 
     GJS_DEC_COUNTER(closure);
     gjs_debug_closure("Invalidating closure %p which calls object %p",
-                      closure, c->obj);
+                      closure, c->obj.get());
 
     if (c->obj == NULL) {
         gjs_debug_closure("   (closure %p already dead, nothing to do)",
@@ -223,9 +225,10 @@ closure_invalidated(gpointer data,
                           closure);
         gjs_keep_alive_remove_global_child(c->context,
                                            global_context_finalized,
-                                           c->obj,
+                                           c->obj.get(),
                                            c);
 
+        gjs_heap_object_pre_barrier(c->obj);
         c->obj = NULL;
         c->context = NULL;
         c->runtime = NULL;
@@ -238,6 +241,7 @@ closure_set_invalid(gpointer  data,
 {
     Closure *self = (Closure*) closure;
 
+    gjs_heap_object_pre_barrier(self->obj);
     self->obj = NULL;
     self->context = NULL;
     self->runtime = NULL;
@@ -265,7 +269,7 @@ gjs_closure_invoke(GClosure                   *closure,
 
     context = c->context;
     JS_BeginRequest(context);
-    JSAutoCompartment ac(context, c->obj);
+    JSAutoCompartment ac(context, c->obj.get());
 
     if (JS_IsExceptionPending(context)) {
         gjs_debug_closure("Exception was pending before invoking callback??? "
@@ -273,7 +277,7 @@ gjs_closure_invoke(GClosure                   *closure,
         gjs_log_exception(context);
     }
 
-    JS::RootedValue v_closure(context, JS::ObjectValue(*c->obj));
+    JS::RootedValue v_closure(context, JS::ObjectValue(*c->obj.get()));
     if (!gjs_call_function_value(context,
                                  /* "this" object; null is some kind of default presumably */
                                  JS::NullPtr(),
@@ -281,7 +285,7 @@ gjs_closure_invoke(GClosure                   *closure,
         /* Exception thrown... */
         gjs_debug_closure("Closure invocation failed (exception should "
                           "have been thrown) closure %p callable %p",
-                          closure, c->obj);
+                          closure, c->obj.get());
         if (!gjs_log_exception(context))
             gjs_debug_closure("Closure invocation failed but no exception was set?"
                               "closure %p", closure);
@@ -324,7 +328,17 @@ gjs_closure_get_callable(GClosure *closure)
 
     c = (Closure*) closure;
 
-    return c->obj;
+    return c->obj.get();
+}
+
+static void
+closure_finalize(gpointer  data,
+                 GClosure *closure)
+{
+    Closure *self = (Closure*) closure;
+
+    gjs_heap_object_pre_barrier(self->obj);
+    self->obj.~Heap();
 }
 
 void
@@ -338,7 +352,7 @@ gjs_closure_trace(GClosure *closure,
     if (c->obj == NULL)
         return;
 
-    JS_CallObjectTracer(tracer, &c->obj, "signal connection");
+    JS_CallHeapObjectTracer(tracer, &c->obj, "signal connection");
 }
 
 GClosure*
@@ -350,6 +364,10 @@ gjs_closure_new(JSContext  *context,
     Closure *c;
 
     c = (Closure*) g_closure_new_simple(sizeof(Closure), NULL);
+    /* The GClosure is allocated by GLib, so the barriered pointer has to
+     * be constructed in place and destroyed in the finalize notifier */
+    new (&c->obj) JS::Heap<JSObject *>();
+    g_closure_add_finalize_notifier(&c->base, NULL, closure_finalize);
     c->runtime = JS_GetRuntime(context);
     /* The saved context is used for lifetime management, so that the closure will
      * be torn down with the context that created it. The context could be attached to
@@ -368,7 +386,7 @@ gjs_closure_new(JSContext  *context,
         /* Fully manage closure lifetime if so asked */
         gjs_keep_alive_add_global_child(context,
                                         global_context_finalized,
-                                        c->obj,
+                                        c->obj.get(),
                                         c);
 
         g_closure_add_invalidate_notifier(&c->base, NULL, closure_invalidated);
@@ -379,7 +397,7 @@ gjs_closure_new(JSContext  *context,
     }
 
     gjs_debug_closure("Create closure %p which calls object %p '%s'",
-                      c, c->obj, description);
+                      c, c->obj.get(), description);
 
     JS_EndRequest(context);
 
@@ -26,16 +26,49 @@
 #include <string.h>
 
 #include "gjs/jsapi-wrapper.h"
+#include "gjs/mem.h"
 #include "repo.h"
 #include "gtype.h"
 #include "function.h"
 
 #include <util/log.h>
+#include <util/misc.h>
 
 #include <girepository.h>
 
 #include "enumeration.h"
 
+typedef struct {
+    GIEnumInfo *info;
+    /* JS name -> member, built on the first lookup; see enum_find_member() */
+    GHashTable *members;
+} Enum;
+
+extern struct JSClass gjs_enum_class;
+
+GJS_DEFINE_PRIV_FROM_JS(Enum, gjs_enum_class)
+
+/* g-i converts enum members such as GDK_GRAVITY_SOUTH_WEST to
+ * Gdk.GravityType.south-west (where 'south-west' is value_name)
+ * Convert back to all SOUTH_WEST.
+ */
+static char *
+fix_value_name(const char *value_name)
+{
+    char *fixed_name;
+    gsize i;
+
+    fixed_name = g_ascii_strup(value_name, -1);
+    for (i = 0; fixed_name[i]; ++i) {
+        char c = fixed_name[i];
+        if (!(('A' <= c && c <= 'Z') ||
+              ('0' <= c && c <= '9')))
+            fixed_name[i] = '_';
+    }
+
+    return fixed_name;
+}
+
 static bool
 gjs_define_enum_value(JSContext       *context,
                       JS::HandleObject in_object,
@@ -43,23 +76,12 @@ gjs_define_enum_value(JSContext       *context,
 {
     const char *value_name;
     char *fixed_name;
-    gsize i;
     gint64 value_val;
 
     value_name = g_base_info_get_name( (GIBaseInfo*) info);
     value_val = g_value_info_get_value(info);
 
-    /* g-i converts enum members such as GDK_GRAVITY_SOUTH_WEST to
-     * Gdk.GravityType.south-west (where 'south-west' is value_name)
-     * Convert back to all SOUTH_WEST.
-     */
-    fixed_name = g_ascii_strup(value_name, -1);
-    for (i = 0; fixed_name[i]; ++i) {
-        char c = fixed_name[i];
-        if (!(('A' <= c && c <= 'Z') ||
-              ('0' <= c && c <= '9')))
-            fixed_name[i] = '_';
-    }
+    fixed_name = fix_value_name(value_name);
 
     gjs_debug(GJS_DEBUG_GENUM,
               "Defining enum value %s (fixed from %s) %" G_GINT64_MODIFIER "d",
@@ -146,16 +168,323 @@ gjs_define_enum_static_methods(JSContext       *context,
     return true;
 }
 
+/* Members are encoded as the index of the value plus one, or minus the
+ * index of the static method minus one */
+static void
+enum_build_members(Enum *priv)
+{
+    int i, n;
+
+    priv->members = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                          g_free, NULL);
+
+    n = g_enum_info_get_n_values(priv->info);
+    for (i = 0; i < n; i++) {
+        GIValueInfo *value_info = g_enum_info_get_value(priv->info, i);
+        char *fixed_name = fix_value_name(g_base_info_get_name(value_info));
+
+        if (g_hash_table_contains(priv->members, fixed_name))
+            g_free(fixed_name);
+        else
+            g_hash_table_insert(priv->members, fixed_name,
+                                GINT_TO_POINTER(i + 1));
+
+        g_base_info_unref(value_info);
+    }
+
+    n = g_enum_info_get_n_methods(priv->info);
+    for (i = 0; i < n; i++) {
+        GIFunctionInfo *meth_info = g_enum_info_get_method(priv->info, i);
+
+        /* see gjs_define_enum_static_methods() */
+        if (!(g_function_info_get_flags(meth_info) & GI_FUNCTION_IS_METHOD))
+            g_hash_table_insert(priv->members,
+                                g_strdup(g_base_info_get_name(meth_info)),
+                                GINT_TO_POINTER(-(i + 1)));
+
+        g_base_info_unref(meth_info);
+    }
+}
+
+static int
+enum_find_member(Enum       *priv,
+                 const char *name)
+{
+    if (priv->members == NULL)
+        enum_build_members(priv);
+
+    return GPOINTER_TO_INT(g_hash_table_lookup(priv->members, name));
+}
+
+static bool
+enum_define_member(JSContext       *context,
+                   JS::HandleObject obj,
+                   Enum            *priv,
+                   int              member)
+{
+    bool ok;
+
+    if (member > 0) {
+        GIValueInfo *value_info = g_enum_info_get_value(priv->info,
+                                                        member - 1);
+        ok = gjs_define_enum_value(context, obj, value_info);
+        g_base_info_unref(value_info);
+    } else {
+        GIFunctionInfo *meth_info = g_enum_info_get_method(priv->info,
+                                                           -member - 1);
+        ok = gjs_define_function(context, obj, G_TYPE_NONE,
+                                 (GICallableInfo *) meth_info) != NULL;
+        g_base_info_unref(meth_info);
+    }
+
+    return ok;
+}
+
+/*
+ * The *objp out parameter, on success, should be null to indicate that id
+ * was not resolved; and non-null, referring to obj or one of its prototypes,
+ * if id was resolved.
+ */
+static bool
+enum_new_resolve(JSContext *context,
+                 JS::HandleObject obj,
+                 JS::HandleId id,
+                 JS::MutableHandleObject objp)
+{
+    Enum *priv;
+    const char *name;
+    int member;
+    bool ret = true;
+
+    if (!gjs_borrow_string_id(context, id, &name))
+        return true; /* not resolved, but no error */
+
+    priv = priv_from_js(context, obj);
+    gjs_debug_jsprop(GJS_DEBUG_GENUM,
+                     "Resolve prop '%s' hook obj %p priv %p",
+                     name, obj.get(), priv);
+    if (priv == NULL)
+        goto out; /* we are the prototype, or have the wrong class */
+
+    if (strcmp(name, "$gtype") == 0) {
+        GType gtype = g_registered_type_info_get_g_type((GIRegisteredTypeInfo *) priv->info);
+        JS::RootedObject gtype_obj(context,
+            gjs_gtype_create_gtype_wrapper(context, gtype));
+        if (JS_DefineProperty(context, obj, "$gtype", gtype_obj,
+                              JSPROP_PERMANENT))
+            objp.set(obj);
+        else
+            ret = false;
+        goto out;
+    }
+
+    member = enum_find_member(priv, name);
+    if (member == 0)
+        goto out; /* not one of ours; let Object.prototype resolve it */
+
+    if (enum_define_member(context, obj, priv, member))
+        objp.set(obj);
+    else
+        ret = false;
+
+ out:
+    gjs_release_string_id(context, name);
+    return ret;
+}
+
+/* Enumerating the properties has to show all of them, so this is where
+ * we define everything that was not looked up yet */
+static bool
+enum_enumerate(JSContext       *context,
+               JS::HandleObject obj)
+{
+    Enum *priv;
+    int i, n;
+
+    priv = priv_from_js(context, obj);
+    if (priv == NULL)
+        return true;
+
+    n = g_enum_info_get_n_values(priv->info);
+    for (i = 0; i < n; i++) {
+        GIValueInfo *value_info = g_enum_info_get_value(priv->info, i);
+        char *fixed_name = fix_value_name(g_base_info_get_name(value_info));
+        bool found;
+        bool ok = JS_AlreadyHasOwnProperty(context, obj, fixed_name, &found) &&
+            (found || gjs_define_enum_value(context, obj, value_info));
+
+        g_free(fixed_name);
+        g_base_info_unref(value_info);
+        if (!ok)
+            return false;
+    }
+
+    n = g_enum_info_get_n_methods(priv->info);
+    for (i = 0; i < n; i++) {
+        GIFunctionInfo *meth_info = g_enum_info_get_method(priv->info, i);
+        bool found = true;
+        bool ok = true;
+
+        if (!(g_function_info_get_flags(meth_info) & GI_FUNCTION_IS_METHOD)) {
+            ok = JS_AlreadyHasOwnProperty(context, obj,
+                                          g_base_info_get_name(meth_info),
+                                          &found);
+            if (ok && !found)
+                ok = gjs_define_function(context, obj, G_TYPE_NONE,
+                                         (GICallableInfo *) meth_info) != NULL;
+        }
+
+        g_base_info_unref(meth_info);
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+GJS_NATIVE_CONSTRUCTOR_DEFINE_ABSTRACT(enum)
+
+static void
+enum_finalize(JSFreeOp *fop,
+              JSObject *obj)
+{
+    Enum *priv;
+
+    priv = (Enum *) JS_GetPrivate(obj);
+    gjs_debug_lifecycle(GJS_DEBUG_GENUM,
+                        "finalize, obj %p priv %p", obj, priv);
+    if (priv == NULL)
+        return; /* we are the prototype, not a real instance */
+
+    g_clear_pointer(&priv->members, g_hash_table_destroy);
+    g_base_info_unref((GIBaseInfo *) priv->info);
+
+    GJS_DEC_COUNTER(enumeration);
+    g_slice_free(Enum, priv);
+}
+
+/* The bizarre thing about this vtable is that it applies to both
+ * instances of the object, and to the prototype that instances of the
+ * class have.
+ */
+struct JSClass gjs_enum_class = {
+    "GIRepositoryEnum",
+    JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
+    JSCLASS_NEW_RESOLVE,
+    JS_PropertyStub,
+    JS_DeletePropertyStub,
+    JS_PropertyStub,
+    JS_StrictPropertyStub,
+    enum_enumerate,
+    (JSResolveOp) enum_new_resolve, /* needs cast since it's the new resolve signature */
+    JS_ConvertStub,
+    enum_finalize
+};
+
+JSPropertySpec gjs_enum_proto_props[] = {
+    JS_PS_END
+};
+
+JSFunctionSpec gjs_enum_proto_funcs[] = {
+    JS_FS_END
+};
+
+/* Creates an object whose values and static methods are only defined
+ * when they are first looked up */
+static JSObject *
+enum_new(JSContext  *context,
+         GIEnumInfo *info)
+{
+    Enum *priv;
+    bool found;
+
+    JS::RootedObject global(context, gjs_get_import_global(context));
+
+    if (!JS_HasProperty(context, global, gjs_enum_class.name, &found))
+        return NULL;
+    if (!found) {
+        JSObject *prototype;
+        prototype = JS_InitClass(context, global,
+                                 /* parent prototype JSObject* for
+                                  * prototype; NULL for
+                                  * Object.prototype
+                                  */
+                                 JS::NullPtr(),
+                                 &gjs_enum_class,
+                                 /* constructor for instances (NULL for
+                                  * none - just name the prototype like
+                                  * Math - rarely correct)
+                                  */
+                                 gjs_enum_constructor,
+                                 /* number of constructor args */
+                                 0,
+                                 /* props of prototype */
+                                 &gjs_enum_proto_props[0],
+                                 /* funcs of prototype */
+                                 &gjs_enum_proto_funcs[0],
+                                 /* props of constructor, MyConstructor.myprop */
+                                 NULL,
+                                 /* funcs of constructor, MyConstructor.myfunc() */
+                                 NULL);
+        if (prototype == NULL)
+            g_error("Can't init class %s", gjs_enum_class.name);
+
+        gjs_debug(GJS_DEBUG_GENUM, "Initialized class %s prototype %p",
+                  gjs_enum_class.name, prototype);
+    }
+
+    JS::RootedObject enum_obj(context,
+        JS_NewObject(context, &gjs_enum_class, JS::NullPtr(), global));
+    if (enum_obj == NULL)
+        return NULL;
+
+    priv = g_slice_new0(Enum);
+    priv->info = (GIEnumInfo *) g_base_info_ref((GIBaseInfo *) info);
+
+    GJS_INC_COUNTER(enumeration);
+
+    g_assert(priv_from_js(context, enum_obj) == NULL);
+    JS_SetPrivate(enum_obj, priv);
+
+    return enum_obj;
+}
+
+/* The old way, defining everything up front; kept for comparison with
+ * GJS_DISABLE_FAST_PATHS */
+static JSObject *
+enum_new_eager(JSContext  *context,
+               GIEnumInfo *info)
+{
+    JS::RootedObject global(context, gjs_get_import_global(context));
+
+    JS::RootedObject enum_obj(context, JS_NewObject(context, NULL, JS::NullPtr(),
+                                                    global));
+    if (enum_obj == NULL)
+        return NULL;
+
+    /* https://bugzilla.mozilla.org/show_bug.cgi?id=599651 means we
+     * can't just pass in the global as the parent */
+    JS_SetParent(context, enum_obj, global);
+
+    if (!gjs_define_enum_values(context, enum_obj, info))
+        return NULL;
+    gjs_define_enum_static_methods (context, enum_obj, info);
+
+    return enum_obj;
+}
+
 bool
 gjs_define_enumeration(JSContext       *context,
                        JS::HandleObject in_object,
                        GIEnumInfo      *info)
 {
     const char *enum_name;
-    JS::RootedObject global(context, gjs_get_import_global(context));
 
     /* An enumeration is simply an object containing integer attributes for
-     * each enum value. It does not have a special JSClass.
+     * each enum value. It does not have a special JSClass, other than for
+     * defining the values lazily, since big namespaces have a lot of
+     * enumerations most of whose values are never used.
      *
      * We could make this more typesafe and also print enum values as strings
      * if we created a class for each enum and made the enum values instances
@@ -165,21 +494,19 @@ gjs_define_enumeration(JSContext       *context,
 
     enum_name = g_base_info_get_name( (GIBaseInfo*) info);
 
-    JS::RootedObject enum_obj(context, JS_NewObject(context, NULL, JS::NullPtr(),
-                                                    global));
-    if (enum_obj == NULL) {
-        g_error("Could not create enumeration %s.%s",
-               	g_base_info_get_namespace( (GIBaseInfo*) info),
-                enum_name);
-    }
+    JS::RootedObject enum_obj(context);
+    if (gjs_environment_variable_is_set("GJS_DISABLE_FAST_PATHS"))
+        enum_obj = enum_new_eager(context, info);
+    else
+        enum_obj = enum_new(context, info);
 
-    /* https://bugzilla.mozilla.org/show_bug.cgi?id=599651 means we
-     * can't just pass in the global as the parent */
-    JS_SetParent(context, enum_obj, global);
-
-    if (!gjs_define_enum_values(context, enum_obj, info))
+    if (enum_obj == NULL) {
+        if (!JS_IsExceptionPending(context))
+            g_error("Could not create enumeration %s.%s",
+                    g_base_info_get_namespace( (GIBaseInfo*) info),
+                    enum_name);
         return false;
-    gjs_define_enum_static_methods (context, enum_obj, info);
+    }
 
     gjs_debug(GJS_DEBUG_GENUM,
               "Defining %s.%s as %p",
@@ -33,11 +33,13 @@
 #include "closure.h"
 #include "gtype.h"
 #include "param.h"
+#include "gjs/byteArray.h"
 #include "gjs/jsapi-private.h"
 #include "gjs/jsapi-wrapper.h"
 #include "gjs/mem.h"
 
 #include <util/log.h>
+#include <util/misc.h>
 
 #include <girepository.h>
 #include <sys/mman.h>
@@ -50,10 +52,78 @@
  */
 #define GJS_ARG_INDEX_INVALID G_MAXUINT8
 
+/* Everything gjs_invoke_c_function() needs to know about one argument,
+ * computed once in init_cached_function_data() so that invoking the
+ * function does not need to go back to the typelib.
+ */
+typedef struct _ArgPlan ArgPlan;
+
+typedef bool (*ArgPlanInFunc) (JSContext       *context,
+                               ArgPlan         *plan,
+                               JS::HandleValue  value,
+                               GIArgument      *arg);
+
+struct _ArgPlan {
+    /* Loaded in place; they are only valid while Function.info is alive */
+    GIArgInfo arg_info;
+    GITypeInfo type_info;
+    const char *name;
+
+    GjsParamType param_type;
+    GIDirection direction;
+    GITypeTag type_tag;
+    GITransfer transfer;
+    GjsArgumentType argument_type;
+    bool may_be_null;
+
+    /* (out caller-allocates); size is 0 if the type is unsupported */
+    bool is_caller_allocates;
+    gsize caller_allocates_size;
+
+    /* GJS_ARG_INDEX_INVALID if not applicable, otherwise the index of
+     * the corresponding GI argument (not counting the instance) */
+    guint8 array_length_pos;
+    guint8 closure_pos;
+    guint8 destroy_pos;
+
+    /* PARAM_CALLBACK only; owned */
+    GICallableInfo *callback_info;
+    GIScopeType scope;
+
+    /* Converter for (in) and (inout) values */
+    ArgPlanInFunc in;
+    /* (in) GBytes with transfer none; the converter took a reference that
+     * is dropped after the call */
+    bool holds_bytes_ref;
+    /* (in) GByteArray with transfer none; a ByteArray passed for it is
+     * copied, so what the function changes is copied back after the call */
+    bool updates_byte_array;
+};
+
 typedef struct {
     GIFunctionInfo *info;
 
-    GjsParamType *param_types;
+    ArgPlan *args;
+    guint8 n_args;
+
+    bool is_method;
+    bool can_throw_gerror;
+
+    /* Instance parameter, only valid if is_method */
+    GIBaseInfo *container;
+    GIInfoType container_type;
+    GType container_gtype;
+    bool container_is_gtype_struct;
+    GITransfer instance_transfer;
+
+    GITypeInfo return_info;
+    GITypeTag return_tag;
+    GITransfer return_transfer;
+    guint8 return_array_length_pos;
+
+    /* All arguments and the return value are passed by value and need no
+     * release, see function_is_primitive() */
+    bool is_primitive;
 
     guint8 expected_js_argc;
     guint8 js_out_argc;
@@ -68,6 +138,17 @@ extern struct JSClass gjs_function_class;
  */
 static GSList *completed_trampolines = NULL;  /* GjsCallbackTrampoline */
 
+/* Preparing a closure allocates executable memory, so the trampolines for
+ * (scope call) callbacks are kept for reuse once the call is over, up to a
+ * limit. They are found by the name of their callback info, which points
+ * into the typelib and so stays valid; infos that share a name but are not
+ * equal are told apart with g_base_info_equal().
+ */
+#define TRAMPOLINE_POOL_MAX_SIZE 64
+
+static GHashTable *trampoline_pool = NULL;  /* name -> GSList of GjsCallbackTrampoline */
+static guint trampoline_pool_size = 0;
+
 GJS_DEFINE_PRIV_FROM_JS(Function, gjs_function_class)
 
 void
@@ -76,6 +157,74 @@ gjs_callback_trampoline_ref(GjsCallbackTrampoline *trampoline)
     trampoline->ref_count++;
 }
 
+static void
+trampoline_free(GjsCallbackTrampoline *trampoline)
+{
+    g_callable_info_free_closure(trampoline->info, trampoline->closure);
+    g_base_info_unref( (GIBaseInfo*) trampoline->info);
+    g_free (trampoline->param_types);
+    g_slice_free(GjsCallbackTrampoline, trampoline);
+}
+
+static bool
+trampoline_pool_put(GjsCallbackTrampoline *trampoline)
+{
+    const char *name;
+    GSList *list;
+
+    if (trampoline->scope != GI_SCOPE_TYPE_CALL || trampoline->is_vfunc ||
+        trampoline_pool_size >= TRAMPOLINE_POOL_MAX_SIZE)
+        return false;
+
+    name = g_base_info_get_name((GIBaseInfo *) trampoline->info);
+    if (name == NULL)
+        return false;
+
+    if (trampoline_pool == NULL)
+        trampoline_pool = g_hash_table_new(g_str_hash, g_str_equal);
+
+    list = (GSList *) g_hash_table_lookup(trampoline_pool, name);
+    g_hash_table_insert(trampoline_pool, (gpointer) name,
+                        g_slist_prepend(list, trampoline));
+    trampoline_pool_size++;
+
+    return true;
+}
+
+static GjsCallbackTrampoline *
+trampoline_pool_take(GICallableInfo *callable_info)
+{
+    const char *name;
+    GSList *list, *iter;
+
+    if (trampoline_pool == NULL)
+        return NULL;
+
+    name = g_base_info_get_name((GIBaseInfo *) callable_info);
+    if (name == NULL)
+        return NULL;
+
+    list = (GSList *) g_hash_table_lookup(trampoline_pool, name);
+    for (iter = list; iter; iter = iter->next) {
+        GjsCallbackTrampoline *trampoline = (GjsCallbackTrampoline *) iter->data;
+
+        if (!g_base_info_equal((GIBaseInfo *) trampoline->info,
+                               (GIBaseInfo *) callable_info))
+            continue;
+
+        list = g_slist_delete_link(list, iter);
+        if (list != NULL)
+            g_hash_table_insert(trampoline_pool, (gpointer) name, list);
+        else
+            g_hash_table_remove(trampoline_pool, name);
+        trampoline_pool_size--;
+
+        return trampoline;
+    }
+
+    return NULL;
+}
+
 void
 gjs_callback_trampoline_unref(GjsCallbackTrampoline *trampoline)
 {
@@ -91,13 +240,50 @@ gjs_callback_trampoline_unref(GjsCallbackTrampoline *trampoline)
             JS_EndRequest(context);
         }
 
-        g_callable_info_free_closure(trampoline->info, trampoline->closure);
-        g_base_info_unref( (GIBaseInfo*) trampoline->info);
-        g_free (trampoline->param_types);
-        g_slice_free(GjsCallbackTrampoline, trampoline);
+        trampoline->js_function = JS::UndefinedValue();
+        if (trampoline_pool_put(trampoline))
+            return;
+
+        trampoline_free(trampoline);
     }
 }
 
+static void
+free_pooled_trampolines(gpointer key,
+                        gpointer value,
+                        gpointer user_data)
+{
+    g_slist_free_full((GSList *) value, (GDestroyNotify) trampoline_free);
+}
+
+/* Releases the trampolines that are only waiting to be freed or reused,
+ * so that their closures and callable infos don't outlive the context
+ * that created them.
+ */
+void
+gjs_callback_trampoline_pool_drain(void)
+{
+    GSList *iter;
+
+    for (iter = completed_trampolines; iter; iter = iter->next)
+        gjs_callback_trampoline_unref((GjsCallbackTrampoline *) iter->data);
+    g_slist_free(completed_trampolines);
+    completed_trampolines = NULL;
+
+    if (trampoline_pool == NULL)
+        return;
+
+    g_hash_table_foreach(trampoline_pool, free_pooled_trampolines, NULL);
+    g_clear_pointer(&trampoline_pool, g_hash_table_unref);
+    trampoline_pool_size = 0;
+}
+
+guint
+gjs_callback_trampoline_pool_size(void)
+{
+    return trampoline_pool_size;
+}
+
 static void
 set_return_ffi_arg_from_giargument (GITypeInfo  *ret_type,
                                     void        *result,
@@ -449,6 +635,21 @@ gjs_callback_trampoline_new(JSContext      *context,
 
     g_assert(JS_TypeOfValue(context, function) == JSTYPE_FUNCTION);
 
+    /* A recycled trampoline keeps its closure, cif and param types */
+    if (scope == GI_SCOPE_TYPE_CALL && !is_vfunc) {
+        trampoline = trampoline_pool_take(callable_info);
+        if (trampoline != NULL) {
+            GJS_INC_STAT_COUNTER(trampoline_pool_hit);
+            trampoline->ref_count = 1;
+            trampoline->context = context;
+            trampoline->js_function = function;
+            JS::AddValueRoot(context, &trampoline->js_function);
+            return trampoline;
+        }
+
+        GJS_INC_STAT_COUNTER(trampoline_pool_miss);
+    }
+
     trampoline = g_slice_new(GjsCallbackTrampoline);
     trampoline->ref_count = 1;
     trampoline->context = context;
@@ -554,10 +755,10 @@ gjs_fill_method_instance(JSContext       *context,
                          Function        *function,
                          GIArgument      *out_arg)
 {
-    GIBaseInfo *container = g_base_info_get_container((GIBaseInfo *) function->info);
-    GIInfoType type = g_base_info_get_type(container);
-    GType gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo *)container);
-    GITransfer transfer = g_callable_info_get_instance_ownership_transfer (function->info);
+    GIBaseInfo *container = function->container;
+    GIInfoType type = function->container_type;
+    GType gtype = function->container_gtype;
+    GITransfer transfer = function->instance_transfer;
 
     if (type == GI_INFO_TYPE_STRUCT || type == GI_INFO_TYPE_BOXED) {
         /* GError must be special cased */
@@ -569,7 +770,7 @@ gjs_fill_method_instance(JSContext       *context,
             if (transfer == GI_TRANSFER_EVERYTHING)
                 out_arg->v_pointer = g_error_copy ((GError*) out_arg->v_pointer);
         } else if (type == GI_INFO_TYPE_STRUCT &&
-                   g_struct_info_is_gtype_struct((GIStructInfo*) container)) {
+                   function->container_is_gtype_struct) {
             /* And so do GType structures */
             GType actual_gtype;
             gpointer klass;
@@ -664,6 +865,182 @@ gjs_fill_method_instance(JSContext       *context,
     return true;
 }
 
+static bool
+check_js_argc(JSContext                  *context,
+              Function                   *function,
+              const JS::HandleValueArray& args)
+{
+    if (args.length() < function->expected_js_argc) {
+        gjs_throw(context,
+                  "Too few arguments to %s %s.%s expected %d got %" G_GSIZE_FORMAT,
+                  function->is_method ? "method" : "function",
+                  g_base_info_get_namespace( (GIBaseInfo*) function->info),
+                  g_base_info_get_name( (GIBaseInfo*) function->info),
+                  function->expected_js_argc,
+                  args.length());
+        return false;
+    }
+
+    return true;
+}
+
+/* See comment for GjsFFIReturnValue above */
+static gpointer
+get_return_value_pointer(GITypeTag         return_tag,
+                         GIFFIReturnValue *return_value)
+{
+    if (return_tag == GI_TYPE_TAG_FLOAT)
+        return &return_value->v_float;
+    else if (return_tag == GI_TYPE_TAG_DOUBLE)
+        return &return_value->v_double;
+    else if (return_tag == GI_TYPE_TAG_INT64 || return_tag == GI_TYPE_TAG_UINT64)
+        return &return_value->v_uint64;
+    else
+        return &return_value->v_long;
+}
+
+/* Default converter for (in) and (inout) arguments */
+static bool
+arg_plan_value_to_arg(JSContext       *context,
+                      ArgPlan         *plan,
+                      JS::HandleValue  value,
+                      GIArgument      *arg)
+{
+    return gjs_value_to_g_argument(context, value, &plan->type_info,
+                                   plan->name, plan->argument_type,
+                                   plan->transfer, plan->may_be_null, arg);
+}
+
+/* Fast converters for the common cases of numbers and booleans; anything
+ * unusual (out of range, not a number) goes through the default converter,
+ * which knows how to coerce and report errors.
+ */
+static bool
+arg_plan_int_to_arg(JSContext       *context,
+                    ArgPlan         *plan,
+                    JS::HandleValue  value,
+                    GIArgument      *arg)
+{
+    if (value.isInt32()) {
+        gint32 i = value.toInt32();
+
+        switch (plan->type_tag) {
+        case GI_TYPE_TAG_INT8:
+            if (i >= G_MININT8 && i <= G_MAXINT8) {
+                arg->v_int8 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_UINT8:
+            if (i >= 0 && i <= G_MAXUINT8) {
+                arg->v_uint8 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_INT16:
+            if (i >= G_MININT16 && i <= G_MAXINT16) {
+                arg->v_int16 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_UINT16:
+            if (i >= 0 && i <= G_MAXUINT16) {
+                arg->v_uint16 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_INT32:
+            arg->v_int32 = i;
+            return true;
+        case GI_TYPE_TAG_UINT32:
+            if (i >= 0) {
+                arg->v_uint32 = i;
+                return true;
+            }
+            break;
+        case GI_TYPE_TAG_INT64:
+            arg->v_int64 = i;
+            return true;
+        case GI_TYPE_TAG_UINT64:
+            if (i >= 0) {
+                arg->v_uint64 = i;
+                return true;
+            }
+            break;
+        default:
+            g_assert_not_reached();
+        }
+    }
+
+    return arg_plan_value_to_arg(context, plan, value, arg);
+}
+
+static bool
+arg_plan_double_to_arg(JSContext       *context,
+                       ArgPlan         *plan,
+                       JS::HandleValue  value,
+                       GIArgument      *arg)
+{
+    if (value.isNumber()) {
+        double v = value.toNumber();
+
+        if (plan->type_tag == GI_TYPE_TAG_DOUBLE) {
+            arg->v_double = v;
+            return true;
+        }
+        if (v <= G_MAXFLOAT && v >= - G_MAXFLOAT) {
+            arg->v_float = (gfloat) v;
+            return true;
+        }
+    }
+
+    return arg_plan_value_to_arg(context, plan, value, arg);
+}
+
+/* A ByteArray only lends out the GBytes for its data until it is next
+ * written to, which JS code called back from the function could do */
+static bool
+arg_plan_bytes_to_arg(JSContext       *context,
+                      ArgPlan         *plan,
+                      JS::HandleValue  value,
+                      GIArgument      *arg)
+{
+    if (!arg_plan_value_to_arg(context, plan, value, arg))
+        return false;
+
+    if (arg->v_pointer != NULL)
+        g_bytes_ref((GBytes *) arg->v_pointer);
+    return true;
+}
+
+/* Brings the changes that the function made to the GByteArray copy of a
+ * ByteArray back into it */
+static bool
+arg_plan_update_byte_array(JSContext       *context,
+                           JS::HandleValue  value,
+                           GIArgument      *arg)
+{
+    if (arg->v_pointer == NULL || !value.isObject())
+        return true;
+
+    JS::RootedObject obj(context, &value.toObject());
+    if (!gjs_typecheck_bytearray(context, obj, false))
+        return true;
+
+    return gjs_byte_array_update_from_byte_array(context, obj,
+                                                 (GByteArray *) arg->v_pointer);
+}
+
+static bool
+arg_plan_boolean_to_arg(JSContext       *context,
+                        ArgPlan         *plan,
+                        JS::HandleValue  value,
+                        GIArgument      *arg)
+{
+    arg->v_boolean = JS::ToBoolean(value);
+    return true;
+}
+
 /*
  * This function can be called in 2 different ways. You can either use
  * it to create javascript objects by providing a @js_rval argument or
@@ -701,13 +1078,13 @@ gjs_invoke_c_function(JSContext                              *context,
     guint8 gi_argc, gi_arg_pos;
     guint8 c_argc, c_arg_pos;
     guint8 js_arg_pos;
+    guint8 *in_js_arg_pos; /* JS argument of each GI argument, if needed */
     bool can_throw_gerror;
     bool did_throw_gerror = false;
     GError *local_error = NULL;
     bool failed, postinvoke_release_failed;
 
     bool is_method;
-    GITypeInfo return_info;
     GITypeTag return_tag;
     JS::AutoValueVector return_values(context);
     guint8 next_rval = 0; /* index into return_values */
@@ -726,11 +1103,11 @@ gjs_invoke_c_function(JSContext                              *context,
         completed_trampolines = NULL;
     }
 
-    is_method = g_callable_info_is_method(function->info);
-    can_throw_gerror = g_callable_info_can_throw_gerror(function->info);
+    is_method = function->is_method;
+    can_throw_gerror = function->can_throw_gerror;
 
     c_argc = function->invoker.cif.nargs;
-    gi_argc = g_callable_info_get_n_args( (GICallableInfo*) function->info);
+    gi_argc = function->n_args;
 
     /* @c_argc is the number of arguments that the underlying C
      * function takes. @gi_argc is the number of arguments the
@@ -745,24 +1122,16 @@ gjs_invoke_c_function(JSContext                              *context,
      * don't allow too few args, since that would break.
      */
 
-    if (args.length() < function->expected_js_argc) {
-        gjs_throw(context,
-                  "Too few arguments to %s %s.%s expected %d got %" G_GSIZE_FORMAT,
-                  is_method ? "method" : "function",
-                  g_base_info_get_namespace( (GIBaseInfo*) function->info),
-                  g_base_info_get_name( (GIBaseInfo*) function->info),
-                  function->expected_js_argc,
-                  args.length());
+    if (!check_js_argc(context, function, args))
         return false;
-    }
 
-    g_callable_info_load_return_type( (GICallableInfo*) function->info, &return_info);
-    return_tag = g_type_info_get_tag(&return_info);
+    return_tag = function->return_tag;
 
     in_arg_cvalues = g_newa(GArgument, c_argc);
     ffi_arg_pointers = g_newa(gpointer, c_argc);
     out_arg_cvalues = g_newa(GArgument, c_argc);
     inout_original_arg_cvalues = g_newa(GArgument, c_argc);
+    in_js_arg_pos = g_newa(guint8, gi_argc);
 
     failed = false;
     c_arg_pos = 0; /* index into in_arg_cvalues, etc */
@@ -778,79 +1147,41 @@ gjs_invoke_c_function(JSContext                              *context,
 
     processed_c_args = c_arg_pos;
     for (gi_arg_pos = 0; gi_arg_pos < gi_argc; gi_arg_pos++, c_arg_pos++) {
-        GIDirection direction;
-        GIArgInfo arg_info;
+        ArgPlan *plan = &function->args[gi_arg_pos];
+        GIDirection direction = plan->direction;
         bool arg_removed = false;
 
         /* gjs_debug(GJS_DEBUG_GFUNCTION, "gi_arg_pos: %d c_arg_pos: %d js_arg_pos: %d", gi_arg_pos, c_arg_pos, js_arg_pos); */
 
-        g_callable_info_load_arg( (GICallableInfo*) function->info, gi_arg_pos, &arg_info);
-        direction = g_arg_info_get_direction(&arg_info);
-
         g_assert_cmpuint(c_arg_pos, <, c_argc);
         ffi_arg_pointers[c_arg_pos] = &in_arg_cvalues[c_arg_pos];
 
         if (direction == GI_DIRECTION_OUT) {
-            if (g_arg_info_is_caller_allocates(&arg_info)) {
-                GITypeTag type_tag;
-                GITypeInfo ainfo;
-
-                g_arg_info_load_type(&arg_info, &ainfo);
-                type_tag = g_type_info_get_tag(&ainfo);
-
-                if (type_tag == GI_TYPE_TAG_INTERFACE) {
-                    GIBaseInfo* interface_info;
-                    GIInfoType interface_type;
-                    gsize size;
-
-                    interface_info = g_type_info_get_interface(&ainfo);
-                    g_assert(interface_info != NULL);
-
-                    interface_type = g_base_info_get_type(interface_info);
-
-                    if (interface_type == GI_INFO_TYPE_STRUCT) {
-                        size = g_struct_info_get_size((GIStructInfo*)interface_info);
-                    } else if (interface_type == GI_INFO_TYPE_UNION) {
-                        size = g_union_info_get_size((GIUnionInfo*)interface_info);
-                    } else {
-                        failed = true;
-                    }
-
-                    g_base_info_unref((GIBaseInfo*)interface_info);
-
-                    if (!failed) {
-                        in_arg_cvalues[c_arg_pos].v_pointer = g_slice_alloc0(size);
-                        out_arg_cvalues[c_arg_pos].v_pointer = in_arg_cvalues[c_arg_pos].v_pointer;
-                    }
+            if (plan->is_caller_allocates) {
+                if (plan->caller_allocates_size > 0) {
+                    in_arg_cvalues[c_arg_pos].v_pointer = g_slice_alloc0(plan->caller_allocates_size);
+                    out_arg_cvalues[c_arg_pos].v_pointer = in_arg_cvalues[c_arg_pos].v_pointer;
                 } else {
                     failed = true;
+                    gjs_throw(context, "Unsupported type %s for (out caller-allocates)",
+                              g_type_tag_to_string(plan->type_tag));
                 }
-                if (failed)
-                    gjs_throw(context, "Unsupported type %s for (out caller-allocates)", g_type_tag_to_string(type_tag));
             } else {
                 out_arg_cvalues[c_arg_pos].v_pointer = NULL;
                 in_arg_cvalues[c_arg_pos].v_pointer = &out_arg_cvalues[c_arg_pos];
             }
         } else {
             GArgument *in_value;
-            GITypeInfo ainfo;
-            GjsParamType param_type;
-
-            g_arg_info_load_type(&arg_info, &ainfo);
 
             in_value = &in_arg_cvalues[c_arg_pos];
 
-            param_type = function->param_types[gi_arg_pos];
-
-            switch (param_type) {
+            switch (plan->param_type) {
             case PARAM_CALLBACK: {
-                GICallableInfo *callable_info;
-                GIScopeType scope = g_arg_info_get_scope(&arg_info);
                 GjsCallbackTrampoline *trampoline;
                 ffi_closure *closure;
                 JS::HandleValue current_arg = args[js_arg_pos];
 
-                if (current_arg.isNull() && g_arg_info_may_be_null(&arg_info)) {
+                if (current_arg.isNull() && plan->may_be_null) {
                     closure = NULL;
                     trampoline = NULL;
                 } else {
@@ -858,37 +1189,33 @@ gjs_invoke_c_function(JSContext                              *context,
                         gjs_throw(context, "Error invoking %s.%s: Expected function for callback argument %s, got %s",
                                   g_base_info_get_namespace( (GIBaseInfo*) function->info),
                                   g_base_info_get_name( (GIBaseInfo*) function->info),
-                                  g_base_info_get_name( (GIBaseInfo*) &arg_info),
+                                  plan->name,
                                   JS_GetTypeName(context,
                                                  JS_TypeOfValue(context, current_arg)));
                         failed = true;
                         break;
                     }
 
-                    callable_info = (GICallableInfo*) g_type_info_get_interface(&ainfo);
                     trampoline = gjs_callback_trampoline_new(context,
                                                              current_arg,
-                                                             callable_info,
-                                                             scope,
+                                                             plan->callback_info,
+                                                             plan->scope,
                                                              false);
                     closure = trampoline->closure;
-                    g_base_info_unref(callable_info);
                 }
 
-                gint destroy_pos = g_arg_info_get_destroy(&arg_info);
-                gint closure_pos = g_arg_info_get_closure(&arg_info);
-                if (destroy_pos >= 0) {
-                    gint c_pos = is_method ? destroy_pos + 1 : destroy_pos;
-                    g_assert (function->param_types[destroy_pos] == PARAM_SKIPPED);
+                if (plan->destroy_pos != GJS_ARG_INDEX_INVALID) {
+                    gint c_pos = is_method ? plan->destroy_pos + 1 : plan->destroy_pos;
+                    g_assert (function->args[plan->destroy_pos].param_type == PARAM_SKIPPED);
                     in_arg_cvalues[c_pos].v_pointer = trampoline ? (gpointer) gjs_destroy_notify_callback : NULL;
                 }
-                if (closure_pos >= 0) {
-                    gint c_pos = is_method ? closure_pos + 1 : closure_pos;
-                    g_assert (function->param_types[closure_pos] == PARAM_SKIPPED);
+                if (plan->closure_pos != GJS_ARG_INDEX_INVALID) {
+                    gint c_pos = is_method ? plan->closure_pos + 1 : plan->closure_pos;
+                    g_assert (function->args[plan->closure_pos].param_type == PARAM_SKIPPED);
                     in_arg_cvalues[c_pos].v_pointer = trampoline;
                 }
 
-                if (trampoline && scope != GI_SCOPE_TYPE_CALL) {
+                if (trampoline && plan->scope != GI_SCOPE_TYPE_CALL) {
                     /* Add an extra reference that will be cleared when collecting
                        async calls, or when GDestroyNotify is called */
                     gjs_callback_trampoline_ref(trampoline);
@@ -900,23 +1227,25 @@ gjs_invoke_c_function(JSContext                              *context,
                 arg_removed = true;
                 break;
             case PARAM_ARRAY: {
-                GIArgInfo array_length_arg;
-
-                gint array_length_pos = g_type_info_get_array_length(&ainfo);
+                ArgPlan *length_plan = &function->args[plan->array_length_pos];
+                gint array_length_pos = plan->array_length_pos;
                 gsize length;
 
-                if (!gjs_value_to_explicit_array(context, args[js_arg_pos],
-                                                 &arg_info, in_value, &length)) {
+                if (!gjs_array_to_explicit_array(context, args[js_arg_pos],
+                                                 &plan->type_info, plan->name,
+                                                 GJS_ARGUMENT_ARGUMENT,
+                                                 plan->transfer,
+                                                 plan->may_be_null,
+                                                 &in_value->v_pointer,
+                                                 &length)) {
                     failed = true;
                     break;
                 }
 
-                g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
-
                 array_length_pos += is_method ? 1 : 0;
                 JS::RootedValue v_length(context, JS::Int32Value(length));
-                if (!gjs_value_to_arg(context, v_length, &array_length_arg,
-                                      in_arg_cvalues + array_length_pos)) {
+                if (!length_plan->in(context, length_plan, v_length,
+                                     in_arg_cvalues + array_length_pos)) {
                     failed = true;
                     break;
                 }
@@ -940,9 +1269,9 @@ gjs_invoke_c_function(JSContext                              *context,
             case PARAM_NORMAL: {
                 /* Ok, now just convert argument normally */
                 g_assert_cmpuint(js_arg_pos, <, args.length());
-                if (!gjs_value_to_arg(context, args[js_arg_pos], &arg_info,
-                                      in_value))
+                if (!plan->in(context, plan, args[js_arg_pos], in_value))
                     failed = true;
+                in_js_arg_pos[gi_arg_pos] = js_arg_pos;
 
                 break;
             }
@@ -991,15 +1320,7 @@ gjs_invoke_c_function(JSContext                              *context,
     g_assert_cmpuint(c_arg_pos, ==, c_argc);
     g_assert_cmpuint(gi_arg_pos, ==, gi_argc);
 
-    /* See comment for GjsFFIReturnValue above */
-    if (return_tag == GI_TYPE_TAG_FLOAT)
-        return_value_p = &return_value.v_float;
-    else if (return_tag == GI_TYPE_TAG_DOUBLE)
-        return_value_p = &return_value.v_double;
-    else if (return_tag == GI_TYPE_TAG_INT64 || return_tag == GI_TYPE_TAG_UINT64)
-        return_value_p = &return_value.v_uint64;
-    else
-        return_value_p = &return_value.v_long;
+    return_value_p = get_return_value_pointer(return_tag, &return_value);
     ffi_call(&(function->invoker.cif), FFI_FN(function->invoker.native_address), return_value_p, ffi_arg_pointers);
 
     /* Return value and out arguments are valid only if invocation doesn't
@@ -1020,31 +1341,27 @@ gjs_invoke_c_function(JSContext                              *context,
             return_values.append(JS::UndefinedValue());
 
         if (return_tag != GI_TYPE_TAG_VOID) {
-            GITransfer transfer = g_callable_info_get_caller_owns((GICallableInfo*) function->info);
+            GITransfer transfer = function->return_transfer;
             bool arg_failed = false;
-            gint array_length_pos;
 
             g_assert_cmpuint(next_rval, <, function->js_out_argc);
 
-            gi_type_info_extract_ffi_return_value(&return_info, &return_value, &return_gargument);
+            gi_type_info_extract_ffi_return_value(&function->return_info, &return_value, &return_gargument);
 
-            array_length_pos = g_type_info_get_array_length(&return_info);
-            if (array_length_pos >= 0) {
-                GIArgInfo array_length_arg;
-                GITypeInfo arg_type_info;
+            if (function->return_array_length_pos != GJS_ARG_INDEX_INVALID) {
+                ArgPlan *length_plan = &function->args[function->return_array_length_pos];
+                gint array_length_pos = function->return_array_length_pos;
                 JS::RootedValue length(context);
 
-                g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
-                g_arg_info_load_type(&array_length_arg, &arg_type_info);
                 array_length_pos += is_method ? 1 : 0;
                 arg_failed = !gjs_value_from_g_argument(context, &length,
-                                                        &arg_type_info,
+                                                        &length_plan->type_info,
                                                         &out_arg_cvalues[array_length_pos],
                                                         true);
                 if (!arg_failed && !js_rval.empty()) {
                     arg_failed = !gjs_value_from_explicit_array(context,
                                                                 return_values.handleAt(next_rval),
-                                                                &return_info,
+                                                                &function->return_info,
                                                                 &return_gargument,
                                                                 length.toInt32());
                 }
@@ -1052,7 +1369,7 @@ gjs_invoke_c_function(JSContext                              *context,
                     !r_value &&
                     !gjs_g_argument_release_out_array(context,
                                                       transfer,
-                                                      &return_info,
+                                                      &function->return_info,
                                                       length.toInt32(),
                                                       &return_gargument))
                     failed = true;
@@ -1060,14 +1377,14 @@ gjs_invoke_c_function(JSContext                              *context,
                 if (!js_rval.empty())
                     arg_failed = !gjs_value_from_g_argument(context,
                                                             return_values.handleAt(next_rval),
-                                                            &return_info, &return_gargument,
+                                                            &function->return_info, &return_gargument,
                                                             true);
                 /* Free GArgument, the JS::Value should have ref'd or copied it */
                 if (!arg_failed &&
                     !r_value &&
                     !gjs_g_argument_release(context,
                                             transfer,
-                                            &return_info,
+                                            &function->return_info,
                                             &return_gargument))
                     failed = true;
             }
@@ -1085,16 +1402,9 @@ release:
     c_arg_pos = is_method ? 1 : 0;
     postinvoke_release_failed = false;
     for (gi_arg_pos = 0; gi_arg_pos < gi_argc && c_arg_pos < processed_c_args; gi_arg_pos++, c_arg_pos++) {
-        GIDirection direction;
-        GIArgInfo arg_info;
-        GITypeInfo arg_type_info;
-        GjsParamType param_type;
-
-        g_callable_info_load_arg( (GICallableInfo*) function->info, gi_arg_pos, &arg_info);
-        direction = g_arg_info_get_direction(&arg_info);
-
-        g_arg_info_load_type(&arg_info, &arg_type_info);
-        param_type = function->param_types[gi_arg_pos];
+        ArgPlan *plan = &function->args[gi_arg_pos];
+        GIDirection direction = plan->direction;
+        GjsParamType param_type = plan->param_type;
 
         if (direction == GI_DIRECTION_IN || direction == GI_DIRECTION_INOUT) {
             GArgument *arg;
@@ -1102,7 +1412,7 @@ release:
 
             if (direction == GI_DIRECTION_IN) {
                 arg = &in_arg_cvalues[c_arg_pos];
-                transfer = g_arg_info_get_ownership_transfer(&arg_info);
+                transfer = plan->transfer;
             } else {
                 arg = &inout_original_arg_cvalues[c_arg_pos];
                 /* For inout, transfer refers to what we get back from the function; for
@@ -1123,34 +1433,37 @@ release:
                 }
             } else if (param_type == PARAM_ARRAY) {
                 gsize length;
-                GIArgInfo array_length_arg;
-                GITypeInfo array_length_type;
-                gint array_length_pos = g_type_info_get_array_length(&arg_type_info);
+                gint array_length_pos = plan->array_length_pos;
 
-                g_assert(array_length_pos >= 0);
-
-                g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
-                g_arg_info_load_type(&array_length_arg, &array_length_type);
+                g_assert(plan->array_length_pos != GJS_ARG_INDEX_INVALID);
 
                 array_length_pos += is_method ? 1 : 0;
 
                 length = get_length_from_arg(in_arg_cvalues + array_length_pos,
-                                             g_type_info_get_tag(&array_length_type));
+                                             function->args[plan->array_length_pos].type_tag);
 
                 if (!gjs_g_argument_release_in_array(context,
                                                      transfer,
-                                                     &arg_type_info,
+                                                     &plan->type_info,
                                                      length,
                                                      arg)) {
                     postinvoke_release_failed = true;
                 }
             } else if (param_type == PARAM_NORMAL) {
+                if (plan->updates_byte_array && !failed &&
+                    !arg_plan_update_byte_array(context,
+                                                args[in_js_arg_pos[gi_arg_pos]],
+                                                arg)) {
+                    postinvoke_release_failed = true;
+                }
                 if (!gjs_g_argument_release_in_arg(context,
                                                    transfer,
-                                                   &arg_type_info,
+                                                   &plan->type_info,
                                                    arg)) {
                     postinvoke_release_failed = true;
                 }
+                if (plan->holds_bytes_ref && arg->v_pointer != NULL)
+                    g_clear_pointer((GBytes **) &arg->v_pointer, g_bytes_unref);
             }
         }
 
@@ -1164,39 +1477,34 @@ release:
         if ((direction == GI_DIRECTION_OUT || direction == GI_DIRECTION_INOUT) && param_type != PARAM_SKIPPED) {
             GArgument *arg;
             bool arg_failed = false;
-            gint array_length_pos;
+            bool has_array_length = plan->array_length_pos != GJS_ARG_INDEX_INVALID;
             JS::RootedValue array_length(context, JS::Int32Value(0));
-            GITransfer transfer;
 
             g_assert(next_rval < function->js_out_argc);
 
             arg = &out_arg_cvalues[c_arg_pos];
 
-            array_length_pos = g_type_info_get_array_length(&arg_type_info);
-
             if (!js_rval.empty()) {
-                if (array_length_pos >= 0) {
-                    GIArgInfo array_length_arg;
-                    GITypeInfo array_length_type_info;
+                if (has_array_length) {
+                    ArgPlan *length_plan = &function->args[plan->array_length_pos];
+                    gint array_length_pos = plan->array_length_pos;
 
-                    g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
-                    g_arg_info_load_type(&array_length_arg, &array_length_type_info);
                     array_length_pos += is_method ? 1 : 0;
                     arg_failed = !gjs_value_from_g_argument(context, &array_length,
-                                                            &array_length_type_info,
+                                                            &length_plan->type_info,
                                                             &out_arg_cvalues[array_length_pos],
                                                             true);
                     if (!arg_failed) {
                         arg_failed = !gjs_value_from_explicit_array(context,
                                                                     return_values.handleAt(next_rval),
-                                                                    &arg_type_info,
+                                                                    &plan->type_info,
                                                                     arg,
                                                                     array_length.toInt32());
                     }
                 } else {
                     arg_failed = !gjs_value_from_g_argument(context,
                                                             return_values.handleAt(next_rval),
-                                                            &arg_type_info,
+                                                            &plan->type_info,
                                                             arg,
                                                             true);
                 }
@@ -1206,18 +1514,17 @@ release:
                 postinvoke_release_failed = true;
 
             /* Free GArgument, the JS::Value should have ref'd or copied it */
-            transfer = g_arg_info_get_ownership_transfer(&arg_info);
             if (!arg_failed) {
-                if (array_length_pos >= 0) {
+                if (has_array_length) {
                     gjs_g_argument_release_out_array(context,
-                                                     transfer,
-                                                     &arg_type_info,
+                                                     plan->transfer,
+                                                     &plan->type_info,
                                                      array_length.toInt32(),
                                                      arg);
                 } else {
                     gjs_g_argument_release(context,
-                                           transfer,
-                                           &arg_type_info,
+                                           plan->transfer,
+                                           &plan->type_info,
                                            arg);
                 }
             }
@@ -1231,26 +1538,10 @@ release:
              * this works OK.  We could also alloca() the structure instead
              * of slice allocating.
              */
-            if (g_arg_info_is_caller_allocates(&arg_info)) {
-                GITypeTag type_tag;
-                GIBaseInfo* interface_info;
-                GIInfoType interface_type;
-                gsize size;
-
-                type_tag = g_type_info_get_tag(&arg_type_info);
-                g_assert(type_tag == GI_TYPE_TAG_INTERFACE);
-                interface_info = g_type_info_get_interface(&arg_type_info);
-                interface_type = g_base_info_get_type(interface_info);
-                if (interface_type == GI_INFO_TYPE_STRUCT) {
-                    size = g_struct_info_get_size((GIStructInfo*)interface_info);
-                } else if (interface_type == GI_INFO_TYPE_UNION) {
-                    size = g_union_info_get_size((GIUnionInfo*)interface_info);
-                } else {
-                    g_assert_not_reached();
-                }
-
-                g_slice_free1(size, out_arg_cvalues[c_arg_pos].v_pointer);
-                g_base_info_unref((GIBaseInfo*)interface_info);
+            if (plan->is_caller_allocates) {
+                g_assert(plan->caller_allocates_size > 0);
+                g_slice_free1(plan->caller_allocates_size,
+                              out_arg_cvalues[c_arg_pos].v_pointer);
             }
 
             ++next_rval;
@@ -1297,6 +1588,69 @@ release:
     }
 }
 
+/*
+ * Invoker for functions marked is_primitive: every argument is (in),
+ * converted by a single converter, and neither the arguments nor the
+ * return value need releasing, so the bookkeeping in
+ * gjs_invoke_c_function() can be skipped entirely. Completed trampolines
+ * are left for the next call through the general path; no callbacks can
+ * be created here.
+ */
+static bool
+gjs_invoke_c_function_primitive(JSContext                  *context,
+                                Function                   *function,
+                                JS::HandleObject            obj, /* "this" object */
+                                const JS::HandleValueArray& args,
+                                JS::MutableHandleValue      js_rval)
+{
+    GArgument *in_arg_cvalues;
+    gpointer *ffi_arg_pointers;
+    GIFFIReturnValue return_value;
+    GArgument return_gargument;
+    guint8 c_argc, c_arg_pos, gi_arg_pos;
+
+    if (!check_js_argc(context, function, args))
+        return false;
+
+    c_argc = function->invoker.cif.nargs;
+    in_arg_cvalues = g_newa(GArgument, c_argc);
+    ffi_arg_pointers = g_newa(gpointer, c_argc);
+
+    c_arg_pos = 0;
+    if (function->is_method) {
+        if (!gjs_fill_method_instance(context, obj,
+                                      function, &in_arg_cvalues[0]))
+            return false;
+        ffi_arg_pointers[0] = &in_arg_cvalues[0];
+        ++c_arg_pos;
+    }
+
+    /* JS arguments map one-to-one to GI arguments here */
+    for (gi_arg_pos = 0; gi_arg_pos < function->n_args; gi_arg_pos++, c_arg_pos++) {
+        ArgPlan *plan = &function->args[gi_arg_pos];
+
+        if (!plan->in(context, plan, args[gi_arg_pos], &in_arg_cvalues[c_arg_pos]))
+            return false;
+        ffi_arg_pointers[c_arg_pos] = &in_arg_cvalues[c_arg_pos];
+    }
+
+    g_assert_cmpuint(c_arg_pos, ==, c_argc);
+
+    ffi_call(&(function->invoker.cif), FFI_FN(function->invoker.native_address),
+             get_return_value_pointer(function->return_tag, &return_value),
+             ffi_arg_pointers);
+
+    if (function->return_tag == GI_TYPE_TAG_VOID) {
+        js_rval.setUndefined();
+        return true;
+    }
+
+    gi_type_info_extract_ffi_return_value(&function->return_info, &return_value,
+                                          &return_gargument);
+    return gjs_value_from_g_argument(context, js_rval, &function->return_info,
+                                     &return_gargument, true);
+}
+
 static bool
 function_call(JSContext *context,
               unsigned   js_argc,
@@ -1318,6 +1672,14 @@ function_call(JSContext *context,
     if (priv == NULL)
         return true; /* we are the prototype, or have the wrong class */
 
+    if (priv->is_primitive) {
+        if (!gjs_invoke_c_function_primitive(context, priv, object, js_argv,
+                                             &retval))
+            return false;
+        js_argv.rval().set(retval);
+        return true;
+    }
+
     /* COMPAT: mozilla::Maybe gains a much more usable API in future versions */
     mozilla::Maybe<JS::MutableHandleValue> m_retval;
     m_retval.construct(&retval);
@@ -1337,10 +1699,17 @@ GJS_NATIVE_CONSTRUCTOR_DEFINE_ABSTRACT(function)
 static void
 uninit_cached_function_data (Function *function)
 {
+    guint8 i;
+
+    if (function->args) {
+        for (i = 0; i < function->n_args; i++) {
+            if (function->args[i].callback_info)
+                g_base_info_unref(function->args[i].callback_info);
+        }
+        g_free(function->args);
+    }
     if (function->info)
         g_base_info_unref( (GIBaseInfo*) function->info);
-    if (function->param_types)
-        g_free(function->param_types);
 
     g_function_invoker_destroy(&function->invoker);
 }
@@ -1374,17 +1743,13 @@ get_num_arguments (JSContext *context,
     if (priv == NULL)
         return false;
 
-    n_args = g_callable_info_get_n_args(priv->info);
+    n_args = priv->n_args;
     n_jsargs = 0;
     for (i = 0; i < n_args; i++) {
-        GIArgInfo arg_info;
-
-        if (priv->param_types[i] == PARAM_SKIPPED)
+        if (priv->args[i].param_type == PARAM_SKIPPED)
             continue;
 
-        g_callable_info_load_arg(priv->info, i, &arg_info);
-
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_OUT)
+        if (priv->args[i].direction == GI_DIRECTION_OUT)
             continue;
     }
 
@@ -1413,25 +1778,21 @@ function_to_string (JSContext *context,
 
     free = true;
 
-    n_args = g_callable_info_get_n_args(priv->info);
+    n_args = priv->n_args;
     n_jsargs = 0;
     arg_names_str = g_string_new("");
     for (i = 0; i < n_args; i++) {
-        GIArgInfo arg_info;
-
-        if (priv->param_types[i] == PARAM_SKIPPED)
+        if (priv->args[i].param_type == PARAM_SKIPPED)
             continue;
 
-        g_callable_info_load_arg(priv->info, i, &arg_info);
-
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_OUT)
+        if (priv->args[i].direction == GI_DIRECTION_OUT)
             continue;
 
         if (n_jsargs > 0)
             g_string_append(arg_names_str, ", ");
 
         n_jsargs++;
-        g_string_append(arg_names_str, g_base_info_get_name(&arg_info));
+        g_string_append(arg_names_str, priv->args[i].name);
     }
     arg_names = g_string_free(arg_names_str, false);
 
@@ -1464,6 +1825,7 @@ function_to_string (JSContext *context,
 struct JSClass gjs_function_class = {
     "GIRepositoryFunction", /* means "new GIRepositoryFunction()" works */
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_BACKGROUND_FINALIZE,
     JS_PropertyStub,
     JS_DeletePropertyStub,
@@ -1488,6 +1850,198 @@ JSFunctionSpec gjs_function_proto_funcs[] = {
     JS_FS_END
 };
 
+static bool
+type_is_gbytes(GITypeInfo *type_info)
+{
+    GIBaseInfo *interface_info;
+    GIInfoType interface_type;
+    bool ret;
+
+    if (g_type_info_get_tag(type_info) != GI_TYPE_TAG_INTERFACE)
+        return false;
+
+    interface_info = g_type_info_get_interface(type_info);
+    g_assert(interface_info != NULL);
+
+    interface_type = g_base_info_get_type(interface_info);
+    ret = (interface_type == GI_INFO_TYPE_STRUCT ||
+           interface_type == GI_INFO_TYPE_BOXED) &&
+        g_registered_type_info_get_g_type((GIRegisteredTypeInfo *) interface_info) == G_TYPE_BYTES;
+
+    g_base_info_unref(interface_info);
+    return ret;
+}
+
+static void
+init_arg_plan(GICallableInfo *info,
+              guint8          index,
+              ArgPlan        *plan)
+{
+    /* Load in place, so the type info's container stays valid */
+    g_callable_info_load_arg(info, index, &plan->arg_info);
+    g_arg_info_load_type(&plan->arg_info, &plan->type_info);
+
+    plan->name = g_base_info_get_name((GIBaseInfo *) &plan->arg_info);
+    plan->direction = g_arg_info_get_direction(&plan->arg_info);
+    plan->type_tag = g_type_info_get_tag(&plan->type_info);
+    plan->transfer = g_arg_info_get_ownership_transfer(&plan->arg_info);
+    plan->argument_type = g_arg_info_is_return_value(&plan->arg_info) ?
+        GJS_ARGUMENT_RETURN_VALUE : GJS_ARGUMENT_ARGUMENT;
+    plan->may_be_null = g_arg_info_may_be_null(&plan->arg_info);
+
+    plan->array_length_pos = GJS_ARG_INDEX_INVALID;
+    plan->closure_pos = GJS_ARG_INDEX_INVALID;
+    plan->destroy_pos = GJS_ARG_INDEX_INVALID;
+
+    plan->in = arg_plan_value_to_arg;
+
+    if (plan->direction == GI_DIRECTION_IN &&
+        plan->transfer == GI_TRANSFER_NOTHING &&
+        type_is_gbytes(&plan->type_info)) {
+        plan->in = arg_plan_bytes_to_arg;
+        plan->holds_bytes_ref = true;
+    }
+
+    plan->updates_byte_array =
+        plan->direction == GI_DIRECTION_IN &&
+        plan->transfer == GI_TRANSFER_NOTHING &&
+        plan->type_tag == GI_TYPE_TAG_ARRAY &&
+        g_type_info_get_array_type(&plan->type_info) == GI_ARRAY_TYPE_BYTE_ARRAY;
+
+    if (plan->direction == GI_DIRECTION_OUT &&
+        g_arg_info_is_caller_allocates(&plan->arg_info)) {
+        plan->is_caller_allocates = true;
+
+        if (plan->type_tag == GI_TYPE_TAG_INTERFACE) {
+            GIBaseInfo *interface_info;
+            GIInfoType interface_type;
+
+            interface_info = g_type_info_get_interface(&plan->type_info);
+            g_assert(interface_info != NULL);
+
+            interface_type = g_base_info_get_type(interface_info);
+
+            if (interface_type == GI_INFO_TYPE_STRUCT)
+                plan->caller_allocates_size = g_struct_info_get_size((GIStructInfo*)interface_info);
+            else if (interface_type == GI_INFO_TYPE_UNION)
+                plan->caller_allocates_size = g_union_info_get_size((GIUnionInfo*)interface_info);
+
+            g_base_info_unref(interface_info);
+        }
+    }
+}
+
+/* Whether values of this type are passed by value, and never need to be
+ * released when they are (in) with transfer none or a return value
+ */
+static bool
+type_is_primitive(GITypeInfo *type_info,
+                  GITypeTag   type_tag,
+                  bool        allow_objects)
+{
+    switch (type_tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+    case GI_TYPE_TAG_INT8:
+    case GI_TYPE_TAG_UINT8:
+    case GI_TYPE_TAG_INT16:
+    case GI_TYPE_TAG_UINT16:
+    case GI_TYPE_TAG_INT32:
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_INT64:
+    case GI_TYPE_TAG_UINT64:
+    case GI_TYPE_TAG_FLOAT:
+    case GI_TYPE_TAG_DOUBLE:
+        return true;
+    case GI_TYPE_TAG_INTERFACE: {
+        GIBaseInfo *interface_info;
+        GIInfoType interface_type;
+        bool retval;
+
+        interface_info = g_type_info_get_interface(type_info);
+        interface_type = g_base_info_get_type(interface_info);
+
+        if (interface_type == GI_INFO_TYPE_ENUM ||
+            interface_type == GI_INFO_TYPE_FLAGS) {
+            retval = true;
+        } else if (allow_objects && interface_type == GI_INFO_TYPE_OBJECT) {
+            GType gtype = g_registered_type_info_get_g_type((GIRegisteredTypeInfo *) interface_info);
+            retval = g_type_is_a(gtype, G_TYPE_OBJECT);
+        } else {
+            retval = false;
+        }
+
+        g_base_info_unref(interface_info);
+        return retval;
+    }
+    default:
+        return false;
+    }
+}
+
+/* Classifies functions that can use gjs_invoke_c_function_primitive(), and
+ * picks the fast converters for their arguments. Set GJS_DISABLE_FAST_PATHS
+ * to compare against the general path.
+ */
+static bool
+function_is_primitive(Function *function)
+{
+    guint8 i;
+
+    if (gjs_environment_variable_is_set("GJS_DISABLE_FAST_PATHS"))
+        return false;
+
+    if (function->can_throw_gerror)
+        return false;
+
+    if (function->is_method &&
+        (function->instance_transfer != GI_TRANSFER_NOTHING ||
+         !g_type_is_a(function->container_gtype, G_TYPE_OBJECT)))
+        return false;
+
+    if (function->return_tag != GI_TYPE_TAG_VOID &&
+        !type_is_primitive(&function->return_info, function->return_tag, false))
+        return false;
+
+    for (i = 0; i < function->n_args; i++) {
+        ArgPlan *plan = &function->args[i];
+
+        if (plan->direction != GI_DIRECTION_IN ||
+            plan->param_type != PARAM_NORMAL ||
+            plan->transfer != GI_TRANSFER_NOTHING ||
+            !type_is_primitive(&plan->type_info, plan->type_tag, true))
+            return false;
+    }
+
+    for (i = 0; i < function->n_args; i++) {
+        ArgPlan *plan = &function->args[i];
+
+        switch (plan->type_tag) {
+        case GI_TYPE_TAG_BOOLEAN:
+            plan->in = arg_plan_boolean_to_arg;
+            break;
+        case GI_TYPE_TAG_INT8:
+        case GI_TYPE_TAG_UINT8:
+        case GI_TYPE_TAG_INT16:
+        case GI_TYPE_TAG_UINT16:
+        case GI_TYPE_TAG_INT32:
+        case GI_TYPE_TAG_UINT32:
+        case GI_TYPE_TAG_INT64:
+        case GI_TYPE_TAG_UINT64:
+            plan->in = arg_plan_int_to_arg;
+            break;
+        case GI_TYPE_TAG_FLOAT:
+        case GI_TYPE_TAG_DOUBLE:
+            plan->in = arg_plan_double_to_arg;
+            break;
+        default:
+            /* enums, flags and objects keep the default converter */
+            break;
+        }
+    }
+
+    return true;
+}
+
 static bool
 init_cached_function_data (JSContext      *context,
                            Function       *function,
@@ -1497,7 +2051,6 @@ init_cached_function_data (JSContext      *context,
     guint8 i, n_args;
     int array_length_pos;
     GError *error = NULL;
-    GITypeInfo return_type;
     GIInfoType info_type;
 
     info_type = g_base_info_get_type((GIBaseInfo *)info);
@@ -1529,57 +2082,80 @@ init_cached_function_data (JSContext      *context,
         }
     }
 
-    g_callable_info_load_return_type((GICallableInfo*)info, &return_type);
-    if (g_type_info_get_tag(&return_type) != GI_TYPE_TAG_VOID)
+    function->is_method = g_callable_info_is_method(info);
+    function->can_throw_gerror = g_callable_info_can_throw_gerror(info);
+
+    if (function->is_method) {
+        function->container = g_base_info_get_container((GIBaseInfo *) info);
+        function->container_type = g_base_info_get_type(function->container);
+        function->container_gtype =
+            g_registered_type_info_get_g_type((GIRegisteredTypeInfo *) function->container);
+        function->container_is_gtype_struct =
+            function->container_type == GI_INFO_TYPE_STRUCT &&
+            g_struct_info_is_gtype_struct((GIStructInfo *) function->container);
+        function->instance_transfer = g_callable_info_get_instance_ownership_transfer(info);
+    }
+
+    g_callable_info_load_return_type(info, &function->return_info);
+    function->return_tag = g_type_info_get_tag(&function->return_info);
+    function->return_transfer = g_callable_info_get_caller_owns(info);
+    function->return_array_length_pos = GJS_ARG_INDEX_INVALID;
+    if (function->return_tag != GI_TYPE_TAG_VOID)
         function->js_out_argc += 1;
 
     n_args = g_callable_info_get_n_args((GICallableInfo*) info);
-    function->param_types = g_new0(GjsParamType, n_args);
+    function->n_args = n_args;
+    function->args = g_new0(ArgPlan, n_args);
+
+    for (i = 0; i < n_args; i++)
+        init_arg_plan(info, i, &function->args[i]);
 
-    array_length_pos = g_type_info_get_array_length(&return_type);
-    if (array_length_pos >= 0 && array_length_pos < n_args)
-        function->param_types[array_length_pos] = PARAM_SKIPPED;
+    array_length_pos = g_type_info_get_array_length(&function->return_info);
+    if (array_length_pos >= 0 && array_length_pos < n_args) {
+        function->args[array_length_pos].param_type = PARAM_SKIPPED;
+        function->return_array_length_pos = array_length_pos;
+    }
 
     for (i = 0; i < n_args; i++) {
+        ArgPlan *plan = &function->args[i];
         GIDirection direction;
-        GIArgInfo arg_info;
-        GITypeInfo type_info;
         int destroy = -1;
         int closure = -1;
         GITypeTag type_tag;
 
-        if (function->param_types[i] == PARAM_SKIPPED)
+        if (plan->param_type == PARAM_SKIPPED)
             continue;
 
-        g_callable_info_load_arg((GICallableInfo*) info, i, &arg_info);
-        g_arg_info_load_type(&arg_info, &type_info);
-
-        direction = g_arg_info_get_direction(&arg_info);
-        type_tag = g_type_info_get_tag(&type_info);
+        direction = plan->direction;
+        type_tag = plan->type_tag;
 
         if (type_tag == GI_TYPE_TAG_INTERFACE) {
             GIBaseInfo* interface_info;
             GIInfoType interface_type;
 
-            interface_info = g_type_info_get_interface(&type_info);
+            interface_info = g_type_info_get_interface(&plan->type_info);
             interface_type = g_base_info_get_type(interface_info);
             if (interface_type == GI_INFO_TYPE_CALLBACK) {
                 if (strcmp(g_base_info_get_name(interface_info), "DestroyNotify") == 0 &&
                     strcmp(g_base_info_get_namespace(interface_info), "GLib") == 0) {
                     /* Skip GDestroyNotify if they appear before the respective callback */
-                    function->param_types[i] = PARAM_SKIPPED;
+                    plan->param_type = PARAM_SKIPPED;
                 } else {
-                    function->param_types[i] = PARAM_CALLBACK;
+                    plan->param_type = PARAM_CALLBACK;
                     function->expected_js_argc += 1;
 
-                    destroy = g_arg_info_get_destroy(&arg_info);
-                    closure = g_arg_info_get_closure(&arg_info);
+                    destroy = g_arg_info_get_destroy(&plan->arg_info);
+                    closure = g_arg_info_get_closure(&plan->arg_info);
 
-                    if (destroy >= 0 && destroy < n_args)
-                        function->param_types[destroy] = PARAM_SKIPPED;
+                    if (destroy >= 0 && destroy < n_args) {
+                        function->args[destroy].param_type = PARAM_SKIPPED;
+                        plan->destroy_pos = destroy;
+                    }
 
-                    if (closure >= 0 && closure < n_args)
-                        function->param_types[closure] = PARAM_SKIPPED;
+                    if (closure >= 0 && closure < n_args) {
+                        function->args[closure].param_type = PARAM_SKIPPED;
+                        plan->closure_pos = closure;
+                    }
 
                     if (destroy >= 0 && closure < 0) {
                         gjs_throw(context, "Function %s.%s has a GDestroyNotify but no user_data, not supported",
@@ -1588,26 +2164,27 @@ init_cached_function_data (JSContext      *context,
                         g_base_info_unref(interface_info);
                         return false;
                     }
+
+                    plan->scope = g_arg_info_get_scope(&plan->arg_info);
+                    plan->callback_info = (GICallableInfo *) g_base_info_ref(interface_info);
                 }
             }
             g_base_info_unref(interface_info);
         } else if (type_tag == GI_TYPE_TAG_ARRAY) {
-            if (g_type_info_get_array_type(&type_info) == GI_ARRAY_TYPE_C) {
-                array_length_pos = g_type_info_get_array_length(&type_info);
+            if (g_type_info_get_array_type(&plan->type_info) == GI_ARRAY_TYPE_C) {
+                array_length_pos = g_type_info_get_array_length(&plan->type_info);
 
                 if (array_length_pos >= 0 && array_length_pos < n_args) {
-                    GIArgInfo length_arg_info;
-
-                    g_callable_info_load_arg((GICallableInfo*) info, array_length_pos, &length_arg_info);
-                    if (g_arg_info_get_direction(&length_arg_info) != direction) {
+                    if (function->args[array_length_pos].direction != direction) {
                         gjs_throw(context, "Function %s.%s has an array with different-direction length arg, not supported",
                                   g_base_info_get_namespace( (GIBaseInfo*) info),
                                   g_base_info_get_name( (GIBaseInfo*) info));
                         return false;
                     }
 
-                    function->param_types[array_length_pos] = PARAM_SKIPPED;
-                    function->param_types[i] = PARAM_ARRAY;
+                    function->args[array_length_pos].param_type = PARAM_SKIPPED;
+                    plan->param_type = PARAM_ARRAY;
+                    plan->array_length_pos = array_length_pos;
 
                     if (array_length_pos < i) {
                         /* we already collected array_length_pos, remove it */
@@ -1620,8 +2197,8 @@ init_cached_function_data (JSContext      *context,
             }
         }
 
-        if (function->param_types[i] == PARAM_NORMAL ||
-            function->param_types[i] == PARAM_ARRAY) {
+        if (plan->param_type == PARAM_NORMAL ||
+            plan->param_type == PARAM_ARRAY) {
             if (direction == GI_DIRECTION_IN || direction == GI_DIRECTION_INOUT)
                 function->expected_js_argc += 1;
             if (direction == GI_DIRECTION_OUT || direction == GI_DIRECTION_INOUT)
@@ -1633,6 +2210,8 @@ init_cached_function_data (JSContext      *context,
 
     g_base_info_ref((GIBaseInfo*) function->info);
 
+    function->is_primitive = function_is_primitive(function);
+
     return true;
 }
 
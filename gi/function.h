@@ -62,6 +62,9 @@ GjsCallbackTrampoline* gjs_callback_trampoline_new(JSContext      *context,
 void gjs_callback_trampoline_unref(GjsCallbackTrampoline *trampoline);
 void gjs_callback_trampoline_ref(GjsCallbackTrampoline *trampoline);
 
+void  gjs_callback_trampoline_pool_drain(void);
+guint gjs_callback_trampoline_pool_size(void);
+
 JSObject *gjs_define_function(JSContext       *context,
                               JS::HandleObject in_object,
                               GType            gtype,
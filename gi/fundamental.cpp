@@ -120,8 +120,12 @@ static JSObject *
 _fundamental_lookup_object(void *native_object)
 {
     GHashTable *table = _ensure_mapping_table(gjs_context_get_current());
+    JSObject *obj = (JSObject *) g_hash_table_lookup(table, native_object);
 
-    return (JSObject *) g_hash_table_lookup(table, native_object);
+    /* The table is weak, see peek_js_obj() in object.cpp */
+    if (obj != NULL)
+        JS::ExposeObjectToActiveJS(obj);
+    return obj;
 }
 
 /**/
@@ -228,7 +232,7 @@ fundamental_instance_new_resolve_interface(JSContext    *context,
                                            JS::HandleObject obj,
                                            JS::MutableHandleObject objp,
                                            Fundamental  *proto_priv,
-                                           char         *name)
+                                           const char   *name)
 {
     GIFunctionInfo *method_info;
     bool ret;
@@ -289,10 +293,10 @@ fundamental_instance_new_resolve(JSContext  *context,
                                  JS::MutableHandleObject objp)
 {
     FundamentalInstance *priv;
-    char *name;
+    const char *name;
     bool ret = false;
 
-    if (!gjs_get_string_id(context, id, &name))
+    if (!gjs_borrow_string_id(context, id, &name))
         return true; /* not resolved, but no error */
 
     priv = priv_from_js(context, obj);
@@ -364,7 +368,7 @@ fundamental_instance_new_resolve(JSContext  *context,
 
     ret = true;
  out:
-    g_free(name);
+    gjs_release_string_id(context, name);
     return ret;
 }
 
@@ -538,6 +542,7 @@ fundamental_trace(JSTracer *tracer,
 struct JSClass gjs_fundamental_instance_class = {
     "GFundamental_Object",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE,
     JS_PropertyStub,
     JS_DeletePropertyStub,
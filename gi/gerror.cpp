@@ -276,6 +276,7 @@ error_constructor_value_of(JSContext *context,
 struct JSClass gjs_error_class = {
     "GLib_Error",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE |
     JSCLASS_BACKGROUND_FINALIZE,
     JS_PropertyStub,
@@ -111,11 +111,11 @@ interface_new_resolve(JSContext *context,
                       JS::MutableHandleObject objp)
 {
     Interface *priv;
-    char *name;
+    const char *name;
     bool ret = false;
     GIFunctionInfo *method_info;
 
-    if (!gjs_get_string_id(context, id, &name))
+    if (!gjs_borrow_string_id(context, id, &name))
         return true;
 
     priv = priv_from_js(context, obj);
@@ -151,13 +151,14 @@ interface_new_resolve(JSContext *context,
     ret = true;
 
  out:
-    g_free (name);
+    gjs_release_string_id(context, name);
     return ret;
 }
 
 struct JSClass gjs_interface_class = {
     "GObject_Interface",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE |
     JSCLASS_BACKGROUND_FINALIZE,
     JS_PropertyStub,
@@ -31,7 +31,7 @@
 
 typedef struct {
     GjsUnrootedFunc notify;
-    JSObject *child;
+    JS::Heap<JSObject *> child;
     void *data;
 } Child;
 
@@ -52,7 +52,7 @@ child_hash(gconstpointer  v)
 
     return
         GPOINTER_TO_UINT(child->notify) ^
-        GPOINTER_TO_UINT(child->child) ^
+        GPOINTER_TO_UINT(child->child.get()) ^
         GPOINTER_TO_UINT(child->data);
 }
 
@@ -65,7 +65,7 @@ child_equal (gconstpointer  v1,
 
     /* notify is most likely to be equal, so check it last */
     return child1->data == child2->data &&
-        child1->child == child2->child &&
+        child1->child.get() == child2->child.get() &&
         child1->notify == child2->notify;
 }
 
@@ -73,7 +73,10 @@ static void
 child_free(void *data)
 {
     Child *child = (Child *) data;
-    g_slice_free(Child, child);
+
+    /* removing a child while an incremental GC marks must not hide it */
+    gjs_heap_object_pre_barrier(child->child);
+    delete child;
 }
 
 GJS_NATIVE_CONSTRUCTOR_DEFINE_ABSTRACT(keep_alive)
@@ -100,7 +103,7 @@ keep_alive_finalize(JSFreeOp *fop,
                                       &key, &value)) {
         Child *child = (Child *) value;
         if (child->notify)
-            (* child->notify) (child->child, child->data);
+            (* child->notify) (child->child.get(), child->data);
 
         child_free(child);
     }
@@ -117,11 +120,8 @@ trace_foreach(void *key,
     Child *child = (Child *) value;
     JSTracer *tracer = (JSTracer *) data;
 
-    if (child->child != NULL) {
-        JS::Value val;
-        val = JS::ObjectValue(*(child->child));
-        JS_CallValueTracer(tracer, &val, "keep-alive::val");
-    }
+    if (child->child != NULL)
+        JS_CallHeapObjectTracer(tracer, &child->child, "keep-alive::val");
 }
 
 static void
@@ -147,7 +147,7 @@ keep_alive_trace(JSTracer *tracer,
  */
 struct JSClass gjs_keep_alive_class = {
     "__private_GjsKeepAlive", /* means "new __private_GjsKeepAlive()" works */
-    JSCLASS_HAS_PRIVATE,
+    JSCLASS_HAS_PRIVATE | JSCLASS_IMPLEMENTS_BARRIERS,
     JS_PropertyStub,
     JS_DeletePropertyStub,
     JS_PropertyStub,
@@ -269,7 +269,7 @@ gjs_keep_alive_add_child(JSObject          *keep_alive,
     g_return_if_fail(!priv->inside_trace);
     g_return_if_fail(!priv->inside_finalize);
 
-    child = g_slice_new0(Child);
+    child = new Child();
     child->notify = notify;
     child->child = obj;
     child->data = data;
@@ -416,7 +416,7 @@ gjs_keep_alive_iterator_next (GjsKeepAliveIter  *iter,
             continue;
 
         ret = true;
-        *out_child = child->child;
+        *out_child = child->child.get();
         *out_data = child->data;
         break;
     }
@@ -54,13 +54,13 @@ ns_new_resolve(JSContext *context,
                JS::MutableHandleObject objp)
 {
     Ns *priv;
-    char *name;
+    const char *name;
     GIRepository *repo;
     GIBaseInfo *info;
     bool ret = false;
     bool defined;
 
-    if (!gjs_get_string_id(context, id, &name))
+    if (!gjs_borrow_string_id(context, id, &name))
         return true; /* not resolved, but no error */
 
     /* let Object.prototype resolve these */
@@ -113,7 +113,7 @@ ns_new_resolve(JSContext *context,
     JS_EndRequest(context);
 
  out:
-    g_free(name);
+    gjs_release_string_id(context, name);
     return ret;
 }
 
@@ -158,6 +158,7 @@ ns_finalize(JSFreeOp *fop,
 struct JSClass gjs_ns_class = {
     "GIRepositoryNamespace",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE,
     JS_PropertyStub,
     JS_DeletePropertyStub,
@@ -45,25 +45,61 @@
 #include "gjs_gi_trace.h"
 #include "gjs/jsapi-wrapper.h"
 #include "gjs/context-private.h"
+#include "gjs/gc-scheduler.h"
 #include "gjs/mem.h"
 #include "gjs/type-module.h"
 
 #include <util/log.h>
 #include <util/hash-x32.h>
+#include <util/misc.h>
 #include <girepository.h>
 
+/* What a property name on an instance of a class resolves to */
+struct PropertyCacheEntry {
+    int refcount;
+    bool used; /* looked up since the cache was last traced by the GC */
+    JS::Heap<jsid> id;
+    char *name;
+    GParamSpec *param;  /* NULL if it is not a GObject property */
+    GIFieldInfo *field; /* NULL if it is not a field */
+};
+
+/* Names that are neither properties nor fields, such as expandos set from
+ * JS, are remembered as well, but only this many of them per class */
+#define PROPERTY_CACHE_MAX_MISSES 256
+
+/* Resolved property names of a class, keyed by jsid. The ids are traced
+ * rather than interned, and entries that were not used between two
+ * collections are dropped, so that the cache doesn't keep atoms alive. */
+typedef struct {
+    GHashTable *entries;
+    guint n_misses;
+    GjsMemCacheStats *stats;
+} PropertyCache;
+
 typedef struct {
     GIObjectInfo *info;
     GObject *gobj; /* NULL if we are the prototype and not an instance */
-    JSObject *keep_alive; /* NULL if we are not added to it */
+    JS::Heap<JSObject *> keep_alive; /* NULL if we are not added to it */
     GType gtype;
 
+    /* instance size of gobj, as reported to the GC scheduler */
+    gsize native_size;
+
     /* a list of all signal connections, used when tracing */
     GList *signals;
 
     /* the GObjectClass wrapped by this JS Object (only used for
        prototypes) */
     GTypeClass *klass;
+
+    /* property lookups for instances of this class (only used for
+       prototypes) */
+    PropertyCache *property_cache;
+
+    /* signals emitted by name on instances of this class, keyed by
+       interned jsid (only used for prototypes) */
+    GHashTable *signal_cache;
 } ObjectInstance;
 
 typedef struct {
@@ -72,18 +108,27 @@ typedef struct {
     GClosure *closure;
 } ConnectData;
 
+typedef struct {
+    guint signal_id;
+    GQuark detail;
+    GSignalQuery query;
+} SignalCacheEntry;
+
 typedef enum
 {
   TOGGLE_DOWN,
   TOGGLE_UP,
 } ToggleDirection;
 
-typedef struct
+typedef struct _ToggleRefNotifyOperation ToggleRefNotifyOperation;
+struct _ToggleRefNotifyOperation
 {
-    GObject         *gobj;
-    ToggleDirection  direction;
-    guint            needs_unref : 1;
-} ToggleRefNotifyOperation;
+    ToggleRefNotifyOperation *next;
+    GObject                  *gobj;
+    ToggleDirection           direction;
+    guint                     needs_unref : 1;
+    guint                     cancelled : 1;
+};
 
 enum {
     PROP_0,
@@ -95,7 +140,11 @@ static GHashTable *class_init_properties;
 
 extern struct JSClass gjs_object_instance_class;
 static GThread *gjs_eval_thread;
-static volatile gint pending_idle_toggles;
+
+/* Toggle notifications from other threads are pushed onto this lock-free
+ * stack by any thread, and popped all at once by the main thread */
+static ToggleRefNotifyOperation * volatile toggle_queue;
+static GSource *toggle_queue_source;
 
 GJS_DEFINE_PRIV_FROM_JS(ObjectInstance, gjs_object_instance_class)
 
@@ -144,6 +193,16 @@ gjs_object_priv_quark (void)
     return val;
 }
 
+static GQuark
+gjs_method_index_quark (void)
+{
+    static GQuark val = 0;
+    if (G_UNLIKELY (!val))
+        val = g_quark_from_static_string ("gjs::method-index");
+
+    return val;
+}
+
 static GQuark
 gjs_toggle_down_quark (void)
 {
@@ -189,27 +248,13 @@ throw_priv_is_null_error(JSContext *context)
 }
 
 static ValueFromPropertyResult
-init_g_param_from_property(JSContext      *context,
-                           const char     *js_prop_name,
-                           JS::HandleValue value,
-                           GType           gtype,
-                           GParameter     *parameter,
-                           bool            constructing)
+init_g_param_from_param_spec(JSContext      *context,
+                             const char     *js_prop_name,
+                             GParamSpec     *param_spec,
+                             JS::HandleValue value,
+                             GParameter     *parameter,
+                             bool            constructing)
 {
-    char *gname;
-    GParamSpec *param_spec;
-    void *klass;
-
-    gname = gjs_hyphen_from_camel(js_prop_name);
-    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
-                     "Hyphen name %s on %s", gname, g_type_name(gtype));
-
-    klass = g_type_class_ref(gtype);
-    param_spec = g_object_class_find_property(G_OBJECT_CLASS(klass),
-                                              gname);
-    g_type_class_unref(klass);
-    g_free(gname);
-
     if (param_spec == NULL) {
         /* not a GObject prop, so nothing else to do */
         return NO_SUCH_G_PROPERTY;
@@ -244,6 +289,32 @@ init_g_param_from_property(JSContext      *context,
     return VALUE_WAS_SET;
 }
 
+static ValueFromPropertyResult
+init_g_param_from_property(JSContext      *context,
+                           const char     *js_prop_name,
+                           JS::HandleValue value,
+                           GType           gtype,
+                           GParameter     *parameter,
+                           bool            constructing)
+{
+    char *gname;
+    GParamSpec *param_spec;
+    void *klass;
+
+    gname = gjs_hyphen_from_camel(js_prop_name);
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
+                     "Hyphen name %s on %s", gname, g_type_name(gtype));
+
+    klass = g_type_class_ref(gtype);
+    param_spec = g_object_class_find_property(G_OBJECT_CLASS(klass),
+                                              gname);
+    g_type_class_unref(klass);
+    g_free(gname);
+
+    return init_g_param_from_param_spec(context, js_prop_name, param_spec,
+                                        value, parameter, constructing);
+}
+
 static inline ObjectInstance *
 proto_priv_from_js(JSContext       *context,
                    JS::HandleObject obj)
@@ -253,22 +324,33 @@ proto_priv_from_js(JSContext       *context,
     return priv_from_js(context, proto);
 }
 
+/* Returns the private data of the prototype of the instance @obj, if it
+ * can hold caches for @priv. The prototype only caches for instances of
+ * exactly its own type, which is the usual case. */
+static ObjectInstance *
+caching_proto_priv_from_js(JSContext       *context,
+                           JS::HandleObject obj,
+                           ObjectInstance  *priv)
+{
+    ObjectInstance *proto_priv = proto_priv_from_js(context, obj);
+
+    if (proto_priv != NULL && proto_priv->gobj == NULL &&
+        proto_priv->gtype == G_OBJECT_TYPE(priv->gobj))
+        return proto_priv;
+
+    return NULL;
+}
+
 static bool
 get_prop_from_g_param(JSContext             *context,
                       JS::HandleObject       obj,
                       ObjectInstance        *priv,
                       const char            *name,
+                      GParamSpec            *param,
                       JS::MutableHandleValue value_p)
 {
-    char *gname;
-    GParamSpec *param;
     GValue gvalue = { 0, };
 
-    gname = gjs_hyphen_from_camel(name);
-    param = g_object_class_find_property(G_OBJECT_GET_CLASS(priv->gobj),
-                                         gname);
-    g_free(gname);
-
     if (param == NULL) {
         /* leave value_p as it was */
         return true;
@@ -322,15 +404,11 @@ get_prop_from_field(JSContext             *cx,
                     JS::HandleObject       obj,
                     ObjectInstance        *priv,
                     const char            *name,
+                    GIFieldInfo           *field,
                     JS::MutableHandleValue value_p)
 {
-    if (priv->info == NULL)
-        return true;  /* Not resolved, but no error; leave value_p untouched */
-
-    GIFieldInfo *field = lookup_field_info(priv->info, name);
-
     if (field == NULL)
-        return true;
+        return true;  /* Not resolved, but no error; leave value_p untouched */
 
     bool retval = true;
     GITypeInfo *type = NULL;
@@ -371,10 +449,162 @@ get_prop_from_field(JSContext             *cx,
 out:
     if (type != NULL)
         g_base_info_unref((GIBaseInfo *) type);
-    g_base_info_unref((GIBaseInfo *) field);
     return retval;
 }
 
+static PropertyCacheEntry *
+property_cache_entry_new(ObjectInstance *priv,
+                         jsid            id,
+                         char           *name)
+{
+    PropertyCacheEntry *entry = new PropertyCacheEntry();
+    char *gname;
+
+    entry->refcount = 1;
+    entry->id = id;
+    entry->name = name;
+
+    gname = gjs_hyphen_from_camel(name);
+    entry->param = g_object_class_find_property(G_OBJECT_GET_CLASS(priv->gobj),
+                                                gname);
+    if (entry->param != NULL)
+        g_param_spec_ref(entry->param);
+    g_free(gname);
+
+    entry->field = priv->info ? lookup_field_info(priv->info, name) : NULL;
+
+    return entry;
+}
+
+static PropertyCacheEntry *
+property_cache_entry_ref(PropertyCacheEntry *entry)
+{
+    entry->refcount++;
+    return entry;
+}
+
+/* The caller of lookup_property() holds a reference, since getting or
+ * setting the property can run JS and so trace, and sweep, the cache */
+static void
+property_cache_entry_unref(gpointer data)
+{
+    PropertyCacheEntry *entry = (PropertyCacheEntry *) data;
+
+    if (--entry->refcount > 0)
+        return;
+
+    g_free(entry->name);
+    if (entry->param != NULL)
+        g_param_spec_unref(entry->param);
+    if (entry->field != NULL)
+        g_base_info_unref((GIBaseInfo *) entry->field);
+    delete entry;
+}
+
+static void
+property_cache_free(ObjectInstance *priv)
+{
+    PropertyCache *cache = priv->property_cache;
+
+    g_hash_table_destroy(cache->entries);
+    g_slice_free(PropertyCache, cache);
+    priv->property_cache = NULL;
+}
+
+static void
+property_cache_trace(JSTracer      *tracer,
+                     PropertyCache *cache)
+{
+    bool sweeping = JS_IsGCMarkingTracer(tracer);
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, cache->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        PropertyCacheEntry *entry = (PropertyCacheEntry *) value;
+
+        if (sweeping) {
+            if (!entry->used) {
+                if (entry->param == NULL && entry->field == NULL)
+                    cache->n_misses--;
+                g_hash_table_iter_remove(&iter);
+                continue;
+            }
+            entry->used = false;
+        }
+
+        JS_CallHeapIdTracer(tracer, &entry->id, "PropertyCacheEntry::id");
+    }
+}
+
+/* Finds out what @id resolves to on the instance @priv. The answer is
+ * usually cached in the prototype, so after the first time, this does
+ * neither string conversion nor allocation. Returns a reference that the
+ * caller must drop with property_cache_entry_unref(), or NULL if @id is
+ * not a name that we handle.
+ */
+static PropertyCacheEntry *
+lookup_property(JSContext          *context,
+                JS::HandleObject    obj,
+                ObjectInstance     *priv,
+                JS::HandleId        id)
+{
+    ObjectInstance *proto_priv;
+    PropertyCache *cache = NULL;
+    PropertyCacheEntry *entry;
+    gpointer key;
+    char *name;
+
+    if (!JSID_IS_STRING(id))
+        return NULL;
+
+    key = GSIZE_TO_POINTER(JSID_BITS(id));
+
+    proto_priv = caching_proto_priv_from_js(context, obj, priv);
+    if (proto_priv != NULL) {
+        if (proto_priv->property_cache == NULL) {
+            proto_priv->property_cache = g_slice_new0(PropertyCache);
+            proto_priv->property_cache->entries =
+                g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                      property_cache_entry_unref);
+            proto_priv->property_cache->stats =
+                gjs_memory_get_cache_stats("property_cache",
+                                           g_type_name(proto_priv->gtype));
+        }
+        cache = proto_priv->property_cache;
+
+        entry = (PropertyCacheEntry *) g_hash_table_lookup(cache->entries, key);
+        if (entry != NULL) {
+            entry->used = true;
+            GJS_INC_CACHE_STAT(cache->stats, hits);
+            GJS_INC_STAT_COUNTER(property_cache_hit);
+            return property_cache_entry_ref(entry);
+        }
+
+        GJS_INC_CACHE_STAT(cache->stats, misses);
+        GJS_INC_STAT_COUNTER(property_cache_miss);
+    }
+
+    if (!gjs_get_string_id(context, id, &name))
+        return NULL;
+
+    entry = property_cache_entry_new(priv, id, name);
+
+    if (cache == NULL)
+        return entry;
+
+    if (entry->param == NULL && entry->field == NULL) {
+        if (cache->n_misses >= PROPERTY_CACHE_MAX_MISSES)
+            return entry;
+        cache->n_misses++;
+    }
+
+    entry->used = true;
+    g_hash_table_insert(cache->entries, key, property_cache_entry_ref(entry));
+
+    return entry;
+}
+
 /* a hook on getting a property; set value_p to override property's value.
  * Return value is false on OOM/exception.
  */
@@ -385,27 +615,30 @@ object_instance_get_prop(JSContext              *context,
                          JS::MutableHandleValue  value_p)
 {
     ObjectInstance *priv;
-    char *name;
+    PropertyCacheEntry *entry;
     bool ret = true;
 
-    if (!gjs_get_string_id(context, id, &name))
-        return true; /* not resolved, but no error */
-
     priv = priv_from_js(context, obj);
-    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
-                     "Get prop '%s' hook obj %p priv %p",
-                     name, obj.get(), priv);
 
     if (priv == NULL) {
         /* If we reach this point, either object_instance_new_resolve
          * did not throw (so name == "_init"), or the property actually
          * exists and it's not something we should be concerned with */
-        goto out;
+        return true;
     }
     if (priv->gobj == NULL) /* prototype, not an instance. */
-        goto out;
+        return true;
+
+    entry = lookup_property(context, obj, priv, id);
+    if (entry == NULL)
+        return true; /* not resolved, but no error */
+
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
+                     "Get prop '%s' hook obj %p priv %p",
+                     entry->name, obj.get(), priv);
 
-    ret = get_prop_from_g_param(context, obj, priv, name, value_p);
+    ret = get_prop_from_g_param(context, obj, priv, entry->name, entry->param,
+                                value_p);
     if (!ret)
         goto out;
 
@@ -413,10 +646,11 @@ object_instance_get_prop(JSContext              *context,
         goto out;
 
     /* Fall back to fields */
-    ret = get_prop_from_field(context, obj, priv, name, value_p);
+    ret = get_prop_from_field(context, obj, priv, entry->name, entry->field,
+                              value_p);
 
  out:
-    g_free(name);
+    property_cache_entry_unref(entry);
     return ret;
 }
 
@@ -424,17 +658,16 @@ static bool
 set_g_param_from_prop(JSContext      *context,
                       ObjectInstance *priv,
                       const char     *name,
+                      GParamSpec     *param_spec,
                       bool&           was_set,
                       JS::HandleValue value_p)
 {
     GParameter param = { NULL, { 0, }};
     was_set = false;
 
-    switch (init_g_param_from_property(context, name,
-                                       value_p,
-                                       G_TYPE_FROM_INSTANCE(priv->gobj),
-                                       &param,
-                                       false /* constructing */)) {
+    switch (init_g_param_from_param_spec(context, name, param_spec,
+                                         value_p, &param,
+                                         false /* constructing */)) {
     case SOME_ERROR_OCCURRED:
         return false;
     case NO_SUCH_G_PROPERTY:
@@ -456,30 +689,24 @@ static bool
 check_set_field_from_prop(JSContext             *cx,
                           ObjectInstance        *priv,
                           const char            *name,
+                          GIFieldInfo           *field,
                           bool                   strict,
                           JS::MutableHandleValue value_p)
 {
-    if (priv->info == NULL)
-        return true;
-
-    GIFieldInfo *field = lookup_field_info(priv->info, name);
     if (field == NULL)
         return true;
 
-    bool retval = true;
-
     /* As far as I know, GI never exposes GObject instance struct fields as
      * writable, so no need to implement this for the time being */
     if (g_field_info_get_flags(field) & GI_FIELD_IS_WRITABLE) {
         g_message("Field %s of a GObject is writable, but setting it is not "
                   "implemented", name);
-        goto out;
+        return true;
     }
 
     if (strict) {
         gjs_throw(cx, "Tried to set read-only field %s in strict mode", name);
-        retval = false;
-        goto out;
+        return false;
     }
 
     /* We have to update value_p because JS caches it as the property's "stored
@@ -488,9 +715,7 @@ check_set_field_from_prop(JSContext             *cx,
      * the field */
     value_p.setUndefined();
 
-out:
-    g_base_info_unref((GIBaseInfo *) field);
-    return retval;
+    return true;
 }
 
 /* a hook on setting a property; set value_p to override property value to
@@ -504,30 +729,34 @@ object_instance_set_prop(JSContext              *context,
                          JS::MutableHandleValue  value_p)
 {
     ObjectInstance *priv;
-    char *name;
+    PropertyCacheEntry *entry;
     bool ret = true;
     bool g_param_was_set = false;
 
-    if (!gjs_get_string_id(context, id, &name))
-        return true; /* not resolved, but no error */
-
     priv = priv_from_js(context, obj);
-    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
-                     "Set prop '%s' hook obj %p priv %p",
-                     name, obj.get(), priv);
 
     if (priv == NULL) {
         /* see the comment in object_instance_get_prop() on this */
-        goto out;
+        return true;
     }
     if (priv->gobj == NULL) /* prototype, not an instance. */
-        goto out;
+        return true;
 
-    ret = set_g_param_from_prop(context, priv, name, g_param_was_set, value_p);
+    entry = lookup_property(context, obj, priv, id);
+    if (entry == NULL)
+        return true; /* not resolved, but no error */
+
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
+                     "Set prop '%s' hook obj %p priv %p",
+                     entry->name, obj.get(), priv);
+
+    ret = set_g_param_from_prop(context, priv, entry->name, entry->param,
+                                g_param_was_set, value_p);
     if (g_param_was_set || !ret)
         goto out;
 
-    ret = check_set_field_from_prop(context, priv, name, strict, value_p);
+    ret = check_set_field_from_prop(context, priv, entry->name, entry->field,
+                                    strict, value_p);
 
     /* note that the prop will also have been set in JS, which I think
      * is OK, since we hook get and set so will always override that
@@ -536,7 +765,7 @@ object_instance_set_prop(JSContext              *context,
      */
 
  out:
-    g_free(name);
+    property_cache_entry_unref(entry);
     return ret;
 }
 
@@ -600,24 +829,22 @@ find_vfunc_on_parents(GIObjectInfo *info,
     return vfunc;
 }
 
-static bool
-object_instance_new_resolve_no_info(JSContext       *context,
-                                    JS::HandleObject obj,
-                                    JS::MutableHandleObject objp,
-                                    ObjectInstance  *priv,
-                                    char            *name)
+/* Looks through the interfaces of @gtype, which may or may not have
+ * introspection info itself, for a method called @name. */
+static GIFunctionInfo *
+find_method_on_gtype_interfaces(GType       gtype,
+                                const char *name)
 {
-    GIFunctionInfo *method_info;
-    bool ret;
+    GIFunctionInfo *found = NULL;
     GType *interfaces;
     guint n_interfaces;
     guint i;
 
-    ret = true;
-    interfaces = g_type_interfaces(priv->gtype, &n_interfaces);
+    interfaces = g_type_interfaces(gtype, &n_interfaces);
     for (i = 0; i < n_interfaces; i++) {
         GIBaseInfo *base_info;
         GIInterfaceInfo *iface_info;
+        GIFunctionInfo *method_info;
 
         base_info = g_irepository_find_by_gtype(g_irepository_get_default(),
                                                 interfaces[i]);
@@ -634,81 +861,37 @@ object_instance_new_resolve_no_info(JSContext       *context,
 
         g_base_info_unref(base_info);
 
+        if (method_info == NULL)
+            continue;
 
-        if (method_info != NULL) {
-            if (g_function_info_get_flags (method_info) & GI_FUNCTION_IS_METHOD) {
-                if (gjs_define_function(context, obj, priv->gtype,
-                                        (GICallableInfo *)method_info)) {
-                    objp.set(obj);
-                } else {
-                    ret = false;
-                }
-            }
-
-            g_base_info_unref( (GIBaseInfo*) method_info);
+        /* If several interfaces have a method with this name, the last one
+         * wins, as it would if we defined each of them in turn. */
+        if (g_function_info_get_flags (method_info) & GI_FUNCTION_IS_METHOD) {
+            if (found != NULL)
+                g_base_info_unref((GIBaseInfo *) found);
+            found = method_info;
+        } else {
+            g_base_info_unref((GIBaseInfo *) method_info);
         }
     }
 
     g_free(interfaces);
-    return ret;
+    return found;
 }
 
-/*
- * The *objp out parameter, on success, should be null to indicate that id
- * was not resolved; and non-null, referring to obj or one of its prototypes,
- * if id was resolved.
- */
-static bool
-object_instance_new_resolve(JSContext *context,
-                            JS::HandleObject obj,
-                            JS::HandleId id,
-                            JS::MutableHandleObject objp)
+/* Returns the vfunc or method info to define in the prototype of @priv for
+ * @name, or NULL if there is nothing to define. */
+static GIBaseInfo *
+find_prototype_member(ObjectInstance *priv,
+                      const char     *name)
 {
     GIFunctionInfo *method_info;
-    ObjectInstance *priv;
-    char *name;
-    bool ret = false;
-
-    if (!gjs_get_string_id(context, id, &name))
-        return true; /* not resolved, but no error */
-
-    priv = priv_from_js(context, obj);
-
-    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
-                     "Resolve prop '%s' hook obj %p priv %p (%s.%s) gobj %p %s",
-                     name,
-                     obj.get(),
-                     priv,
-                     priv && priv->info ? g_base_info_get_namespace (priv->info) : "",
-                     priv && priv->info ? g_base_info_get_name (priv->info) : "",
-                     priv ? priv->gobj : NULL,
-                     (priv && priv->gobj) ? g_type_name_from_instance((GTypeInstance*) priv->gobj) : "(type unknown)");
-
-    if (priv == NULL) {
-        /* We won't have a private until the initializer is called, so
-         * just defer to prototype chains in this case.
-         *
-         * This isn't too bad: either you get undefined if the field
-         * doesn't exist on any of the prototype chains, or whatever code
-         * will run afterwards will fail because of the "priv == NULL"
-         * check there.
-         */
-        ret = true;
-        goto out;
-    }
-
-    if (priv->gobj != NULL) {
-        ret = true;
-        goto out;
-    }
 
     /* If we have no GIRepository information (we're a JS GObject subclass),
      * we need to look at exposing interfaces. Look up our interfaces through
      * GType data, and then hope that *those* are introspectable. */
-    if (priv->info == NULL) {
-        ret = object_instance_new_resolve_no_info(context, obj, objp, priv, name);
-        goto out;
-    }
+    if (priv->info == NULL)
+        return (GIBaseInfo *) find_method_on_gtype_interfaces(priv->gtype, name);
 
     if (g_str_has_prefix (name, "vfunc_")) {
         /* The only time we find a vfunc info is when we're the base
@@ -725,7 +908,7 @@ object_instance_new_resolve(JSContext *context,
          * rest.
          */
 
-        gchar *name_without_vfunc_ = &name[6];
+        gchar *name_without_vfunc_ = (gchar *) &name[6];
         GIVFuncInfo *vfunc;
         bool defined_by_parent;
 
@@ -735,15 +918,10 @@ object_instance_new_resolve(JSContext *context,
              * prototypal inheritance take over. */
             if (defined_by_parent && is_vfunc_unchanged(vfunc, priv->gtype)) {
                 g_base_info_unref((GIBaseInfo *)vfunc);
-                ret = true;
-                goto out;
+                return NULL;
             }
 
-            gjs_define_function(context, obj, priv->gtype, vfunc);
-            objp.set(obj);
-            g_base_info_unref((GIBaseInfo *)vfunc);
-            ret = true;
-            goto out;
+            return (GIBaseInfo *) vfunc;
         }
 
         /* If the vfunc wasn't found, fall through, back to normal
@@ -770,37 +948,151 @@ object_instance_new_resolve(JSContext *context,
      * this could be done better.  See
      * https://bugzilla.gnome.org/show_bug.cgi?id=632922
      */
-    if (method_info == NULL) {
-        ret = object_instance_new_resolve_no_info(context, obj, objp,
-                                                  priv, name);
-        goto out;
-    } else {
+    if (method_info == NULL)
+        return (GIBaseInfo *) find_method_on_gtype_interfaces(priv->gtype, name);
+
 #if GJS_VERBOSE_ENABLE_GI_USAGE
-        _gjs_log_info_usage((GIBaseInfo*) method_info);
+    _gjs_log_info_usage((GIBaseInfo*) method_info);
 #endif
 
-        if (g_function_info_get_flags (method_info) & GI_FUNCTION_IS_METHOD) {
-            gjs_debug(GJS_DEBUG_GOBJECT,
-                      "Defining method %s in prototype for %s (%s.%s)",
-                      g_base_info_get_name( (GIBaseInfo*) method_info),
-                      g_type_name(priv->gtype),
-                      g_base_info_get_namespace( (GIBaseInfo*) priv->info),
-                      g_base_info_get_name( (GIBaseInfo*) priv->info));
-
-            if (gjs_define_function(context, obj, priv->gtype, method_info) == NULL) {
-                g_base_info_unref( (GIBaseInfo*) method_info);
-                goto out;
-            }
+    if (!(g_function_info_get_flags (method_info) & GI_FUNCTION_IS_METHOD)) {
+        g_base_info_unref((GIBaseInfo *) method_info);
+        return NULL;
+    }
 
-            objp.set(obj); /* we defined the prop in obj */
-        }
+    return (GIBaseInfo *) method_info;
+}
 
-        g_base_info_unref( (GIBaseInfo*) method_info);
+/* Names that resolve to nothing are remembered as well, but any expando
+ * that JS code sets on an instance ends up here, so only this many of them
+ * are kept for each GType */
+#define METHOD_INDEX_MAX_MISSES 256
+
+typedef struct {
+    GHashTable *members;
+    guint n_misses;
+} MethodIndex;
+
+static void
+method_index_value_free(gpointer data)
+{
+    if (data != NULL)
+        g_base_info_unref((GIBaseInfo *) data);
+}
+
+/* Each GType has an index of the names that have been resolved on its
+ * prototypes, shared by all of them. A name maps to the info that gets
+ * defined for it, or to NULL if nothing does, so that each name only has
+ * to be looked up in the typelib once. */
+static MethodIndex *
+get_method_index(GType gtype)
+{
+    MethodIndex *index;
+
+    index = (MethodIndex *) g_type_get_qdata(gtype, gjs_method_index_quark());
+    if (G_UNLIKELY(index == NULL)) {
+        index = g_slice_new0(MethodIndex);
+        index->members = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               method_index_value_free);
+        g_type_set_qdata(gtype, gjs_method_index_quark(), index);
+    }
+
+    return index;
+}
+
+static GIBaseInfo *
+lookup_prototype_member(ObjectInstance *priv,
+                        const char     *name)
+{
+    MethodIndex *index = get_method_index(priv->gtype);
+    GIBaseInfo *info;
+
+    if (g_hash_table_lookup_extended(index->members, name, NULL,
+                                     (gpointer *) &info))
+        return info;
+
+    info = find_prototype_member(priv, name);
+    if (info != NULL) {
+        g_hash_table_insert(index->members, g_strdup(name), info);
+    } else if (index->n_misses < METHOD_INDEX_MAX_MISSES) {
+        g_hash_table_insert(index->members, g_strdup(name), NULL);
+        index->n_misses++;
+    }
+
+    return info;
+}
+
+/*
+ * The *objp out parameter, on success, should be null to indicate that id
+ * was not resolved; and non-null, referring to obj or one of its prototypes,
+ * if id was resolved.
+ */
+static bool
+object_instance_new_resolve(JSContext *context,
+                            JS::HandleObject obj,
+                            JS::HandleId id,
+                            JS::MutableHandleObject objp)
+{
+    GIBaseInfo *info;
+    ObjectInstance *priv;
+    const char *name;
+    bool ret = false;
+
+    if (!gjs_borrow_string_id(context, id, &name))
+        return true; /* not resolved, but no error */
+
+    priv = priv_from_js(context, obj);
+
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
+                     "Resolve prop '%s' hook obj %p priv %p (%s.%s) gobj %p %s",
+                     name,
+                     obj.get(),
+                     priv,
+                     priv && priv->info ? g_base_info_get_namespace (priv->info) : "",
+                     priv && priv->info ? g_base_info_get_name (priv->info) : "",
+                     priv ? priv->gobj : NULL,
+                     (priv && priv->gobj) ? g_type_name_from_instance((GTypeInstance*) priv->gobj) : "(type unknown)");
+
+    if (priv == NULL) {
+        /* We won't have a private until the initializer is called, so
+         * just defer to prototype chains in this case.
+         *
+         * This isn't too bad: either you get undefined if the field
+         * doesn't exist on any of the prototype chains, or whatever code
+         * will run afterwards will fail because of the "priv == NULL"
+         * check there.
+         */
+        ret = true;
+        goto out;
+    }
+
+    if (priv->gobj != NULL) {
+        ret = true;
+        goto out;
+    }
+
+    info = lookup_prototype_member(priv, name);
+    if (info == NULL) {
+        ret = true;
+        goto out;
     }
 
+    gjs_debug(GJS_DEBUG_GOBJECT,
+              "Defining method %s in prototype for %s (%s.%s)",
+              g_base_info_get_name(info),
+              g_type_name(priv->gtype),
+              priv->info ? g_base_info_get_namespace((GIBaseInfo *) priv->info) : "",
+              priv->info ? g_base_info_get_name((GIBaseInfo *) priv->info) : "");
+
+    if (gjs_define_function(context, obj, priv->gtype,
+                            (GICallableInfo *) info) == NULL)
+        goto out;
+
+    objp.set(obj); /* we defined the prop in obj */
+
     ret = true;
  out:
-    g_free(name);
+    gjs_release_string_id(context, name);
     return ret;
 }
 
@@ -913,6 +1205,7 @@ gobj_no_longer_kept_alive_func(JSObject *obj,
                         "GObject wrapper %p will no longer be kept alive, eligible for collection",
                         obj);
 
+    gjs_heap_object_pre_barrier(priv->keep_alive);
     priv->keep_alive = NULL;
 }
 
@@ -962,16 +1255,18 @@ cancel_toggle_idle(GObject         *gobj,
                    ToggleDirection  direction)
 {
     GQuark qdata_key;
-    GSource *source;
+    ToggleRefNotifyOperation *operation;
 
     qdata_key = get_qdata_key_for_toggle_direction(direction);
 
-    source = (GSource*) g_object_steal_qdata(gobj, qdata_key);
+    operation = (ToggleRefNotifyOperation *) g_object_steal_qdata(gobj, qdata_key);
 
-    if (source)
-        g_source_destroy(source);
+    /* The operation can't be taken out of the queue, but it won't touch
+     * the object when it is drained */
+    if (operation)
+        operation->cancelled = true;
 
-    return source != 0;
+    return operation != NULL;
 }
 
 static void
@@ -986,7 +1281,7 @@ handle_toggle_down(GObject *gobj)
 
     gjs_debug_lifecycle(GJS_DEBUG_GOBJECT,
                         "Toggle notify gobj %p obj %p is_last_ref true keep-alive %p",
-                        gobj, obj, priv->keep_alive);
+                        gobj, obj, priv->keep_alive.get());
 
     /* Change to weak ref so the wrapper-wrappee pair can be
      * collected by the GC
@@ -997,6 +1292,7 @@ handle_toggle_down(GObject *gobj)
                                     gobj_no_longer_kept_alive_func,
                                     obj,
                                     priv);
+        gjs_heap_object_pre_barrier(priv->keep_alive);
         priv->keep_alive = NULL;
     }
 }
@@ -1020,7 +1316,7 @@ handle_toggle_up(GObject   *gobj)
 
     gjs_debug_lifecycle(GJS_DEBUG_GOBJECT,
                         "Toggle notify gobj %p obj %p is_last_ref false keep-alive %p",
-                        gobj, obj, priv->keep_alive);
+                        gobj, obj, priv->keep_alive.get());
 
     /* Change to strong ref so the wrappee keeps the wrapper alive
      * in case the wrapper has data in it that the app cares about
@@ -1038,14 +1334,15 @@ handle_toggle_up(GObject   *gobj)
     }
 }
 
-static gboolean
-idle_handle_toggle(gpointer data)
+static void
+handle_queued_toggle(ToggleRefNotifyOperation *operation)
 {
-    ToggleRefNotifyOperation *operation = (ToggleRefNotifyOperation *) data;
+    if (operation->cancelled)
+        return;
 
     if (!clear_toggle_idle_source(operation->gobj, operation->direction)) {
         /* Already cleared, the JSObject is going away, abort mission */
-        goto out;
+        return;
     }
 
     switch (operation->direction) {
@@ -1058,9 +1355,6 @@ idle_handle_toggle(gpointer data)
         default:
             g_assert_not_reached();
     }
-
-out:
-    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -1069,14 +1363,87 @@ toggle_ref_notify_operation_free(ToggleRefNotifyOperation *operation)
     if (operation->needs_unref)
         g_object_unref (operation->gobj);
     g_slice_free(ToggleRefNotifyOperation, operation);
-    g_atomic_int_add(&pending_idle_toggles, -1);
+    GJS_DEC_STAT_COUNTER(toggle_queue_depth);
+}
+
+static bool
+toggle_queue_is_empty(void)
+{
+    return g_atomic_pointer_get(&toggle_queue) == NULL;
+}
+
+static gboolean
+toggle_queue_prepare(GSource *source,
+                     gint    *timeout)
+{
+    *timeout = -1;
+    return !toggle_queue_is_empty();
+}
+
+static gboolean
+toggle_queue_check(GSource *source)
+{
+    return !toggle_queue_is_empty();
+}
+
+static gboolean
+toggle_queue_dispatch(GSource    *source,
+                      GSourceFunc callback,
+                      gpointer    user_data)
+{
+    ToggleRefNotifyOperation *operation, *next, *pending = NULL;
+
+    /* Take everything that has been queued so far... */
+    do {
+        operation = (ToggleRefNotifyOperation *) g_atomic_pointer_get(&toggle_queue);
+    } while (!g_atomic_pointer_compare_and_exchange(&toggle_queue,
+                                                    operation, NULL));
+
+    /* ...and reverse it, so the operations are handled in the order they
+     * were queued; a toggle down is always handled before the toggle up
+     * that follows it. */
+    for (; operation != NULL; operation = next) {
+        next = operation->next;
+        operation->next = pending;
+        pending = operation;
+    }
+
+    for (operation = pending; operation != NULL; operation = next) {
+        next = operation->next;
+        handle_queued_toggle(operation);
+        toggle_ref_notify_operation_free(operation);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs toggle_queue_source_funcs = {
+    toggle_queue_prepare,
+    toggle_queue_check,
+    toggle_queue_dispatch,
+    NULL
+};
+
+static GSource *
+ensure_toggle_queue_source(void)
+{
+    if (g_once_init_enter(&toggle_queue_source)) {
+        GSource *source = g_source_new(&toggle_queue_source_funcs,
+                                       sizeof(GSource));
+        g_source_set_priority(source, G_PRIORITY_HIGH);
+        g_source_set_name(source, "GJS toggle ref queue");
+        g_source_attach(source, NULL);
+        g_once_init_leave(&toggle_queue_source, source);
+    }
+
+    return toggle_queue_source;
 }
 
 static void
 queue_toggle_idle(GObject         *gobj,
                   ToggleDirection  direction)
 {
-    ToggleRefNotifyOperation *operation;
+    ToggleRefNotifyOperation *operation, *head;
     GQuark qdata_key;
     GSource *source;
 
@@ -1109,20 +1476,20 @@ queue_toggle_idle(GObject         *gobj,
     }
 
     qdata_key = get_qdata_key_for_toggle_direction(direction);
+    source = ensure_toggle_queue_source();
 
-    source = g_idle_source_new();
-    g_source_set_priority(source, G_PRIORITY_HIGH);
-    g_source_set_callback(source,
-                          idle_handle_toggle,
-                          operation,
-                          (GDestroyNotify) toggle_ref_notify_operation_free);
+    GJS_INC_STAT_COUNTER(toggle_queue_depth);
+    g_object_set_qdata (gobj, qdata_key, operation);
 
-    g_atomic_int_inc(&pending_idle_toggles);
-    g_object_set_qdata (gobj, qdata_key, source);
-    g_source_attach (source, NULL);
+    do {
+        head = (ToggleRefNotifyOperation *) g_atomic_pointer_get(&toggle_queue);
+        operation->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&toggle_queue,
+                                                    head, operation));
 
-    /* object qdata is piggy-backing off the main loop's ref of the source */
-    g_source_unref (source);
+    /* Only the first operation in a batch needs to wake up the main loop */
+    if (head == NULL)
+        g_main_context_wakeup(g_source_get_context(source));
 }
 
 static void
@@ -1236,6 +1603,9 @@ release_native_object (ObjectInstance *priv)
     set_js_obj(priv->gobj, NULL);
     g_object_remove_toggle_ref(priv->gobj, wrapped_gobj_toggle_notify, NULL);
     priv->gobj = NULL;
+
+    gjs_gc_track_native_memory(GJS_GC_NATIVE_OBJECT, -(gssize) priv->native_size);
+    priv->native_size = 0;
 }
 
 /* At shutdown, we need to ensure we've cleared the context of any
@@ -1254,7 +1624,7 @@ gjs_object_prepare_shutdown (JSContext *context)
 
     /* First, get rid of anything left over on the main context */
     while (g_main_context_pending(NULL) &&
-           g_atomic_int_get(&pending_idle_toggles) > 0) {
+           GJS_GET_COUNTER(toggle_queue_depth) > 0) {
         g_main_context_iteration(NULL, false);
     }
 
@@ -1282,7 +1652,7 @@ init_object_private (JSContext       *context,
 
     JS_BeginRequest(context);
 
-    priv = g_slice_new0(ObjectInstance);
+    priv = new ObjectInstance();
 
     GJS_INC_COUNTER(object);
 
@@ -1311,10 +1681,15 @@ associate_js_gobject (JSContext       *context,
                       GObject         *gobj)
 {
     ObjectInstance *priv;
+    GTypeQuery query;
 
     priv = priv_from_js(context, object);
     priv->gobj = gobj;
 
+    g_type_query(G_OBJECT_TYPE(gobj), &query);
+    priv->native_size = query.instance_size;
+    gjs_gc_track_native_memory(GJS_GC_NATIVE_OBJECT, priv->native_size);
+
     g_assert(peek_js_obj(gobj) == NULL);
     set_js_obj(gobj, object);
 
@@ -1516,6 +1891,13 @@ object_instance_trace(JSTracer *tracer,
 
         gjs_closure_trace(cd->closure, tracer);
     }
+
+    if (priv->property_cache)
+        property_cache_trace(tracer, priv->property_cache);
+
+    if (priv->keep_alive != NULL)
+        JS_CallHeapObjectTracer(tracer, &priv->keep_alive,
+                                "ObjectInstance::keep_alive");
 }
 
 static void
@@ -1588,8 +1970,14 @@ object_instance_finalize(JSFreeOp  *fop,
         priv->klass = NULL;
     }
 
+    if (priv->property_cache)
+        property_cache_free(priv);
+
+    if (priv->signal_cache)
+        g_hash_table_destroy(priv->signal_cache);
+
     GJS_DEC_COUNTER(object);
-    g_slice_free(ObjectInstance, priv);
+    delete priv;
 }
 
 static JSObject *
@@ -1777,21 +2165,95 @@ connect_func(JSContext *context,
     return real_connect_func(context, argc, vp, false);
 }
 
+static void
+signal_cache_entry_free(gpointer data)
+{
+    g_slice_free(SignalCacheEntry, data);
+}
+
+/* Parses the signal name @str for the instance @priv into @scratch, or
+ * finds it in the cache of its prototype. Returns NULL with an exception
+ * set if there is no such signal. */
+static SignalCacheEntry *
+lookup_signal(JSContext        *context,
+              JS::HandleObject  obj,
+              ObjectInstance   *priv,
+              JS::HandleString  str,
+              SignalCacheEntry *scratch)
+{
+    ObjectInstance *proto_priv;
+    SignalCacheEntry *entry;
+    char *signal_name;
+    jsid id;
+
+    proto_priv = caching_proto_priv_from_js(context, obj, priv);
+
+    /* Signal names given as literals are atoms already, so they can be
+     * looked up without converting them to UTF-8 */
+    if (proto_priv != NULL && proto_priv->signal_cache != NULL &&
+        JS_StringHasBeenInterned(context, str)) {
+        id = INTERNED_STRING_TO_JSID(context, str);
+        entry = (SignalCacheEntry *) g_hash_table_lookup(proto_priv->signal_cache,
+                                                         GSIZE_TO_POINTER(JSID_BITS(id)));
+        if (entry != NULL)
+            return entry;
+    }
+
+    if (!gjs_string_to_utf8(context, JS::StringValue(str), &signal_name))
+        return NULL;
+
+    if (!g_signal_parse_name(signal_name,
+                             G_OBJECT_TYPE(priv->gobj),
+                             &scratch->signal_id,
+                             &scratch->detail,
+                             false)) {
+        gjs_throw(context, "No signal '%s' on object '%s'",
+                     signal_name,
+                     g_type_name(G_OBJECT_TYPE(priv->gobj)));
+        g_free(signal_name);
+        return NULL;
+    }
+
+    g_free(signal_name);
+    g_signal_query(scratch->signal_id, &scratch->query);
+
+    /* Only valid signal names are interned, and so kept alive for as long
+     * as the runtime, so that the key can't be reused for another name */
+    if (proto_priv == NULL || JS_InternJSString(context, str) == NULL) {
+        JS_ClearPendingException(context);
+        return scratch;
+    }
+
+    if (proto_priv->signal_cache == NULL)
+        proto_priv->signal_cache = g_hash_table_new_full(g_direct_hash,
+                                                         g_direct_equal, NULL,
+                                                         signal_cache_entry_free);
+
+    id = INTERNED_STRING_TO_JSID(context, str);
+    entry = g_slice_new(SignalCacheEntry);
+    *entry = *scratch;
+    g_hash_table_insert(proto_priv->signal_cache,
+                        GSIZE_TO_POINTER(JSID_BITS(id)), entry);
+
+    return entry;
+}
+
+/* Most signals have few enough arguments that emitting them doesn't need
+ * to touch the heap */
+#define EMIT_PREALLOCATED_VALUES 8
+
 static bool
 emit_func(JSContext *context,
           unsigned   argc,
           JS::Value *vp)
 {
     GJS_GET_PRIV(context, argc, vp, argv, obj, ObjectInstance, priv);
-    guint signal_id;
-    GQuark signal_detail;
-    GSignalQuery signal_query;
-    char *signal_name;
+    SignalCacheEntry scratch, *signal;
+    GValue preallocated_values[EMIT_PREALLOCATED_VALUES];
     GValue *instance_and_args;
     GValue rvalue = G_VALUE_INIT;
-    unsigned int i;
+    unsigned int i, n_values;
     bool failed;
-    bool ret = false;
 
     gjs_debug_gsignal("emit obj %p priv %p argc %d", obj.get(), priv, argc);
 
@@ -1813,48 +2275,42 @@ emit_func(JSContext *context,
         return false;
     }
 
-    if (!gjs_string_to_utf8(context, argv[0], &signal_name))
+    JS::RootedString signal_str(context, argv[0].toString());
+    signal = lookup_signal(context, obj, priv, signal_str, &scratch);
+    if (signal == NULL)
         return false;
 
-    if (!g_signal_parse_name(signal_name,
-                             G_OBJECT_TYPE(priv->gobj),
-                             &signal_id,
-                             &signal_detail,
-                             false)) {
-        gjs_throw(context, "No signal '%s' on object '%s'",
-                     signal_name,
-                     g_type_name(G_OBJECT_TYPE(priv->gobj)));
-        goto out;
-    }
-
-    g_signal_query(signal_id, &signal_query);
-
-    if ((argc - 1) != signal_query.n_params) {
+    if ((argc - 1) != signal->query.n_params) {
         gjs_throw(context, "Signal '%s' on %s requires %d args got %d",
-                     signal_name,
+                     signal->query.signal_name,
                      g_type_name(G_OBJECT_TYPE(priv->gobj)),
-                     signal_query.n_params,
+                     signal->query.n_params,
                      argc - 1);
-        goto out;
+        return false;
     }
 
-    if (signal_query.return_type != G_TYPE_NONE) {
-        g_value_init(&rvalue, signal_query.return_type & ~G_SIGNAL_TYPE_STATIC_SCOPE);
+    if (signal->query.return_type != G_TYPE_NONE) {
+        g_value_init(&rvalue, signal->query.return_type & ~G_SIGNAL_TYPE_STATIC_SCOPE);
     }
 
-    instance_and_args = g_newa(GValue, signal_query.n_params + 1);
-    memset(instance_and_args, 0, sizeof(GValue) * (signal_query.n_params + 1));
+    n_values = signal->query.n_params + 1;
+    if (n_values <= EMIT_PREALLOCATED_VALUES)
+        instance_and_args = preallocated_values;
+    else
+        instance_and_args = g_new(GValue, n_values);
+    memset(instance_and_args, 0, sizeof(GValue) * n_values);
 
     g_value_init(&instance_and_args[0], G_TYPE_FROM_INSTANCE(priv->gobj));
     g_value_set_instance(&instance_and_args[0], priv->gobj);
 
     failed = false;
-    for (i = 0; i < signal_query.n_params; ++i) {
+    for (i = 0; i < signal->query.n_params; ++i) {
         GValue *value;
+        GType param_type = signal->query.param_types[i];
         value = &instance_and_args[i + 1];
 
-        g_value_init(value, signal_query.param_types[i] & ~G_SIGNAL_TYPE_STATIC_SCOPE);
-        if ((signal_query.param_types[i] & G_SIGNAL_TYPE_STATIC_SCOPE) != 0)
+        g_value_init(value, param_type & ~G_SIGNAL_TYPE_STATIC_SCOPE);
+        if ((param_type & G_SIGNAL_TYPE_STATIC_SCOPE) != 0)
             failed = !gjs_value_to_g_value_no_copy(context, argv[i + 1], value);
         else
             failed = !gjs_value_to_g_value(context, argv[i + 1], value);
@@ -1864,11 +2320,11 @@ emit_func(JSContext *context,
     }
 
     if (!failed) {
-        g_signal_emitv(instance_and_args, signal_id, signal_detail,
+        g_signal_emitv(instance_and_args, signal->signal_id, signal->detail,
                        &rvalue);
     }
 
-    if (signal_query.return_type != G_TYPE_NONE) {
+    if (signal->query.return_type != G_TYPE_NONE) {
         if (!gjs_value_from_g_value(context, argv.rval(), &rvalue))
             failed = true;
 
@@ -1877,14 +2333,14 @@ emit_func(JSContext *context,
         argv.rval().setUndefined();
     }
 
-    for (i = 0; i < (signal_query.n_params + 1); ++i) {
+    for (i = 0; i < n_values; ++i) {
         g_value_unset(&instance_and_args[i]);
     }
 
-    ret = !failed;
- out:
-    g_free(signal_name);
-    return ret;
+    if (instance_and_args != preallocated_values)
+        g_free(instance_and_args);
+
+    return !failed;
 }
 
 static bool
@@ -1907,6 +2363,7 @@ to_string_func(JSContext *context,
 struct JSClass gjs_object_instance_class = {
     "GObject_Object",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE,
     JS_PropertyStub,
     JS_DeletePropertyStub,
@@ -2012,6 +2469,187 @@ gjs_object_define_static_methods(JSContext       *context,
     g_base_info_unref((GIBaseInfo*) gtype_struct);
 }
 
+/* Reserved slot in the GObject property accessor functions, holding the
+ * GParamSpec that they get or set */
+#define PROPERTY_ACCESSOR_SLOT_PARAM_SPEC 0
+
+static GParamSpec *
+property_accessor_get_param_spec(JS::CallArgs& args)
+{
+    JS::Value v = js::GetFunctionNativeReserved(&args.callee(),
+                                                PROPERTY_ACCESSOR_SLOT_PARAM_SPEC);
+    return (GParamSpec *) v.toPrivate();
+}
+
+/* Returns false with an exception set if the accessor was called on an
+ * object that doesn't have this property. Otherwise returns true, and sets
+ * *priv_p to NULL if there is nothing to get or set, because it's not an
+ * instance. */
+static bool
+property_accessor_get_instance(JSContext       *context,
+                               JS::CallArgs&    args,
+                               GParamSpec      *pspec,
+                               ObjectInstance **priv_p)
+{
+    ObjectInstance *priv = NULL;
+
+    if (args.thisv().isObject()) {
+        JS::RootedObject obj(context, &args.thisv().toObject());
+        priv = priv_from_js(context, obj);
+    }
+
+    if (priv != NULL && priv->gobj != NULL &&
+        !G_TYPE_CHECK_INSTANCE_TYPE(priv->gobj, pspec->owner_type)) {
+        gjs_throw(context, "Object of type %s has no property %s of %s",
+                  G_OBJECT_TYPE_NAME(priv->gobj), pspec->name,
+                  g_type_name(pspec->owner_type));
+        return false;
+    }
+
+    /* Prototypes, and subclass instances that didn't chain up to _init,
+     * have nothing to get or set */
+    *priv_p = (priv != NULL && priv->gobj != NULL) ? priv : NULL;
+    return true;
+}
+
+static bool
+object_property_getter(JSContext *context,
+                       unsigned   argc,
+                       JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    GParamSpec *pspec = property_accessor_get_param_spec(args);
+    ObjectInstance *priv;
+    GValue gvalue = G_VALUE_INIT;
+    bool ret;
+
+    if (!property_accessor_get_instance(context, args, pspec, &priv))
+        return false;
+
+    if (priv == NULL || (pspec->flags & G_PARAM_READABLE) == 0) {
+        args.rval().setUndefined();
+        return true;
+    }
+
+    g_value_init(&gvalue, G_PARAM_SPEC_VALUE_TYPE(pspec));
+    g_object_get_property(priv->gobj, pspec->name, &gvalue);
+    ret = gjs_value_from_g_value(context, args.rval(), &gvalue);
+    g_value_unset(&gvalue);
+
+    return ret;
+}
+
+static bool
+object_property_setter(JSContext *context,
+                       unsigned   argc,
+                       JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    GParamSpec *pspec = property_accessor_get_param_spec(args);
+    ObjectInstance *priv;
+    GParameter param = { NULL, { 0, }};
+
+    args.rval().setUndefined();
+
+    if (!property_accessor_get_instance(context, args, pspec, &priv))
+        return false;
+
+    if (priv == NULL)
+        return true;
+
+    if (init_g_param_from_param_spec(context, pspec->name, pspec,
+                                     args.get(0), &param,
+                                     false /* constructing */) != VALUE_WAS_SET)
+        return false;
+
+    g_object_set_property(priv->gobj, param.name, &param.value);
+    g_value_unset(&param.value);
+
+    return true;
+}
+
+static JSObject *
+new_property_accessor(JSContext  *context,
+                      JSNative    native,
+                      GParamSpec *pspec)
+{
+    JSFunction *func = js::NewFunctionWithReserved(context, native, 0, 0,
+                                                   JS::CurrentGlobalOrNull(context),
+                                                   pspec->name);
+    if (func == NULL)
+        return NULL;
+
+    JSObject *func_obj = JS_GetFunctionObject(func);
+    js::SetFunctionNativeReserved(func_obj, PROPERTY_ACCESSOR_SLOT_PARAM_SPEC,
+                                  JS::PrivateValue(pspec));
+    return func_obj;
+}
+
+/* Defines a getter and setter on @prototype for each GObject property
+ * introduced by @gtype, under both its underscore and camelCase names.
+ * These are found before the get and set hooks of the instance class are
+ * consulted, and already know their GParamSpec. Properties that are
+ * implemented in JS are left to the hooks.
+ */
+static bool
+define_property_accessors(JSContext       *context,
+                          JS::HandleObject prototype,
+                          ObjectInstance  *priv)
+{
+    GParamSpec **pspecs;
+    guint n_pspecs, i;
+    bool ret = true;
+
+    if (gjs_environment_variable_is_set("GJS_DISABLE_FAST_PATHS"))
+        return true;
+
+    pspecs = g_object_class_list_properties(G_OBJECT_CLASS(priv->klass),
+                                            &n_pspecs);
+
+    for (i = 0; i < n_pspecs && ret; i++) {
+        GParamSpec *pspec = pspecs[i];
+        char *underscore_name, *camel_name;
+
+        /* Inherited properties are defined on the parent's prototype */
+        if (pspec->owner_type != priv->gtype)
+            continue;
+
+        if (g_param_spec_get_qdata(pspec, gjs_is_custom_property_quark()))
+            continue;
+
+        JS::RootedObject getter(context,
+            new_property_accessor(context, object_property_getter, pspec));
+        JS::RootedObject setter(context,
+            new_property_accessor(context, object_property_setter, pspec));
+        if (getter == NULL || setter == NULL) {
+            ret = false;
+            break;
+        }
+
+        underscore_name = g_strdelimit(g_strdup(pspec->name), "-", '_');
+        camel_name = gjs_camel_from_hyphen(pspec->name);
+
+        ret = JS_DefineProperty(context, prototype, underscore_name,
+                                JS::UndefinedHandleValue,
+                                JSPROP_GETTER | JSPROP_SETTER | JSPROP_SHARED,
+                                JS_DATA_TO_FUNC_PTR(JSPropertyOp, getter.get()),
+                                JS_DATA_TO_FUNC_PTR(JSStrictPropertyOp, setter.get()));
+
+        if (ret && strcmp(underscore_name, camel_name) != 0)
+            ret = JS_DefineProperty(context, prototype, camel_name,
+                                    JS::UndefinedHandleValue,
+                                    JSPROP_GETTER | JSPROP_SETTER | JSPROP_SHARED,
+                                    JS_DATA_TO_FUNC_PTR(JSPropertyOp, getter.get()),
+                                    JS_DATA_TO_FUNC_PTR(JSStrictPropertyOp, setter.get()));
+
+        g_free(underscore_name);
+        g_free(camel_name);
+    }
+
+    g_free(pspecs);
+    return ret;
+}
+
 void
 gjs_define_object_class(JSContext              *context,
                         JS::HandleObject        in_object,
@@ -2095,7 +2733,7 @@ gjs_define_object_class(JSContext              *context,
     }
 
     GJS_INC_COUNTER(object);
-    priv = g_slice_new0(ObjectInstance);
+    priv = new ObjectInstance();
     priv->info = info;
     if (info)
         g_base_info_ref((GIBaseInfo*) info);
@@ -2110,6 +2748,9 @@ gjs_define_object_class(JSContext              *context,
     if (info)
         gjs_object_define_static_methods(context, constructor, gtype, info);
 
+    if (!define_property_accessors(context, prototype, priv))
+        g_error("Can't define properties of class %s", constructor_name);
+
     JS::RootedObject gtype_obj(context,
         gjs_gtype_create_gtype_wrapper(context, gtype));
     JS_DefineProperty(context, constructor, "$gtype", gtype_obj,
@@ -2135,6 +2776,9 @@ ensure_heap_wrapper(GObject *gobj)
     return static_cast<JS::Heap<JSObject *> *>(data);
 }
 
+/* The wrapper pointer is weak, so nothing marks it; an incremental GC in
+ * progress could sweep a wrapper that is handed back to JS after marking
+ * started, unless it is exposed first */
 static JSObject*
 peek_js_obj(GObject *gobj)
 {
@@ -2148,7 +2792,10 @@ peek_js_obj(GObject *gobj)
         return NULL; /* return null to associate again with a new wrapper */
     }
 
-    return heap_object->get();
+    JSObject *obj = heap_object->get();
+    if (obj != NULL)
+        JS::ExposeObjectToActiveJS(obj);
+    return obj;
 }
 
 static void
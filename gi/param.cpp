@@ -58,10 +58,10 @@ param_new_resolve(JSContext *context,
     GIObjectInfo *info = NULL;
     GIFunctionInfo *method_info;
     Param *priv;
-    char *name;
+    const char *name;
     bool ret = false;
 
-    if (!gjs_get_string_id(context, id, &name))
+    if (!gjs_borrow_string_id(context, id, &name))
         return true; /* not resolved, but no error */
 
     priv = priv_from_js(context, obj);
@@ -100,7 +100,7 @@ param_new_resolve(JSContext *context,
 
     ret = true;
  out:
-    g_free(name);
+    gjs_release_string_id(context, name);
     if (info != NULL)
         g_base_info_unref( (GIBaseInfo*)info);
 
@@ -145,6 +145,7 @@ param_finalize(JSFreeOp *fop,
 struct JSClass gjs_param_class = {
     "GObject_ParamSpec",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE |
     JSCLASS_BACKGROUND_FINALIZE,
     JS_PropertyStub,
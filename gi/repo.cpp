@@ -156,10 +156,10 @@ repo_new_resolve(JSContext *context,
                  JS::MutableHandleObject objp)
 {
     Repo *priv;
-    char *name;
+    const char *name;
     bool ret = true;
 
-    if (!gjs_get_string_id(context, id, &name))
+    if (!gjs_borrow_string_id(context, id, &name))
         return true; /* not resolved, but no error */
 
     /* let Object.prototype resolve these */
@@ -181,7 +181,7 @@ repo_new_resolve(JSContext *context,
     }
 
  out:
-    g_free(name);
+    gjs_release_string_id(context, name);
     return ret;
 }
 
@@ -210,6 +210,7 @@ repo_finalize(JSFreeOp *fop,
 struct JSClass gjs_repo_class = {
     "GIRepository", /* means "new GIRepository()" works */
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE,
     JS_PropertyStub,
     JS_DeletePropertyStub,
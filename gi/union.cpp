@@ -61,10 +61,10 @@ union_new_resolve(JSContext *context,
                   JS::MutableHandleObject objp)
 {
     Union *priv;
-    char *name;
+    const char *name;
     bool ret = true;
 
-    if (!gjs_get_string_id(context, id, &name))
+    if (!gjs_borrow_string_id(context, id, &name))
         return true; /* not resolved, but no error */
 
     priv = priv_from_js(context, obj);
@@ -123,7 +123,7 @@ union_new_resolve(JSContext *context,
     }
 
  out:
-    g_free(name);
+    gjs_release_string_id(context, name);
     return ret;
 }
 
@@ -288,6 +288,7 @@ to_string_func(JSContext *context,
 struct JSClass gjs_union_class = {
     "GObject_Union",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE,
     JS_PropertyStub,
     JS_DeletePropertyStub,
@@ -109,6 +109,151 @@ gjs_value_from_array_and_length_values(JSContext             *context,
                                          &array_arg, array_length.toInt32());
 }
 
+/* How each argument of a signal is converted to a JS value */
+typedef enum {
+    SIGNAL_ARG_GVALUE,   /* generic conversion of the GValue */
+    SIGNAL_ARG_SKIPPED,  /* length of an array argument, not passed to JS */
+    SIGNAL_ARG_ARRAY,    /* C array with its length in another argument */
+    SIGNAL_ARG_POINTER   /* pointer described by the introspection info */
+} SignalArgConverter;
+
+typedef struct {
+    /* Only loaded if the signal is introspectable; these are stored in
+     * place, so they must not move */
+    GIArgInfo arg_info;
+    GITypeInfo type_info;
+
+    SignalArgConverter converter;
+    bool no_copy;        /* G_SIGNAL_TYPE_STATIC_SCOPE */
+    int array_len_index; /* for SIGNAL_ARG_ARRAY */
+} SignalArgPlan;
+
+/* Everything closure_marshal() needs to know about a signal, worked out on
+ * its first emission. Plans are kept for the lifetime of the process, like
+ * the signals themselves. */
+typedef struct {
+    GSignalQuery query;
+    GISignalInfo *signal_info; /* NULL if not introspectable */
+    SignalArgPlan *args;       /* indexed like param_values, so args[0] is
+                                  the instance */
+} SignalMarshalPlan;
+
+static GPtrArray *signal_marshal_plans;
+
+static SignalMarshalPlan *
+signal_marshal_plan_new(guint signal_id)
+{
+    SignalMarshalPlan *plan;
+    guint i, n_args;
+
+    plan = g_slice_new0(SignalMarshalPlan);
+    g_signal_query(signal_id, &plan->query);
+    if (!plan->query.signal_id) {
+        g_slice_free(SignalMarshalPlan, plan);
+        return NULL;
+    }
+
+    n_args = plan->query.n_params + 1;
+    plan->args = g_new0(SignalArgPlan, n_args);
+    plan->signal_info = get_signal_info_if_available(&plan->query);
+
+    for (i = 0; i < n_args; i++) {
+        plan->args[i].converter = SIGNAL_ARG_GVALUE;
+        plan->args[i].array_len_index = -1;
+    }
+
+    /* Start at argument 1, skip the instance parameter */
+    for (i = 1; i < n_args; i++) {
+        SignalArgPlan *arg = &plan->args[i];
+        GType param_type = plan->query.param_types[i - 1];
+        int array_len_pos;
+
+        arg->no_copy = (param_type & G_SIGNAL_TYPE_STATIC_SCOPE) != 0;
+        param_type &= ~G_SIGNAL_TYPE_STATIC_SCOPE;
+
+        if (plan->signal_info == NULL)
+            continue;
+
+        g_callable_info_load_arg(plan->signal_info, i - 1, &arg->arg_info);
+        g_arg_info_load_type(&arg->arg_info, &arg->type_info);
+
+        array_len_pos = g_type_info_get_array_length(&arg->type_info);
+        if (array_len_pos != -1) {
+            arg->converter = SIGNAL_ARG_ARRAY;
+            arg->array_len_index = array_len_pos + 1;
+        } else if (g_type_is_a(param_type, G_TYPE_POINTER)) {
+            arg->converter = SIGNAL_ARG_POINTER;
+        }
+    }
+
+    /* Array lengths are only eliminated once all the arrays are known */
+    for (i = 1; i < n_args; i++) {
+        if (plan->args[i].converter == SIGNAL_ARG_ARRAY)
+            plan->args[plan->args[i].array_len_index].converter = SIGNAL_ARG_SKIPPED;
+    }
+
+    return plan;
+}
+
+static SignalMarshalPlan *
+get_signal_marshal_plan(guint signal_id)
+{
+    SignalMarshalPlan *plan = NULL;
+
+    if (G_UNLIKELY(signal_marshal_plans == NULL))
+        signal_marshal_plans = g_ptr_array_new();
+
+    if (signal_id < signal_marshal_plans->len)
+        plan = (SignalMarshalPlan *) g_ptr_array_index(signal_marshal_plans,
+                                                       signal_id);
+
+    if (G_UNLIKELY(plan == NULL)) {
+        plan = signal_marshal_plan_new(signal_id);
+        if (plan == NULL)
+            return NULL;
+
+        if (signal_id >= signal_marshal_plans->len)
+            g_ptr_array_set_size(signal_marshal_plans, signal_id + 1);
+        g_ptr_array_index(signal_marshal_plans, signal_id) = plan;
+    }
+
+    return plan;
+}
+
+static bool
+signal_arg_to_value(JSContext             *context,
+                    SignalMarshalPlan     *plan,
+                    unsigned               arg_n,
+                    const GValue          *param_values,
+                    JS::MutableHandleValue value_p)
+{
+    SignalArgPlan *arg = &plan->args[arg_n];
+    const GValue *gval = &param_values[arg_n];
+    GArgument pointer_arg;
+
+    switch (arg->converter) {
+    case SIGNAL_ARG_ARRAY:
+        return gjs_value_from_array_and_length_values(context, value_p,
+                                                      &arg->type_info, gval,
+                                                      &param_values[arg->array_len_index],
+                                                      arg->no_copy, &plan->query,
+                                                      arg->array_len_index);
+    case SIGNAL_ARG_POINTER:
+        pointer_arg.v_pointer = g_value_get_pointer(gval);
+        return gjs_value_from_g_argument(context, value_p, &arg->type_info,
+                                         &pointer_arg, true);
+    case SIGNAL_ARG_GVALUE:
+        return gjs_value_from_g_value_internal(context, value_p, gval,
+                                               arg->no_copy, &plan->query,
+                                               arg_n);
+    case SIGNAL_ARG_SKIPPED:
+    default:
+        g_assert_not_reached();
+    }
+
+    return false;
+}
+
 static void
 closure_marshal(GClosure        *closure,
                 GValue          *return_value,
@@ -122,10 +267,7 @@ closure_marshal(GClosure        *closure,
     JSObject *obj;
     unsigned i;
     GSignalQuery signal_query = { 0, };
-    GISignalInfo *signal_info;
-    bool *skip;
-    int *array_len_indices_for;
-    GITypeInfo **type_info_for;
+    SignalMarshalPlan *plan = NULL;
 
     gjs_debug_marshal(GJS_DEBUG_GCLOSURE,
                       "Marshal closure %p",
@@ -168,90 +310,40 @@ closure_marshal(GClosure        *closure,
 
     if (marshal_data) {
         /* we are used for a signal handler */
-        guint signal_id;
-
-        signal_id = GPOINTER_TO_UINT(marshal_data);
+        plan = get_signal_marshal_plan(GPOINTER_TO_UINT(marshal_data));
 
-        g_signal_query(signal_id, &signal_query);
-
-        if (!signal_query.signal_id) {
+        if (plan == NULL) {
             gjs_debug(GJS_DEBUG_GCLOSURE,
                       "Signal handler being called on invalid signal");
             return;
         }
 
-        if (signal_query.n_params + 1 != n_param_values) {
+        if (plan->query.n_params + 1 != n_param_values) {
             gjs_debug(GJS_DEBUG_GCLOSURE,
                       "Signal handler being called with wrong number of parameters");
             return;
         }
     }
 
-    /* Check if any parameters, such as array lengths, need to be eliminated
-     * before we invoke the closure.
-     */
-    skip = g_newa(bool, n_param_values);
-    memset(skip, 0, sizeof (bool) * n_param_values);
-    array_len_indices_for = g_newa(int, n_param_values);
-    for(i = 0; i < n_param_values; i++)
-        array_len_indices_for[i] = -1;
-    type_info_for = g_newa(GITypeInfo *, n_param_values);
-    memset(type_info_for, 0, sizeof (gpointer) * n_param_values);
-
-    signal_info = get_signal_info_if_available(&signal_query);
-    if (signal_info) {
-        /* Start at argument 1, skip the instance parameter */
-        for (i = 1; i < n_param_values; ++i) {
-            GIArgInfo *arg_info;
-            int array_len_pos;
-
-            arg_info = g_callable_info_get_arg(signal_info, i - 1);
-            type_info_for[i] = g_arg_info_get_type(arg_info);
-
-            array_len_pos = g_type_info_get_array_length(type_info_for[i]);
-            if (array_len_pos != -1) {
-                skip[array_len_pos + 1] = true;
-                array_len_indices_for[i] = array_len_pos + 1;
-            }
-
-            g_base_info_unref((GIBaseInfo *)arg_info);
-        }
-
-        g_base_info_unref((GIBaseInfo *)signal_info);
-    }
-
     JS::AutoValueVector argv(context);
     argv.reserve(n_param_values);  /* May end up being less */
     JS::RootedValue argv_to_append(context);
     for (i = 0; i < n_param_values; ++i) {
-        const GValue *gval = &param_values[i];
-        bool no_copy;
-        int array_len_index;
         bool res;
 
-        if (skip[i])
-            continue;
-
-        no_copy = false;
+        if (plan != NULL) {
+            /* Parameters such as array lengths are eliminated before we
+             * invoke the closure */
+            if (plan->args[i].converter == SIGNAL_ARG_SKIPPED)
+                continue;
 
-        if (i >= 1 && signal_query.signal_id) {
-            no_copy = (signal_query.param_types[i - 1] & G_SIGNAL_TYPE_STATIC_SCOPE) != 0;
-        }
-
-        array_len_index = array_len_indices_for[i];
-        if (array_len_index != -1) {
-            const GValue *array_len_gval = &param_values[array_len_index];
-            res = gjs_value_from_array_and_length_values(context,
-                                                         &argv_to_append,
-                                                         type_info_for[i],
-                                                         gval, array_len_gval,
-                                                         no_copy, &signal_query,
-                                                         array_len_index);
+            res = signal_arg_to_value(context, plan, i, param_values,
+                                      &argv_to_append);
         } else {
             res = gjs_value_from_g_value_internal(context,
                                                   &argv_to_append,
-                                                  gval, no_copy, &signal_query,
-                                                  i);
+                                                  &param_values[i], false,
+                                                  &signal_query, i);
         }
 
         if (!res) {
@@ -265,10 +357,6 @@ closure_marshal(GClosure        *closure,
         argv.append(argv_to_append);
     }
 
-    for (i = 1; i < n_param_values; i++)
-        if (type_info_for[i])
-            g_base_info_unref((GIBaseInfo *)type_info_for[i]);
-
     JS::RootedValue rval(context);
     gjs_closure_invoke(closure, argv, &rval);
 
@@ -22,20 +22,53 @@
  */
 
 #include <config.h>
+#include <stdlib.h>
 #include <string.h>
 #include <glib.h>
 #include "byteArray.h"
+#include "gc-scheduler.h"
 #include "gi/boxed.h"
+#include "text-codec.h"
 #include "jsapi-wrapper.h"
 #include "jsapi-util-args.h"
 #include <girepository.h>
 #include <util/log.h>
 
+/* Data taken out of an ArrayBuffer, so that it can be handed to C as
+ * GBytes without a copy. The ByteArray holds one reference while it reads
+ * from it, and every GBytes made from it holds another. Once the ByteArray
+ * holds the only reference, the data can go back into an ArrayBuffer and
+ * be written to without a copy. */
 typedef struct {
-    GByteArray *array;
-    GBytes     *bytes;
+    gint    refcount;
+    void   *contents;  /* from JS_StealArrayBufferContents() */
+    guint8 *data;
+    gsize   len;
+} SharedContents;
+
+/* The bytes are held in one of three ways, tried in this order:
+ *  - bytes: a GBytes made elsewhere, which is read-only;
+ *  - shared: data that was handed out as GBytes, and is read-only while
+ *    anyone else uses it;
+ *  - the ArrayBuffer in BYTE_ARRAY_SLOT_BUFFER, which is writable, and can
+ *    be viewed by a Uint8Array from asUint8Array(), whose element accesses
+ *    the JIT inlines.
+ * Writing moves the data into an ArrayBuffer, copying it only if it is
+ * still shared. */
+typedef struct {
+    GBytes         *bytes;
+    SharedContents *shared;
+    GBytes         *exported;    /* last handed out, until the next write */
+    gsize           len;         /* <= capacity of the ArrayBuffer */
+    bool            has_views;   /* views of the current ArrayBuffer exist */
+    gsize           native_size; /* as last reported to the GC scheduler */
 } ByteArrayInstance;
 
+enum {
+    BYTE_ARRAY_SLOT_BUFFER,
+    BYTE_ARRAY_SLOT_LAST
+};
+
 extern struct JSClass gjs_byte_array_class;
 GJS_DEFINE_PRIV_FROM_JS(ByteArrayInstance, gjs_byte_array_class)
 
@@ -56,6 +89,8 @@ static void   byte_array_finalize      (JSFreeOp     *fop,
 struct JSClass gjs_byte_array_class = {
     "ByteArray",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
+    JSCLASS_HAS_RESERVED_SLOTS(BYTE_ARRAY_SLOT_LAST) |
     JSCLASS_BACKGROUND_FINALIZE,
     JS_PropertyStub,
     JS_DeletePropertyStub,
@@ -84,26 +119,342 @@ gjs_value_from_gsize(gsize v)
     return JS::NumberValue(v);
 }
 
+/* Copies between the ways of holding the data, counted for
+ * gjs_byte_array_get_copy_stats() */
+static gsize n_copies;
+static gsize n_bytes_copied;
+static gsize n_copies_avoided;
+static gsize n_bytes_not_copied;
+
 static void
-byte_array_ensure_array (ByteArrayInstance  *priv)
+count_copy(gsize len)
 {
-    if (priv->bytes) {
-        priv->array = g_bytes_unref_to_array(priv->bytes);
-        priv->bytes = NULL;
-    } else {
-        g_assert(priv->array);
-    }
+    g_atomic_pointer_add(&n_copies, 1);
+    g_atomic_pointer_add(&n_bytes_copied, len);
+}
+
+static void
+count_copy_avoided(gsize len)
+{
+    g_atomic_pointer_add(&n_copies_avoided, 1);
+    g_atomic_pointer_add(&n_bytes_not_copied, len);
+}
+
+static SharedContents *
+shared_contents_new(void   *contents,
+                    guint8 *data,
+                    gsize   len)
+{
+    SharedContents *shared = g_slice_new(SharedContents);
+
+    shared->refcount = 1;
+    shared->contents = contents;
+    shared->data = data;
+    shared->len = len;
+    return shared;
+}
+
+static SharedContents *
+shared_contents_ref(SharedContents *shared)
+{
+    g_atomic_int_inc(&shared->refcount);
+    return shared;
 }
 
+/* GBytes may be released on any thread */
 static void
-byte_array_ensure_gbytes (ByteArrayInstance  *priv)
+shared_contents_unref(gpointer data)
+{
+    SharedContents *shared = (SharedContents *) data;
+
+    if (!g_atomic_int_dec_and_test(&shared->refcount))
+        return;
+
+    free(shared->contents);
+    g_slice_free(SharedContents, shared);
+}
+
+/* Takes the contents back from @shared, which the caller holds the only
+ * reference to */
+static void *
+shared_contents_steal(SharedContents *shared)
+{
+    void *contents = shared->contents;
+
+    g_assert(g_atomic_int_get(&shared->refcount) == 1);
+    g_slice_free(SharedContents, shared);
+    return contents;
+}
+
+static JSObject *
+byte_array_get_buffer(JSObject *obj)
+{
+    JS::Value v = JS_GetReservedSlot(obj, BYTE_ARRAY_SLOT_BUFFER);
+
+    return v.isObject() ? &v.toObject() : NULL;
+}
+
+static gsize
+byte_array_get_capacity(JSObject *obj)
+{
+    JSObject *buffer = byte_array_get_buffer(obj);
+
+    return buffer ? JS_GetArrayBufferByteLength(buffer) : 0;
+}
+
+/* Reports the change in size of the data held outside an ArrayBuffer
+ * since the last call to the GC scheduler; SpiderMonkey counts what is in
+ * the ArrayBuffer itself */
+static void
+byte_array_track_native_memory(ByteArrayInstance *priv)
+{
+    gsize size;
+
+    if (priv->bytes)
+        size = g_bytes_get_size(priv->bytes);
+    else if (priv->shared)
+        size = priv->shared->len;
+    else
+        size = 0;
+
+    gjs_gc_track_native_memory(GJS_GC_NATIVE_BYTE_ARRAY,
+                               (gssize) size - (gssize) priv->native_size);
+    priv->native_size = size;
+}
+
+/* The returned pointer is only valid until the ByteArray is resized or
+ * converted to a GBytes */
+static guint8 *
+byte_array_get_data(JSObject          *obj,
+                    ByteArrayInstance *priv)
+{
+    JSObject *buffer;
+
+    if (priv->bytes)
+        return (guint8 *) g_bytes_get_data(priv->bytes, NULL);
+    if (priv->shared)
+        return priv->shared->data;
+
+    buffer = byte_array_get_buffer(obj);
+    return buffer ? JS_GetArrayBufferData(buffer) : NULL;
+}
+
+static bool
+byte_array_set_buffer_contents(JSContext        *context,
+                               JS::HandleObject  obj,
+                               void             *contents)
+{
+    JSObject *buffer = JS_NewArrayBufferWithContents(context, contents);
+
+    if (buffer == NULL) {
+        free(contents);
+        return false;
+    }
+    JS_SetReservedSlot(obj, BYTE_ARRAY_SLOT_BUFFER, JS::ObjectValue(*buffer));
+    return true;
+}
+
+/* Moves read-only data into new contents of @capacity bytes */
+static bool
+byte_array_unshare(JSContext         *context,
+                   ByteArrayInstance *priv,
+                   gsize              capacity,
+                   void             **contents_p)
+{
+    const guint8 *old_data = NULL;
+    guint8 *data;
+
+    if (priv->shared && g_atomic_int_get(&priv->shared->refcount) == 1) {
+        /* nobody else uses the data any more */
+        *contents_p = shared_contents_steal(priv->shared);
+        priv->shared = NULL;
+        count_copy_avoided(priv->len);
+
+        if (capacity > priv->len &&
+            !JS_ReallocateArrayBufferContents(context, capacity, contents_p,
+                                              &data)) {
+            free(*contents_p);
+            priv->len = 0;
+            return false;
+        }
+        return true;
+    }
+
+    if (!JS_AllocateArrayBufferContents(context, capacity, contents_p, &data))
+        return false;
+
+    if (priv->bytes)
+        old_data = (const guint8 *) g_bytes_get_data(priv->bytes, NULL);
+    else if (priv->shared)
+        old_data = priv->shared->data;
+
+    if (priv->len > 0) {
+        memcpy(data, old_data, MIN(priv->len, capacity));
+        count_copy(MIN(priv->len, capacity));
+    }
+
+    g_clear_pointer(&priv->bytes, g_bytes_unref);
+    g_clear_pointer(&priv->shared, shared_contents_unref);
+    return true;
+}
+
+/* Makes sure that the data is in an ArrayBuffer of at least @capacity bytes
+ * that may be written to. Growing takes the contents away from the old
+ * ArrayBuffer, which detaches views of it. */
+static bool
+byte_array_reserve(JSContext         *context,
+                   JS::HandleObject   obj,
+                   ByteArrayInstance *priv,
+                   gsize              capacity)
 {
-    if (priv->array) {
-        priv->bytes = g_byte_array_free_to_bytes(priv->array);
-        priv->array = NULL;
+    gsize old_capacity;
+    void *contents;
+    guint8 *data;
+
+    /* a GBytes is immutable, so the next one has to be made anew; this
+     * also lets go of our reference to shared contents */
+    g_clear_pointer(&priv->exported, g_bytes_unref);
+
+    if (priv->bytes == NULL && priv->shared == NULL &&
+        byte_array_get_buffer(obj) != NULL &&
+        capacity <= byte_array_get_capacity(obj))
+        return true;
+
+    if (capacity > G_MAXUINT32) {
+        gjs_throw(context, "ByteArray length %" G_GSIZE_FORMAT " is too large",
+                  capacity);
+        return false;
+    }
+
+    if (priv->bytes || priv->shared) {
+        if (!byte_array_unshare(context, priv, capacity, &contents)) {
+            byte_array_track_native_memory(priv);
+            return false;
+        }
+    } else if (byte_array_get_buffer(obj) == NULL) {
+        if (!JS_AllocateArrayBufferContents(context, capacity, &contents, &data))
+            return false;
     } else {
-        g_assert(priv->bytes);
+        JS::RootedObject buffer(context, byte_array_get_buffer(obj));
+
+        /* grow geometrically, so that appending byte by byte is linear */
+        old_capacity = JS_GetArrayBufferByteLength(buffer);
+        capacity = MAX(capacity, MIN(old_capacity * 2, (gsize) G_MAXUINT32));
+
+        if (!JS_StealArrayBufferContents(context, buffer, &contents, &data))
+            return false;
+        JS_SetReservedSlot(obj, BYTE_ARRAY_SLOT_BUFFER, JS::UndefinedValue());
+        priv->has_views = false;
+
+        /* new bytes are cleared */
+        if (!JS_ReallocateArrayBufferContents(context, capacity, &contents,
+                                              &data)) {
+            free(contents);
+            priv->len = 0;
+            byte_array_track_native_memory(priv);
+            return false;
+        }
     }
+
+    bool ok = byte_array_set_buffer_contents(context, obj, contents);
+    byte_array_track_native_memory(priv);
+    return ok;
+}
+
+static bool
+byte_array_set_length(JSContext         *context,
+                      JS::HandleObject   obj,
+                      ByteArrayInstance *priv,
+                      gsize              len)
+{
+    if (len == priv->len)
+        return true;
+
+    if (!byte_array_reserve(context, obj, priv, len))
+        return false;
+
+    /* shrinking earlier may have left bytes behind */
+    if (len > priv->len)
+        memset(byte_array_get_data(obj, priv) + priv->len, 0, len - priv->len);
+
+    priv->len = len;
+    return true;
+}
+
+static bool
+byte_array_set_data(JSContext         *context,
+                    JS::HandleObject   obj,
+                    ByteArrayInstance *priv,
+                    const guint8      *data,
+                    gsize              len)
+{
+    if (!byte_array_reserve(context, obj, priv, len))
+        return false;
+
+    if (len > 0)
+        memcpy(byte_array_get_data(obj, priv), data, len);
+    priv->len = len;
+    return true;
+}
+
+/* Returns a GBytes holding the data, which stays valid until the
+ * ByteArray is next written to or converted. Unless views of the
+ * ArrayBuffer exist, its contents are shared without a copy, and the
+ * ByteArray reads from them until it is written to again. */
+static GBytes *
+byte_array_peek_gbytes(JSContext         *context,
+                       JS::HandleObject   obj,
+                       ByteArrayInstance *priv)
+{
+    void *contents;
+    guint8 *data;
+
+    if (priv->bytes) {
+        count_copy_avoided(priv->len);
+        return priv->bytes;
+    }
+
+    if (priv->exported && !priv->has_views) {
+        count_copy_avoided(priv->len);
+        return priv->exported;
+    }
+    g_clear_pointer(&priv->exported, g_bytes_unref);
+
+    JS::RootedObject buffer(context, byte_array_get_buffer(obj));
+    if (priv->shared == NULL && (buffer == NULL || priv->len == 0)) {
+        priv->exported = g_bytes_new(NULL, 0);
+        return priv->exported;
+    }
+
+    if (priv->shared == NULL) {
+        if (priv->has_views ||
+            !JS_StealArrayBufferContents(context, buffer, &contents, &data)) {
+            /* views see later changes, which a GBytes must not */
+            JS_ClearPendingException(context);
+            count_copy(priv->len);
+            priv->exported = g_bytes_new(JS_GetArrayBufferData(buffer),
+                                         priv->len);
+            return priv->exported;
+        }
+
+        JS_SetReservedSlot(obj, BYTE_ARRAY_SLOT_BUFFER, JS::UndefinedValue());
+        priv->shared = shared_contents_new(contents, data, priv->len);
+        byte_array_track_native_memory(priv);
+    }
+
+    count_copy_avoided(priv->len);
+    priv->exported = g_bytes_new_with_free_func(priv->shared->data, priv->len,
+                                                shared_contents_unref,
+                                                shared_contents_ref(priv->shared));
+    return priv->exported;
+}
+
+static void
+throw_negative_index(JSContext *context,
+                     int        i)
+{
+    gjs_throw(context, "Negative length or index %d is not allowed for ByteArray",
+              i);
 }
 
 static bool
@@ -119,8 +470,7 @@ gjs_value_to_gsize(JSContext         *context,
     if (value.isInt32()) {
         int i = value.toInt32();
         if (i < 0) {
-            gjs_throw(context, "Negative length or index %d is not allowed for ByteArray",
-                      i);
+            throw_negative_index(context, i);
             return false;
         }
         *v_p = i;
@@ -158,6 +508,38 @@ gjs_value_to_byte(JSContext         *context,
     return true;
 }
 
+/* Only non-negative integers are int ids; a negative index arrives as a
+ * string id like "-1" */
+static bool
+id_is_negative_index(JSContext   *context,
+                     JS::HandleId id,
+                     int         *index_p)
+{
+    const char16_t *chars;
+    size_t len, i;
+    gint64 v = 0;
+
+    if (!JSID_IS_STRING(id))
+        return false;
+
+    chars = JS_GetStringCharsAndLength(context, JSID_TO_STRING(id), &len);
+    if (chars == NULL || len < 2 || len > 11 ||
+        chars[0] != '-' || chars[1] == '0')
+        return false;
+
+    for (i = 1; i < len; i++) {
+        if (chars[i] < '0' || chars[i] > '9')
+            return false;
+        v = v * 10 + (chars[i] - '0');
+    }
+
+    if (v > -(gint64) G_MININT32)
+        return false;
+
+    *index_p = (int) -v;
+    return true;
+}
+
 static bool
 byte_array_get_index(JSContext         *context,
                      JS::HandleObject obj,
@@ -165,20 +547,15 @@ byte_array_get_index(JSContext         *context,
                      gsize              idx,
                      JS::MutableHandleValue value_p)
 {
-    gsize len;
-    guint8 *data;
-    
-    gjs_byte_array_peek_data(context, obj, &data, &len);
-
-    if (idx >= len) {
+    if (idx >= priv->len) {
         gjs_throw(context,
                   "Index %" G_GSIZE_FORMAT " is out of range for ByteArray length %lu",
                   idx,
-                  (unsigned long)len);
+                  (unsigned long)priv->len);
         return false;
     }
 
-    value_p.setInt32(data[idx]);
+    value_p.setInt32(byte_array_get_data(obj, priv)[idx]);
 
     return true;
 }
@@ -193,22 +570,20 @@ byte_array_get_prop(JSContext *context,
                     JS::MutableHandleValue value_p)
 {
     ByteArrayInstance *priv;
+    int negative;
 
     priv = priv_from_js(context, obj);
 
     if (priv == NULL)
         return true; /* prototype, not an instance. */
 
-    JS::RootedValue id_value(context);
-    if (!JS_IdToValue(context, id, &id_value))
-        return false;
-
     /* First handle array indexing */
-    if (id_value.isNumber()) {
-        gsize idx;
-        if (!gjs_value_to_gsize(context, id_value, &idx))
-            return false;
-        return byte_array_get_index(context, obj, priv, idx, value_p);
+    if (JSID_IS_INT(id))
+        return byte_array_get_index(context, obj, priv, JSID_TO_INT(id),
+                                    value_p);
+    if (id_is_negative_index(context, id, &negative)) {
+        throw_negative_index(context, negative);
+        return false;
     }
 
     /* We don't special-case anything else for now. Regular JS arrays
@@ -224,16 +599,11 @@ byte_array_length_getter(JSContext *context,
                          JS::Value *vp)
 {
     GJS_GET_PRIV(context, argc, vp, args, to, ByteArrayInstance, priv);
-    gsize len = 0;
 
     if (priv == NULL)
         return true; /* prototype, not an instance. */
 
-    if (priv->array != NULL)
-        len = priv->array->len;
-    else if (priv->bytes != NULL)
-        len = g_bytes_get_size (priv->bytes);
-    args.rval().set(gjs_value_from_gsize(len));
+    args.rval().set(gjs_value_from_gsize(priv->len));
     return true;
 }
 
@@ -248,14 +618,13 @@ byte_array_length_setter(JSContext *context,
     if (priv == NULL)
         return true; /* prototype, not instance */
 
-    byte_array_ensure_array(priv);
-
     if (!gjs_value_to_gsize(context, args[0], &len)) {
         gjs_throw(context,
                   "Can't set ByteArray length to non-integer");
         return false;
     }
-    g_byte_array_set_size(priv->array, len);
+    if (!byte_array_set_length(context, to, priv, len))
+        return false;
     args.rval().setUndefined();
     return true;
 }
@@ -273,15 +642,15 @@ byte_array_set_index(JSContext         *context,
         return false;
     }
 
-    byte_array_ensure_array(priv);
-
     /* grow the array if necessary */
-    if (idx >= priv->array->len) {
-        g_byte_array_set_size(priv->array,
-                              idx + 1);
+    if (idx >= priv->len) {
+        if (!byte_array_set_length(context, obj, priv, idx + 1))
+            return false;
+    } else if (!byte_array_reserve(context, obj, priv, priv->len)) {
+        return false;
     }
 
-    g_array_index(priv->array, guint8, idx) = v;
+    byte_array_get_data(obj, priv)[idx] = v;
 
     /* Stop JS from storing a copy of the value */
     value_p.setUndefined();
@@ -300,23 +669,20 @@ byte_array_set_prop(JSContext *context,
                     JS::MutableHandleValue value_p)
 {
     ByteArrayInstance *priv;
+    int negative;
 
     priv = priv_from_js(context, obj);
 
     if (priv == NULL)
         return true; /* prototype, not an instance. */
 
-    JS::RootedValue id_value(context);
-    if (!JS_IdToValue(context, id, &id_value))
-        return false;
-
     /* First handle array indexing */
-    if (id_value.isNumber()) {
-        gsize idx;
-        if (!gjs_value_to_gsize(context, id_value, &idx))
-            return false;
-
-        return byte_array_set_index(context, obj, priv, idx, value_p);
+    if (JSID_IS_INT(id))
+        return byte_array_set_index(context, obj, priv, JSID_TO_INT(id),
+                                    value_p);
+    if (id_is_negative_index(context, id, &negative)) {
+        throw_negative_index(context, negative);
+        return false;
     }
 
     /* We don't special-case anything else for now */
@@ -324,29 +690,6 @@ byte_array_set_prop(JSContext *context,
     return true;
 }
 
-static GByteArray *
-gjs_g_byte_array_new(int preallocated_length)
-{
-    GByteArray *array;
-
-    /* can't use g_byte_array_new() because we need to clear to zero.
-     * We nul-terminate too for ease of toString() and for security
-     * paranoia.
-     */
-    array =  (GByteArray*) g_array_sized_new (true, /* nul-terminated */
-                                              true, /* clear to zero */
-                                              1, /* element size */
-                                              preallocated_length);
-   if (preallocated_length > 0) {
-       /* we want to not only allocate the size, but have it
-        * already be the array's length.
-        */
-       g_byte_array_set_size(array, preallocated_length);
-   }
-
-   return array;
-}
-
 GJS_NATIVE_CONSTRUCTOR_DECLARE(byte_array)
 {
     GJS_NATIVE_CONSTRUCTOR_VARIABLES(byte_array)
@@ -365,10 +708,12 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(byte_array)
     }
 
     priv = g_slice_new0(ByteArrayInstance);
-    priv->array = gjs_g_byte_array_new(preallocated_length);
     g_assert(priv_from_js(context, object) == NULL);
     JS_SetPrivate(object, priv);
 
+    if (!byte_array_set_length(context, object, priv, preallocated_length))
+        return false;
+
     GJS_NATIVE_CONSTRUCTOR_FINISH(byte_array);
 
     return true;
@@ -385,12 +730,12 @@ byte_array_finalize(JSFreeOp *fop,
     if (priv == NULL)
         return; /* prototype, not instance */
 
-    if (priv->array) {
-        g_byte_array_free(priv->array, true);
-        priv->array = NULL;
-    } else if (priv->bytes) {
-        g_clear_pointer(&priv->bytes, g_bytes_unref);
-    }
+    gjs_gc_track_native_memory(GJS_GC_NATIVE_BYTE_ARRAY, -(gssize) priv->native_size);
+
+    /* the ArrayBuffer is collected on its own */
+    g_clear_pointer(&priv->exported, g_bytes_unref);
+    g_clear_pointer(&priv->bytes, g_bytes_unref);
+    g_clear_pointer(&priv->shared, shared_contents_unref);
 
     g_slice_free(ByteArrayInstance, priv);
 }
@@ -403,85 +748,24 @@ to_string_func(JSContext *context,
 {
     GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
     char *encoding;
-    bool encoding_is_utf8;
-    gchar *data;
+    bool ok;
 
     if (priv == NULL)
         return true; /* prototype, not instance */
 
-    byte_array_ensure_array(priv);
-
     if (argc >= 1 && argv[0].isString()) {
         if (!gjs_string_to_utf8(context, argv[0], &encoding))
             return false;
-
-        /* maybe we should be smarter about utf8 synonyms here.
-         * doesn't matter much though. encoding_is_utf8 is
-         * just an optimization anyway.
-         */
-        if (strcmp(encoding, "UTF-8") == 0) {
-            encoding_is_utf8 = true;
-            g_free(encoding);
-            encoding = NULL;
-        } else {
-            encoding_is_utf8 = false;
-        }
     } else {
-        encoding_is_utf8 = true;
+        encoding = g_strdup("UTF-8");
     }
 
-    if (priv->array->len == 0)
-        /* the internal data pointer could be NULL in this case */
-        data = (gchar*)"";
-    else
-        data = (gchar*)priv->array->data;
-
-    if (encoding_is_utf8) {
-        /* optimization, avoids iconv overhead and runs
-         * libmozjs hardwired utf8-to-utf16
-         */
-        return gjs_string_from_utf8(context, data, priv->array->len,
-                                    argv.rval());
-    } else {
-        bool ok = false;
-        gsize bytes_written;
-        GError *error;
-        JSString *s;
-        char *u16_str;
-        char16_t *u16_out;
-
-        error = NULL;
-        u16_str = g_convert(data,
-                           priv->array->len,
-                           "UTF-16",
-                           encoding,
-                           NULL, /* bytes read */
-                           &bytes_written,
-                           &error);
-        g_free(encoding);
-        if (u16_str == NULL) {
-            /* frees the GError */
-            gjs_throw_g_error(context, error);
-            return false;
-        }
-
-        /* bytes_written should be bytes in a UTF-16 string so
-         * should be a multiple of 2
-         */
-        g_assert((bytes_written % 2) == 0);
-
-        u16_out = g_new(char16_t, bytes_written / 2);
-        memcpy(u16_out, u16_str, bytes_written);
-        s = JS_NewUCStringCopyN(context, u16_out, bytes_written / 2);
-        if (s != NULL) {
-            ok = true;
-            argv.rval().setString(s);
-        }
-
-        g_free(u16_str);
-        g_free(u16_out);
-        return ok;
-    }
+    /* UTF-8 and Latin-1 are decoded straight from our data, keeping any
+     * embedded nuls */
+    ok = gjs_text_decode(context, encoding, byte_array_get_data(to, priv),
+                         priv->len, argv.rval());
+    g_free(encoding);
+    return ok;
 }
 
 static bool
@@ -492,20 +776,53 @@ to_gbytes_func(JSContext *context,
     GJS_GET_PRIV(context, argc, vp, rec, to, ByteArrayInstance, priv);
     JSObject *ret_bytes_obj;
     GIBaseInfo *gbytes_info;
+    GBytes *bytes;
 
     if (priv == NULL)
         return true; /* prototype, not instance */
 
-    byte_array_ensure_gbytes(priv);
+    bytes = byte_array_peek_gbytes(context, to, priv);
 
     gbytes_info = g_irepository_find_by_gtype(NULL, G_TYPE_BYTES);
     ret_bytes_obj = gjs_boxed_from_c_struct(context, (GIStructInfo*)gbytes_info,
-                                            priv->bytes, GJS_BOXED_CREATION_NONE);
+                                            bytes, GJS_BOXED_CREATION_NONE);
 
     rec.rval().setObjectOrNull(ret_bytes_obj);
     return true;
 }
 
+/* asUint8Array() returns a Uint8Array that shares memory with the
+ * ByteArray until the ByteArray grows beyond what it has allocated, which
+ * detaches the view. */
+static bool
+as_uint8_array_func(JSContext *context,
+                    unsigned   argc,
+                    JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, rec, to, ByteArrayInstance, priv);
+
+    if (priv == NULL)
+        return true; /* prototype, not instance */
+
+    if (priv->len > G_MAXINT32) {
+        gjs_throw(context, "ByteArray length %" G_GSIZE_FORMAT " is too large "
+                  "for a Uint8Array", priv->len);
+        return false;
+    }
+
+    if (!byte_array_reserve(context, to, priv, priv->len))
+        return false;
+
+    JS::RootedObject buffer(context, byte_array_get_buffer(to));
+    JSObject *view = JS_NewUint8ArrayWithBuffer(context, buffer, 0, priv->len);
+    if (view == NULL)
+        return false;
+
+    priv->has_views = true;
+    rec.rval().setObject(*view);
+    return true;
+}
+
 /* Ensure that the module and class objects exists, and that in turn
  * ensures that JS_InitClass has been called. */
 static JSObject *
@@ -533,6 +850,9 @@ byte_array_new(JSContext *context)
     JS::RootedObject array(context,
         JS_NewObject(context, &gjs_byte_array_class, proto, JS::NullPtr()));
 
+    if (array == NULL)
+        return NULL;
+
     priv = g_slice_new0(ByteArrayInstance);
 
     g_assert(priv_from_js(context, array) == NULL);
@@ -550,7 +870,7 @@ from_string_func(JSContext *context,
     JS::CallArgs argv = JS::CallArgsFromVp (argc, vp);
     ByteArrayInstance *priv;
     char *encoding;
-    bool encoding_is_utf8;
+    bool ok;
     JS::RootedObject obj(context, byte_array_new(context));
 
     if (obj == NULL)
@@ -561,8 +881,6 @@ from_string_func(JSContext *context,
 
     g_assert(argc > 0); /* because we specified min args 1 */
 
-    priv->array = gjs_g_byte_array_new(0);
-
     if (!argv[0].isString()) {
         gjs_throw(context,
                   "byteArray.fromString() called with non-string as first arg");
@@ -572,66 +890,17 @@ from_string_func(JSContext *context,
     if (argc > 1 && argv[1].isString()) {
         if (!gjs_string_to_utf8(context, argv[1], &encoding))
             return false;
-
-        /* maybe we should be smarter about utf8 synonyms here.
-         * doesn't matter much though. encoding_is_utf8 is
-         * just an optimization anyway.
-         */
-        if (strcmp(encoding, "UTF-8") == 0) {
-            encoding_is_utf8 = true;
-            g_free(encoding);
-            encoding = NULL;
-        } else {
-            encoding_is_utf8 = false;
-        }
     } else {
-        encoding_is_utf8 = true;
+        encoding = g_strdup("UTF-8");
     }
 
-    if (encoding_is_utf8) {
-        /* optimization? avoids iconv overhead and runs
-         * libmozjs hardwired utf16-to-utf8.
-         */
-        char *utf8 = NULL;
-        if (!gjs_string_to_utf8(context,
-                                argv[0],
-                                &utf8))
-            return false;
-
-        g_byte_array_set_size(priv->array, 0);
-        g_byte_array_append(priv->array, (guint8*) utf8, strlen(utf8));
-        g_free(utf8);
-    } else {
-        char *encoded;
-        gsize bytes_written;
-        GError *error;
-        const char16_t *u16_chars;
-        gsize u16_len;
-
-        u16_chars = JS_GetStringCharsAndLength(context, argv[0].toString(), &u16_len);
-        if (u16_chars == NULL)
-            return false;
-
-        error = NULL;
-        encoded = g_convert((char*) u16_chars,
-                            u16_len * 2,
-                            encoding, /* to_encoding */
-                            "UTF-16", /* from_encoding */
-                            NULL, /* bytes read */
-                            &bytes_written,
-                            &error);
-        g_free(encoding);
-        if (encoded == NULL) {
-            /* frees the GError */
-            gjs_throw_g_error(context, error);
-            return false;
-        }
-
-        g_byte_array_set_size(priv->array, 0);
-        g_byte_array_append(priv->array, (guint8*) encoded, bytes_written);
-
-        g_free(encoded);
-    }
+    /* written straight into the ByteArray, without an intermediate copy
+     * for UTF-8 and Latin-1 */
+    JS::RootedString str(context, argv[0].toString());
+    ok = gjs_text_encode(context, encoding, str, obj);
+    g_free(encoding);
+    if (!ok)
+        return false;
 
     argv.rval().setObject(*obj);
     return true;
@@ -657,8 +926,6 @@ from_array_func(JSContext *context,
 
     g_assert(argc > 0); /* because we specified min args 1 */
 
-    priv->array = gjs_g_byte_array_new(0);
-
     JS::RootedObject array_obj(context, &argv[0].toObject());
     if (!JS_IsArrayObject(context, array_obj)) {
         gjs_throw(context,
@@ -672,7 +939,8 @@ from_array_func(JSContext *context,
         return false;
     }
 
-    g_byte_array_set_size(priv->array, len);
+    if (!byte_array_set_length(context, obj, priv, len))
+        return false;
 
     JS::RootedValue elem(context);
     for (i = 0; i < len; ++i) {
@@ -692,7 +960,7 @@ from_array_func(JSContext *context,
         if (!gjs_value_to_byte(context, elem, &b))
             return false;
 
-        g_array_index(priv->array, guint8, i) = b;
+        byte_array_get_data(obj, priv)[i] = b;
     }
 
     argv.rval().setObject(*obj);
@@ -724,7 +992,11 @@ from_gbytes_func(JSContext *context,
     priv = priv_from_js(context, obj);
     g_assert (priv != NULL);
 
+    /* copied on the first write */
+    count_copy_avoided(g_bytes_get_size(gbytes));
     priv->bytes = g_bytes_ref(gbytes);
+    priv->len = g_bytes_get_size(gbytes);
+    byte_array_track_native_memory(priv);
 
     argv.rval().setObject(*obj);
     return true;
@@ -739,21 +1011,16 @@ gjs_byte_array_from_byte_array (JSContext *context,
     g_return_val_if_fail(context != NULL, NULL);
     g_return_val_if_fail(array != NULL, NULL);
 
-    JS::RootedObject proto(context, byte_array_get_prototype(context));
-    JS::RootedObject object(context,
-        JS_NewObject(context, &gjs_byte_array_class, proto, JS::NullPtr()));
-
+    JS::RootedObject object(context, byte_array_new(context));
     if (!object) {
         gjs_throw(context, "failed to create byte array");
         return NULL;
     }
 
-    priv = g_slice_new0(ByteArrayInstance);
-    g_assert(priv_from_js(context, object) == NULL);
-    JS_SetPrivate(object, priv);
-    priv->array = g_byte_array_new();
-    priv->array->data = (guint8*) g_memdup(array->data, array->len);
-    priv->array->len = array->len;
+    priv = priv_from_js(context, object);
+    if (!byte_array_set_data(context, object, priv, array->data, array->len))
+        return NULL;
+    count_copy(array->len);
 
     return object;
 }
@@ -766,22 +1033,90 @@ gjs_byte_array_get_bytes (JSContext       *context,
     priv = priv_from_js(context, object);
     g_assert(priv != NULL);
 
-    byte_array_ensure_gbytes(priv);
+    return g_bytes_ref(byte_array_peek_gbytes(context, object, priv));
+}
 
-    return g_bytes_ref (priv->bytes);
+/**
+ * gjs_byte_array_peek_bytes:
+ * @context: the #JSContext
+ * @object: a ByteArray
+ *
+ * Like gjs_byte_array_get_bytes(), but the ByteArray keeps the reference,
+ * so the result only stays valid until the ByteArray is next written to or
+ * converted. Suitable for passing to a function that does not take
+ * ownership.
+ */
+GBytes *
+gjs_byte_array_peek_bytes(JSContext       *context,
+                          JS::HandleObject object)
+{
+    ByteArrayInstance *priv;
+    priv = priv_from_js(context, object);
+    g_assert(priv != NULL);
+
+    return byte_array_peek_gbytes(context, object, priv);
 }
 
+/**
+ * gjs_byte_array_get_byte_array:
+ * @context: the #JSContext
+ * @obj: a ByteArray
+ *
+ * Returns a new #GByteArray with a copy of the data of @obj. The data of a
+ * ByteArray lives in an ArrayBuffer, which a #GByteArray cannot wrap; use
+ * gjs_byte_array_update_from_byte_array() to bring changes that C code
+ * made to the copy back into @obj.
+ */
 GByteArray *
 gjs_byte_array_get_byte_array (JSContext       *context,
                                JS::HandleObject obj)
 {
     ByteArrayInstance *priv;
+    GByteArray *array;
+
     priv = priv_from_js(context, obj);
     g_assert(priv != NULL);
 
-    byte_array_ensure_array(priv);
+    array = g_byte_array_sized_new(priv->len);
+    if (priv->len > 0) {
+        g_byte_array_append(array, byte_array_get_data(obj, priv), priv->len);
+        count_copy(priv->len);
+    }
 
-    return g_byte_array_ref (priv->array);
+    return array;
+}
+
+/**
+ * gjs_byte_array_update_from_byte_array:
+ * @context: the #JSContext
+ * @obj: a ByteArray
+ * @array: the result of gjs_byte_array_get_byte_array() on @obj
+ *
+ * Copies the data of @array into @obj, if C code changed it.
+ *
+ * Returns: %false with an exception pending if @obj could not be resized
+ */
+bool
+gjs_byte_array_update_from_byte_array(JSContext       *context,
+                                      JS::HandleObject obj,
+                                      GByteArray      *array)
+{
+    ByteArrayInstance *priv;
+
+    priv = priv_from_js(context, obj);
+    g_assert(priv != NULL);
+
+    /* Comparing is cheaper than writing, which would also take the data
+     * back from a GBytes handed out earlier */
+    if (array->len == priv->len &&
+        (priv->len == 0 ||
+         memcmp(array->data, byte_array_get_data(obj, priv), priv->len) == 0))
+        return true;
+
+    if (!byte_array_set_data(context, obj, priv, array->data, array->len))
+        return false;
+    count_copy(array->len);
+    return true;
 }
 
 void
@@ -793,15 +1128,72 @@ gjs_byte_array_peek_data (JSContext       *context,
     ByteArrayInstance *priv;
     priv = priv_from_js(context, obj);
     g_assert(priv != NULL);
-    
-    if (priv->array != NULL) {
-        *out_data = (guint8*)priv->array->data;
-        *out_len = (gsize)priv->array->len;
-    } else if (priv->bytes != NULL) {
-        *out_data = (guint8*)g_bytes_get_data(priv->bytes, out_len);
-    } else {
-        g_assert_not_reached();
-    }
+
+    *out_data = byte_array_get_data(obj, priv);
+    *out_len = priv->len;
+}
+
+JSObject *
+gjs_byte_array_new(JSContext *context)
+{
+    return byte_array_new(context);
+}
+
+/**
+ * gjs_byte_array_begin_write:
+ * @context: the #JSContext
+ * @object: a ByteArray
+ * @capacity: number of bytes that will be written
+ *
+ * Makes room for writing @capacity bytes into @object directly, keeping
+ * its current contents. The returned pointer is valid until the ByteArray
+ * is next used from JS; call gjs_byte_array_end_write() to set the length
+ * of what was written.
+ *
+ * Returns: the data of @object, or %NULL with an exception pending
+ */
+guint8 *
+gjs_byte_array_begin_write(JSContext       *context,
+                           JS::HandleObject object,
+                           gsize            capacity)
+{
+    ByteArrayInstance *priv;
+    priv = priv_from_js(context, object);
+    g_assert(priv != NULL);
+
+    if (!byte_array_reserve(context, object, priv, MAX(capacity, 1)))
+        return NULL;
+
+    return byte_array_get_data(object, priv);
+}
+
+void
+gjs_byte_array_end_write(JSContext       *context,
+                         JS::HandleObject object,
+                         gsize            len)
+{
+    ByteArrayInstance *priv;
+    priv = priv_from_js(context, object);
+    g_assert(priv != NULL);
+
+    g_assert(len <= byte_array_get_capacity(object));
+    priv->len = len;
+}
+
+/**
+ * gjs_byte_array_get_copy_stats:
+ * @stats: (out): return location for the counters
+ *
+ * Reports how often data changed hands between ByteArrays, GBytes and
+ * GByteArrays with and without a copy, in this process so far.
+ */
+void
+gjs_byte_array_get_copy_stats(GjsByteArrayCopyStats *stats)
+{
+    stats->copies = (gsize) g_atomic_pointer_get(&n_copies);
+    stats->bytes_copied = (gsize) g_atomic_pointer_get(&n_bytes_copied);
+    stats->copies_avoided = (gsize) g_atomic_pointer_get(&n_copies_avoided);
+    stats->bytes_not_copied = (gsize) g_atomic_pointer_get(&n_bytes_not_copied);
 }
 
 JSPropertySpec gjs_byte_array_proto_props[] = {
@@ -813,6 +1205,7 @@ JSPropertySpec gjs_byte_array_proto_props[] = {
 JSFunctionSpec gjs_byte_array_proto_funcs[] = {
     JS_FS("toString", to_string_func, 0, 0),
     JS_FS("toGBytes", to_gbytes_func, 0, 0),
+    JS_FS("asUint8Array", as_uint8_array_func, 0, 0),
     JS_FS_END
 };
 
@@ -843,6 +1236,9 @@ gjs_define_byte_array_stuff(JSContext              *context,
     if (!JS_DefineFunctions(context, module, &gjs_byte_array_module_funcs[0]))
         return false;
 
+    if (!gjs_define_text_codec_stuff(context, module))
+        return false;
+
     g_assert(gjs_get_global_slot(context, GJS_GLOBAL_SLOT_BYTE_ARRAY_PROTOTYPE).isUndefined());
     gjs_set_global_slot(context, GJS_GLOBAL_SLOT_BYTE_ARRAY_PROTOTYPE,
                         JS::ObjectOrNullValue(prototype));
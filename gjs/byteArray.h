@@ -42,15 +42,38 @@ JSObject *    gjs_byte_array_from_byte_array (JSContext  *context,
 
 GByteArray *gjs_byte_array_get_byte_array(JSContext       *context,
                                           JS::HandleObject object);
+bool        gjs_byte_array_update_from_byte_array(JSContext       *context,
+                                                  JS::HandleObject object,
+                                                  GByteArray      *array);
 
 GBytes     *gjs_byte_array_get_bytes(JSContext       *context,
                                      JS::HandleObject object);
+GBytes     *gjs_byte_array_peek_bytes(JSContext       *context,
+                                      JS::HandleObject object);
 
 void        gjs_byte_array_peek_data(JSContext       *context,
                                      JS::HandleObject object,
                                      guint8         **out_data,
                                      gsize           *out_len);
 
+JSObject   *gjs_byte_array_new(JSContext *context);
+
+guint8     *gjs_byte_array_begin_write(JSContext       *context,
+                                       JS::HandleObject object,
+                                       gsize            capacity);
+void        gjs_byte_array_end_write  (JSContext       *context,
+                                       JS::HandleObject object,
+                                       gsize            len);
+
+typedef struct {
+    guint64 copies;
+    guint64 bytes_copied;
+    guint64 copies_avoided;
+    guint64 bytes_not_copied;
+} GjsByteArrayCopyStats;
+
+void        gjs_byte_array_get_copy_stats(GjsByteArrayCopyStats *stats);
+
 G_END_DECLS
 
 #endif  /* __GJS_BYTE_ARRAY_H__ */
@@ -0,0 +1,399 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* On-disk cache of compiled modules.
+ *
+ * Each module file gets a cache file, named after a checksum of its path,
+ * holding a header followed by the script as encoded by SpiderMonkey's XDR.
+ * The header records the size, inode, and modification and change times of
+ * the source file, down to the nanosecond where the platform has them, so
+ * that we can tell whether the entry is stale without reading the source,
+ * and a hash of the encoded script so that we never hand a truncated or
+ * corrupted file to the decoder.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "bytecode-cache.h"
+#include "jsapi-util.h"
+#include "mem.h"
+#include <util/log.h>
+
+#define CACHE_MAGIC "GJSXDR2"
+
+typedef struct {
+    char magic[8];
+    guint32 build_hash;
+    guint32 payload_hash;
+    guint64 source_size;
+    gint64 source_mtime;
+    gint64 source_mtime_nsec;
+    gint64 source_ctime;
+    gint64 source_ctime_nsec;
+    guint64 source_inode;
+    guint64 payload_size;
+} CacheHeader;
+
+/* A file rewritten in place within the same second, keeping its size,
+ * only differs from the original in the nanoseconds of its times; the
+ * change time also moves when the modification time is set back */
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+#define STAT_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#define STAT_CTIME_NSEC(st) ((st)->st_ctim.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) 0
+#define STAT_CTIME_NSEC(st) 0
+#endif
+
+/* Encoded scripts are only valid for the exact SpiderMonkey build that
+ * produced them */
+static guint32
+get_build_hash(void)
+{
+    static gsize build_hash;
+
+    if (g_once_init_enter(&build_hash)) {
+        guint32 hash = g_str_hash(PACKAGE_VERSION) * 31 +
+            g_str_hash(JS_GetImplementationVersion());
+        g_once_init_leave(&build_hash, MAX(hash, 1));
+    }
+    return build_hash;
+}
+
+/* FNV-1a; we only want to detect damaged files, and this is much cheaper
+ * than compiling the source */
+static guint32
+hash_payload(const guint8 *data,
+             gsize         len)
+{
+    guint32 hash = 2166136261u;
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static char *
+get_cache_dir(void)
+{
+    const char *dir = g_getenv("GJS_BYTECODE_CACHE_DIR");
+
+    if (dir != NULL)
+        return g_strdup(dir);
+    return g_build_filename(g_get_user_cache_dir(), "gjs", "bytecode", NULL);
+}
+
+static char *
+get_cache_path(const char *path)
+{
+    char *dir, *checksum, *basename, *cache_path;
+
+    dir = get_cache_dir();
+    checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, path, -1);
+    basename = g_strconcat(checksum, ".jsc", NULL);
+    cache_path = g_build_filename(dir, basename, NULL);
+
+    g_free(basename);
+    g_free(checksum);
+    g_free(dir);
+    return cache_path;
+}
+
+static void
+header_init(CacheHeader       *header,
+            const struct stat *st,
+            const guint8      *payload,
+            gsize              payload_size)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+    header->build_hash = get_build_hash();
+    header->payload_hash = hash_payload(payload, payload_size);
+    header->source_size = st->st_size;
+    header->source_mtime = st->st_mtime;
+    header->source_mtime_nsec = STAT_MTIME_NSEC(st);
+    header->source_ctime = st->st_ctime;
+    header->source_ctime_nsec = STAT_CTIME_NSEC(st);
+    header->source_inode = st->st_ino;
+    header->payload_size = payload_size;
+}
+
+static bool
+header_is_valid(const CacheHeader *header,
+                const struct stat *st,
+                const guint8      *payload,
+                gsize              payload_size)
+{
+    return memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->build_hash == get_build_hash() &&
+        header->source_size == (guint64) st->st_size &&
+        header->source_mtime == (gint64) st->st_mtime &&
+        header->source_mtime_nsec == (gint64) STAT_MTIME_NSEC(st) &&
+        header->source_ctime == (gint64) st->st_ctime &&
+        header->source_ctime_nsec == (gint64) STAT_CTIME_NSEC(st) &&
+        header->source_inode == (guint64) st->st_ino &&
+        header->payload_size == payload_size &&
+        header->payload_hash == hash_payload(payload, payload_size);
+}
+
+static GBytes *
+lookup(const char        *cache_path,
+       const struct stat *st)
+{
+    GMappedFile *mapped;
+    GBytes *contents, *payload;
+    const CacheHeader *header;
+    gsize len;
+
+    mapped = g_mapped_file_new(cache_path, false, NULL);
+    if (mapped == NULL)
+        return NULL;
+
+    contents = g_mapped_file_get_bytes(mapped);
+    g_mapped_file_unref(mapped);
+
+    header = (const CacheHeader *) g_bytes_get_data(contents, &len);
+    if (len < sizeof(CacheHeader) ||
+        !header_is_valid(header, st, (const guint8 *) (header + 1),
+                         len - sizeof(CacheHeader))) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Discarding stale cache file %s",
+                  cache_path);
+        GJS_INC_STAT_COUNTER(bytecode_cache_stale);
+        g_bytes_unref(contents);
+        return NULL;
+    }
+
+    payload = g_bytes_new_from_bytes(contents, sizeof(CacheHeader),
+                                     len - sizeof(CacheHeader));
+    g_bytes_unref(contents);
+    return payload;
+}
+
+static void
+store(JSContext         *context,
+      const char        *cache_path,
+      const struct stat *st,
+      JS::HandleScript   script)
+{
+    void *payload;
+    uint32_t payload_size;
+    char *contents, *dir;
+    GError *error = NULL;
+
+    payload = JS_EncodeScript(context, script, &payload_size);
+    if (payload == NULL) {
+        JS_ClearPendingException(context);
+        return;
+    }
+
+    contents = (char *) g_malloc(sizeof(CacheHeader) + payload_size);
+    header_init((CacheHeader *) contents, st, (const guint8 *) payload,
+                payload_size);
+    memcpy(contents + sizeof(CacheHeader), payload, payload_size);
+    JS_free(context, payload);
+
+    dir = g_path_get_dirname(cache_path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    /* Writes to a temporary file and renames it over the old one, so a
+     * concurrent reader never sees a partial file */
+    if (!g_file_set_contents(cache_path, contents,
+                             sizeof(CacheHeader) + payload_size, &error)) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Could not write cache file %s: %s",
+                  cache_path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(contents);
+}
+
+static JSScript *
+compile(JSContext  *context,
+        const char *path)
+{
+    GMappedFile *source;
+    const char *script;
+    gssize script_len;
+    int start_line_number = 1;
+    GError *error = NULL;
+
+    source = g_mapped_file_new(path, false, &error);
+    if (source == NULL) {
+        gjs_throw_g_error(context, error);
+        return NULL;
+    }
+
+    script_len = g_mapped_file_get_length(source);
+    script = g_mapped_file_get_contents(source);
+    if (script != NULL)
+        script = gjs_strip_unix_shebang(script, &script_len, &start_line_number);
+    if (script == NULL) {
+        /* empty, or nothing but a shebang line */
+        script = "";
+        script_len = 0;
+    }
+
+    JS::CompileOptions options(context);
+    options.setUTF8(true)
+           .setFileAndLine(path, start_line_number);
+    gjs_bytecode_cache_set_compile_options(options);
+
+    JS::RootedObject global(context, JS::CurrentGlobalOrNull(context));
+    JSScript *compiled = JS::Compile(context, global, options, script,
+                                     script_len);
+
+    g_mapped_file_unref(source);
+    return compiled;
+}
+
+/**
+ * gjs_bytecode_cache_set_compile_options:
+ * @options: options for compiling a script that is to be cached
+ *
+ * Encoded scripts must not be bound to a global, and every function has to
+ * be compiled up front to end up in the encoding.
+ */
+void
+gjs_bytecode_cache_set_compile_options(JS::CompileOptions& options)
+{
+    options.setSourceIsLazy(true)
+           .setCompileAndGo(false)
+           .setCanLazilyParse(false);
+}
+
+/**
+ * gjs_bytecode_cache_read:
+ * @path: the path of a JS source file
+ * @st: the result of stat() on @path
+ *
+ * Looks up the cache entry of @path without decoding it. This does not
+ * touch the JS engine, so it may be called from any thread.
+ *
+ * Returns: the encoded script, or %NULL if there is no valid entry
+ */
+GBytes *
+gjs_bytecode_cache_read(const char        *path,
+                        const struct stat *st)
+{
+    char *cache_path = get_cache_path(path);
+    GBytes *payload = lookup(cache_path, st);
+
+    g_free(cache_path);
+    return payload;
+}
+
+/**
+ * gjs_bytecode_cache_decode:
+ * @context: the #JSContext
+ * @payload: an encoded script returned by gjs_bytecode_cache_read()
+ *
+ * Returns: the script, or %NULL if it could not be decoded
+ */
+JSScript *
+gjs_bytecode_cache_decode(JSContext *context,
+                          GBytes    *payload)
+{
+    const void *data;
+    gsize len;
+    JSScript *script;
+
+    data = g_bytes_get_data(payload, &len);
+    script = JS_DecodeScript(context, data, len, NULL);
+    if (script == NULL)
+        JS_ClearPendingException(context);
+    else
+        GJS_INC_STAT_COUNTER(bytecode_cache_hit);
+
+    return script;
+}
+
+/**
+ * gjs_bytecode_cache_store:
+ * @context: the #JSContext
+ * @path: the path of a JS source file
+ * @st: the result of stat() on @path
+ * @script: @path compiled with gjs_bytecode_cache_set_compile_options()
+ *
+ * Writes @script to the cache entry of @path. Failures are not reported,
+ * as they only mean the next run has to compile @path again.
+ */
+void
+gjs_bytecode_cache_store(JSContext         *context,
+                         const char        *path,
+                         const struct stat *st,
+                         JS::HandleScript   script)
+{
+    char *cache_path = get_cache_path(path);
+
+    store(context, cache_path, st, script);
+    g_free(cache_path);
+}
+
+/**
+ * gjs_bytecode_cache_compile_file:
+ * @context: the #JSContext
+ * @path: the path of a JS source file
+ * @st: the result of stat() on @path
+ *
+ * Returns the compiled script of @path, decoded from the cache if it holds
+ * an entry that is still valid for @st, or compiled from source and
+ * written to the cache otherwise.
+ *
+ * Returns: the script, or %NULL with an exception pending
+ */
+JSScript *
+gjs_bytecode_cache_compile_file(JSContext         *context,
+                                const char        *path,
+                                const struct stat *st)
+{
+    JSAutoRequest ar(context);
+    char *cache_path = get_cache_path(path);
+    GBytes *payload = lookup(cache_path, st);
+
+    JS::RootedScript script(context);
+    if (payload != NULL) {
+        script = gjs_bytecode_cache_decode(context, payload);
+        g_bytes_unref(payload);
+    }
+
+    if (script != NULL) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Loaded %s from cache", path);
+        g_free(cache_path);
+        return script;
+    }
+
+    script = compile(context, path);
+    if (script != NULL)
+        store(context, cache_path, st, script);
+
+    g_free(cache_path);
+    return script;
+}
@@ -0,0 +1,52 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __GJS_BYTECODE_CACHE_H__
+#define __GJS_BYTECODE_CACHE_H__
+
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+G_BEGIN_DECLS
+
+void      gjs_bytecode_cache_set_compile_options(JS::CompileOptions& options);
+
+GBytes   *gjs_bytecode_cache_read  (const char        *path,
+                                    const struct stat *st);
+JSScript *gjs_bytecode_cache_decode(JSContext         *context,
+                                    GBytes            *payload);
+void      gjs_bytecode_cache_store (JSContext         *context,
+                                    const char        *path,
+                                    const struct stat *st,
+                                    JS::HandleScript   script);
+
+JSScript *gjs_bytecode_cache_compile_file(JSContext         *context,
+                                          const char        *path,
+                                          const struct stat *st);
+
+G_END_DECLS
+
+#endif  /* __GJS_BYTECODE_CACHE_H__ */
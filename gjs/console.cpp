@@ -34,6 +34,7 @@ static char **include_path = NULL;
 static char **coverage_prefixes = NULL;
 static char *coverage_output_path = NULL;
 static char *command = NULL;
+static char *preparse_manifest = NULL;
 static gboolean print_version = false;
 
 static GOptionEntry entries[] = {
@@ -42,6 +43,7 @@ static GOptionEntry entries[] = {
     { "coverage-prefix", 'C', 0, G_OPTION_ARG_STRING_ARRAY, &coverage_prefixes, "Add the prefix PREFIX to the list of files to generate coverage info for", "PREFIX" },
     { "coverage-output", 0, 0, G_OPTION_ARG_STRING, &coverage_output_path, "Write coverage output to a directory DIR. This option is mandatory when using --coverage-path", "DIR", },
     { "include-path", 'I', 0, G_OPTION_ARG_STRING_ARRAY, &include_path, "Add the directory DIR to the list of directories to search for js files.", "DIR" },
+    { "preparse-manifest", 0, 0, G_OPTION_ARG_FILENAME, &preparse_manifest, "Compile the modules listed in FILE on background threads while starting up", "FILE" },
     { NULL }
 };
 
@@ -202,6 +204,7 @@ main(int argc, char **argv)
     coverage_prefixes = NULL;
     coverage_output_path = NULL;
     command = NULL;
+    preparse_manifest = NULL;
     print_version = false;
     g_option_context_set_ignore_unknown_options(context, false);
     g_option_context_set_help_enabled(context, true);
@@ -245,6 +248,12 @@ main(int argc, char **argv)
                                             "program-name", program_name,
                                             NULL);
 
+    if (preparse_manifest != NULL &&
+        !gjs_context_preparse_manifest(js_context, preparse_manifest, &error)) {
+        g_printerr("Failed to read preparse manifest: %s\n", error->message);
+        g_clear_error(&error);
+    }
+
     env_coverage_output_path = g_getenv("GJS_COVERAGE_OUTPUT");
     if (env_coverage_output_path != NULL) {
         g_free(coverage_output_path);
@@ -294,6 +303,7 @@ main(int argc, char **argv)
         gjs_coverage_write_statistics(coverage);
 
     g_free(coverage_output_path);
+    g_free(preparse_manifest);
     g_strfreev(coverage_prefixes);
     if (coverage)
         g_object_unref(coverage);
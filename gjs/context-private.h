@@ -27,6 +27,8 @@
 #include <inttypes.h>
 
 #include "context.h"
+#include "gc-scheduler.h"
+#include "preparse.h"
 
 G_BEGIN_DECLS
 
@@ -34,9 +36,19 @@ bool         _gjs_context_destroying                  (GjsContext *js_context);
 
 void         _gjs_context_schedule_gc_if_needed       (GjsContext *js_context);
 
+GjsGcScheduler *_gjs_context_get_gc_scheduler(GjsContext *js_context);
+
 void _gjs_context_exit(GjsContext *js_context,
                        uint8_t     exit_code);
 
+bool _gjs_context_get_typed_arrays(GjsContext *js_context);
+
+bool _gjs_context_get_bytecode_cache(GjsContext *js_context);
+
+GjsPreparser *_gjs_context_get_preparser(GjsContext *js_context);
+
+guint _gjs_context_get_import_cache_generation(GjsContext *js_context);
+
 G_END_DECLS
 
 #endif  /* __GJS_CONTEXT_PRIVATE_H__ */
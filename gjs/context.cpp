@@ -26,16 +26,19 @@
 #include <gio/gio.h>
 
 #include "context-private.h"
+#include "gc-scheduler.h"
 #include "importer.h"
 #include "jsapi-constructor-proxy.h"
 #include "jsapi-private.h"
 #include "jsapi-util.h"
 #include "jsapi-wrapper.h"
 #include "native.h"
+#include "preparse.h"
 #include "byteArray.h"
 #include "runtime.h"
 
 #include "gi.h"
+#include "gi/function.h"
 #include "gi/object.h"
 
 #include <modules/modules.h>
@@ -73,7 +76,17 @@ struct _GjsContext {
     bool should_exit;
     uint8_t exit_code;
 
+    bool typed_arrays;
+    bool bytecode_cache;
+
     guint    auto_gc_id;
+    guint    gc_slice_budget;
+    GjsGcScheduler *gc_scheduler;
+
+    GjsPreparser *preparser;
+
+    /* bumped by gjs_context_invalidate_import_caches() */
+    guint import_cache_generation;
 
     jsid const_strings[GJS_STRING_LAST];
 };
@@ -101,6 +114,9 @@ enum {
     PROP_0,
     PROP_SEARCH_PATH,
     PROP_PROGRAM_NAME,
+    PROP_TYPED_ARRAYS,
+    PROP_GC_SLICE_BUDGET,
+    PROP_BYTECODE_CACHE,
 };
 
 static GMutex contexts_lock;
@@ -350,6 +366,36 @@ gjs_context_class_init(GjsContextClass *klass)
                                     PROP_PROGRAM_NAME,
                                     pspec);
 
+    pspec = g_param_spec_boolean("typed-arrays",
+                                 "Typed arrays",
+                                 "Return C arrays of numbers as typed arrays instead of Array objects",
+                                 false,
+                                 (GParamFlags) (G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+    g_object_class_install_property(object_class,
+                                    PROP_TYPED_ARRAYS,
+                                    pspec);
+
+    pspec = g_param_spec_uint("gc-slice-budget",
+                              "GC slice budget",
+                              "Longest time in microseconds that one slice of an automatic garbage collection may take",
+                              1000, G_MAXUINT, GJS_GC_DEFAULT_SLICE_BUDGET_US,
+                              (GParamFlags) (G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+    g_object_class_install_property(object_class,
+                                    PROP_GC_SLICE_BUDGET,
+                                    pspec);
+
+    pspec = g_param_spec_boolean("bytecode-cache",
+                                 "Bytecode cache",
+                                 "Keep compiled modules in the user's cache directory and reuse them while their source is unchanged",
+                                 false,
+                                 (GParamFlags) (G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+    g_object_class_install_property(object_class,
+                                    PROP_BYTECODE_CACHE,
+                                    pspec);
+
     /* For GjsPrivate */
     {
         char *priv_typelib_dir = g_build_filename (PKGLIBDIR, "girepository-1.0", NULL);
@@ -399,12 +445,27 @@ gjs_context_dispose(GObject *object)
          * still exist, but point to NULL.
          */
         gjs_object_prepare_shutdown(js_context->context);
+        gjs_callback_trampoline_pool_drain();
 
         if (js_context->auto_gc_id > 0) {
             g_source_remove (js_context->auto_gc_id);
             js_context->auto_gc_id = 0;
         }
 
+        g_clear_pointer(&js_context->gc_scheduler, gjs_gc_scheduler_free);
+
+        /* Releasing the native objects above iterates the main loop, which
+         * may have started an incremental collection; nothing will run
+         * its next slice now, so finish it */
+        if (JS::IsIncrementalGCInProgress(js_context->runtime)) {
+            JS_BeginRequest(js_context->context);
+            JS::PrepareForFullGC(js_context->runtime);
+            JS::FinishIncrementalGC(js_context->runtime, JS::gcreason::API);
+            JS_EndRequest(js_context->context);
+        }
+
+        g_clear_pointer(&js_context->preparser, gjs_preparser_free);
+
         JS_RemoveExtraGCRootsTracer(js_context->runtime, gjs_context_tracer,
                                     js_context);
 
@@ -462,6 +523,10 @@ gjs_context_constructed(GObject *object)
 
     js_context->runtime = gjs_runtime_ref();
 
+    js_context->gc_scheduler = gjs_gc_scheduler_new(js_context->runtime);
+    gjs_gc_scheduler_set_slice_budget(js_context->gc_scheduler,
+                                      js_context->gc_slice_budget);
+
     js_context->context = JS_NewContext(js_context->runtime, 8192 /* stack chunk size */);
     if (js_context->context == NULL)
         g_error("Failed to create javascript context");
@@ -537,6 +602,15 @@ gjs_context_get_property (GObject     *object,
     case PROP_PROGRAM_NAME:
         g_value_set_string(value, js_context->program_name);
         break;
+    case PROP_TYPED_ARRAYS:
+        g_value_set_boolean(value, js_context->typed_arrays);
+        break;
+    case PROP_GC_SLICE_BUDGET:
+        g_value_set_uint(value, js_context->gc_slice_budget);
+        break;
+    case PROP_BYTECODE_CACHE:
+        g_value_set_boolean(value, js_context->bytecode_cache);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -560,6 +634,18 @@ gjs_context_set_property (GObject      *object,
     case PROP_PROGRAM_NAME:
         js_context->program_name = g_value_dup_string(value);
         break;
+    case PROP_TYPED_ARRAYS:
+        js_context->typed_arrays = g_value_get_boolean(value);
+        break;
+    case PROP_GC_SLICE_BUDGET:
+        js_context->gc_slice_budget = g_value_get_uint(value);
+        if (js_context->gc_scheduler)
+            gjs_gc_scheduler_set_slice_budget(js_context->gc_scheduler,
+                                              js_context->gc_slice_budget);
+        break;
+    case PROP_BYTECODE_CACHE:
+        js_context->bytecode_cache = g_value_get_boolean(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -587,12 +673,43 @@ _gjs_context_destroying (GjsContext *context)
     return context->destroying;
 }
 
+bool
+_gjs_context_get_typed_arrays(GjsContext *js_context)
+{
+    return js_context->typed_arrays;
+}
+
+bool
+_gjs_context_get_bytecode_cache(GjsContext *js_context)
+{
+    return js_context->bytecode_cache;
+}
+
+GjsPreparser *
+_gjs_context_get_preparser(GjsContext *js_context)
+{
+    return js_context->preparser;
+}
+
+GjsGcScheduler *
+_gjs_context_get_gc_scheduler(GjsContext *js_context)
+{
+    return js_context->gc_scheduler;
+}
+
 static gboolean
 trigger_gc_if_needed (gpointer user_data)
 {
     GjsContext *js_context = GJS_CONTEXT(user_data);
     js_context->auto_gc_id = 0;
-    gjs_gc_if_needed(js_context->context);
+
+    /* Run the rest of an unfinished collection in bounded slices, one
+     * slice budget per frame, so that it never blocks for longer */
+    if (gjs_gc_scheduler_maybe_collect(js_context->gc_scheduler))
+        js_context->auto_gc_id = g_timeout_add_full(G_PRIORITY_LOW,
+                                                    GJS_GC_FRAME_US / 1000,
+                                                    trigger_gc_if_needed,
+                                                    js_context, NULL);
     return G_SOURCE_REMOVE;
 }
 
@@ -641,10 +758,12 @@ context_reset_exit(GjsContext *js_context)
  * may initiate a garbage collection. 
  *
  * This function always unconditionally invokes JS_MaybeGC(), but
- * additionally looks at memory usage from the system malloc()
- * when available, and if the delta has grown since the last run
- * significantly, also initiates a full JavaScript garbage
- * collection.  The idea is that since GJS is a bridge between
+ * additionally looks at how much native memory has been allocated
+ * by wrapper objects and at the process RSS, and if either has grown
+ * significantly since the last collection, starts or continues an
+ * incremental JavaScript garbage collection, running one slice of
+ * at most #GjsContext:gc-slice-budget.  See gjs_context_get_gc_stats()
+ * for what was decided.  The idea is that since GJS is a bridge between
  * JavaScript and system libraries, and JS objects act as proxies
  * for these system memory objects, GJS consumers need a way to
  * hint to the runtime that it may be a good idea to try a
@@ -672,6 +791,150 @@ gjs_context_gc (GjsContext  *context)
     JS_GC(context->runtime);
 }
 
+/**
+ * gjs_context_gc_slice:
+ * @context: a #GjsContext
+ * @budget_us: time in microseconds that may be spent collecting
+ *
+ * Runs incremental garbage collection slices for at most @budget_us,
+ * starting a collection if none is in progress.  Embedders that know
+ * how much idle time they have, for example until the next frame,
+ * can call this repeatedly to spread a collection over several idle
+ * periods instead of blocking in gjs_context_gc().
+ *
+ * If the collection is not finished when this returns, the rest of it
+ * is also run from an idle handler, one #GjsContext:gc-slice-budget
+ * per frame.
+ *
+ * Returns: %TRUE if the collection finished
+ */
+bool
+gjs_context_gc_slice(GjsContext *context,
+                     guint       budget_us)
+{
+    bool finished;
+
+    g_return_val_if_fail(GJS_IS_CONTEXT(context), true);
+    g_return_val_if_fail(context->gc_scheduler != NULL, true);
+
+    finished = gjs_gc_scheduler_run_slices(context->gc_scheduler, budget_us);
+    if (!finished)
+        _gjs_context_schedule_gc_if_needed(context);
+
+    return finished;
+}
+
+/**
+ * gjs_context_get_gc_stats:
+ * @context: a #GjsContext
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Fills in @stats with the native memory accounted to wrapper objects,
+ * the last sampled RSS, and what the automatic garbage collection
+ * scheduler decided the last time it ran, along with counts of the
+ * incremental slices it has run so far.  The collection counts include
+ * every collection of the runtime, however it was started.
+ */
+void
+gjs_context_get_gc_stats(GjsContext *context,
+                         GjsGcStats *stats)
+{
+    g_return_if_fail(GJS_IS_CONTEXT(context));
+    g_return_if_fail(stats != NULL);
+
+    if (context->gc_scheduler == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    gjs_gc_scheduler_get_stats(context->gc_scheduler, stats);
+}
+
+static GjsPreparser *
+ensure_preparser(GjsContext *js_context)
+{
+    if (js_context->preparser == NULL)
+        js_context->preparser = gjs_preparser_new(js_context->context,
+                                                  js_context->bytecode_cache);
+    return js_context->preparser;
+}
+
+/**
+ * gjs_context_preparse_modules:
+ * @js_context: a #GjsContext
+ * @paths: (array zero-terminated=1): module files that are going to be
+ *   imported
+ *
+ * Starts reading and compiling @paths on background threads, so that most
+ * of the work is done by the time they are imported. Nothing is run until
+ * the modules are actually imported, and modules that fail to load are
+ * loaded again as usual then, so listing more files than needed only costs
+ * some background work.
+ */
+void
+gjs_context_preparse_modules(GjsContext        *js_context,
+                             const char * const *paths)
+{
+    GjsPreparser *preparser;
+    int i;
+
+    g_return_if_fail(GJS_IS_CONTEXT(js_context));
+
+    preparser = ensure_preparser(js_context);
+    for (i = 0; paths[i] != NULL; i++)
+        gjs_preparser_add(preparser, paths[i]);
+}
+
+/**
+ * gjs_context_preparse_manifest:
+ * @js_context: a #GjsContext
+ * @manifest: a file listing module files, one per line
+ * @error: return location for a #GError
+ *
+ * Like gjs_context_preparse_modules() for all the files listed in
+ * @manifest. Relative paths are resolved against the directory of
+ * @manifest; empty lines and lines starting with '#' are ignored.
+ *
+ * Returns: false if @manifest could not be read
+ */
+bool
+gjs_context_preparse_manifest(GjsContext  *js_context,
+                              const char  *manifest,
+                              GError     **error)
+{
+    g_return_val_if_fail(GJS_IS_CONTEXT(js_context), false);
+
+    return gjs_preparser_add_manifest(ensure_preparser(js_context),
+                                      manifest, error);
+}
+
+/**
+ * gjs_context_invalidate_import_caches:
+ * @js_context: a #GjsContext
+ *
+ * Importers remember which files each directory of their search path
+ * contains, and which module names could not be found. They find out about
+ * changes from file monitors, and from the modification time of each
+ * directory, which they check before every import. Call this after changing
+ * those directories in a way that neither shows, for example by replacing
+ * a file within the timestamp resolution of the file system, so that the
+ * next import in @js_context looks at the file system again. Importers of
+ * other contexts are not affected.
+ */
+void
+gjs_context_invalidate_import_caches(GjsContext *js_context)
+{
+    g_return_if_fail(GJS_IS_CONTEXT(js_context));
+
+    js_context->import_cache_generation++;
+}
+
+guint
+_gjs_context_get_import_cache_generation(GjsContext *js_context)
+{
+    return js_context->import_cache_generation;
+}
+
 /**
  * gjs_context_get_all:
  *
@@ -771,7 +1034,8 @@ gjs_context_eval_file(GjsContext    *js_context,
                       int           *exit_status_p,
                       GError       **error)
 {
-    char     *script = NULL;
+    GBytes   *bytes = NULL;
+    const char *script;
     gsize    script_len;
     bool ret = true;
 
@@ -782,18 +1046,23 @@ gjs_context_eval_file(GjsContext    *js_context,
         goto out;
     }
 
-    if (!g_file_load_contents(file, NULL, &script, &script_len, NULL, error)) {
+    bytes = gjs_file_load_bytes(file, error);
+    if (bytes == NULL) {
         ret = false;
         goto out;
     }
 
+    script = (const char *) g_bytes_get_data(bytes, &script_len);
+    if (script == NULL)
+        script = "";
+
     if (!gjs_context_eval(js_context, script, script_len, filename, exit_status_p, error)) {
         ret = false;
         goto out;
     }
 
 out:
-    g_free(script);
+    g_clear_pointer(&bytes, g_bytes_unref);
     g_object_unref(file);
     return ret;
 }
@@ -63,6 +63,14 @@ bool            gjs_context_define_string_array  (GjsContext  *js_context,
                                                   const char   **array_values,
                                                   GError       **error);
 
+void            gjs_context_preparse_modules     (GjsContext         *js_context,
+                                                  const char * const *paths);
+bool            gjs_context_preparse_manifest    (GjsContext  *js_context,
+                                                  const char    *manifest,
+                                                  GError       **error);
+
+void            gjs_context_invalidate_import_caches(GjsContext *js_context);
+
 GList*          gjs_context_get_all              (void);
 
 GjsContext     *gjs_context_get_current          (void);
@@ -76,6 +84,43 @@ void            gjs_context_maybe_gc              (GjsContext  *context);
 
 void            gjs_context_gc                    (GjsContext  *context);
 
+bool            gjs_context_gc_slice              (GjsContext  *context,
+                                                   guint        budget_us);
+
+typedef enum {
+    GJS_GC_DECISION_NONE,            /* no collection needed */
+    GJS_GC_DECISION_RATE_LIMITED,    /* too soon after the last collection */
+    GJS_GC_DECISION_NATIVE_PRESSURE, /* wrappers allocated enough native memory */
+    GJS_GC_DECISION_RSS_GROWTH,      /* the process RSS grew by 25% */
+    GJS_GC_DECISION_CONTINUE         /* a collection was already in progress */
+} GjsGcDecision;
+
+typedef struct {
+    /* native memory currently owned by wrappers, process-wide */
+    guint64 native_bytes_boxed;
+    guint64 native_bytes_object;
+    guint64 native_bytes_byte_array;
+    guint64 native_bytes_since_gc;
+    guint64 native_trigger_bytes;
+
+    guint64 rss_bytes;
+    guint64 rss_trigger_bytes;
+
+    guint    slice_budget_us;
+    gboolean collecting;
+
+    guint n_checks;
+    guint n_collections_started;
+    guint n_collections_finished;
+    guint n_slices;
+    gint64 last_slice_us;
+    gint64 max_slice_us;
+    GjsGcDecision last_decision;
+} GjsGcStats;
+
+void            gjs_context_get_gc_stats          (GjsContext  *context,
+                                                   GjsGcStats  *stats);
+
 void            gjs_dumpstack                     (void);
 
 G_END_DECLS
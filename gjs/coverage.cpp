@@ -1260,7 +1260,8 @@ gjs_coverage_init(GjsCoverage *self)
 
 static JSClass coverage_global_class = {
     "GjsCoverageGlobal",
-    JSCLASS_GLOBAL_FLAGS_WITH_SLOTS(GJS_GLOBAL_SLOT_LAST),
+    JSCLASS_GLOBAL_FLAGS_WITH_SLOTS(GJS_GLOBAL_SLOT_LAST) |
+    JSCLASS_IMPLEMENTS_BARRIERS,
     JS_PropertyStub,
     JS_DeletePropertyStub,
     JS_PropertyStub,
@@ -1779,6 +1780,7 @@ gjs_clear_js_side_statistics_from_coverage_object(GjsCoverage *coverage)
                                     coverage_statistics_tracer,
                                     coverage);
 
+        gjs_heap_object_pre_barrier(priv->coverage_statistics);
         priv->coverage_statistics = NULL;
     }
 }
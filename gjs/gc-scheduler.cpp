@@ -0,0 +1,357 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "gc-scheduler.h"
+#include "runtime.h"
+#include <util/log.h>
+
+/* We start a new collection at most once per this many microseconds
+ * (5 frames at 60 Hz); slices of a collection in progress are not
+ * limited by this. */
+#define MIN_COLLECTION_INTERVAL_US (5 * GJS_GC_FRAME_US)
+
+/* Start a collection once wrappers have taken this much native memory
+ * since the last one, or half of what was alive after it, if larger */
+#define MIN_NATIVE_TRIGGER_BYTES (8 * 1024 * 1024)
+
+struct _GjsGcScheduler {
+    JSRuntime *runtime;
+    guint slice_budget_us;
+
+    /* Value of native_bytes_allocated when the last collection finished,
+     * whoever started it */
+    gsize native_allocated_at_gc;
+    gsize native_trigger;
+
+    /* As with the old /proc/self/stat check, the trigger starts out at
+     * 0 so we always do a collection early */
+    gsize rss;
+    gsize rss_trigger;
+
+    /* When we last started a collection ourselves */
+    gint64 last_collection_time;
+
+    GjsGcStats stats;
+};
+
+static volatile gssize native_bytes[GJS_GC_NATIVE_LAST];
+/* Only ever grows; the scheduler looks at the difference between two
+ * readings */
+static volatile gssize native_bytes_allocated;
+
+void
+gjs_gc_track_native_memory(GjsGcNativeKind kind,
+                           gssize          delta)
+{
+    g_assert(kind < GJS_GC_NATIVE_LAST);
+
+    if (delta == 0)
+        return;
+
+    g_atomic_pointer_add(&native_bytes[kind], delta);
+    if (delta > 0)
+        g_atomic_pointer_add(&native_bytes_allocated, delta);
+}
+
+static gsize
+get_native_bytes(GjsGcNativeKind kind)
+{
+    gssize bytes = (gssize) g_atomic_pointer_get(&native_bytes[kind]);
+    return bytes > 0 ? bytes : 0;
+}
+
+static gsize
+get_native_bytes_allocated(void)
+{
+    return (gsize) g_atomic_pointer_get(&native_bytes_allocated);
+}
+
+static gsize
+get_live_native_bytes(void)
+{
+    gsize total = 0;
+    int i;
+
+    for (i = 0; i < GJS_GC_NATIVE_LAST; i++)
+        total += get_native_bytes((GjsGcNativeKind) i);
+    return total;
+}
+
+#ifdef __linux__
+/* /proc/self/statm is a handful of numbers, the second of which is the
+ * resident set size in pages. We keep it open and re-read it with pread(),
+ * rather than reading and scanning the much longer /proc/self/stat. */
+static int statm_fd = -1;
+
+static gsize
+sample_rss(void)
+{
+    static gsize page_size;
+    char buf[128];
+    char *end;
+    ssize_t len;
+    gulong resident;
+
+    if (statm_fd < 0) {
+        statm_fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+        if (statm_fd < 0)
+            return 0;
+        page_size = sysconf(_SC_PAGESIZE);
+    }
+
+    len = pread(statm_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    /* skip the total program size */
+    strtoul(buf, &end, 10);
+    resident = strtoul(end, NULL, 10);
+
+    return resident * page_size;
+}
+#else
+static gsize
+sample_rss(void)
+{
+    return 0;
+}
+#endif
+
+/* Runs at the end of every collection, including the ones started by
+ * JS_MaybeGC(), gjs_context_gc() or the engine itself, so that they all
+ * count as a fresh start for the native memory trigger */
+static void
+collection_finished(GjsGcScheduler *scheduler)
+{
+    gsize live_native;
+
+    scheduler->stats.n_collections_finished++;
+
+    scheduler->native_allocated_at_gc = get_native_bytes_allocated();
+    live_native = get_live_native_bytes();
+    scheduler->native_trigger = MAX(MIN_NATIVE_TRIGGER_BYTES, live_native / 2);
+
+    /* In theory using RSS is bad if we get swapped out, since we may be
+     * overzealous in GC, but on the other hand, if swapping is going on,
+     * better to GC. */
+    scheduler->rss = sample_rss();
+    scheduler->rss_trigger = (gsize) MIN(G_MAXSIZE, scheduler->rss * 1.25);
+
+    gjs_debug(GJS_DEBUG_CONTEXT,
+              "GC finished, %" G_GSIZE_FORMAT " bytes of "
+              "native memory alive, RSS %" G_GSIZE_FORMAT,
+              live_native, scheduler->rss);
+}
+
+static void
+scheduler_gc_callback(JSRuntime *runtime,
+                      JSGCStatus status,
+                      void      *data)
+{
+    GjsGcScheduler *scheduler = (GjsGcScheduler *) data;
+
+    if (status == JSGC_BEGIN)
+        scheduler->stats.n_collections_started++;
+    else if (status == JSGC_END)
+        collection_finished(scheduler);
+}
+
+GjsGcScheduler *
+gjs_gc_scheduler_new(JSRuntime *runtime)
+{
+    GjsGcScheduler *scheduler = g_slice_new0(GjsGcScheduler);
+
+    scheduler->runtime = runtime;
+    scheduler->slice_budget_us = GJS_GC_DEFAULT_SLICE_BUDGET_US;
+    scheduler->native_allocated_at_gc = get_native_bytes_allocated();
+    scheduler->native_trigger = MIN_NATIVE_TRIGGER_BYTES;
+    scheduler->stats.last_decision = GJS_GC_DECISION_NONE;
+
+    gjs_runtime_add_gc_callback(runtime, scheduler_gc_callback, scheduler);
+
+    return scheduler;
+}
+
+void
+gjs_gc_scheduler_free(GjsGcScheduler *scheduler)
+{
+    gjs_runtime_remove_gc_callback(scheduler->runtime, scheduler_gc_callback,
+                                   scheduler);
+    g_slice_free(GjsGcScheduler, scheduler);
+}
+
+void
+gjs_gc_scheduler_set_slice_budget(GjsGcScheduler *scheduler,
+                                  guint           budget_us)
+{
+    scheduler->slice_budget_us = budget_us;
+}
+
+guint
+gjs_gc_scheduler_get_slice_budget(GjsGcScheduler *scheduler)
+{
+    return scheduler->slice_budget_us;
+}
+
+/* Runs one incremental slice of at most @budget_us and returns true if the
+ * collection still has work left */
+static bool
+run_slice(GjsGcScheduler *scheduler,
+          guint           budget_us)
+{
+    JSRuntime *rt = scheduler->runtime;
+    gint64 start, elapsed;
+
+    /* SpiderMonkey budgets slices in whole milliseconds */
+    int64_t budget_ms = MAX(1, budget_us / 1000);
+
+    start = g_get_monotonic_time();
+    if (JS::IsIncrementalGCInProgress(rt)) {
+        JS::PrepareForIncrementalGC(rt);
+    } else {
+        JS::PrepareForFullGC(rt);
+        scheduler->last_collection_time = start;
+    }
+    JS::IncrementalGC(rt, JS::gcreason::API, budget_ms);
+    elapsed = g_get_monotonic_time() - start;
+
+    scheduler->stats.n_slices++;
+    scheduler->stats.last_slice_us = elapsed;
+    if (elapsed > scheduler->stats.max_slice_us)
+        scheduler->stats.max_slice_us = elapsed;
+
+    /* If this was the last slice, the GC callback has already called
+     * collection_finished() */
+    return JS::IsIncrementalGCInProgress(rt);
+}
+
+/**
+ * gjs_gc_scheduler_run_slices:
+ *
+ * Starts a collection if none is in progress, then runs incremental slices
+ * until either it finishes or @budget_us has been used up. SpiderMonkey
+ * budgets slices in whole milliseconds, so a budget of less than that
+ * still runs one slice of a millisecond.
+ *
+ * Returns: true if the collection finished.
+ */
+bool
+gjs_gc_scheduler_run_slices(GjsGcScheduler *scheduler,
+                            guint           budget_us)
+{
+    gint64 deadline = g_get_monotonic_time() + budget_us;
+    gint64 remaining = budget_us;
+
+    do {
+        if (!run_slice(scheduler, (guint) remaining))
+            return true;
+        remaining = deadline - g_get_monotonic_time();
+    } while (remaining >= 1000);
+
+    return false;
+}
+
+static GjsGcDecision
+decide(GjsGcScheduler *scheduler,
+       gint64          now)
+{
+    gsize native_since_gc;
+
+    if (JS::IsIncrementalGCInProgress(scheduler->runtime))
+        return GJS_GC_DECISION_CONTINUE;
+
+    if (scheduler->last_collection_time != 0 &&
+        now - scheduler->last_collection_time < MIN_COLLECTION_INTERVAL_US)
+        return GJS_GC_DECISION_RATE_LIMITED;
+
+    native_since_gc = get_native_bytes_allocated() -
+        scheduler->native_allocated_at_gc;
+    if (native_since_gc >= scheduler->native_trigger)
+        return GJS_GC_DECISION_NATIVE_PRESSURE;
+
+    scheduler->rss = sample_rss();
+    if (scheduler->rss > scheduler->rss_trigger)
+        return GJS_GC_DECISION_RSS_GROWTH;
+
+    /* If we've shrunk by 25%, lower the trigger */
+    if (scheduler->rss < 0.75 * scheduler->rss_trigger)
+        scheduler->rss_trigger = (gsize) (scheduler->rss * 1.25);
+
+    return GJS_GC_DECISION_NONE;
+}
+
+/**
+ * gjs_gc_scheduler_maybe_collect:
+ *
+ * Looks at how much native memory wrappers have taken since the last
+ * collection and at the process RSS, and starts or continues an incremental
+ * collection if needed, running slices for at most the slice budget.
+ *
+ * Returns: true if a collection is still in progress, in which case the
+ * caller should call this again, about a frame later.
+ */
+bool
+gjs_gc_scheduler_maybe_collect(GjsGcScheduler *scheduler)
+{
+    GjsGcDecision decision;
+
+    scheduler->stats.n_checks++;
+
+    decision = decide(scheduler, g_get_monotonic_time());
+    scheduler->stats.last_decision = decision;
+
+    if (decision == GJS_GC_DECISION_NONE ||
+        decision == GJS_GC_DECISION_RATE_LIMITED)
+        return false;
+
+    return !gjs_gc_scheduler_run_slices(scheduler, scheduler->slice_budget_us);
+}
+
+void
+gjs_gc_scheduler_get_stats(GjsGcScheduler *scheduler,
+                           GjsGcStats     *stats)
+{
+    *stats = scheduler->stats;
+
+    stats->native_bytes_boxed = get_native_bytes(GJS_GC_NATIVE_BOXED);
+    stats->native_bytes_object = get_native_bytes(GJS_GC_NATIVE_OBJECT);
+    stats->native_bytes_byte_array = get_native_bytes(GJS_GC_NATIVE_BYTE_ARRAY);
+    stats->native_bytes_since_gc = get_native_bytes_allocated() -
+        scheduler->native_allocated_at_gc;
+    stats->native_trigger_bytes = scheduler->native_trigger;
+    stats->rss_bytes = scheduler->rss;
+    stats->rss_trigger_bytes = scheduler->rss_trigger;
+    stats->slice_budget_us = scheduler->slice_budget_us;
+    stats->collecting = JS::IsIncrementalGCInProgress(scheduler->runtime);
+}
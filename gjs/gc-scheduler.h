@@ -0,0 +1,75 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __GJS_GC_SCHEDULER_H__
+#define __GJS_GC_SCHEDULER_H__
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "gjs/context.h"
+#include "gjs/jsapi-wrapper.h"
+
+G_BEGIN_DECLS
+
+/* Kinds of native memory owned by JS wrappers; the JS engine does not see
+ * these allocations, so we account for them ourselves */
+typedef enum {
+    GJS_GC_NATIVE_BOXED,
+    GJS_GC_NATIVE_OBJECT,
+    GJS_GC_NATIVE_BYTE_ARRAY,
+    GJS_GC_NATIVE_LAST
+} GjsGcNativeKind;
+
+/* Default time budget of a single incremental GC slice, about a quarter of
+ * a 60 Hz frame */
+#define GJS_GC_DEFAULT_SLICE_BUDGET_US 4000
+
+/* Interval at which the scheduler runs slices of an unfinished collection
+ * on its own */
+#define GJS_GC_FRAME_US 16666
+
+typedef struct _GjsGcScheduler GjsGcScheduler;
+
+/* May be called from any thread, including background finalizers */
+void gjs_gc_track_native_memory(GjsGcNativeKind kind,
+                                gssize          delta);
+
+GjsGcScheduler *gjs_gc_scheduler_new   (JSRuntime      *runtime);
+void            gjs_gc_scheduler_free  (GjsGcScheduler *scheduler);
+
+void  gjs_gc_scheduler_set_slice_budget(GjsGcScheduler *scheduler,
+                                        guint           budget_us);
+guint gjs_gc_scheduler_get_slice_budget(GjsGcScheduler *scheduler);
+
+bool gjs_gc_scheduler_maybe_collect(GjsGcScheduler *scheduler);
+
+bool gjs_gc_scheduler_run_slices(GjsGcScheduler *scheduler,
+                                 guint           budget_us);
+
+void gjs_gc_scheduler_get_stats(GjsGcScheduler *scheduler,
+                                GjsGcStats     *stats);
+
+G_END_DECLS
+
+#endif  /* __GJS_GC_SCHEDULER_H__ */
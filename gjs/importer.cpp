@@ -26,12 +26,17 @@
 #include <util/log.h>
 #include <util/glib.h>
 
+#include "bytecode-cache.h"
+#include "context-private.h"
 #include "importer.h"
+#include "jsapi-private.h"
 #include "jsapi-wrapper.h"
 #include "mem.h"
 #include "native.h"
+#include "preparse.h"
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
 #include <string.h>
 
@@ -41,8 +46,41 @@ static char **gjs_search_path = NULL;
 
 typedef struct {
     bool is_root;
+
+    /* dirname -> DirectoryIndex, for each search path entry looked at */
+    GHashTable *directory_index;
+    /* names known not to exist in any entry of the search path below */
+    GHashTable *missing_names;
+    char *missing_names_search_path;
+    guint cache_generation;
 } Importer;
 
+/* The names in one search path directory, so that looking for a module
+ * does not have to stat every candidate file in every directory. */
+typedef struct {
+    Importer *importer;
+    char *dirname;
+    /* name -> GFileType, or NULL if the directory could not be listed, in
+     * which case we probe the file system as before */
+    GHashTable *entries;
+    GFileMonitor *monitor;
+    bool valid;
+
+    /* The directory as it was when listed; file monitor events need a
+     * main loop to be delivered, so this is compared as well before the
+     * index is trusted */
+    bool is_native;
+    bool existed;
+    gint64 mtime;
+    gint64 mtime_nsec;
+} DirectoryIndex;
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+#define STAT_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) 0
+#endif
+
 typedef struct {
     GPtrArray *elements;
     unsigned int index;
@@ -313,12 +351,158 @@ import_native_file(JSContext       *context,
                              GJS_MODULE_PROP_FLAGS);
 }
 
+/* GMappedFile reports GFileErrors, but callers check for the GIOErrors
+ * that g_file_load_contents() would have given them */
+static void
+mapped_file_error_to_io_error(GError *error)
+{
+    if (error->domain != G_FILE_ERROR)
+        return;
+
+    error->domain = G_IO_ERROR;
+    error->code = g_io_error_from_errno(g_file_error_to_errno((GFileError) error->code));
+}
+
+/**
+ * gjs_file_load_bytes:
+ * @file: a #GFile
+ * @error: return location for a #GError
+ *
+ * Loads the contents of @file without copying them where possible: data of
+ * resource:// files is returned straight from the registered #GResource,
+ * and local files are mapped into memory. Other files are read into a new
+ * buffer as with g_file_load_contents().
+ *
+ * The data is not necessarily nul-terminated.
+ *
+ * Returns: (transfer full): the contents of @file, or %NULL on error
+ */
+GBytes *
+gjs_file_load_bytes(GFile   *file,
+                    GError **error)
+{
+    char *path;
+    char *contents;
+    gsize len;
+
+    if (g_file_has_uri_scheme(file, "resource")) {
+        char *uri = g_file_get_uri(file);
+        GBytes *bytes;
+
+        path = g_uri_unescape_string(uri + strlen("resource://"), NULL);
+        g_free(uri);
+
+        bytes = g_resources_lookup_data(path, G_RESOURCE_LOOKUP_FLAGS_NONE,
+                                        error);
+        g_free(path);
+
+        if (bytes == NULL && error != NULL &&
+            g_error_matches(*error, G_RESOURCE_ERROR,
+                            G_RESOURCE_ERROR_NOT_FOUND)) {
+            (*error)->domain = G_IO_ERROR;
+            (*error)->code = G_IO_ERROR_NOT_FOUND;
+        }
+        return bytes;
+    }
+
+    path = g_file_get_path(file);
+    if (path != NULL) {
+        GError *map_error = NULL;
+        GMappedFile *mapped = g_mapped_file_new(path, false, &map_error);
+
+        g_free(path);
+
+        if (mapped != NULL) {
+            GBytes *bytes = g_mapped_file_get_bytes(mapped);
+            g_mapped_file_unref(mapped);
+            return bytes;
+        }
+
+        if (g_error_matches(map_error, G_FILE_ERROR, G_FILE_ERROR_NOENT) ||
+            g_error_matches(map_error, G_FILE_ERROR, G_FILE_ERROR_NOTDIR)) {
+            mapped_file_error_to_io_error(map_error);
+            g_propagate_error(error, map_error);
+            return NULL;
+        }
+
+        /* Directories and special files can't be mapped; let GIO tell
+         * us why they can't be loaded either */
+        g_error_free(map_error);
+    }
+
+    if (!g_file_load_contents(file, NULL, &contents, &len, NULL, error))
+        return NULL;
+    return g_bytes_new_take(contents, len);
+}
+
 static JSObject *
 create_module_object(JSContext *context)
 {
     return JS_NewObject(context, NULL, JS::NullPtr(), JS::NullPtr());
 }
 
+/* Returns false if @file is not a regular local file, leaving it to the
+ * uncached path to report why it can't be imported */
+static bool
+import_file_cached(JSContext       *context,
+                   GFile           *file,
+                   JS::HandleObject module_obj,
+                   bool            *ok)
+{
+    char *path;
+    struct stat st;
+
+    path = g_file_get_path(file);
+    if (path == NULL || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        g_free(path);
+        return false;
+    }
+
+    JS::RootedScript script(context,
+        gjs_bytecode_cache_compile_file(context, path, &st));
+    g_free(path);
+
+    JS::RootedValue ignored(context);
+    *ok = script != NULL &&
+        JS_ExecuteScript(context, module_obj, script, &ignored);
+
+    if (*ok)
+        gjs_schedule_gc_if_needed(context);
+    return true;
+}
+
+/* Returns false if @file was not preloaded by the context's preparser */
+static bool
+import_file_preparsed(JSContext       *context,
+                      GjsPreparser    *preparser,
+                      GFile           *file,
+                      JS::HandleObject module_obj,
+                      bool            *ok)
+{
+    char *path;
+    bool taken;
+
+    /* Any import is a good time to start compiling more modules */
+    gjs_preparser_pump(preparser, context);
+
+    path = g_file_get_path(file);
+    if (path == NULL)
+        return false;
+
+    JS::RootedScript script(context);
+    taken = gjs_preparser_take_script(preparser, context, path, &script);
+    g_free(path);
+    if (!taken)
+        return false;
+
+    JS::RootedValue ignored(context);
+    *ok = JS_ExecuteScript(context, module_obj, script, &ignored);
+
+    if (*ok)
+        gjs_schedule_gc_if_needed(context);
+    return true;
+}
+
 static bool
 import_file(JSContext       *context,
             const char      *name,
@@ -326,15 +510,27 @@ import_file(JSContext       *context,
             JS::HandleObject module_obj)
 {
     bool ret = false;
-    char *script = NULL;
+    GBytes *bytes = NULL;
+    const char *script;
     char *full_path = NULL;
     gsize script_len = 0;
     GError *error = NULL;
+    GjsContext *gjs_context = (GjsContext *) JS_GetContextPrivate(context);
 
     JS::CompileOptions options(context);
     JS::RootedValue ignored(context);
 
-    if (!(g_file_load_contents(file, NULL, &script, &script_len, NULL, &error))) {
+    if (gjs_context != NULL && _gjs_context_get_preparser(gjs_context) != NULL &&
+        import_file_preparsed(context, _gjs_context_get_preparser(gjs_context),
+                              file, module_obj, &ret))
+        return ret;
+
+    if (gjs_context != NULL && _gjs_context_get_bytecode_cache(gjs_context) &&
+        import_file_cached(context, file, module_obj, &ret))
+        return ret;
+
+    bytes = gjs_file_load_bytes(file, &error);
+    if (bytes == NULL) {
         if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY) &&
             !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_DIRECTORY) &&
             !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
@@ -345,7 +541,9 @@ import_file(JSContext       *context,
         goto out;
     }
 
-    g_assert(script != NULL);
+    script = (const char *) g_bytes_get_data(bytes, &script_len);
+    if (script == NULL)
+        script = "";
 
     full_path = g_file_get_parse_name (file);
 
@@ -356,7 +554,7 @@ import_file(JSContext       *context,
     ret = true;
 
  out:
-    g_free(script);
+    g_clear_pointer(&bytes, g_bytes_unref);
     g_free(full_path);
     return ret;
 }
@@ -473,67 +671,283 @@ import_file_on_module(JSContext       *context,
     return retval;
 }
 
+static void
+directory_index_free(DirectoryIndex *index)
+{
+    if (index->monitor != NULL) {
+        g_signal_handlers_disconnect_by_data(index->monitor, index);
+        g_file_monitor_cancel(index->monitor);
+        g_object_unref(index->monitor);
+    }
+    g_clear_pointer(&index->entries, g_hash_table_destroy);
+    g_free(index->dirname);
+    g_slice_free(DirectoryIndex, index);
+}
+
+static void
+on_search_path_directory_changed(GFileMonitor     *monitor,
+                                 GFile            *file,
+                                 GFile            *other_file,
+                                 GFileMonitorEvent event_type,
+                                 DirectoryIndex   *index)
+{
+    switch (event_type) {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+        gjs_debug(GJS_DEBUG_IMPORTER, "Search path directory %s changed",
+                  index->dirname);
+        index->valid = false;
+        if (index->importer->missing_names != NULL)
+            g_hash_table_remove_all(index->importer->missing_names);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+directory_index_fill(DirectoryIndex *index)
+{
+    GFile *dir;
+    GFileEnumerator *direnum;
+    GFileInfo *info;
+    GError *error = NULL;
+
+    g_clear_pointer(&index->entries, g_hash_table_destroy);
+    index->valid = true;
+
+    dir = g_file_new_for_commandline_arg(index->dirname);
+
+    /* Also before listing, a change in between makes the next lookup list
+     * the directory again rather than go unnoticed */
+    index->is_native = g_file_is_native(dir);
+    if (index->is_native) {
+        struct stat st;
+
+        index->existed = g_stat(index->dirname, &st) == 0;
+        index->mtime = index->existed ? st.st_mtime : 0;
+        index->mtime_nsec = index->existed ? STAT_MTIME_NSEC(&st) : 0;
+    }
+
+    /* Watch before listing, so that nothing created in between is missed */
+    if (index->monitor == NULL && g_file_is_native(dir)) {
+        index->monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE,
+                                                  NULL, NULL);
+        if (index->monitor != NULL)
+            g_signal_connect(index->monitor, "changed",
+                             G_CALLBACK(on_search_path_directory_changed),
+                             index);
+    }
+
+    direnum = g_file_enumerate_children(dir,
+                                        G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                        G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                        G_FILE_QUERY_INFO_NONE,
+                                        NULL, &error);
+    if (direnum == NULL) {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ||
+            g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_DIRECTORY)) {
+            /* Nothing to import from here */
+            index->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   g_free, NULL);
+        } else {
+            gjs_debug(GJS_DEBUG_IMPORTER, "Could not list %s: %s",
+                      index->dirname, error->message);
+        }
+        g_error_free(error);
+        g_object_unref(dir);
+        return;
+    }
+
+    index->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, NULL);
+    while ((info = g_file_enumerator_next_file(direnum, NULL, NULL)) != NULL) {
+        g_hash_table_insert(index->entries,
+                            g_strdup(g_file_info_get_name(info)),
+                            GINT_TO_POINTER(g_file_info_get_file_type(info)));
+        g_object_unref(info);
+    }
+
+    g_object_unref(direnum);
+    g_object_unref(dir);
+}
+
+/* Adding, removing or renaming an entry changes the mtime of the
+ * directory */
 static bool
-do_import(JSContext       *context,
-          JS::HandleObject obj,
-          Importer        *priv,
-          const char      *name)
+directory_index_is_current(DirectoryIndex *index)
+{
+    struct stat st;
+
+    if (!index->valid)
+        return false;
+    if (!index->is_native)
+        return true;
+
+    if (g_stat(index->dirname, &st) != 0)
+        return !index->existed;
+
+    return index->existed &&
+        index->mtime == (gint64) st.st_mtime &&
+        index->mtime_nsec == (gint64) STAT_MTIME_NSEC(&st);
+}
+
+/* Drops the index of each directory of @search_path that changed since it
+ * was listed, along with the names known to be missing, as one of them
+ * may be there now */
+static void
+importer_check_directories(Importer *priv,
+                           char    **search_path)
+{
+    guint32 i;
+
+    if (priv->directory_index == NULL)
+        return;
+
+    for (i = 0; search_path[i] != NULL; ++i) {
+        DirectoryIndex *index = (DirectoryIndex *)
+            g_hash_table_lookup(priv->directory_index, search_path[i]);
+
+        if (index == NULL || !index->valid || directory_index_is_current(index))
+            continue;
+
+        gjs_debug(GJS_DEBUG_IMPORTER, "Search path directory %s changed",
+                  index->dirname);
+        index->valid = false;
+        if (priv->missing_names != NULL)
+            g_hash_table_remove_all(priv->missing_names);
+    }
+}
+
+static DirectoryIndex *
+get_directory_index(Importer   *priv,
+                    const char *dirname)
+{
+    DirectoryIndex *index;
+
+    if (priv->directory_index == NULL)
+        priv->directory_index =
+            g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                  (GDestroyNotify) directory_index_free);
+
+    index = (DirectoryIndex *) g_hash_table_lookup(priv->directory_index,
+                                                   dirname);
+    if (index == NULL) {
+        index = g_slice_new0(DirectoryIndex);
+        index->importer = priv;
+        index->dirname = g_strdup(dirname);
+        g_hash_table_insert(priv->directory_index, index->dirname, index);
+    }
+
+    if (!index->valid)
+        directory_index_fill(index);
+
+    return index;
+}
+
+static bool
+directory_index_may_contain(DirectoryIndex *index,
+                            const char     *name)
+{
+    return index->entries == NULL ||
+        g_hash_table_contains(index->entries, name);
+}
+
+static bool
+directory_index_is_directory(DirectoryIndex *index,
+                             const char     *name,
+                             const char     *full_path)
+{
+    GFile *gfile;
+    GFileType type;
+
+    if (index->entries != NULL)
+        return GPOINTER_TO_INT(g_hash_table_lookup(index->entries, name)) ==
+            G_FILE_TYPE_DIRECTORY;
+
+    gfile = g_file_new_for_commandline_arg(full_path);
+    type = g_file_query_file_type(gfile, (GFileQueryInfoFlags) 0, NULL);
+    g_object_unref(gfile);
+    return type == G_FILE_TYPE_DIRECTORY;
+}
+
+static void
+importer_clear_caches(Importer *priv)
+{
+    g_clear_pointer(&priv->directory_index, g_hash_table_destroy);
+    g_clear_pointer(&priv->missing_names, g_hash_table_destroy);
+    g_clear_pointer(&priv->missing_names_search_path, g_free);
+}
+
+/* Bumped by gjs_context_invalidate_import_caches() for the importers of
+ * that context only */
+static guint
+get_cache_generation(JSContext *context)
+{
+    GjsContext *gjs_context = (GjsContext *) JS_GetContextPrivate(context);
+
+    if (gjs_context == NULL)
+        return 0;
+    return _gjs_context_get_import_cache_generation(gjs_context);
+}
+
+static void
+importer_check_cache_generation(JSContext *context,
+                                Importer  *priv)
+{
+    guint generation = get_cache_generation(context);
+
+    if (priv->cache_generation != generation) {
+        importer_clear_caches(priv);
+        priv->cache_generation = generation;
+    }
+}
+
+/* Reads the search path of @importer into a NULL-terminated array of
+ * UTF-8 strings, skipping undefined and empty elements */
+static char **
+get_search_path(JSContext       *context,
+                JS::HandleObject importer)
 {
-    char *filename;
-    char *full_path;
-    char *dirname = NULL;
     JS::RootedObject search_path(context);
     guint32 search_path_len;
     guint32 i;
-    bool result;
-    GPtrArray *directories;
-    GFile *gfile;
-    bool exists;
+    GPtrArray *dirs;
 
     JS::RootedId search_path_name(context,
         gjs_context_get_const_string(context, GJS_STRING_SEARCH_PATH));
 
-    if (!gjs_object_require_property_value(context, obj, "importer",
+    if (!gjs_object_require_property_value(context, importer, "importer",
                                            search_path_name, &search_path)) {
-        return false;
+        return NULL;
     }
 
     if (!JS_IsArrayObject(context, search_path)) {
         gjs_throw(context, "searchPath property on importer is not an array");
-        return false;
+        return NULL;
     }
 
     if (!JS_GetArrayLength(context, search_path, &search_path_len)) {
         gjs_throw(context, "searchPath array has no length");
-        return false;
+        return NULL;
     }
 
-    result = false;
-
-    filename = g_strdup_printf("%s.js", name);
-    full_path = NULL;
-    directories = NULL;
+    dirs = g_ptr_array_new();
 
     JS::RootedValue elem(context);
-    JS::RootedObject module_obj(context);
-
-    /* First try importing an internal module like byteArray */
-    if (priv->is_root &&
-        gjs_is_registered_native_module(context, obj, name) &&
-        import_native_file(context, obj, name)) {
-        gjs_debug(GJS_DEBUG_IMPORTER,
-                  "successfully imported module '%s'", name);
-        result = true;
-        goto out;
-    }
-
     for (i = 0; i < search_path_len; ++i) {
+        char *dirname;
+
         elem.setUndefined();
         if (!JS_GetElement(context, search_path, i, &elem)) {
             /* this means there was an exception, while elem.isUndefined()
              * means no element found
              */
-            goto out;
+            goto fail;
         }
 
         if (elem.isUndefined())
@@ -541,59 +955,143 @@ do_import(JSContext       *context,
 
         if (!elem.isString()) {
             gjs_throw(context, "importer searchPath contains non-string");
-            goto out;
+            goto fail;
         }
 
-        g_free(dirname);
-        dirname = NULL;
-
         if (!gjs_string_to_utf8(context, elem, &dirname))
-            goto out; /* Error message already set */
+            goto fail; /* Error message already set */
 
         /* Ignore empty path elements */
-        if (dirname[0] == '\0')
+        if (dirname[0] == '\0') {
+            g_free(dirname);
             continue;
+        }
+
+        g_ptr_array_add(dirs, dirname);
+    }
+
+    g_ptr_array_add(dirs, NULL);
+    return (char **) g_ptr_array_free(dirs, false);
+
+ fail:
+    g_ptr_array_foreach(dirs, (GFunc) g_free, NULL);
+    g_ptr_array_free(dirs, true);
+    return NULL;
+}
+
+/* Returns false if a name that was looked up before is known not to exist
+ * anywhere in @search_path; forgets all such names if the search path
+ * changed since */
+static bool
+check_missing_names(Importer   *priv,
+                    char      **search_path,
+                    const char *name)
+{
+    char *key = g_strjoinv("\n", search_path);
+
+    if (priv->missing_names == NULL ||
+        g_strcmp0(key, priv->missing_names_search_path) != 0) {
+        g_clear_pointer(&priv->missing_names, g_hash_table_destroy);
+        g_free(priv->missing_names_search_path);
+        priv->missing_names_search_path = key;
+        priv->missing_names = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    g_free, NULL);
+        return true;
+    }
+
+    g_free(key);
+    return !g_hash_table_contains(priv->missing_names, name);
+}
+
+static bool
+do_import(JSContext       *context,
+          JS::HandleObject obj,
+          Importer        *priv,
+          const char      *name)
+{
+    char *filename;
+    char *full_path;
+    char **search_path;
+    guint32 i;
+    bool result;
+    GPtrArray *directories;
+    GFile *gfile;
+    bool exists;
+
+    /* First try importing an internal module like byteArray */
+    if (priv->is_root &&
+        gjs_is_registered_native_module(context, obj, name) &&
+        import_native_file(context, obj, name)) {
+        gjs_debug(GJS_DEBUG_IMPORTER,
+                  "successfully imported module '%s'", name);
+        return true;
+    }
+
+    search_path = get_search_path(context, obj);
+    if (search_path == NULL)
+        return false;
+
+    importer_check_cache_generation(context, priv);
+    importer_check_directories(priv, search_path);
+
+    if (!check_missing_names(priv, search_path, name)) {
+        g_strfreev(search_path);
+        gjs_throw_custom(context, "Error", "ImportError",
+                         "No JS module '%s' found in search path", name);
+        return false;
+    }
+
+    result = false;
+
+    filename = g_strdup_printf("%s.js", name);
+    full_path = NULL;
+    directories = NULL;
+
+    JS::RootedObject module_obj(context);
+
+    for (i = 0; search_path[i] != NULL; ++i) {
+        const char *dirname = search_path[i];
+        DirectoryIndex *index = get_directory_index(priv, dirname);
 
         /* Try importing __init__.js and loading the symbol from it */
-        if (full_path)
+        if (directory_index_may_contain(index, MODULE_INIT_FILENAME)) {
             g_free(full_path);
-        full_path = g_build_filename(dirname, MODULE_INIT_FILENAME,
-                                     NULL);
-
-        module_obj.set(load_module_init(context, obj, full_path));
-        if (module_obj != NULL) {
-            JS::RootedValue obj_val(context);
-            if (JS_GetProperty(context, module_obj, name, &obj_val)) {
-                if (!obj_val.isUndefined() &&
-                    JS_DefineProperty(context, obj, name, obj_val,
-                                      GJS_MODULE_PROP_FLAGS & ~JSPROP_PERMANENT)) {
-                    result = true;
-                    goto out;
+            full_path = g_build_filename(dirname, MODULE_INIT_FILENAME,
+                                         NULL);
+
+            module_obj.set(load_module_init(context, obj, full_path));
+            if (module_obj != NULL) {
+                JS::RootedValue obj_val(context);
+                if (JS_GetProperty(context, module_obj, name, &obj_val)) {
+                    if (!obj_val.isUndefined() &&
+                        JS_DefineProperty(context, obj, name, obj_val,
+                                          GJS_MODULE_PROP_FLAGS & ~JSPROP_PERMANENT)) {
+                        result = true;
+                        goto out;
+                    }
                 }
             }
         }
 
         /* Second try importing a directory (a sub-importer) */
-        if (full_path)
+        if (directory_index_may_contain(index, name)) {
             g_free(full_path);
-        full_path = g_build_filename(dirname, name,
-                                     NULL);
-        gfile = g_file_new_for_commandline_arg(full_path);
+            full_path = g_build_filename(dirname, name,
+                                         NULL);
 
-        if (g_file_query_file_type(gfile, (GFileQueryInfoFlags) 0, NULL) == G_FILE_TYPE_DIRECTORY) {
-            gjs_debug(GJS_DEBUG_IMPORTER,
-                      "Adding directory '%s' to child importer '%s'",
-                      full_path, name);
-            if (directories == NULL) {
-                directories = g_ptr_array_new();
+            if (directory_index_is_directory(index, name, full_path)) {
+                gjs_debug(GJS_DEBUG_IMPORTER,
+                          "Adding directory '%s' to child importer '%s'",
+                          full_path, name);
+                if (directories == NULL) {
+                    directories = g_ptr_array_new();
+                }
+                g_ptr_array_add(directories, full_path);
+                /* don't free it twice - pass ownership to ptr array */
+                full_path = NULL;
             }
-            g_ptr_array_add(directories, full_path);
-            /* don't free it twice - pass ownership to ptr array */
-            full_path = NULL;
         }
 
-        g_object_unref(gfile);
-
         /* If we just added to directories, we know we don't need to
          * check for a file.  If we added to directories on an earlier
          * iteration, we want to ignore any files later in the
@@ -605,18 +1103,22 @@ do_import(JSContext       *context,
         }
 
         /* Third, if it's not a directory, try importing a file */
-        g_free(full_path);
-        full_path = g_build_filename(dirname, filename,
-                                     NULL);
-        gfile = g_file_new_for_commandline_arg(full_path);
-        exists = g_file_query_exists(gfile, NULL);
+        exists = false;
+        gfile = NULL;
+        if (directory_index_may_contain(index, filename)) {
+            g_free(full_path);
+            full_path = g_build_filename(dirname, filename,
+                                         NULL);
+            gfile = g_file_new_for_commandline_arg(full_path);
+            exists = index->entries != NULL || g_file_query_exists(gfile, NULL);
+        }
 
         if (!exists) {
             gjs_debug(GJS_DEBUG_IMPORTER,
                       "JS import '%s' not found in %s",
                       name, dirname);
 
-            g_object_unref(gfile);
+            g_clear_object(&gfile);
             continue;
         }
 
@@ -663,13 +1165,16 @@ do_import(JSContext       *context,
 
     g_free(full_path);
     g_free(filename);
-    g_free(dirname);
+    g_strfreev(search_path);
 
     if (!result &&
         !JS_IsExceptionPending(context)) {
         /* If no exception occurred, the problem is just that we got to the
-         * end of the path. Be sure an exception is set.
+         * end of the path. Be sure an exception is set, and remember that
+         * there is no such module until the search path or one of its
+         * directories changes.
          */
+        g_hash_table_add(priv->missing_names, g_strdup(name));
         gjs_throw_custom(context, "Error", "ImportError",
                          "No JS module '%s' found in search path", name);
     }
@@ -940,6 +1445,7 @@ importer_finalize(JSFreeOp *fop,
         return; /* we are the prototype, not a real instance */
 
     GJS_DEC_COUNTER(importer);
+    importer_clear_caches(priv);
     g_slice_free(Importer, priv);
 }
 
@@ -950,6 +1456,7 @@ importer_finalize(JSFreeOp *fop,
 struct JSClass gjs_importer_class = {
     "GjsFileImporter",
     JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
     JSCLASS_NEW_RESOLVE |
     JSCLASS_NEW_ENUMERATE,
     JS_PropertyStub,
@@ -1021,6 +1528,7 @@ importer_new(JSContext *context,
 
     priv = g_slice_new0(Importer);
     priv->is_root = is_root;
+    priv->cache_generation = get_cache_generation(context);
 
     GJS_INC_COUNTER(importer);
 
@@ -26,6 +26,7 @@
 
 #include <stdbool.h>
 #include <glib.h>
+#include <gio/gio.h>
 #include "gjs/jsapi-util.h"
 
 G_BEGIN_DECLS
@@ -39,6 +40,9 @@ bool      gjs_define_root_importer_object(JSContext        *context,
                                           JS::HandleObject  in_object,
                                           JS::HandleObject  root_importer);
 
+GBytes   *gjs_file_load_bytes      (GFile       *file,
+                                    GError     **error);
+
 JSObject *gjs_define_importer(JSContext       *context,
                               JS::HandleObject in_object,
                               const char      *importer_name,
@@ -25,16 +25,229 @@
 
 #include <string.h>
 
+#include <new>
+
 #include "jsapi-util.h"
 #include "jsapi-wrapper.h"
 
+/* Most strings that cross between JS and C are identifiers, paths and
+ * other plain ASCII, so we check for that a machine word at a time and
+ * skip the general transcoding for it. */
+
+#define ASCII_MASK_8 G_GUINT64_CONSTANT(0x8080808080808080)
+#define ASCII_MASK_16 G_GUINT64_CONSTANT(0xff80ff80ff80ff80)
+
+/* Returns the length of the leading run of ASCII bytes in @s */
+static size_t
+utf8_ascii_prefix(const char *s,
+                  size_t      len)
+{
+    size_t i = 0;
+    guint64 word;
+
+    for (; i + sizeof(word) <= len; i += sizeof(word)) {
+        memcpy(&word, s + i, sizeof(word));
+        if (word & ASCII_MASK_8)
+            break;
+    }
+    for (; i < len; i++) {
+        if ((guint8) s[i] & 0x80)
+            break;
+    }
+    return i;
+}
+
+static bool
+utf16_is_ascii(const char16_t *s,
+               size_t          len)
+{
+    size_t i = 0;
+    guint64 word;
+
+    for (; i + 4 <= len; i += 4) {
+        memcpy(&word, s + i, sizeof(word));
+        if (word & ASCII_MASK_16)
+            return false;
+    }
+    for (; i < len; i++) {
+        if (s[i] >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+/* Number of bytes needed to encode @s, not counting the terminator.
+ * Unpaired surrogates become U+FFFD, as in JS_EncodeStringToUTF8(). */
+size_t
+gjs_utf16_to_utf8_length(const char16_t *s,
+                         size_t          len)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < len; i++) {
+        char16_t c = s[i];
+
+        if (c < 0x80) {
+            n += 1;
+        } else if (c < 0x800) {
+            n += 2;
+        } else if (c >= 0xd800 && c < 0xdc00 && i + 1 < len &&
+                   s[i + 1] >= 0xdc00 && s[i + 1] < 0xe000) {
+            n += 4;
+            i++;
+        } else {
+            n += 3;
+        }
+    }
+    return n;
+}
+
+/* Encodes @s into @out, which must hold gjs_utf16_to_utf8_length() + 1
+ * bytes */
+void
+gjs_utf16_to_utf8(const char16_t *s,
+                  size_t          len,
+                  char           *out)
+{
+    guint8 *q = (guint8 *) out;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        guint32 c = s[i];
+
+        if (c < 0x80) {
+            *q++ = c;
+            continue;
+        }
+
+        if (c < 0x800) {
+            *q++ = 0xc0 | (c >> 6);
+            *q++ = 0x80 | (c & 0x3f);
+            continue;
+        }
+
+        if (c >= 0xd800 && c < 0xdc00 && i + 1 < len &&
+            s[i + 1] >= 0xdc00 && s[i + 1] < 0xe000) {
+            c = 0x10000 + ((c - 0xd800) << 10) + (s[++i] - 0xdc00);
+            *q++ = 0xf0 | (c >> 18);
+            *q++ = 0x80 | ((c >> 12) & 0x3f);
+            *q++ = 0x80 | ((c >> 6) & 0x3f);
+            *q++ = 0x80 | (c & 0x3f);
+            continue;
+        }
+
+        if (c >= 0xd800 && c < 0xe000)
+            c = 0xfffd;  /* unpaired surrogate */
+
+        *q++ = 0xe0 | (c >> 12);
+        *q++ = 0x80 | ((c >> 6) & 0x3f);
+        *q++ = 0x80 | (c & 0x3f);
+    }
+    *q = '\0';
+}
+
+/* Returns @s as a newly allocated UTF-8 string */
+static char *
+utf16_to_utf8_dup(const char16_t *s,
+                  size_t          len)
+{
+    char *out;
+    size_t i;
+
+    if (utf16_is_ascii(s, len)) {
+        out = (char *) g_malloc(len + 1);
+        for (i = 0; i < len; i++)
+            out[i] = (char) s[i];
+        out[len] = '\0';
+        return out;
+    }
+
+    out = (char *) g_malloc(gjs_utf16_to_utf8_length(s, len) + 1);
+    gjs_utf16_to_utf8(s, len, out);
+    return out;
+}
+
+/* Validates and decodes @s in one pass, starting after its first @start
+ * bytes, which the caller has already found to be ASCII. Rejects what
+ * g_utf8_validate() rejects. Returns a zero-terminated string allocated
+ * with g_malloc(), or %NULL if @s is not valid UTF-8. */
+static char16_t *
+utf8_to_utf16(const char *s,
+              size_t      len,
+              size_t      start,
+              size_t     *len_p)
+{
+    const guint8 *p = (const guint8 *) s + start;
+    const guint8 *end = (const guint8 *) s + len;
+    /* No sequence decodes to more UTF-16 units than it has bytes */
+    char16_t *out = g_new(char16_t, len + 1);
+    char16_t *q = out;
+    size_t i;
+
+    for (i = 0; i < start; i++)
+        *q++ = (guint8) s[i];
+
+    while (p < end) {
+        guint32 c = *p;
+
+        if (c < 0x80) {
+            *q++ = c;
+            p++;
+        } else if (c < 0xc2) {
+            goto invalid;  /* stray continuation byte, or overlong */
+        } else if (c < 0xe0) {
+            if (end - p < 2 || (p[1] & 0xc0) != 0x80)
+                goto invalid;
+            *q++ = ((c & 0x1f) << 6) | (p[1] & 0x3f);
+            p += 2;
+        } else if (c < 0xf0) {
+            if (end - p < 3 || (p[1] & 0xc0) != 0x80 ||
+                (p[2] & 0xc0) != 0x80)
+                goto invalid;
+            c = ((c & 0x0f) << 12) | ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+            if (c < 0x800 || (c >= 0xd800 && c < 0xe000))
+                goto invalid;
+            *q++ = c;
+            p += 3;
+        } else if (c < 0xf5) {
+            if (end - p < 4 || (p[1] & 0xc0) != 0x80 ||
+                (p[2] & 0xc0) != 0x80 || (p[3] & 0xc0) != 0x80)
+                goto invalid;
+            c = ((c & 0x07) << 18) | ((p[1] & 0x3f) << 12) |
+                ((p[2] & 0x3f) << 6) | (p[3] & 0x3f);
+            if (c < 0x10000 || c > 0x10ffff)
+                goto invalid;
+            c -= 0x10000;
+            *q++ = 0xd800 + (c >> 10);
+            *q++ = 0xdc00 + (c & 0x3ff);
+            p += 4;
+        } else {
+            goto invalid;
+        }
+    }
+
+    *q = 0;
+    *len_p = q - out;
+
+    /* Don't keep a buffer that is mostly unused alive as long as the
+     * string is */
+    if (*len_p < len / 2)
+        out = (char16_t *) g_realloc(out, (*len_p + 1) * sizeof(char16_t));
+
+    return out;
+
+ invalid:
+    g_free(out);
+    return NULL;
+}
+
 bool
 gjs_string_to_utf8 (JSContext      *context,
                     const JS::Value value,
                     char          **utf8_string_p)
 {
-    gsize len;
-    char *bytes;
+    const char16_t *chars;
+    size_t len;
 
     JS_BeginRequest(context);
 
@@ -47,16 +260,14 @@ gjs_string_to_utf8 (JSContext      *context,
 
     JS::RootedString str(context, value.toString());
 
-    len = JS_GetStringEncodingLength(context, str);
-    if (len == (gsize)(-1)) {
+    chars = JS_GetStringCharsAndLength(context, str, &len);
+    if (chars == NULL) {
         JS_EndRequest(context);
         return false;
     }
 
-    if (utf8_string_p) {
-        bytes = JS_EncodeStringToUTF8(context, str);
-        *utf8_string_p = bytes;
-    }
+    if (utf8_string_p)
+        *utf8_string_p = utf16_to_utf8_dup(chars, len);
 
     JS_EndRequest(context);
 
@@ -68,37 +279,68 @@ gjs_string_from_utf8(JSContext             *context,
                      const char            *utf8_string,
                      ssize_t                n_bytes,
                      JS::MutableHandleValue value_p)
+{
+    size_t len;
+
+    /* Like g_utf8_to_utf16(), stop at an embedded nul */
+    if (n_bytes < 0) {
+        len = strlen(utf8_string);
+    } else {
+        const char *nul = (const char *) memchr(utf8_string, '\0', n_bytes);
+        len = nul != NULL ? nul - utf8_string : n_bytes;
+    }
+
+    return gjs_string_from_utf8_n(context, utf8_string, len, value_p);
+}
+
+/**
+ * gjs_string_from_utf8_n:
+ * @context: a #JSContext
+ * @utf8_string: UTF-8 data, not necessarily zero-terminated
+ * @len: length of @utf8_string in bytes
+ * @value_p: JS::Value that will be filled with a string
+ *
+ * Like gjs_string_from_utf8(), but converts all of @len bytes, including
+ * any embedded nuls.
+ *
+ * Returns: true on success, false otherwise in which case a JS error is thrown
+ */
+bool
+gjs_string_from_utf8_n(JSContext             *context,
+                       const char            *utf8_string,
+                       size_t                 len,
+                       JS::MutableHandleValue value_p)
 {
     char16_t *u16_string;
-    glong u16_string_length;
-    GError *error;
+    size_t ascii_len, u16_string_length;
 
-    /* intentionally using n_bytes even though glib api suggests n_chars; with
-    * n_chars (from g_utf8_strlen()) the result appears truncated
-    */
+    JSAutoRequest ar(context);
+    JS::RootedString str(context);
 
-    error = NULL;
-    u16_string =
-        reinterpret_cast<char16_t *>(g_utf8_to_utf16(utf8_string, n_bytes, NULL,
-                                                     &u16_string_length, &error));
-    if (!u16_string) {
-        gjs_throw(context,
-                  "Failed to convert UTF-8 string to "
-                  "JS string: %s",
-                  error->message);
-                  g_error_free(error);
-        return false;
-    }
+    ascii_len = utf8_ascii_prefix(utf8_string, len);
+    if (ascii_len == len) {
+        /* ASCII is a subset of Latin-1, which SpiderMonkey widens itself;
+         * short strings don't even need a separate allocation */
+        str = JS_NewStringCopyN(context, utf8_string, len);
+    } else {
+        u16_string = utf8_to_utf16(utf8_string, len, ascii_len,
+                                   &u16_string_length);
+        if (!u16_string) {
+            gjs_throw(context,
+                      "Failed to convert UTF-8 string to JS string: "
+                      "Invalid byte sequence in conversion input");
+            return false;
+        }
 
-    JS_BeginRequest(context);
+        /* Avoid a copy - assumes that g_malloc == js_malloc == malloc */
+        str = JS_NewUCString(context, u16_string, u16_string_length);
+        if (str == NULL)
+            g_free(u16_string);
+    }
 
-    /* Avoid a copy - assumes that g_malloc == js_malloc == malloc */
-    JS::RootedString str(context,
-                         JS_NewUCString(context, u16_string, u16_string_length));
     if (str)
         value_p.setString(str);
 
-    JS_EndRequest(context);
     return str != NULL;
 }
 
@@ -311,17 +553,193 @@ gjs_get_string_id (JSContext       *context,
                    jsid             id,
                    char           **name_p)
 {
-    JS::RootedValue id_val(context);
+    const char16_t *chars;
+    size_t len;
 
-    if (!JS_IdToValue(context, id, &id_val))
+    if (!JSID_IS_STRING(id)) {
+        *name_p = NULL;
         return false;
+    }
 
-    if (id_val.isString()) {
-        return gjs_string_to_utf8(context, id_val, name_p);
-    } else {
+    /* Strings used as ids are atoms, which are always flat, so this
+     * cannot fail or allocate */
+    chars = JS_GetStringCharsAndLength(context, JSID_TO_STRING(id), &len);
+    if (chars == NULL) {
         *name_p = NULL;
         return false;
     }
+
+    *name_p = utf16_to_utf8_dup(chars, len);
+    return true;
+}
+
+/* Resolve hooks run for every property lookup that misses on a wrapper, so
+ * each runtime keeps the UTF-8 names of the ids they see, keyed by the
+ * address of the id's atom. The ids are traced so that the atom cannot be
+ * collected, and its address reused, while it is in the table; but like
+ * the GObject property cache, each marking trace first drops the names
+ * that were not looked up since the previous one, so the table does not
+ * keep atoms alive for long after they stop being used. Borrowed names are
+ * never dropped. */
+
+typedef struct {
+    JS::Heap<jsid> id;
+    unsigned n_borrowed;
+    bool used;
+    char name[1];
+} CachedName;
+
+struct GjsStringIdCache {
+    JSRuntime *runtime;
+    GHashTable *names;  /* JSString* -> CachedName* */
+};
+
+static CachedName *
+cached_name_new(jsid            id,
+                const char16_t *chars,
+                size_t          len)
+{
+    size_t utf8_len = gjs_utf16_to_utf8_length(chars, len);
+    CachedName *cached = (CachedName *) g_malloc(G_STRUCT_OFFSET(CachedName, name) +
+                                                 utf8_len + 1);
+
+    new (&cached->id) JS::Heap<jsid>(id);
+    cached->n_borrowed = 0;
+    cached->used = true;
+    gjs_utf16_to_utf8(chars, len, cached->name);
+    return cached;
+}
+
+static void
+cached_name_free(gpointer data)
+{
+    CachedName *cached = (CachedName *) data;
+
+    g_assert(cached->n_borrowed == 0);
+    cached->id.~Heap();
+    g_free(cached);
+}
+
+static void
+string_id_cache_trace(JSTracer *tracer,
+                      void     *data)
+{
+    GjsStringIdCache *cache = (GjsStringIdCache *) data;
+    bool sweeping = JS_IsGCMarkingTracer(tracer);
+    GHashTableIter iter;
+    CachedName *cached;
+
+    g_hash_table_iter_init(&iter, cache->names);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &cached)) {
+        if (sweeping) {
+            if (!cached->used && cached->n_borrowed == 0) {
+                g_hash_table_iter_remove(&iter);
+                continue;
+            }
+            cached->used = false;
+        }
+
+        JS_CallHeapIdTracer(tracer, &cached->id, "string id cache");
+    }
+}
+
+GjsStringIdCache *
+gjs_string_id_cache_new(JSRuntime *runtime)
+{
+    GjsStringIdCache *cache = g_slice_new0(GjsStringIdCache);
+
+    cache->runtime = runtime;
+    cache->names = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                         NULL, cached_name_free);
+    JS_AddExtraGCRootsTracer(runtime, string_id_cache_trace, cache);
+    return cache;
+}
+
+void
+gjs_string_id_cache_free(GjsStringIdCache *cache)
+{
+    JS_RemoveExtraGCRootsTracer(cache->runtime, string_id_cache_trace, cache);
+    g_hash_table_destroy(cache->names);
+    g_slice_free(GjsStringIdCache, cache);
+}
+
+/* Number of names currently cached, for the tests */
+unsigned
+gjs_string_id_cache_size(GjsStringIdCache *cache)
+{
+    return g_hash_table_size(cache->names);
+}
+
+/**
+ * gjs_borrow_string_id:
+ * @context: a #JSContext
+ * @id: a jsid that is an object hash key (could be an int or string)
+ * @name_p: place to store the UTF-8 name of @id
+ *
+ * Like gjs_get_string_id(), but returns a name owned by the runtime, which
+ * is only converted the first time @id is seen. Every successful call must
+ * be paired with gjs_release_string_id(); until then, *name_p stays valid
+ * even if JS code runs and the GC collects in between.
+ *
+ * Returns: true if *name_p is non-%NULL
+ **/
+bool
+gjs_borrow_string_id(JSContext   *context,
+                     jsid         id,
+                     const char **name_p)
+{
+    GjsStringIdCache *cache;
+    JSString *str;
+    CachedName *cached;
+    const char16_t *chars;
+    size_t len;
+
+    if (!JSID_IS_STRING(id)) {
+        *name_p = NULL;
+        return false;
+    }
+
+    cache = gjs_runtime_get_string_id_cache(JS_GetRuntime(context));
+    str = JSID_TO_STRING(id);
+
+    cached = (CachedName *) g_hash_table_lookup(cache->names, str);
+    if (cached == NULL) {
+        chars = JS_GetStringCharsAndLength(context, str, &len);
+        if (chars == NULL) {
+            *name_p = NULL;
+            return false;
+        }
+
+        cached = cached_name_new(id, chars, len);
+        g_hash_table_insert(cache->names, str, cached);
+    }
+
+    cached->used = true;
+    cached->n_borrowed++;
+    *name_p = cached->name;
+    return true;
+}
+
+/**
+ * gjs_release_string_id:
+ * @context: a #JSContext
+ * @name: (allow-none): a name returned by gjs_borrow_string_id()
+ *
+ * Gives back a borrowed name. %NULL is ignored, so that callers can release
+ * unconditionally.
+ **/
+void
+gjs_release_string_id(JSContext  *context,
+                      const char *name)
+{
+    CachedName *cached;
+
+    if (name == NULL)
+        return;
+
+    cached = (CachedName *) (name - G_STRUCT_OFFSET(CachedName, name));
+    g_assert(cached->n_borrowed > 0);
+    cached->n_borrowed--;
 }
 
 /**
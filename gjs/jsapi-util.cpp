@@ -46,7 +46,8 @@ gjs_util_error_quark (void)
 
 static JSClass global_class = {
     "GjsGlobal",
-    JSCLASS_GLOBAL_FLAGS_WITH_SLOTS(GJS_GLOBAL_SLOT_LAST),
+    JSCLASS_GLOBAL_FLAGS_WITH_SLOTS(GJS_GLOBAL_SLOT_LAST) |
+    JSCLASS_IMPLEMENTS_BARRIERS,
     JS_PropertyStub,
     JS_DeletePropertyStub,
     JS_PropertyStub,
@@ -688,80 +689,17 @@ gjs_get_type_name(JS::Value value)
     }
 }
 
-#ifdef __linux__
-static void
-_linux_get_self_process_size (gulong *vm_size,
-                              gulong *rss_size)
+/* Returns true if an incremental collection is still in progress */
+bool
+gjs_gc_if_needed (JSContext *context)
 {
-    char *contents;
-    char *iter;
-    gsize len;
-    int i;
-
-    *vm_size = *rss_size = 0;
-
-    if (!g_file_get_contents ("/proc/self/stat", &contents, &len, NULL))
-        return;
+    GjsContext *gjs_context;
 
-    iter = contents;
-    /* See "man proc" for where this 22 comes from */
-    for (i = 0; i < 22; i++) {
-        iter = strchr (iter, ' ');
-        if (!iter)
-            goto out;
-        iter++;
-    }
-    sscanf (iter, " %lu", vm_size);
-    iter = strchr (iter, ' ');
-    if (iter)
-        sscanf (iter, " %lu", rss_size);
+    gjs_context = (GjsContext *) JS_GetContextPrivate(context);
+    if (gjs_context == NULL)
+        return false;
 
- out:
-    g_free (contents);
-}
-
-static gulong linux_rss_trigger;
-static gint64 last_gc_time;
-#endif
-
-void
-gjs_gc_if_needed (JSContext *context)
-{
-#ifdef __linux__
-    {
-        /* We initiate a GC if VM or RSS has grown by this much */
-        gulong vmsize;
-        gulong rss_size;
-        gint64 now;
-
-        /* We rate limit GCs to at most one per 5 frames.
-           One frame is 16666 microseconds (1000000/60)*/
-        now = g_get_monotonic_time();
-        if (now - last_gc_time < 5 * 16666)
-            return;
-
-        _linux_get_self_process_size (&vmsize, &rss_size);
-
-        /* linux_rss_trigger is initialized to 0, so currently
-         * we always do a full GC early.
-         *
-         * Here we see if the RSS has grown by 25% since
-         * our last look; if so, initiate a full GC.  In
-         * theory using RSS is bad if we get swapped out,
-         * since we may be overzealous in GC, but on the
-         * other hand, if swapping is going on, better
-         * to GC.
-         */
-        if (rss_size > linux_rss_trigger) {
-            linux_rss_trigger = (gulong) MIN(G_MAXULONG, rss_size * 1.25);
-            JS_GC(JS_GetRuntime(context));
-            last_gc_time = now;
-        } else if (rss_size < (0.75 * linux_rss_trigger)) {
-            /* If we've shrunk by 75%, lower the trigger */
-            linux_rss_trigger = (rss_size * 1.25);
-        }
-    }
-#endif
+    return gjs_gc_scheduler_maybe_collect(_gjs_context_get_gc_scheduler(gjs_context));
 }
 
 /**
@@ -773,7 +711,28 @@ void
 gjs_maybe_gc (JSContext *context)
 {
     JS_MaybeGC(context);
-    gjs_gc_if_needed(context);
+
+    /* Leave the rest of an incremental collection to the idle handler */
+    if (gjs_gc_if_needed(context))
+        _gjs_context_schedule_gc_if_needed((GjsContext *) JS_GetContextPrivate(context));
+}
+
+/**
+ * gjs_heap_object_pre_barrier:
+ * @heap: a traced pointer that C code is about to overwrite or destroy
+ *
+ * JS::Heap has no pre-write barrier in this version of SpiderMonkey. An
+ * incremental collection marks everything that was reachable when it
+ * started, so before a pointer that a trace hook marks is dropped while
+ * marking is in progress, the old object has to be marked by hand.
+ */
+void
+gjs_heap_object_pre_barrier(JS::Heap<JSObject *>& heap)
+{
+    JSObject *obj = heap.get();
+
+    if (obj != NULL && JS::IsIncrementalBarrierNeeded(JS_GetObjectRuntime(obj)))
+        JS::IncrementalReferenceBarrier(obj, JSTRACE_OBJECT);
 }
 
 void
@@ -814,10 +773,14 @@ gjs_strip_unix_shebang(const char  *script,
 {
     g_assert(script_len);
 
+    /* The script may be a mapped file without a trailing nul, so don't
+     * look further than its length */
+    gssize len = *script_len >= 0 ? *script_len : (gssize) strlen(script);
+
     /* handle scripts with UNIX shebangs */
-    if (strncmp(script, "#!", 2) == 0) {
+    if (len >= 2 && strncmp(script, "#!", 2) == 0) {
         /* If we found a newline, advance the script by one line */
-        const char *s = (const char *) strstr (script, "\n");
+        const char *s = (const char *) memchr(script, '\n', len);
         if (s != NULL) {
             if (*script_len > 0)
                 *script_len -= (s + 1 - script);
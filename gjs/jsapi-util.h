@@ -186,6 +186,7 @@ static bool gjs_##cname##_new_resolve(JSContext *context, \
 static struct JSClass gjs_##cname##_class = { \
     type_name, \
     JSCLASS_HAS_PRIVATE | \
+    JSCLASS_IMPLEMENTS_BARRIERS | \
     JSCLASS_NEW_RESOLVE | jsclass_flags, \
     JS_PropertyStub, \
     JS_DeletePropertyStub, \
@@ -395,6 +396,16 @@ bool gjs_string_from_utf8(JSContext             *context,
                           const char            *utf8_string,
                           ssize_t                n_bytes,
                           JS::MutableHandleValue value_p);
+bool gjs_string_from_utf8_n(JSContext             *context,
+                            const char            *utf8_string,
+                            size_t                 len,
+                            JS::MutableHandleValue value_p);
+
+size_t gjs_utf16_to_utf8_length(const char16_t *s,
+                                size_t          len);
+void   gjs_utf16_to_utf8       (const char16_t *s,
+                                size_t          len,
+                                char           *out);
 
 bool        gjs_string_to_filename           (JSContext       *context,
                                               const JS::Value  string_val,
@@ -421,6 +432,17 @@ bool gjs_string_from_ucs4(JSContext             *cx,
 bool        gjs_get_string_id                (JSContext       *context,
                                               jsid             id,
                                               char           **name_p);
+
+bool        gjs_borrow_string_id             (JSContext       *context,
+                                              jsid             id,
+                                              const char     **name_p);
+void        gjs_release_string_id            (JSContext       *context,
+                                              const char      *name);
+
+GjsStringIdCache *gjs_string_id_cache_new (JSRuntime        *runtime);
+void              gjs_string_id_cache_free(GjsStringIdCache *cache);
+unsigned          gjs_string_id_cache_size(GjsStringIdCache *cache);
+
 jsid        gjs_intern_string_to_id          (JSContext       *context,
                                               const char      *string);
 
@@ -434,6 +456,8 @@ const char* gjs_get_type_name                (JS::Value        value);
 
 void gjs_maybe_gc (JSContext *context);
 
+void gjs_heap_object_pre_barrier(JS::Heap<JSObject *>& heap);
+
 bool gjs_context_get_frame_info(JSContext                              *context,
                                 mozilla::Maybe<JS::MutableHandleValue>& stack,
                                 mozilla::Maybe<JS::MutableHandleValue>& fileName,
@@ -49,6 +49,16 @@ GJS_DEFINE_COUNTER(resultset)
 GJS_DEFINE_COUNTER(weakhash)
 GJS_DEFINE_COUNTER(interface)
 GJS_DEFINE_COUNTER(constructor_proxy)
+GJS_DEFINE_COUNTER(enumeration)
+
+GJS_DEFINE_COUNTER(property_cache_hit)
+GJS_DEFINE_COUNTER(property_cache_miss)
+GJS_DEFINE_COUNTER(toggle_queue_depth)
+GJS_DEFINE_COUNTER(trampoline_pool_hit)
+GJS_DEFINE_COUNTER(trampoline_pool_miss)
+GJS_DEFINE_COUNTER(bytecode_cache_hit)
+GJS_DEFINE_COUNTER(bytecode_cache_stale)
+GJS_DEFINE_COUNTER(preparsed_script_used)
 
 #define GJS_LIST_COUNTER(name) \
     & gjs_counter_ ## name
@@ -69,8 +79,71 @@ static GjsMemCounter* counters[] = {
     GJS_LIST_COUNTER(weakhash),
     GJS_LIST_COUNTER(interface),
     GJS_LIST_COUNTER(constructor_proxy),
+    GJS_LIST_COUNTER(enumeration),
+};
+
+static GjsMemCounter* stat_counters[] = {
+    GJS_LIST_COUNTER(property_cache_hit),
+    GJS_LIST_COUNTER(property_cache_miss),
+    GJS_LIST_COUNTER(toggle_queue_depth),
+    GJS_LIST_COUNTER(trampoline_pool_hit),
+    GJS_LIST_COUNTER(trampoline_pool_miss),
+    GJS_LIST_COUNTER(bytecode_cache_hit),
+    GJS_LIST_COUNTER(bytecode_cache_stale),
+    GJS_LIST_COUNTER(preparsed_script_used),
 };
 
+G_LOCK_DEFINE_STATIC(cache_stats);
+static GHashTable *cache_stats;
+
+GjsMemCacheStats *
+gjs_memory_get_cache_stats(const char *cache_name,
+                           const char *class_name)
+{
+    GjsMemCacheStats *stats;
+    char *key;
+
+    key = g_strconcat(cache_name, "/", class_name, NULL);
+
+    G_LOCK(cache_stats);
+
+    if (cache_stats == NULL)
+        cache_stats = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            g_free, NULL);
+
+    stats = (GjsMemCacheStats *) g_hash_table_lookup(cache_stats, key);
+    if (stats == NULL) {
+        stats = g_new0(GjsMemCacheStats, 1);
+        stats->cache_name = g_intern_string(cache_name);
+        stats->class_name = g_intern_string(class_name);
+        g_hash_table_insert(cache_stats, key, stats);
+    } else {
+        g_free(key);
+    }
+
+    G_UNLOCK(cache_stats);
+
+    return stats;
+}
+
+static void
+report_cache_stats(gpointer key,
+                   gpointer value,
+                   gpointer user_data)
+{
+    GjsMemCacheStats *stats = (GjsMemCacheStats *) value;
+    int hits = g_atomic_int_get(&stats->hits);
+    int lookups = hits + g_atomic_int_get(&stats->misses);
+
+    if (lookups == 0)
+        return;
+
+    gjs_debug(GJS_DEBUG_MEMORY,
+              "    %s %s: %d%% of %d lookups hit",
+              stats->cache_name, stats->class_name,
+              (int) (100.0 * hits / lookups), lookups);
+}
+
 void
 gjs_memory_report(const char *where,
                   bool        die_if_leaks)
@@ -106,6 +179,18 @@ gjs_memory_report(const char *where,
                   counters[i]->value);
     }
 
+    for (i = 0; i < (int) G_N_ELEMENTS(stat_counters); ++i) {
+        gjs_debug(GJS_DEBUG_MEMORY,
+                  "    %12s = %d",
+                  stat_counters[i]->name,
+                  stat_counters[i]->value);
+    }
+
+    G_LOCK(cache_stats);
+    if (cache_stats != NULL)
+        g_hash_table_foreach(cache_stats, report_cache_stats, NULL);
+    G_UNLOCK(cache_stats);
+
     if (die_if_leaks && GJS_GET_COUNTER(everything) > 0) {
         g_error("%s: JavaScript objects were leaked.", where);
     }
@@ -55,6 +55,18 @@ GJS_DECLARE_COUNTER(resultset)
 GJS_DECLARE_COUNTER(weakhash)
 GJS_DECLARE_COUNTER(interface)
 GJS_DECLARE_COUNTER(constructor_proxy)
+GJS_DECLARE_COUNTER(enumeration)
+
+/* Statistics, rather than counts of live objects; these don't add up to
+ * "everything" and are not checked for leaks */
+GJS_DECLARE_COUNTER(property_cache_hit)
+GJS_DECLARE_COUNTER(property_cache_miss)
+GJS_DECLARE_COUNTER(toggle_queue_depth)
+GJS_DECLARE_COUNTER(trampoline_pool_hit)
+GJS_DECLARE_COUNTER(trampoline_pool_miss)
+GJS_DECLARE_COUNTER(bytecode_cache_hit)
+GJS_DECLARE_COUNTER(bytecode_cache_stale)
+GJS_DECLARE_COUNTER(preparsed_script_used)
 
 #define GJS_INC_COUNTER(name)                \
     do {                                        \
@@ -68,9 +80,31 @@ GJS_DECLARE_COUNTER(constructor_proxy)
         g_atomic_int_add(&gjs_counter_ ## name .value, -1); \
     } while (0)
 
+#define GJS_INC_STAT_COUNTER(name) \
+    g_atomic_int_add(&gjs_counter_ ## name .value, 1)
+
+#define GJS_DEC_STAT_COUNTER(name) \
+    g_atomic_int_add(&gjs_counter_ ## name .value, -1)
+
 #define GJS_GET_COUNTER(name) \
     g_atomic_int_get(&gjs_counter_ ## name .value)
 
+/* Hit and miss counts of a cache that each class keeps, such as the
+ * GObject property cache. They are created on first use and live as long
+ * as the process, so they still add up after the class is gone. */
+typedef struct {
+    const char *cache_name;
+    const char *class_name;
+    volatile int hits;
+    volatile int misses;
+} GjsMemCacheStats;
+
+GjsMemCacheStats *gjs_memory_get_cache_stats(const char *cache_name,
+                                             const char *class_name);
+
+#define GJS_INC_CACHE_STAT(stats, what) \
+    g_atomic_int_add(&(stats)->what, 1)
+
 void gjs_memory_report(const char *where,
                        bool        die_if_leaks);
 
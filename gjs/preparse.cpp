@@ -0,0 +1,613 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* Background loading of modules that an application is going to import.
+ *
+ * A pool of worker threads reads each module listed in advance and either
+ * finds a valid bytecode cache entry for it, or converts its source to
+ * UTF-16 so that SpiderMonkey can compile it on one of its helper threads.
+ * Those compilations have to be started from the main thread; the workers
+ * ask for that from an idle source as soon as a module is read, and the
+ * main thread also starts them whenever it imports anything, in case it
+ * is not running its main loop. It picks up the finished script once the
+ * module itself is imported. Decoding a cache entry needs the JSContext,
+ * so only reading and checking it happens in the background.
+ *
+ * Anything that goes wrong here just leaves the module to be loaded the
+ * usual way, which then reports the error.
+ */
+
+#include <config.h>
+
+#include <sys/stat.h>
+
+#include <gio/gio.h>
+
+#include "bytecode-cache.h"
+#include "jsapi-util.h"
+#include "mem.h"
+#include "preparse.h"
+#include <util/log.h>
+
+/* How long an import may wait for a helper thread to finish compiling
+ * the module, before compiling it again itself */
+#define MAX_COMPILE_WAIT_US (50 * 1000)
+
+typedef enum {
+    ENTRY_QUEUED,
+    ENTRY_READING,
+    ENTRY_SOURCE,     /* UTF-16 source ready to be compiled */
+    ENTRY_ENCODED,    /* valid bytecode cache entry read */
+    ENTRY_COMPILING,  /* being compiled by a SpiderMonkey helper thread */
+    ENTRY_COMPILED,
+    ENTRY_FAILED,
+    ENTRY_TAKEN,
+    ENTRY_ABANDONED   /* imported while ENTRY_COMPILING */
+} EntryState;
+
+typedef struct {
+    GjsPreparser *preparser;
+    char *path;
+    EntryState state;
+    /* Set once the module is imported; no thread may start new work on
+     * the entry after that */
+    bool claimed;
+
+    struct stat st;
+    gunichar2 *chars;
+    glong n_chars;
+    int start_line_number;
+    GBytes *payload;
+    void *token;
+} Entry;
+
+struct _GjsPreparser {
+    JSContext *context;
+    JSRuntime *runtime;
+    bool use_bytecode_cache;
+    GThreadPool *pool;
+    GMainContext *main_context;
+
+    /* Protects the state of all entries, the to_compile queue and
+     * pump_source */
+    GMutex lock;
+    GCond cond;
+
+    GHashTable *entries;  /* path -> Entry */
+    GQueue to_compile;    /* entries in ENTRY_SOURCE */
+    GSource *pump_source;
+    /* Set once gjs_preparser_free() has started; no new pump_source may
+     * be attached after that */
+    bool disposing;
+    /* Helper thread compilations that nobody is waiting for anymore; the
+     * main thread still has to finish them */
+    guint n_abandoned;
+};
+
+static void
+entry_clear(Entry *entry)
+{
+    g_clear_pointer(&entry->chars, g_free);
+    g_clear_pointer(&entry->payload, g_bytes_unref);
+}
+
+static void
+entry_free(Entry *entry)
+{
+    entry_clear(entry);
+    g_free(entry->path);
+    g_slice_free(Entry, entry);
+}
+
+static bool
+read_source(Entry *entry)
+{
+    GMappedFile *mapped;
+    const char *script;
+    gssize script_len;
+
+    mapped = g_mapped_file_new(entry->path, false, NULL);
+    if (mapped == NULL)
+        return false;
+
+    script_len = g_mapped_file_get_length(mapped);
+    script = g_mapped_file_get_contents(mapped);
+    entry->start_line_number = 1;
+    if (script != NULL)
+        script = gjs_strip_unix_shebang(script, &script_len,
+                                        &entry->start_line_number);
+
+    if (script == NULL) {
+        /* empty, or nothing but a shebang line */
+        entry->chars = g_new0(gunichar2, 1);
+        entry->n_chars = 0;
+    } else {
+        /* NULL if the file is not valid UTF-8 */
+        entry->chars = g_utf8_to_utf16(script, script_len, NULL,
+                                       &entry->n_chars, NULL);
+    }
+
+    g_mapped_file_unref(mapped);
+    return entry->chars != NULL;
+}
+
+static gboolean
+on_pump_idle(gpointer data)
+{
+    GjsPreparser *preparser = (GjsPreparser *) data;
+    JSContext *context = preparser->context;
+
+    g_mutex_lock(&preparser->lock);
+    g_clear_pointer(&preparser->pump_source, g_source_unref);
+    g_mutex_unlock(&preparser->lock);
+
+    JSAutoRequest ar(context);
+    JSAutoCompartment ac(context, gjs_get_import_global(context));
+    gjs_preparser_pump(preparser, context);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Asks the main thread to call gjs_preparser_pump(); may be called from
+ * any thread, with the lock held */
+static void
+schedule_pump(GjsPreparser *preparser)
+{
+    if (preparser->disposing || preparser->pump_source != NULL)
+        return;
+
+    preparser->pump_source = g_idle_source_new();
+    g_source_set_priority(preparser->pump_source, G_PRIORITY_HIGH_IDLE);
+    g_source_set_callback(preparser->pump_source, on_pump_idle, preparser,
+                          NULL);
+    g_source_attach(preparser->pump_source, preparser->main_context);
+}
+
+/* Runs in the worker threads */
+static void
+read_entry(Entry        *entry,
+           GjsPreparser *preparser)
+{
+    EntryState state = ENTRY_FAILED;
+
+    g_mutex_lock(&preparser->lock);
+    if (entry->claimed) {
+        /* Imported before we got to it */
+        g_mutex_unlock(&preparser->lock);
+        return;
+    }
+    entry->state = ENTRY_READING;
+    g_mutex_unlock(&preparser->lock);
+
+    if (stat(entry->path, &entry->st) == 0 && S_ISREG(entry->st.st_mode)) {
+        if (preparser->use_bytecode_cache) {
+            entry->payload = gjs_bytecode_cache_read(entry->path, &entry->st);
+            if (entry->payload != NULL)
+                state = ENTRY_ENCODED;
+        }
+
+        if (state == ENTRY_FAILED && read_source(entry))
+            state = ENTRY_SOURCE;
+    }
+
+    g_mutex_lock(&preparser->lock);
+    entry->state = state;
+    if (state == ENTRY_SOURCE && !entry->claimed) {
+        g_queue_push_tail(&preparser->to_compile, entry);
+        schedule_pump(preparser);
+    }
+    g_cond_broadcast(&preparser->cond);
+    g_mutex_unlock(&preparser->lock);
+}
+
+GjsPreparser *
+gjs_preparser_new(JSContext *context,
+                  bool       use_bytecode_cache)
+{
+    GjsPreparser *preparser = g_slice_new0(GjsPreparser);
+
+    preparser->context = context;
+    preparser->runtime = JS_GetRuntime(context);
+    preparser->use_bytecode_cache = use_bytecode_cache;
+    preparser->main_context = g_main_context_ref_thread_default();
+    g_mutex_init(&preparser->lock);
+    g_cond_init(&preparser->cond);
+    g_queue_init(&preparser->to_compile);
+    preparser->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                               (GDestroyNotify) entry_free);
+
+    /* Leave one processor to the main thread */
+    preparser->pool = g_thread_pool_new((GFunc) read_entry, preparser,
+                                        MAX(1, (int) g_get_num_processors() - 1),
+                                        false, NULL);
+
+    return preparser;
+}
+
+void
+gjs_preparser_free(GjsPreparser *preparser)
+{
+    GHashTableIter iter;
+    Entry *entry;
+
+    /* Drops the entries no worker has started on yet */
+    g_thread_pool_free(preparser->pool, true, true);
+
+    g_mutex_lock(&preparser->lock);
+    /* A helper thread may still finish a compilation below and ask for a
+     * pump; that idle would outlive us */
+    preparser->disposing = true;
+    if (preparser->pump_source != NULL) {
+        g_source_destroy(preparser->pump_source);
+        g_clear_pointer(&preparser->pump_source, g_source_unref);
+    }
+    g_mutex_unlock(&preparser->lock);
+
+    /* Scripts compiled off the main thread belong to a temporary
+     * compartment until they are finished, so we cannot just forget them.
+     * gjs_context_dispose() finishes any incremental collection first, so
+     * none is in progress that the helper threads could be waiting for. */
+    g_assert(!JS::IsIncrementalGCInProgress(preparser->runtime));
+    g_hash_table_iter_init(&iter, preparser->entries);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &entry)) {
+        g_mutex_lock(&preparser->lock);
+        while (entry->state == ENTRY_COMPILING ||
+               (entry->state == ENTRY_ABANDONED && entry->token == NULL))
+            g_cond_wait(&preparser->cond, &preparser->lock);
+        g_mutex_unlock(&preparser->lock);
+
+        if (entry->token != NULL)
+            JS::FinishOffThreadScript(NULL, preparser->runtime, entry->token);
+    }
+
+    g_hash_table_destroy(preparser->entries);
+    g_main_context_unref(preparser->main_context);
+    g_queue_clear(&preparser->to_compile);
+    g_cond_clear(&preparser->cond);
+    g_mutex_clear(&preparser->lock);
+    g_slice_free(GjsPreparser, preparser);
+}
+
+/**
+ * gjs_preparser_add:
+ * @preparser: a #GjsPreparser
+ * @path: a JS module file that is likely to be imported
+ *
+ * Starts loading @path in the background. Paths that are not local files
+ * are ignored.
+ */
+void
+gjs_preparser_add(GjsPreparser *preparser,
+                  const char   *path)
+{
+    GFile *file;
+    char *canonical_path;
+    Entry *entry;
+
+    /* Imported files are looked up by the path GIO gives for them */
+    file = g_file_new_for_commandline_arg(path);
+    canonical_path = g_file_get_path(file);
+    g_object_unref(file);
+    if (canonical_path == NULL)
+        return;
+
+    g_mutex_lock(&preparser->lock);
+    if (g_hash_table_contains(preparser->entries, canonical_path)) {
+        g_mutex_unlock(&preparser->lock);
+        g_free(canonical_path);
+        return;
+    }
+
+    entry = g_slice_new0(Entry);
+    entry->preparser = preparser;
+    entry->path = canonical_path;
+    entry->state = ENTRY_QUEUED;
+    g_hash_table_insert(preparser->entries, entry->path, entry);
+    g_mutex_unlock(&preparser->lock);
+
+    g_thread_pool_push(preparser->pool, entry, NULL);
+}
+
+/**
+ * gjs_preparser_add_manifest:
+ * @preparser: a #GjsPreparser
+ * @manifest: a file listing module files, one per line
+ * @error: return location for a #GError
+ *
+ * Calls gjs_preparser_add() for every file listed in @manifest. Relative
+ * paths are resolved against the directory of @manifest; empty lines and
+ * lines starting with '#' are ignored.
+ *
+ * Returns: false if @manifest could not be read
+ */
+bool
+gjs_preparser_add_manifest(GjsPreparser *preparser,
+                           const char   *manifest,
+                           GError      **error)
+{
+    char *contents, *dir;
+    char **lines;
+    int i;
+
+    if (!g_file_get_contents(manifest, &contents, NULL, error))
+        return false;
+
+    dir = g_path_get_dirname(manifest);
+    lines = g_strsplit(contents, "\n", -1);
+
+    for (i = 0; lines[i] != NULL; i++) {
+        char *line = g_strstrip(lines[i]);
+        char *path;
+
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        path = g_path_is_absolute(line) ? g_strdup(line) :
+            g_build_filename(dir, line, NULL);
+        gjs_preparser_add(preparser, path);
+        g_free(path);
+    }
+
+    g_strfreev(lines);
+    g_free(dir);
+    g_free(contents);
+    return true;
+}
+
+static void
+init_compile_options(GjsPreparser       *preparser,
+                     Entry              *entry,
+                     JS::CompileOptions& options)
+{
+    /* Like gjs_eval_with_scope(), modules are run against their own
+     * module object rather than the global */
+    options.setFileAndLine(entry->path, entry->start_line_number)
+           .setSourceIsLazy(true)
+           .setCompileAndGo(false);
+
+    if (preparser->use_bytecode_cache)
+        gjs_bytecode_cache_set_compile_options(options);
+}
+
+/* Called on a SpiderMonkey helper thread */
+static void
+on_compiled_off_thread(void *token,
+                       void *data)
+{
+    Entry *entry = (Entry *) data;
+    GjsPreparser *preparser = entry->preparser;
+
+    g_mutex_lock(&preparser->lock);
+    entry->token = token;
+    if (entry->state == ENTRY_ABANDONED)
+        schedule_pump(preparser);
+    else
+        entry->state = ENTRY_COMPILED;
+    g_cond_broadcast(&preparser->cond);
+    g_mutex_unlock(&preparser->lock);
+}
+
+static bool
+compile_off_thread(GjsPreparser    *preparser,
+                   JSContext       *context,
+                   JS::HandleObject global,
+                   Entry           *entry)
+{
+    JS::CompileOptions options(context);
+    init_compile_options(preparser, entry, options);
+
+    if (!JS::CanCompileOffThread(context, options, entry->n_chars))
+        return false;
+
+    /* Our lock must not be held here; SpiderMonkey calls back into us
+     * with its own lock held */
+    if (!JS::CompileOffThread(context, global, options,
+                              (const jschar *) entry->chars, entry->n_chars,
+                              on_compiled_off_thread, entry)) {
+        JS_ClearPendingException(context);
+        return false;
+    }
+
+    return true;
+}
+
+/* Drops the helper thread results of modules that were compiled again on
+ * the main thread */
+static void
+finish_abandoned(GjsPreparser *preparser)
+{
+    GHashTableIter iter;
+    Entry *entry;
+    GSList *finished = NULL, *l;
+
+    g_mutex_lock(&preparser->lock);
+    if (preparser->n_abandoned > 0) {
+        g_hash_table_iter_init(&iter, preparser->entries);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &entry)) {
+            if (entry->state != ENTRY_ABANDONED || entry->token == NULL)
+                continue;
+
+            entry->state = ENTRY_TAKEN;
+            preparser->n_abandoned--;
+            finished = g_slist_prepend(finished, entry);
+        }
+    }
+    g_mutex_unlock(&preparser->lock);
+
+    for (l = finished; l; l = l->next) {
+        entry = (Entry *) l->data;
+        JS::FinishOffThreadScript(NULL, preparser->runtime, entry->token);
+        entry->token = NULL;
+        entry_clear(entry);
+    }
+    g_slist_free(finished);
+}
+
+/**
+ * gjs_preparser_pump:
+ * @preparser: a #GjsPreparser
+ * @context: the #JSContext, in the compartment modules are imported into
+ *
+ * Hands the modules that the workers have finished reading to
+ * SpiderMonkey's helper threads for compiling. This has to happen on the
+ * main thread, so we do it from an idle source that the workers add, and
+ * whenever the main thread imports something.
+ */
+void
+gjs_preparser_pump(GjsPreparser *preparser,
+                   JSContext    *context)
+{
+    JS::RootedObject global(context, JS::CurrentGlobalOrNull(context));
+    Entry *entry;
+
+    if (global == NULL)
+        return;
+
+    finish_abandoned(preparser);
+
+    while (true) {
+        g_mutex_lock(&preparser->lock);
+        entry = (Entry *) g_queue_pop_head(&preparser->to_compile);
+        if (entry != NULL)
+            entry->state = ENTRY_COMPILING;
+        g_mutex_unlock(&preparser->lock);
+
+        if (entry == NULL)
+            break;
+
+        if (!compile_off_thread(preparser, context, global, entry)) {
+            /* Too small to be worth it, or helper threads are not
+             * available; it gets compiled when it is imported */
+            g_mutex_lock(&preparser->lock);
+            entry->state = ENTRY_SOURCE;
+            g_cond_broadcast(&preparser->cond);
+            g_mutex_unlock(&preparser->lock);
+        }
+    }
+}
+
+/**
+ * gjs_preparser_take_script:
+ * @preparser: a #GjsPreparser
+ * @context: the #JSContext
+ * @path: the path of the module file being imported
+ * @script: return location for the compiled module
+ *
+ * Waits for @path to be read if it was added to @preparser, and returns
+ * the compiled script. Each path can be taken only once.
+ *
+ * Returns: false if @path was not preloaded, or failed to compile, in
+ * which case the caller should load it itself
+ */
+bool
+gjs_preparser_take_script(GjsPreparser           *preparser,
+                          JSContext              *context,
+                          const char             *path,
+                          JS::MutableHandleScript script)
+{
+    Entry *entry;
+    EntryState state;
+    gint64 start = g_get_monotonic_time();
+
+    g_mutex_lock(&preparser->lock);
+    entry = (Entry *) g_hash_table_lookup(preparser->entries, path);
+    if (entry == NULL || entry->claimed) {
+        g_mutex_unlock(&preparser->lock);
+        return false;
+    }
+
+    entry->claimed = true;
+    while (entry->state == ENTRY_READING)
+        g_cond_wait(&preparser->cond, &preparser->lock);
+
+    /* A helper thread stops at allocations while a collection of the
+     * atoms zone is in progress, and that collection could only go on
+     * once we return; no collection can start while we wait, though.
+     * Otherwise, or if the helper thread takes too long, we compile the
+     * module again ourselves and drop the other result later. */
+    if (entry->state == ENTRY_COMPILING &&
+        !JS::IsIncrementalGCInProgress(preparser->runtime)) {
+        gint64 deadline = g_get_monotonic_time() + MAX_COMPILE_WAIT_US;
+
+        while (entry->state == ENTRY_COMPILING &&
+               g_cond_wait_until(&preparser->cond, &preparser->lock, deadline))
+            ;
+    }
+
+    state = entry->state;
+    if (state == ENTRY_SOURCE)
+        g_queue_remove(&preparser->to_compile, entry);
+    if (state == ENTRY_COMPILING) {
+        entry->state = ENTRY_ABANDONED;
+        preparser->n_abandoned++;
+    } else {
+        entry->state = ENTRY_TAKEN;
+    }
+    g_mutex_unlock(&preparser->lock);
+
+    switch (state) {
+    case ENTRY_COMPILED:
+        script.set(JS::FinishOffThreadScript(context, preparser->runtime,
+                                             entry->token));
+        entry->token = NULL;
+        break;
+    case ENTRY_ENCODED:
+        script.set(gjs_bytecode_cache_decode(context, entry->payload));
+        break;
+    case ENTRY_COMPILING:
+    case ENTRY_SOURCE: {
+        /* The helper thread may still be reading entry->chars, but
+         * nobody writes to them */
+        JS::CompileOptions options(context);
+        init_compile_options(preparser, entry, options);
+
+        JS::RootedObject global(context, JS::CurrentGlobalOrNull(context));
+        script.set(JS::Compile(context, global, options,
+                               (const jschar *) entry->chars,
+                               entry->n_chars));
+        break;
+    }
+    default:
+        /* Not read yet, or could not be read */
+        break;
+    }
+
+    if (state != ENTRY_COMPILING)
+        entry_clear(entry);
+
+    if (script == NULL) {
+        /* Loading it the usual way reports the error properly */
+        JS_ClearPendingException(context);
+        return false;
+    }
+
+    if (preparser->use_bytecode_cache && state != ENTRY_ENCODED)
+        gjs_bytecode_cache_store(context, path, &entry->st, script);
+
+    GJS_INC_STAT_COUNTER(preparsed_script_used);
+    gjs_debug(GJS_DEBUG_IMPORTER,
+              "Took preloaded module %s after %" G_GINT64_FORMAT " us",
+              path, g_get_monotonic_time() - start);
+    return true;
+}
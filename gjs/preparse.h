@@ -0,0 +1,57 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef __GJS_PREPARSE_H__
+#define __GJS_PREPARSE_H__
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GjsPreparser GjsPreparser;
+
+GjsPreparser *gjs_preparser_new (JSContext    *context,
+                                 bool          use_bytecode_cache);
+void          gjs_preparser_free(GjsPreparser *preparser);
+
+void gjs_preparser_add         (GjsPreparser *preparser,
+                                const char   *path);
+bool gjs_preparser_add_manifest(GjsPreparser *preparser,
+                                const char   *manifest,
+                                GError      **error);
+
+void gjs_preparser_pump(GjsPreparser *preparser,
+                        JSContext    *context);
+
+bool gjs_preparser_take_script(GjsPreparser             *preparser,
+                               JSContext                *context,
+                               const char               *path,
+                               JS::MutableHandleScript   script);
+
+G_END_DECLS
+
+#endif  /* __GJS_PREPARSE_H__ */
@@ -30,8 +30,15 @@
 struct RuntimeData {
   unsigned refcount;
   bool in_gc_sweep;
+  GjsStringIdCache *string_id_cache;
+  GSList *gc_callbacks;
 };
 
+typedef struct {
+    GjsGcCallback callback;
+    void *data;
+} GcCallback;
+
 bool
 gjs_runtime_is_sweeping (JSRuntime *runtime)
 {
@@ -40,6 +47,51 @@ gjs_runtime_is_sweeping (JSRuntime *runtime)
   return data->in_gc_sweep;
 }
 
+GjsStringIdCache *
+gjs_runtime_get_string_id_cache(JSRuntime *runtime)
+{
+    RuntimeData *data = (RuntimeData *) JS_GetRuntimePrivate(runtime);
+
+    return data->string_id_cache;
+}
+
+/* SpiderMonkey only has room for one GC callback per runtime, so we keep
+ * our own list and dispatch from gjs_gc_callback() */
+void
+gjs_runtime_add_gc_callback(JSRuntime    *runtime,
+                            GjsGcCallback callback,
+                            void         *data)
+{
+    RuntimeData *rtdata = (RuntimeData *) JS_GetRuntimePrivate(runtime);
+    GcCallback *cb = g_slice_new(GcCallback);
+
+    cb->callback = callback;
+    cb->data = data;
+    rtdata->gc_callbacks = g_slist_append(rtdata->gc_callbacks, cb);
+}
+
+void
+gjs_runtime_remove_gc_callback(JSRuntime    *runtime,
+                               GjsGcCallback callback,
+                               void         *data)
+{
+    RuntimeData *rtdata = (RuntimeData *) JS_GetRuntimePrivate(runtime);
+    GSList *iter;
+
+    for (iter = rtdata->gc_callbacks; iter; iter = iter->next) {
+        GcCallback *cb = (GcCallback *) iter->data;
+
+        if (cb->callback == callback && cb->data == data) {
+            rtdata->gc_callbacks = g_slist_delete_link(rtdata->gc_callbacks,
+                                                       iter);
+            g_slice_free(GcCallback, cb);
+            return;
+        }
+    }
+
+    g_assert_not_reached();
+}
+
 /* Implementations of locale-specific operations; these are used
  * in the implementation of String.localeCompare(), Date.toLocaleDateString(),
  * and so forth. We take the straight-forward approach of converting
@@ -152,7 +204,9 @@ destroy_runtime(gpointer data)
     JSRuntime *runtime = (JSRuntime *) data;
     RuntimeData *rtdata = (RuntimeData *) JS_GetRuntimePrivate(runtime);
 
+    gjs_string_id_cache_free(rtdata->string_id_cache);
     JS_DestroyRuntime(runtime);
+    g_assert(rtdata->gc_callbacks == NULL);
     g_free(rtdata);
 }
 
@@ -223,6 +277,25 @@ gjs_finalize_callback(JSFreeOp         *fop,
     data->in_gc_sweep = false;
 }
 
+/* Called when a collection begins and when it ends, however it was
+ * started: by us, by JS_MaybeGC(), or by the engine itself. For an
+ * incremental collection that is before the first slice and after the
+ * last one. */
+static void
+gjs_gc_callback(JSRuntime *runtime,
+                JSGCStatus status,
+                void      *data)
+{
+    RuntimeData *rtdata = (RuntimeData *) data;
+    GSList *iter;
+
+    for (iter = rtdata->gc_callbacks; iter; iter = iter->next) {
+        GcCallback *cb = (GcCallback *) iter->data;
+
+        cb->callback(runtime, status, cb->data);
+    }
+}
+
 /* Destroys the current thread's runtime regardless of refcount. No-op if there
  * is no runtime */
 static void
@@ -268,8 +341,16 @@ gjs_runtime_for_current_thread(void)
 
         JS_SetNativeStackQuota(runtime, 1024*1024);
         JS_SetGCParameter(runtime, JSGC_MAX_BYTES, 0xffffffff);
+        /* Lets the GC scheduler collect in bounded slices. Every JSClass
+         * we define sets JSCLASS_IMPLEMENTS_BARRIERS, but JS::Heap has no
+         * barriers of its own in this SpiderMonkey: weak wrapper lookups
+         * go through JS::ExposeObjectToActiveJS(), and C code that drops
+         * a traced pointer calls gjs_heap_object_pre_barrier() first */
+        JS_SetGCParameter(runtime, JSGC_MODE, JSGC_MODE_INCREMENTAL);
         JS_SetLocaleCallbacks(runtime, &gjs_locale_callbacks);
         JS_SetFinalizeCallback(runtime, gjs_finalize_callback);
+        JS_SetGCCallback(runtime, gjs_gc_callback, data);
+        data->string_id_cache = gjs_string_id_cache_new(runtime);
 
         g_private_set(&thread_runtime, runtime);
     }
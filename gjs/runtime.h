@@ -26,9 +26,26 @@
 
 #include <stdbool.h>
 
+#include "gjs/jsapi-wrapper.h"
+
+typedef struct GjsStringIdCache GjsStringIdCache;
+
 JSRuntime *gjs_runtime_ref(void);
 void gjs_runtime_unref(void);
 
 bool        gjs_runtime_is_sweeping        (JSRuntime *runtime);
 
+GjsStringIdCache *gjs_runtime_get_string_id_cache(JSRuntime *runtime);
+
+typedef void (*GjsGcCallback) (JSRuntime *runtime,
+                               JSGCStatus status,
+                               void      *data);
+
+void gjs_runtime_add_gc_callback   (JSRuntime    *runtime,
+                                    GjsGcCallback callback,
+                                    void         *data);
+void gjs_runtime_remove_gc_callback(JSRuntime    *runtime,
+                                    GjsGcCallback callback,
+                                    void         *data);
+
 #endif /* __GJS_RUNTIME_H__ */
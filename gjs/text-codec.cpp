@@ -0,0 +1,939 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Conversion between ByteArrays and JS strings, for byteArray.TextDecoder,
+ * byteArray.TextEncoder, and ByteArray's toString() and fromString().
+ *
+ * Called with {stream: true}, the decoder and encoder hold back a
+ * character that is split between two chunks until the next call, so data
+ * can be converted as it arrives instead of being collected first. UTF-8
+ * and Latin-1 are converted by hand, straight between the ByteArray and
+ * the characters of the string; other encodings go through iconv.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "text-codec.h"
+#include "byteArray.h"
+#include "jsapi-util.h"
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define UTF16_HOST "UTF-16LE"
+#else
+#define UTF16_HOST "UTF-16BE"
+#endif
+
+/* Longest incomplete sequence kept between two chunks */
+#define TEXT_CODEC_MAX_PENDING 16
+
+#define IS_HIGH_SURROGATE(c) ((c) >= 0xd800 && (c) < 0xdc00)
+#define IS_LOW_SURROGATE(c) ((c) >= 0xdc00 && (c) < 0xe000)
+
+typedef enum {
+    TEXT_CODEC_UTF8,
+    TEXT_CODEC_LATIN1,
+    TEXT_CODEC_ICONV
+} TextCodecKind;
+
+typedef struct {
+    char          *encoding;
+    TextCodecKind  kind;
+    GIConv         iconv;    /* only for TEXT_CODEC_ICONV */
+    /* the start of a character that was split at the end of the last
+     * chunk; bytes when decoding, UTF-16 when encoding */
+    guint8         pending[TEXT_CODEC_MAX_PENDING];
+    gsize          n_pending;
+} TextCodec;
+
+static const char * const utf8_names[] = {
+    "UTF-8", "UTF8", NULL
+};
+
+static const char * const latin1_names[] = {
+    "ISO-8859-1", "ISO8859-1", "ISO_8859-1", "LATIN1", "LATIN-1", NULL
+};
+
+static bool
+name_in_list(const char         *encoding,
+             const char * const *names)
+{
+    for (; *names != NULL; names++) {
+        if (g_ascii_strcasecmp(encoding, *names) == 0)
+            return true;
+    }
+    return false;
+}
+
+static bool
+text_codec_init(JSContext  *context,
+                TextCodec  *codec,
+                const char *encoding,
+                bool        decoding)
+{
+    memset(codec, 0, sizeof(*codec));
+    codec->iconv = (GIConv) -1;
+
+    if (name_in_list(encoding, utf8_names)) {
+        codec->kind = TEXT_CODEC_UTF8;
+    } else if (name_in_list(encoding, latin1_names)) {
+        codec->kind = TEXT_CODEC_LATIN1;
+    } else {
+        codec->kind = TEXT_CODEC_ICONV;
+        if (decoding)
+            codec->iconv = g_iconv_open(UTF16_HOST, encoding);
+        else
+            codec->iconv = g_iconv_open(encoding, UTF16_HOST);
+
+        if (codec->iconv == (GIConv) -1) {
+            gjs_throw(context, "Conversion between character set '%s' and "
+                      "JS strings is not supported", encoding);
+            return false;
+        }
+    }
+
+    codec->encoding = g_strdup(encoding);
+    return true;
+}
+
+static void
+text_codec_clear(TextCodec *codec)
+{
+    if (codec->iconv != (GIConv) -1)
+        g_iconv_close(codec->iconv);
+    codec->iconv = (GIConv) -1;
+    g_clear_pointer(&codec->encoding, g_free);
+}
+
+/* Forgets any partial character, so that the next call starts afresh */
+static void
+text_codec_reset(TextCodec *codec)
+{
+    codec->n_pending = 0;
+    if (codec->iconv != (GIConv) -1)
+        g_iconv(codec->iconv, NULL, NULL, NULL, NULL);
+}
+
+static void
+set_empty_string(JSContext             *context,
+                 JS::MutableHandleValue rval)
+{
+    rval.setString(JS_GetEmptyString(JS_GetRuntime(context)));
+}
+
+/* Only called for bytes that start a sequence of more than one byte */
+static gsize
+utf8_sequence_length(guint8 lead)
+{
+    return lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+}
+
+/* Number of bytes at the end of @data that start a UTF-8 sequence which
+ * continues past it */
+static gsize
+utf8_incomplete_tail(const guint8 *data,
+                     gsize         len)
+{
+    gsize k;
+
+    for (k = 1; k <= MIN(len, 3); k++) {
+        guint8 c = data[len - k];
+
+        if ((c & 0xc0) == 0x80)
+            continue;  /* continuation byte */
+        if (c >= 0xc2 && c < 0xf5 && utf8_sequence_length(c) > k)
+            return k;
+        return 0;
+    }
+    return 0;
+}
+
+static bool
+decode_utf8(JSContext             *context,
+            TextCodec             *codec,
+            const guint8          *data,
+            gsize                  len,
+            bool                   stream,
+            JS::MutableHandleValue rval)
+{
+    JS::RootedValue head(context);
+    gsize tail;
+
+    if (codec->n_pending > 0) {
+        /* finish the character left over from the last chunk */
+        gsize need = utf8_sequence_length(codec->pending[0]) -
+            codec->n_pending;
+        gsize take = MIN(need, len);
+        gsize n;
+
+        memcpy(codec->pending + codec->n_pending, data, take);
+        codec->n_pending += take;
+        data += take;
+        len -= take;
+
+        if (take < need && stream) {
+            set_empty_string(context, rval);
+            return true;
+        }
+
+        n = codec->n_pending;
+        codec->n_pending = 0;
+        if (!gjs_string_from_utf8_n(context, (const char *) codec->pending, n,
+                                    &head))
+            return false;
+    }
+
+    tail = stream ? utf8_incomplete_tail(data, len) : 0;
+
+    /* ByteArray data is not moved by the GC, so it is still valid here */
+    if (!gjs_string_from_utf8_n(context, (const char *) data, len - tail, rval))
+        return false;
+
+    memcpy(codec->pending, data + len - tail, tail);
+    codec->n_pending = tail;
+
+    if (head.isUndefined())
+        return true;
+
+    JS::RootedString left(context, head.toString());
+    JS::RootedString right(context, rval.toString());
+    JSString *str = JS_ConcatStrings(context, left, right);
+    if (str == NULL)
+        return false;
+
+    rval.setString(str);
+    return true;
+}
+
+static bool
+decode_latin1(JSContext             *context,
+              const guint8          *data,
+              gsize                  len,
+              JS::MutableHandleValue rval)
+{
+    /* SpiderMonkey widens each byte to a character itself, which is
+     * exactly Latin-1 */
+    JSString *str = JS_NewStringCopyN(context, (const char *) data, len);
+
+    if (str == NULL)
+        return false;
+
+    rval.setString(str);
+    return true;
+}
+
+static bool
+decode_iconv(JSContext             *context,
+             TextCodec             *codec,
+             const guint8          *data,
+             gsize                  len,
+             bool                   stream,
+             JS::MutableHandleValue rval)
+{
+    guint8 *joined = NULL;
+    char16_t *out;
+    char *inbuf;
+    gsize inleft, cap, used = 0;
+    JSString *str;
+
+    if (codec->n_pending > 0) {
+        joined = (guint8 *) g_malloc(codec->n_pending + len);
+        memcpy(joined, codec->pending, codec->n_pending);
+        memcpy(joined + codec->n_pending, data, len);
+        data = joined;
+        len += codec->n_pending;
+        codec->n_pending = 0;
+    }
+
+    inbuf = (char *) data;
+    inleft = len;
+
+    /* one character per byte is enough for most encodings, and the
+     * buffer grows for the others */
+    cap = MAX(len, 16);
+    out = g_new(char16_t, cap + 1);
+
+    while (true) {
+        char *outbuf = (char *) (out + used);
+        gsize outleft = (cap - used) * sizeof(char16_t);
+        gsize ret = g_iconv(codec->iconv, &inbuf, &inleft, &outbuf, &outleft);
+
+        used = (char16_t *) outbuf - out;
+
+        /* EINVAL means only an incomplete sequence is left */
+        if (ret != (gsize) -1 || errno == EINVAL)
+            break;
+
+        if (errno == E2BIG) {
+            cap *= 2;
+            out = g_renew(char16_t, out, cap + 1);
+            continue;
+        }
+
+        gjs_throw(context, "Invalid byte sequence in conversion input");
+        goto fail;
+    }
+
+    if (inleft > 0) {
+        if (!stream || inleft > TEXT_CODEC_MAX_PENDING) {
+            gjs_throw(context, "Partial character sequence at end of input");
+            goto fail;
+        }
+        memcpy(codec->pending, inbuf, inleft);
+        codec->n_pending = inleft;
+    }
+
+    if (!stream)
+        text_codec_reset(codec);
+    g_free(joined);
+
+    if (used == 0) {
+        g_free(out);
+        set_empty_string(context, rval);
+        return true;
+    }
+
+    out[used] = 0;
+    if (used < cap / 2)
+        out = g_renew(char16_t, out, used + 1);
+
+    /* Avoid a copy - assumes that g_malloc == js_malloc == malloc */
+    str = JS_NewUCString(context, out, used);
+    if (str == NULL) {
+        g_free(out);
+        return false;
+    }
+
+    rval.setString(str);
+    return true;
+
+ fail:
+    g_free(out);
+    g_free(joined);
+    return false;
+}
+
+static bool
+text_codec_decode(JSContext             *context,
+                  TextCodec             *codec,
+                  const guint8          *data,
+                  gsize                  len,
+                  bool                   stream,
+                  JS::MutableHandleValue rval)
+{
+    bool ok = false;
+
+    if (data == NULL)
+        data = (const guint8 *) "";  /* an empty ByteArray may have none */
+
+    switch (codec->kind) {
+    case TEXT_CODEC_UTF8:
+        ok = decode_utf8(context, codec, data, len, stream, rval);
+        break;
+    case TEXT_CODEC_LATIN1:
+        ok = decode_latin1(context, data, len, rval);
+        break;
+    case TEXT_CODEC_ICONV:
+        ok = decode_iconv(context, codec, data, len, stream, rval);
+        break;
+    }
+
+    if (!ok)
+        text_codec_reset(codec);
+    return ok;
+}
+
+/* The characters of a string stay where they are while it is alive, so
+ * the encoders below may allocate while reading them. */
+
+static bool
+encode_utf8(JSContext       *context,
+            TextCodec       *codec,
+            JS::HandleString str,
+            bool             stream,
+            JS::HandleObject array)
+{
+    const char16_t *chars;
+    size_t len;
+    char16_t head[2];
+    gsize head_len = 0, skip = 0, tail = 0, n_head, n;
+    guint8 *out;
+
+    chars = JS_GetStringCharsAndLength(context, str, &len);
+    if (chars == NULL)
+        return false;
+
+    if (codec->n_pending > 0) {
+        if (len == 0 && stream)
+            return true;
+
+        /* a high surrogate, which may be completed by this chunk */
+        memcpy(&head[0], codec->pending, sizeof(char16_t));
+        head_len = 1;
+        if (len > 0 && IS_LOW_SURROGATE(chars[0])) {
+            head[1] = chars[0];
+            head_len = 2;
+            skip = 1;
+        }
+        codec->n_pending = 0;
+    }
+
+    if (stream && len > skip && IS_HIGH_SURROGATE(chars[len - 1]))
+        tail = 1;
+
+    n_head = gjs_utf16_to_utf8_length(head, head_len);
+    n = n_head + gjs_utf16_to_utf8_length(chars + skip, len - skip - tail);
+
+    /* gjs_utf16_to_utf8() also writes a terminator */
+    out = gjs_byte_array_begin_write(context, array, n + 1);
+    if (out == NULL)
+        return false;
+
+    gjs_utf16_to_utf8(head, head_len, (char *) out);
+    gjs_utf16_to_utf8(chars + skip, len - skip - tail, (char *) out + n_head);
+    gjs_byte_array_end_write(context, array, n);
+
+    if (tail > 0) {
+        memcpy(codec->pending, &chars[len - 1], sizeof(char16_t));
+        codec->n_pending = sizeof(char16_t);
+    }
+    return true;
+}
+
+static bool
+encode_latin1(JSContext       *context,
+              TextCodec       *codec,
+              JS::HandleString str,
+              JS::HandleObject array)
+{
+    const char16_t *chars;
+    size_t len, i;
+    guint8 *out;
+
+    chars = JS_GetStringCharsAndLength(context, str, &len);
+    if (chars == NULL)
+        return false;
+
+    out = gjs_byte_array_begin_write(context, array, len);
+    if (out == NULL)
+        return false;
+
+    for (i = 0; i < len; i++) {
+        if (chars[i] > 0xff) {
+            gjs_throw(context, "Character U+%04X at offset %" G_GSIZE_FORMAT
+                      " cannot be represented in %s", (unsigned) chars[i],
+                      i, codec->encoding);
+            return false;
+        }
+        out[i] = chars[i];
+    }
+
+    gjs_byte_array_end_write(context, array, len);
+    return true;
+}
+
+static bool
+encode_iconv(JSContext       *context,
+             TextCodec       *codec,
+             JS::HandleString str,
+             bool             stream,
+             JS::HandleObject array)
+{
+    const char16_t *chars;
+    size_t len;
+    char16_t *joined = NULL;
+    char *inbuf;
+    gsize inleft, cap, used = 0;
+    bool flushing = false;
+    guint8 *out;
+
+    chars = JS_GetStringCharsAndLength(context, str, &len);
+    if (chars == NULL)
+        return false;
+
+    if (codec->n_pending > 0) {
+        gsize n_units = codec->n_pending / sizeof(char16_t);
+
+        joined = g_new(char16_t, n_units + len);
+        memcpy(joined, codec->pending, codec->n_pending);
+        memcpy(joined + n_units, chars, len * sizeof(char16_t));
+        inbuf = (char *) joined;
+        inleft = (n_units + len) * sizeof(char16_t);
+        codec->n_pending = 0;
+    } else {
+        inbuf = (char *) chars;
+        inleft = len * sizeof(char16_t);
+    }
+
+    cap = MAX(len, 16);
+    out = gjs_byte_array_begin_write(context, array, cap);
+    if (out == NULL)
+        goto fail;
+
+    while (true) {
+        char *outbuf = (char *) out + used;
+        gsize outleft = cap - used;
+        gsize ret;
+
+        /* after the input, write whatever returns a stateful encoding to
+         * its initial state */
+        if (flushing)
+            ret = g_iconv(codec->iconv, NULL, NULL, &outbuf, &outleft);
+        else
+            ret = g_iconv(codec->iconv, &inbuf, &inleft, &outbuf, &outleft);
+        used = (guint8 *) outbuf - out;
+
+        if (ret == (gsize) -1 && errno == E2BIG) {
+            gjs_byte_array_end_write(context, array, used);
+            cap *= 2;
+            out = gjs_byte_array_begin_write(context, array, cap);
+            if (out == NULL)
+                goto fail;
+            continue;
+        }
+
+        if (ret == (gsize) -1 && errno != EINVAL) {
+            gjs_throw(context, "String cannot be represented in %s",
+                      codec->encoding);
+            goto fail;
+        }
+
+        if (flushing || stream)
+            break;
+
+        if (inleft > 0) {
+            gjs_throw(context, "Partial character sequence at end of input");
+            goto fail;
+        }
+        flushing = true;
+    }
+
+    if (inleft > 0) {
+        if (inleft > TEXT_CODEC_MAX_PENDING) {
+            gjs_throw(context, "Partial character sequence at end of input");
+            goto fail;
+        }
+        memcpy(codec->pending, inbuf, inleft);
+        codec->n_pending = inleft;
+    }
+
+    gjs_byte_array_end_write(context, array, used);
+    g_free(joined);
+    return true;
+
+ fail:
+    g_free(joined);
+    return false;
+}
+
+static bool
+text_codec_encode(JSContext       *context,
+                  TextCodec       *codec,
+                  JS::HandleString str,
+                  bool             stream,
+                  JS::HandleObject array)
+{
+    bool ok = false;
+
+    switch (codec->kind) {
+    case TEXT_CODEC_UTF8:
+        ok = encode_utf8(context, codec, str, stream, array);
+        break;
+    case TEXT_CODEC_LATIN1:
+        ok = encode_latin1(context, codec, str, array);
+        break;
+    case TEXT_CODEC_ICONV:
+        ok = encode_iconv(context, codec, str, stream, array);
+        break;
+    }
+
+    if (!ok)
+        text_codec_reset(codec);
+    return ok;
+}
+
+/**
+ * gjs_text_decode:
+ * @context: the #JSContext
+ * @encoding: name of the encoding of @data
+ * @data: data that is not moved by the GC, such as that of a ByteArray
+ * @len: length of @data in bytes
+ * @rval: (out): location for the string
+ *
+ * Converts all of @data to a JS string, throwing if it ends in the middle
+ * of a character.
+ *
+ * Returns: false with an exception pending if @data could not be converted
+ */
+bool
+gjs_text_decode(JSContext             *context,
+                const char            *encoding,
+                const guint8          *data,
+                gsize                  len,
+                JS::MutableHandleValue rval)
+{
+    TextCodec codec;
+    bool ok;
+
+    if (!text_codec_init(context, &codec, encoding, true))
+        return false;
+
+    ok = text_codec_decode(context, &codec, data, len, false, rval);
+    text_codec_clear(&codec);
+    return ok;
+}
+
+/**
+ * gjs_text_encode:
+ * @context: the #JSContext
+ * @encoding: name of the encoding to convert to
+ * @str: the string to convert
+ * @byte_array: an empty ByteArray to write the result to
+ *
+ * Returns: false with an exception pending if @str could not be converted
+ */
+bool
+gjs_text_encode(JSContext       *context,
+                const char      *encoding,
+                JS::HandleString str,
+                JS::HandleObject byte_array)
+{
+    TextCodec codec;
+    bool ok;
+
+    if (!text_codec_init(context, &codec, encoding, false))
+        return false;
+
+    ok = text_codec_encode(context, &codec, str, false, byte_array);
+    text_codec_clear(&codec);
+    return ok;
+}
+
+static bool
+get_stream_option(JSContext    *context,
+                  JS::CallArgs& argv,
+                  unsigned      index,
+                  bool         *stream_p)
+{
+    JS::RootedValue value(context);
+
+    *stream_p = false;
+    if (argv.length() <= index || !argv[index].isObject())
+        return true;
+
+    JS::RootedObject options(context, &argv[index].toObject());
+    if (!JS_GetProperty(context, options, "stream", &value))
+        return false;
+
+    *stream_p = JS::ToBoolean(value);
+    return true;
+}
+
+static bool
+get_encoding_arg(JSContext    *context,
+                 JS::CallArgs& argv,
+                 char        **encoding_p)
+{
+    if (argv.length() < 1 || argv[0].isUndefined()) {
+        *encoding_p = g_strdup("UTF-8");
+        return true;
+    }
+
+    if (!argv[0].isString()) {
+        gjs_throw(context, "Encoding should be a string");
+        return false;
+    }
+    return gjs_string_to_utf8(context, argv[0], encoding_p);
+}
+
+/* TextDecoder and TextEncoder both keep a TextCodec as their private
+ * data */
+static TextCodec *
+text_codec_from_this(JSContext     *context,
+                     JS::CallArgs&  argv,
+                     JSClass       *klass,
+                     bool          *ok_p)
+{
+    JS::RootedObject to(context, &argv.computeThis(context).toObject());
+
+    *ok_p = gjs_typecheck_instance(context, to, klass, true);
+    if (!*ok_p)
+        return NULL;
+
+    /* NULL for the prototype */
+    return (TextCodec *) JS_GetInstancePrivate(context, to, klass, NULL);
+}
+
+static void
+text_codec_finalize(JSFreeOp *fop,
+                    JSObject *obj)
+{
+    TextCodec *codec = (TextCodec *) JS_GetPrivate(obj);
+
+    if (codec == NULL)
+        return; /* prototype, not instance */
+
+    text_codec_clear(codec);
+    g_slice_free(TextCodec, codec);
+}
+
+static bool
+text_codec_construct(JSContext     *context,
+                     JS::CallArgs&  argv,
+                     JSClass       *klass,
+                     bool           decoding)
+{
+    char *encoding;
+    TextCodec *codec;
+    bool ok;
+
+    if (!argv.isConstructing()) {
+        gjs_throw_constructor_error(context);
+        return false;
+    }
+
+    JS::RootedObject object(context,
+        JS_NewObjectForConstructor(context, klass, argv));
+    if (object == NULL)
+        return false;
+
+    if (!get_encoding_arg(context, argv, &encoding))
+        return false;
+
+    codec = g_slice_new0(TextCodec);
+    ok = text_codec_init(context, codec, encoding, decoding);
+    g_free(encoding);
+    if (!ok) {
+        g_slice_free(TextCodec, codec);
+        return false;
+    }
+
+    JS_SetPrivate(object, codec);
+    argv.rval().setObject(*object);
+    return true;
+}
+
+static bool
+text_codec_encoding_getter(JSContext     *context,
+                           JS::CallArgs&  argv,
+                           JSClass       *klass)
+{
+    bool ok;
+    TextCodec *codec = text_codec_from_this(context, argv, klass, &ok);
+
+    if (codec == NULL)
+        return ok; /* prototype, not instance */
+
+    return gjs_string_from_utf8(context, codec->encoding, -1, argv.rval());
+}
+
+static struct JSClass gjs_text_decoder_class = {
+    "TextDecoder",
+    JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
+    JSCLASS_BACKGROUND_FINALIZE,
+    JS_PropertyStub,
+    JS_DeletePropertyStub,
+    JS_PropertyStub,
+    JS_StrictPropertyStub,
+    JS_EnumerateStub,
+    JS_ResolveStub,
+    JS_ConvertStub,
+    text_codec_finalize
+};
+
+static struct JSClass gjs_text_encoder_class = {
+    "TextEncoder",
+    JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS |
+    JSCLASS_BACKGROUND_FINALIZE,
+    JS_PropertyStub,
+    JS_DeletePropertyStub,
+    JS_PropertyStub,
+    JS_StrictPropertyStub,
+    JS_EnumerateStub,
+    JS_ResolveStub,
+    JS_ConvertStub,
+    text_codec_finalize
+};
+
+/* new TextDecoder(encoding = 'UTF-8') */
+GJS_NATIVE_CONSTRUCTOR_DECLARE(text_decoder)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+
+    return text_codec_construct(context, argv, &gjs_text_decoder_class, true);
+}
+
+static bool
+text_decoder_encoding_getter(JSContext *context,
+                             unsigned   argc,
+                             JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+
+    return text_codec_encoding_getter(context, argv, &gjs_text_decoder_class);
+}
+
+/* decode(bytes, {stream: false}); the ByteArray may be left out to finish
+ * a stream */
+static bool
+text_decoder_decode_func(JSContext *context,
+                         unsigned   argc,
+                         JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    guint8 *data = NULL;
+    gsize len = 0;
+    bool stream, ok;
+    TextCodec *codec;
+
+    codec = text_codec_from_this(context, argv, &gjs_text_decoder_class, &ok);
+    if (codec == NULL)
+        return ok; /* prototype, not instance */
+
+    /* Reading the option can run JS, which could resize the ByteArray, so
+     * do it before taking the data pointer */
+    if (!get_stream_option(context, argv, 1, &stream))
+        return false;
+
+    if (argc > 0 && !argv[0].isUndefined()) {
+        JS::RootedObject bytes(context,
+                               argv[0].isObject() ? &argv[0].toObject() : NULL);
+
+        if (bytes == NULL || !gjs_typecheck_bytearray(context, bytes, false)) {
+            gjs_throw(context,
+                      "TextDecoder.decode() called with non-ByteArray");
+            return false;
+        }
+        gjs_byte_array_peek_data(context, bytes, &data, &len);
+    }
+
+    return text_codec_decode(context, codec, data, len, stream, argv.rval());
+}
+
+/* new TextEncoder(encoding = 'UTF-8') */
+GJS_NATIVE_CONSTRUCTOR_DECLARE(text_encoder)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+
+    return text_codec_construct(context, argv, &gjs_text_encoder_class, false);
+}
+
+static bool
+text_encoder_encoding_getter(JSContext *context,
+                             unsigned   argc,
+                             JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+
+    return text_codec_encoding_getter(context, argv, &gjs_text_encoder_class);
+}
+
+/* encode(string, {stream: false}) returns a new ByteArray */
+static bool
+text_encoder_encode_func(JSContext *context,
+                         unsigned   argc,
+                         JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    bool stream, ok;
+    TextCodec *codec;
+
+    codec = text_codec_from_this(context, argv, &gjs_text_encoder_class, &ok);
+    if (codec == NULL)
+        return ok; /* prototype, not instance */
+
+    JS::RootedString str(context, JS_GetEmptyString(JS_GetRuntime(context)));
+    if (argc > 0 && !argv[0].isUndefined()) {
+        if (!argv[0].isString()) {
+            gjs_throw(context, "TextEncoder.encode() called with non-string");
+            return false;
+        }
+        str = argv[0].toString();
+    }
+
+    if (!get_stream_option(context, argv, 1, &stream))
+        return false;
+
+    JS::RootedObject array(context, gjs_byte_array_new(context));
+    if (array == NULL)
+        return false;
+
+    if (!text_codec_encode(context, codec, str, stream, array))
+        return false;
+
+    argv.rval().setObject(*array);
+    return true;
+}
+
+static JSPropertySpec gjs_text_decoder_proto_props[] = {
+    JS_PSG("encoding", text_decoder_encoding_getter, JSPROP_PERMANENT),
+    JS_PS_END
+};
+
+static JSFunctionSpec gjs_text_decoder_proto_funcs[] = {
+    JS_FS("decode", text_decoder_decode_func, 0, 0),
+    JS_FS_END
+};
+
+static JSPropertySpec gjs_text_encoder_proto_props[] = {
+    JS_PSG("encoding", text_encoder_encoding_getter, JSPROP_PERMANENT),
+    JS_PS_END
+};
+
+static JSFunctionSpec gjs_text_encoder_proto_funcs[] = {
+    JS_FS("encode", text_encoder_encode_func, 0, 0),
+    JS_FS_END
+};
+
+bool
+gjs_define_text_codec_stuff(JSContext       *context,
+                            JS::HandleObject module)
+{
+    if (!JS_InitClass(context, module, JS::NullPtr(),
+                      &gjs_text_decoder_class,
+                      gjs_text_decoder_constructor,
+                      0,
+                      &gjs_text_decoder_proto_props[0],
+                      &gjs_text_decoder_proto_funcs[0],
+                      NULL,
+                      NULL))
+        return false;
+
+    if (!JS_InitClass(context, module, JS::NullPtr(),
+                      &gjs_text_encoder_class,
+                      gjs_text_encoder_constructor,
+                      0,
+                      &gjs_text_encoder_proto_props[0],
+                      &gjs_text_encoder_proto_funcs[0],
+                      NULL,
+                      NULL))
+        return false;
+
+    return true;
+}
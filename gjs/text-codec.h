@@ -0,0 +1,50 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __GJS_TEXT_CODEC_H__
+#define __GJS_TEXT_CODEC_H__
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+G_BEGIN_DECLS
+
+bool gjs_define_text_codec_stuff(JSContext       *context,
+                                 JS::HandleObject module);
+
+bool gjs_text_decode(JSContext             *context,
+                     const char            *encoding,
+                     const guint8          *data,
+                     gsize                  len,
+                     JS::MutableHandleValue rval);
+
+bool gjs_text_encode(JSContext       *context,
+                     const char      *encoding,
+                     JS::HandleString str,
+                     JS::HandleObject byte_array);
+
+G_END_DECLS
+
+#endif  /* __GJS_TEXT_CODEC_H__ */
@@ -110,4 +110,167 @@ describe('Byte array', function () {
         expect(s.length).toEqual(4);
         expect(s).toEqual('abcd');
     });
+
+    it('keeps embedded nuls when converted to a string', function () {
+        let a = ByteArray.fromArray([0x61, 0, 0x62]);
+        expect(a.toString()).toEqual('a\u0000b');
+    });
+
+    describe('Uint8Array view', function () {
+        let a, view;
+        beforeEach(function () {
+            a = ByteArray.fromArray([1, 2, 3, 4]);
+            view = a.asUint8Array();
+        });
+
+        it('has the same length and contents', function () {
+            expect(view instanceof Uint8Array).toBeTruthy();
+            expect(view.length).toEqual(4);
+            [1, 2, 3, 4].forEach((val, ix) => expect(view[ix]).toEqual(val));
+        });
+
+        it('shares memory with the byte array', function () {
+            view[0] = 42;
+            expect(a[0]).toEqual(42);
+            a[3] = 7;
+            expect(view[3]).toEqual(7);
+        });
+
+        it('is detached when the byte array grows', function () {
+            a.length = 1000;
+            expect(view.length).toEqual(0);
+            expect(a[0]).toEqual(1);
+            expect(a[999]).toEqual(0);
+        });
+
+        it('keeps its contents when converted to GBytes', function () {
+            let bytes = a.toGBytes();
+            view[0] = 42;
+            expect(bytes.get_data()[0]).toEqual(1);
+            expect(a[0]).toEqual(42);
+        });
+    });
+
+    it('can still be written to after converting to GBytes', function () {
+        let a = ByteArray.fromString('abcd');
+        let bytes = a.toGBytes();
+        a[0] = 120;
+        expect(a.toString()).toEqual('xbcd');
+        expect(bytes.get_size()).toEqual(4);
+        expect(bytes.get_data()[0]).toEqual(97);
+    });
+
+    it('can be created from GBytes without sharing writes', function () {
+        let bytes = ByteArray.fromString('abcd').toGBytes();
+        let a = ByteArray.fromGBytes(bytes);
+        expect(a.length).toEqual(4);
+        a[1] = 120;
+        expect(a.toString()).toEqual('axcd');
+        expect(bytes.get_data()[1]).toEqual(98);
+    });
+
+    it('throws for negative indices', function () {
+        let a = new ByteArray.ByteArray(2);
+        expect(() => a[-1]).toThrowError(/Negative/);
+        expect(() => (a[-1] = 5)).toThrowError(/Negative/);
+        expect(a.length).toEqual(2);
+    });
+
+    it('zeroes bytes exposed by growing again after shrinking', function () {
+        let a = ByteArray.fromArray([1, 2, 3, 4]);
+        a.length = 1;
+        a.length = 4;
+        [1, 0, 0, 0].forEach((val, ix) => expect(a[ix]).toEqual(val));
+    });
+});
+
+describe('Text decoder', function () {
+    it('reports its encoding', function () {
+        expect(new ByteArray.TextDecoder().encoding).toEqual('UTF-8');
+        expect(new ByteArray.TextDecoder('ISO-8859-1').encoding)
+            .toEqual('ISO-8859-1');
+    });
+
+    it('carries a UTF-8 sequence split between chunks', function () {
+        let decoder = new ByteArray.TextDecoder();
+        expect(decoder.decode(ByteArray.fromArray([0x61, 0xe2]),
+            {stream: true})).toEqual('a');
+        expect(decoder.decode(ByteArray.fromArray([0x82]), {stream: true}))
+            .toEqual('');
+        expect(decoder.decode(ByteArray.fromArray([0xac, 0x62]),
+            {stream: true})).toEqual('€b');
+        expect(decoder.decode()).toEqual('');
+    });
+
+    it('throws for a sequence cut off at the end', function () {
+        let decoder = new ByteArray.TextDecoder();
+        decoder.decode(ByteArray.fromArray([0xe2, 0x82]), {stream: true});
+        expect(() => decoder.decode()).toThrow();
+        expect(decoder.decode(ByteArray.fromArray([0x61]))).toEqual('a');
+    });
+
+    it('reads the stream option before the data', function () {
+        let decoder = new ByteArray.TextDecoder();
+        let a = ByteArray.fromArray([0x61, 0x62]);
+        let options = {
+            get stream() {
+                a.length = 4096;
+                return false;
+            },
+        };
+        expect(decoder.decode(a, options).length).toEqual(4096);
+    });
+
+    it('keeps embedded nuls', function () {
+        let decoder = new ByteArray.TextDecoder();
+        expect(decoder.decode(ByteArray.fromArray([0x61, 0, 0x62])))
+            .toEqual('a\u0000b');
+    });
+
+    it('decodes Latin-1', function () {
+        let decoder = new ByteArray.TextDecoder('latin1');
+        expect(decoder.decode(ByteArray.fromArray([0x63, 0xe9])))
+            .toEqual('cé');
+    });
+
+    it('carries a partial character of other encodings', function () {
+        let decoder = new ByteArray.TextDecoder('UTF-16LE');
+        expect(decoder.decode(ByteArray.fromArray([0x61, 0, 0xe9]),
+            {stream: true})).toEqual('a');
+        expect(decoder.decode(ByteArray.fromArray([0]))).toEqual('é');
+    });
+
+    it('rejects unknown encodings', function () {
+        expect(() => new ByteArray.TextDecoder('no-such-encoding')).toThrow();
+    });
+});
+
+describe('Text encoder', function () {
+    it('carries a surrogate pair split between chunks', function () {
+        let encoder = new ByteArray.TextEncoder();
+        let a = encoder.encode('a\ud83d', {stream: true});
+        expect(a.length).toEqual(1);
+        a = encoder.encode('\ude00');
+        [0xf0, 0x9f, 0x98, 0x80].forEach((val, ix) => expect(a[ix]).toEqual(val));
+        expect(a.length).toEqual(4);
+    });
+
+    it('encodes Latin-1', function () {
+        let a = new ByteArray.TextEncoder('ISO-8859-1').encode('cé');
+        expect(a.length).toEqual(2);
+        expect(a[1]).toEqual(0xe9);
+    });
+
+    it('throws for characters that Latin-1 cannot represent', function () {
+        let encoder = new ByteArray.TextEncoder('ISO-8859-1');
+        expect(() => encoder.encode('€')).toThrow();
+    });
+
+    it('is used by fromString() and toString()', function () {
+        let a = ByteArray.fromString('café', 'UTF-16LE');
+        expect(a.length).toEqual(8);
+        expect(a.toString('UTF-16LE')).toEqual('café');
+        a = ByteArray.fromString('a\u0000b');
+        expect(a.length).toEqual(3);
+    });
 });
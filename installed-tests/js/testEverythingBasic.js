@@ -271,6 +271,27 @@ describe('Life, the Universe and Everything', function () {
         });
     });
 
+    it('long arrays of small ints, with truncation of out-of-range elements', function () {
+        // More than two of the batches of 256 that arrays are converted in
+        const length = 2 * 256 + 3;
+        let array = [];
+        for (let i = 0; i < length; i++)
+            array.push(i % 2 ? 257 : 65537.5);
+        expect(Regress.test_array_gint8_in(array)).toEqual(length);
+        expect(Regress.test_array_gint16_in(array)).toEqual(257 * 257 + 258);
+
+        // Only the elements around the batch boundaries and the last one
+        // are nonzero after truncation, each with its own bit
+        array = [];
+        for (let i = 0; i < length; i++)
+            array.push(i % 2 ? 65536 : 65536.5);
+        [255, 256, 511, 512, length - 1].forEach((index, bit) => {
+            array[index] += 1 << bit;
+        });
+        expect(Regress.test_array_gint8_in(array)).toEqual(31);
+        expect(Regress.test_array_gint16_in(array)).toEqual(31);
+    });
+
     it('implicit conversions from strings to int arrays', function () {
         expect(Regress.test_array_gint8_in("\x01\x02\x03\x04")).toEqual(10);
         expect(Regress.test_array_gint16_in("\x01\x02\x03\x04")).toEqual(10);
@@ -374,6 +395,20 @@ describe('Life, the Universe and Everything', function () {
         expect(Regress.TestEnum.param(Regress.TestEnum.VALUE4)).toEqual('value4');
     });
 
+    it('lists all enum values and static methods', function () {
+        let keys = Object.keys(Regress.TestEnum);
+        ['VALUE1', 'VALUE2', 'VALUE3', 'VALUE4', 'param'].forEach(key =>
+            expect(keys).toContain(key));
+        keys = Object.keys(Regress.TestFlags);
+        ['FLAG1', 'FLAG2', 'FLAG3'].forEach(key =>
+            expect(keys).toContain(key));
+    });
+
+    it('does not make up enum values', function () {
+        expect(Regress.TestEnum.VALUE5).not.toBeDefined();
+        expect('VALUE5' in Regress.TestEnum).toBeFalsy();
+    });
+
     describe('Signal connection', function () {
         let o;
         beforeEach(function () {
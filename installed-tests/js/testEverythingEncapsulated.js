@@ -1,4 +1,5 @@
 const Regress = imports.gi.Regress;
+const System = imports.system;
 
 describe('Introspected structs', function () {
     let struct;
@@ -26,6 +27,20 @@ describe('Introspected structs', function () {
             expect(b.some_double).toEqual(42.5);
             expect(b.some_enum).toEqual(Regress.TestEnum.VALUE3);
         });
+
+        it('converts field values that are not integers', function () {
+            struct.some_int = 1.5;
+            struct.some_int8 = '12';
+            struct.some_double = 3;
+            expect(struct.some_int).toEqual(1);
+            expect(struct.some_int8).toEqual(12);
+            expect(struct.some_double).toEqual(3);
+        });
+
+        it('catches out-of-range field values', function () {
+            expect(() => struct.some_int8 = 200).toThrow();
+            expect(struct.some_int8).toEqual(43);
+        });
     });
 
     describe('nested', function () {
@@ -45,6 +60,13 @@ describe('Introspected structs', function () {
             expect(b.some_int8).toEqual(43);
             expect(b.nested_a.some_int8).toEqual(66);
         });
+
+        it('keeps the parent alive while a nested struct is used', function () {
+            let nested = new Regress.TestStructB().nested_a;
+            System.gc();
+            nested.some_int8 = 12;
+            expect(nested.some_int8).toEqual(12);
+        });
     });
 
     describe('constructors', function () {
@@ -75,6 +97,12 @@ describe('Introspected structs', function () {
             expect(copy.some_double).toEqual(42.5);
             expect(copy.some_enum).toEqual(Regress.TestEnum.VALUE3);
         });
+
+        it('does not share memory with the copied object', function () {
+            let copy = new Regress.TestStructA(struct);
+            copy.some_int = 7;
+            expect(struct.some_int).toEqual(42);
+        });
     });
 
     it('containing fixed array', function () {
@@ -209,6 +237,31 @@ describe('Introspected GObject', function () {
         expect(obj.some_double).toEqual(obj.double);
     });
 
+    it('defines GObject properties as accessors on the prototype', function () {
+        let desc = Object.getOwnPropertyDescriptor(Regress.TestObj.prototype, 'double');
+        expect(desc.get).toEqual(jasmine.any(Function));
+        expect(desc.set).toEqual(jasmine.any(Function));
+        obj.double = 1.5;
+        expect(obj.double).toEqual(1.5);
+        expect(desc.get.call(obj)).toEqual(1.5);
+    });
+
+    it('still resolves methods after many missing names', function () {
+        for (let i = 0; i < 1000; i++)
+            expect(Regress.TestObj.prototype['no_such_method_' + i]).toBeUndefined();
+        expect(obj.instance_method()).toEqual(-1);
+        expect(obj.no_such_method_1).toBeUndefined();
+    });
+
+    it('keeps many expando properties', function () {
+        for (let i = 0; i < 1000; i++)
+            obj['expando' + i] = i;
+        System.gc();
+        for (let i = 0; i < 1000; i++)
+            expect(obj['expando' + i]).toEqual(i);
+        expect(obj.some_int8).toEqual(42);
+    });
+
     it('cannot access fields with complex types (GI limitation)', function () {
         expect(() => obj.parent_instance).toThrow();
         expect(() => obj.function_ptr).toThrow();
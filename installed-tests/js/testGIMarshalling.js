@@ -20,6 +20,16 @@ describe('C array', function () {
         expect(() => GIMarshallingTests.array_in([-1, 0, 1, 2])).not.toThrow();
     });
 
+    it('can be passed to a function as a typed array', function () {
+        expect(() => GIMarshallingTests.array_in(new Int32Array([-1, 0, 1, 2])))
+            .not.toThrow();
+    });
+
+    it('can be passed to a function as a typed array of another type', function () {
+        expect(() => GIMarshallingTests.array_in(new Float64Array([-1, 0, 1, 2])))
+            .not.toThrow();
+    });
+
     it('can be passed to a function with its length parameter before it', function () {
         expect(() => GIMarshallingTests.array_in_len_before([-1, 0, 1, 2]))
             .not.toThrow();
@@ -124,6 +134,12 @@ describe('C array', function () {
             expect(() => GIMarshallingTests.array_unichar_in([0x63, 0x6f, 0x6e, 0x73,
                 0x74, 0x20, 0x2665, 0x20, 0x75, 0x74, 0x66, 0x38])).not.toThrow();
         });
+
+        it('can be implicitly converted from a typed array', function () {
+            expect(() => GIMarshallingTests.array_unichar_in(new Uint32Array([0x63,
+                0x6f, 0x6e, 0x73, 0x74, 0x20, 0x2665, 0x20, 0x75, 0x74, 0x66,
+                0x38]))).not.toThrow();
+        });
     });
 
     describe('of strings', function () {
@@ -231,6 +247,12 @@ describe('GByteArray', function () {
         expect(() => GIMarshallingTests.bytearray_none_in([0, 49, 0xFF, 51]))
             .not.toThrow();
     });
+
+    it('shows changes made in place by the callee', function () {
+        let array = ByteArray.fromArray([0, 49, 0xFF, 51]);
+        GLib.ByteArray.remove_index(array, 1);
+        expect(array).toEqual(ByteArray.fromArray([0, 0xFF, 51]));
+    });
 });
 
 describe('GBytes', function () {
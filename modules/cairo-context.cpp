@@ -233,7 +233,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 typedef struct {
     void *dummy;
     JSContext  *context;
-    JSObject   *object;
+    JS::Heap<JSObject *> object;
     cairo_t * cr;
 } GjsCairoContext;
 
@@ -247,7 +247,7 @@ _gjs_cairo_context_construct_internal(JSContext       *context,
 {
     GjsCairoContext *priv;
 
-    priv = g_slice_new0(GjsCairoContext);
+    priv = new GjsCairoContext();
 
     g_assert(priv_from_js(context, obj) == NULL);
     JS_SetPrivate(obj, priv);
@@ -301,7 +301,7 @@ gjs_cairo_context_finalize(JSFreeOp *fop,
     if (priv->cr != NULL)
         cairo_destroy(priv->cr);
 
-    g_slice_free(GjsCairoContext, priv);
+    delete priv;
 }
 
 /* Properties */
@@ -29,7 +29,7 @@
 
 typedef struct {
     JSContext       *context;
-    JSObject        *object;
+    JS::Heap<JSObject *> object;
     cairo_path_t    *path;
 } GjsCairoPath;
 
@@ -45,7 +45,7 @@ gjs_cairo_path_finalize(JSFreeOp *fop,
     if (priv == NULL)
         return;
     cairo_path_destroy(priv->path);
-    g_slice_free(GjsCairoPath, priv);
+    delete priv;
 }
 
 /* Properties */
@@ -81,7 +81,7 @@ gjs_cairo_path_from_path(JSContext    *context,
         return NULL;
     }
 
-    priv = g_slice_new0(GjsCairoPath);
+    priv = new GjsCairoPath();
 
     g_assert(priv_from_js(context, object) == NULL);
     JS_SetPrivate(object, priv);
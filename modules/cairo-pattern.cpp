@@ -31,7 +31,7 @@
 typedef struct {
     void            *dummy;
     JSContext       *context;
-    JSObject        *object;
+    JS::Heap<JSObject *> object;
     cairo_pattern_t *pattern;
 } GjsCairoPattern;
 
@@ -47,7 +47,7 @@ gjs_cairo_pattern_finalize(JSFreeOp *fop,
     if (priv == NULL)
         return;
     cairo_pattern_destroy(priv->pattern);
-    g_slice_free(GjsCairoPattern, priv);
+    delete priv;
 }
 
 /* Properties */
@@ -112,7 +112,7 @@ gjs_cairo_pattern_construct(JSContext       *context,
     g_return_if_fail(object != NULL);
     g_return_if_fail(pattern != NULL);
 
-    priv = g_slice_new0(GjsCairoPattern);
+    priv = new GjsCairoPattern();
 
     g_assert(priv_from_js(context, object) == NULL);
     JS_SetPrivate(object, priv);
@@ -32,7 +32,7 @@
 
 typedef struct {
     JSContext *context;
-    JSObject *object;
+    JS::Heap<JSObject *> object;
     cairo_region_t *region;
 } GjsCairoRegion;
 
@@ -230,7 +230,7 @@ _gjs_cairo_region_construct_internal(JSContext       *context,
 {
     GjsCairoRegion *priv;
 
-    priv = g_slice_new0(GjsCairoRegion);
+    priv = new GjsCairoRegion();
 
     g_assert(priv_from_js(context, obj) == NULL);
     JS_SetPrivate(obj, priv);
@@ -270,7 +270,7 @@ gjs_cairo_region_finalize(JSFreeOp *fop,
         return;
 
     cairo_region_destroy(priv->region);
-    g_slice_free(GjsCairoRegion, priv);
+    delete priv;
 }
 
 static JSObject *
@@ -32,7 +32,7 @@
 typedef struct {
     void            *dummy;
     JSContext       *context;
-    JSObject        *object;
+    JS::Heap<JSObject *> object;
     cairo_surface_t *surface;
 } GjsCairoSurface;
 
@@ -48,7 +48,7 @@ gjs_cairo_surface_finalize(JSFreeOp *fop,
     if (priv == NULL)
         return;
     cairo_surface_destroy(priv->surface);
-    g_slice_free(GjsCairoSurface, priv);
+    delete priv;
 }
 
 /* Properties */
@@ -150,7 +150,7 @@ gjs_cairo_surface_construct(JSContext       *context,
     g_return_if_fail(object != NULL);
     g_return_if_fail(surface != NULL);
 
-    priv = g_slice_new0(GjsCairoSurface);
+    priv = new GjsCairoSurface();
 
     g_assert(priv_from_js(context, object) == NULL);
     JS_SetPrivate(object, priv);
@@ -0,0 +1,491 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2026 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Benchmarks. These are only registered in perf mode, for example:
+ *   ./gjs-tests -m perf -p /perf
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <girepository.h>
+
+#include "gjs/context.h"
+#include "gjs/jsapi-wrapper.h"
+#include "test/gjs-test-utils.h"
+
+/* Evaluates @setup in a new context, then returns the time in seconds
+ * taken to evaluate @script in that same context.
+ */
+static double
+time_script(const char *setup,
+            const char *script)
+{
+    GjsContext *context = gjs_context_new();
+    GError *error = NULL;
+    int status;
+    double elapsed;
+
+    if (!gjs_context_eval(context, setup, -1, "<setup>", &status, &error))
+        g_error("%s", error->message);
+
+    g_test_timer_start();
+    if (!gjs_context_eval(context, script, -1, "<benchmark>", &status, &error))
+        g_error("%s", error->message);
+    elapsed = g_test_timer_elapsed();
+
+    g_object_unref(context);
+    return elapsed;
+}
+
+/* Times @script once normally and once with GJS_DISABLE_FAST_PATHS set,
+ * and reports both.
+ */
+static void
+compare_fast_paths(const char *setup,
+                   const char *script)
+{
+    double fast, slow;
+
+    g_unsetenv("GJS_DISABLE_FAST_PATHS");
+    fast = time_script(setup, script);
+
+    g_setenv("GJS_DISABLE_FAST_PATHS", "1", true);
+    slow = time_script(setup, script);
+    g_unsetenv("GJS_DISABLE_FAST_PATHS");
+
+    g_test_message("general path: %.3f s", slow);
+    g_test_minimized_result(fast, "fast path: %.3f s (%.2fx)", fast, slow / fast);
+}
+
+static void
+gjstest_perf_function_call_primitive(void)
+{
+    compare_fast_paths("const GLib = imports.gi.GLib;"
+                       "GLib.random_int_range(0, 10);",
+                       "for (let i = 0; i < 1000000; i++)"
+                       "    GLib.random_int_range(0, 10);");
+}
+
+static void
+gjstest_perf_method_call_primitive(void)
+{
+    compare_fast_paths("const Gio = imports.gi.Gio;"
+                       "const cancellable = new Gio.Cancellable();"
+                       "cancellable.is_cancelled();",
+                       "for (let i = 0; i < 1000000; i++)"
+                       "    cancellable.is_cancelled();");
+}
+
+static void
+gjstest_perf_object_property_get(void)
+{
+    compare_fast_paths("const Regress = imports.gi.Regress;"
+                       "const obj = new Regress.TestObj({ float: 3.5 });"
+                       "obj.float;",
+                       "for (let i = 0; i < 1000000; i++)"
+                       "    obj.float;");
+}
+
+static void
+gjstest_perf_object_signal_emit(void)
+{
+    double elapsed;
+
+    elapsed = time_script("const GObject = imports.gi.GObject;"
+                          "const Lang = imports.lang;"
+                          "const Emitter = new Lang.Class({"
+                          "    Name: 'GjsPerfEmitter',"
+                          "    Extends: GObject.Object,"
+                          "    Signals: {"
+                          "        'ping': { param_types: [GObject.TYPE_INT] },"
+                          "    },"
+                          "});"
+                          "const emitter = new Emitter();"
+                          "emitter.connect('ping', function () {});",
+                          "for (let i = 0; i < 1000000; i++)"
+                          "    emitter.emit('ping', i);");
+    g_test_minimized_result(elapsed, "1M emissions: %.3f s", elapsed);
+}
+
+static void
+gjstest_perf_string_return(void)
+{
+    double elapsed;
+
+    elapsed = time_script("const GLib = imports.gi.GLib;"
+                          "GLib.get_user_name();",
+                          "for (let i = 0; i < 1000000; i++)"
+                          "    GLib.get_user_name();");
+    g_test_minimized_result(elapsed, "1M GLib.get_user_name(): %.3f s",
+                            elapsed);
+}
+
+static void
+gjstest_perf_string_in_out(void)
+{
+    double elapsed;
+
+    elapsed = time_script("const Gio = imports.gi.Gio;"
+                          "const file = Gio.File.new_for_path("
+                          "    '/usr/share/gjs-1.0/some/fairly/long/path.js');"
+                          "file.get_path();",
+                          "for (let i = 0; i < 1000000; i++)"
+                          "    file.get_child('caf\\u00e9').get_path();");
+    g_test_minimized_result(elapsed,
+                            "1M Gio.File.get_child().get_path(): %.3f s",
+                            elapsed);
+}
+
+static void
+gjstest_perf_array_in(gconstpointer data)
+{
+    const char *inttype = (const char *) data;
+    char *script = g_strdup_printf("for (let i = 0; i < 10; i++)"
+                                   "    Regress.test_array_%s_in(array);",
+                                   inttype);
+    double elapsed;
+
+    elapsed = time_script("const Regress = imports.gi.Regress;"
+                          "const array = [];"
+                          "for (let i = 0; i < 1000000; i++)"
+                          "    array.push(i % 100);",
+                          script);
+    g_test_minimized_result(elapsed / 10,
+                            "1M-element %s array: %.3f s", inttype,
+                            elapsed / 10);
+
+    g_free(script);
+}
+
+#define N_STARTUP_MODULES 200
+
+/* Writes N_STARTUP_MODULES modules of a few hundred lines each into a new
+ * temporary directory */
+static char *
+write_startup_modules(void)
+{
+    char *dir = g_dir_make_tmp("gjs-perf-modules-XXXXXX", NULL);
+    GString *source = g_string_new("");
+    int i;
+
+    g_assert(dir != NULL);
+
+    for (i = 0; i < 100; i++)
+        g_string_append_printf(source,
+                               "function f%d(a, b) {\n"
+                               "    let c = a + b * %d;\n"
+                               "    return [c, c * 2].map(function (x) {\n"
+                               "        return x + 1;\n"
+                               "    });\n"
+                               "}\n", i, i);
+
+    for (i = 0; i < N_STARTUP_MODULES; i++) {
+        char *basename = g_strdup_printf("mod%d.js", i);
+        char *path = g_build_filename(dir, basename, NULL);
+
+        if (!g_file_set_contents(path, source->str, source->len, NULL))
+            g_error("Could not write %s", path);
+
+        g_free(path);
+        g_free(basename);
+    }
+
+    g_string_free(source, true);
+    return dir;
+}
+
+static void
+remove_dir(const char *dir)
+{
+    GDir *d = g_dir_open(dir, 0, NULL);
+    const char *name;
+
+    while ((name = g_dir_read_name(d)) != NULL) {
+        char *path = g_build_filename(dir, name, NULL);
+        g_unlink(path);
+        g_free(path);
+    }
+    g_dir_close(d);
+    g_rmdir(dir);
+}
+
+/* Returns the time in seconds to create a context and import every module
+ * in @dir */
+static double
+time_startup(char *dir,
+             bool  bytecode_cache)
+{
+    char *search_path[] = { dir, NULL };
+    GjsContext *context;
+    GError *error = NULL;
+    int status;
+    double elapsed;
+
+    g_test_timer_start();
+    context = (GjsContext *) g_object_new(GJS_TYPE_CONTEXT,
+                                          "search-path", search_path,
+                                          "bytecode-cache", bytecode_cache,
+                                          NULL);
+    if (!gjs_context_eval(context,
+                          "for (let i = 0; i < " G_STRINGIFY(N_STARTUP_MODULES) "; i++)"
+                          "    imports['mod' + i];",
+                          -1, "<benchmark>", &status, &error))
+        g_error("%s", error->message);
+    elapsed = g_test_timer_elapsed();
+
+    g_object_unref(context);
+    return elapsed;
+}
+
+static void
+gjstest_perf_startup_bytecode_cache(void)
+{
+    char *modules_dir = write_startup_modules();
+    char *cache_dir = g_dir_make_tmp("gjs-perf-cache-XXXXXX", NULL);
+    double uncached, cold, warm;
+
+    g_setenv("GJS_BYTECODE_CACHE_DIR", cache_dir, true);
+
+    uncached = time_startup(modules_dir, false);
+    cold = time_startup(modules_dir, true);
+    warm = time_startup(modules_dir, true);
+
+    g_unsetenv("GJS_BYTECODE_CACHE_DIR");
+
+    g_test_message("no cache: %.3f s", uncached);
+    g_test_message("cold cache: %.3f s", cold);
+    g_test_minimized_result(warm, "warm cache: %.3f s (%.2fx)", warm,
+                            uncached / warm);
+
+    remove_dir(cache_dir);
+    remove_dir(modules_dir);
+    g_free(cache_dir);
+    g_free(modules_dir);
+}
+
+/* A handful of enumerations, as a typical application touches them while
+ * building its UI */
+#define TOUCH_GTK_ENUMS "\
+imports.gi.versions.Gtk = '3.0'; \
+const Gtk = imports.gi.Gtk; \
+Gtk.Align.CENTER; \
+Gtk.Orientation.VERTICAL; \
+Gtk.PolicyType.AUTOMATIC; \
+Gtk.StateFlags.PRELIGHT; \
+Gtk.Justification.CENTER; \
+Gtk.IconSize.BUTTON; \
+Gtk.PositionType.TOP; \
+Gtk.ResponseType.OK; \
+Gtk.WindowType.TOPLEVEL; \
+Gtk.ReliefStyle.NONE; \
+"
+
+#define N_ENUM_STARTUPS 20
+
+/* Returns the time in seconds to create a context and run TOUCH_GTK_ENUMS,
+ * and the size of the JS heap after that */
+static double
+time_gtk_enums(gsize *heap_bytes)
+{
+    GjsContext *context;
+    GError *error = NULL;
+    int status;
+    double elapsed;
+
+    g_test_timer_start();
+    context = gjs_context_new();
+    if (!gjs_context_eval(context, TOUCH_GTK_ENUMS, -1, "<benchmark>",
+                          &status, &error))
+        g_error("%s", error->message);
+    elapsed = g_test_timer_elapsed();
+
+    gjs_context_gc(context);
+    JSContext *cx = (JSContext *) gjs_context_get_native_context(context);
+    *heap_bytes = JS_GetGCParameter(JS_GetRuntime(cx), JSGC_BYTES);
+
+    g_object_unref(context);
+    return elapsed;
+}
+
+static void
+gjstest_perf_enum_lazy(void)
+{
+    double lazy = 0, eager = 0;
+    gsize lazy_heap = 0, eager_heap = 0;
+    int i;
+
+    if (!g_irepository_require(NULL, "Gtk", "3.0", (GIRepositoryLoadFlags) 0,
+                               NULL)) {
+        g_test_skip("Gtk 3.0 typelib not available");
+        return;
+    }
+
+    for (i = 0; i < N_ENUM_STARTUPS; i++) {
+        g_unsetenv("GJS_DISABLE_FAST_PATHS");
+        lazy += time_gtk_enums(&lazy_heap);
+
+        g_setenv("GJS_DISABLE_FAST_PATHS", "1", true);
+        eager += time_gtk_enums(&eager_heap);
+    }
+    g_unsetenv("GJS_DISABLE_FAST_PATHS");
+
+    g_test_message("eager: %.3f ms, %" G_GSIZE_FORMAT " KiB of JS heap",
+                   eager * 1000 / N_ENUM_STARTUPS, eager_heap / 1024);
+    g_test_minimized_result(lazy / N_ENUM_STARTUPS,
+                            "lazy: %.3f ms (%.2fx), %" G_GSIZE_FORMAT " KiB of JS heap",
+                            lazy * 1000 / N_ENUM_STARTUPS, eager / lazy,
+                            lazy_heap / 1024);
+}
+
+static void
+gjstest_perf_byte_array_index(void)
+{
+    double indexed, view;
+
+    indexed = time_script("const ByteArray = imports.byteArray;"
+                          "const a = new ByteArray.ByteArray(1 << 20);",
+                          "for (let i = 0; i < a.length; i++)"
+                          "    a[i] = (a[i] + i) & 0xff;");
+    view = time_script("const ByteArray = imports.byteArray;"
+                       "const a = new ByteArray.ByteArray(1 << 20);"
+                       "const v = a.asUint8Array();",
+                       "for (let i = 0; i < v.length; i++)"
+                       "    v[i] = (v[i] + i) & 0xff;");
+
+    g_test_message("1 MiB through ByteArray indexing: %.3f s", indexed);
+    g_test_minimized_result(view, "1 MiB through a Uint8Array view: %.3f s "
+                            "(%.1fx)", view, indexed / view);
+}
+
+static void
+gjstest_perf_boxed_new_simple(void)
+{
+    compare_fast_paths("const Regress = imports.gi.Regress;"
+                       "new Regress.TestStructA();",
+                       "for (let i = 0; i < 10000000; i++) {"
+                       "    let rect = new Regress.TestStructA();"
+                       "    rect.some_int = i;"
+                       "}");
+}
+
+static void
+gjstest_perf_boxed_field_access(void)
+{
+    compare_fast_paths("const Regress = imports.gi.Regress;"
+                       "const a = new Regress.TestStructA();"
+                       "const b = new Regress.TestStructB();",
+                       "for (let i = 0; i < 10000000; i++) {"
+                       "    a.some_int = a.some_int8 + i;"
+                       "    a.some_double += a.some_int;"
+                       "    b.nested_a.some_int8 = i & 0x7f;"
+                       "}");
+}
+
+/* Makes the given number of MiB of text, as ByteArray chunks and as string
+ * pieces whose ends split characters. Each unit is 18 bytes of UTF-8. */
+#define TEXT_CODEC_SETUP \
+    "const ByteArray = imports.byteArray;" \
+    "const unit = 'caf\\u00e9 \\u4e2d\\u6587 \\ud83d\\ude00 ';" \
+    "const text = unit.repeat(Math.ceil(%d * 1048576 / 18));" \
+    "const whole = ByteArray.fromString(text).asUint8Array();" \
+    "const chunks = [], pieces = [];" \
+    "for (let off = 0; off < whole.length; off += 65521) {" \
+    "    let chunk = whole.subarray(off, off + 65521);" \
+    "    let a = new ByteArray.ByteArray(chunk.length);" \
+    "    a.asUint8Array().set(chunk);" \
+    "    chunks.push(a);" \
+    "}" \
+    "for (let off = 0; off < text.length; off += 65521)" \
+    "    pieces.push(text.substring(off, off + 65521));"
+
+static void
+gjstest_perf_byte_array_text_codec(gconstpointer data)
+{
+    int mib = GPOINTER_TO_INT(data);
+    char *setup = g_strdup_printf(TEXT_CODEC_SETUP, mib);
+    double decode, encode;
+
+    decode = time_script(setup,
+                         "const decoder = new ByteArray.TextDecoder();"
+                         "for (let i = 0; i < chunks.length; i++)"
+                         "    decoder.decode(chunks[i], {stream: true});"
+                         "decoder.decode();");
+    encode = time_script(setup,
+                         "const encoder = new ByteArray.TextEncoder();"
+                         "for (let i = 0; i < pieces.length; i++)"
+                         "    encoder.encode(pieces[i], {stream: true});"
+                         "encoder.encode();");
+
+    g_test_message("%d MiB encoded in chunks: %.3f s, %.1f MiB/s", mib,
+                   encode, mib / encode);
+    g_test_minimized_result(decode, "%d MiB decoded in chunks: %.3f s, "
+                            "%.1f MiB/s", mib, decode, mib / decode);
+
+    g_free(setup);
+}
+
+void
+gjs_test_add_tests_for_perf(void)
+{
+    if (!g_test_perf())
+        return;
+
+    g_test_add_func("/perf/function/call/primitive",
+                    gjstest_perf_function_call_primitive);
+    g_test_add_func("/perf/function/method/primitive",
+                    gjstest_perf_method_call_primitive);
+    g_test_add_func("/perf/object/property/get",
+                    gjstest_perf_object_property_get);
+    g_test_add_func("/perf/object/signal/emit",
+                    gjstest_perf_object_signal_emit);
+    g_test_add_func("/perf/arg/string/return",
+                    gjstest_perf_string_return);
+    g_test_add_func("/perf/arg/string/in-out",
+                    gjstest_perf_string_in_out);
+    g_test_add_data_func("/perf/arg/array-in/gint8", "gint8",
+                         gjstest_perf_array_in);
+    g_test_add_data_func("/perf/arg/array-in/gint16", "gint16",
+                         gjstest_perf_array_in);
+    g_test_add_data_func("/perf/arg/array-in/gint32", "gint32",
+                         gjstest_perf_array_in);
+    g_test_add_data_func("/perf/arg/array-in/gint64", "gint64",
+                         gjstest_perf_array_in);
+    g_test_add_func("/perf/importer/startup/bytecode-cache",
+                    gjstest_perf_startup_bytecode_cache);
+    g_test_add_func("/perf/byte-array/index",
+                    gjstest_perf_byte_array_index);
+    g_test_add_data_func("/perf/byte-array/text-codec/1M",
+                         GINT_TO_POINTER(1),
+                         gjstest_perf_byte_array_text_codec);
+    g_test_add_data_func("/perf/byte-array/text-codec/100M",
+                         GINT_TO_POINTER(100),
+                         gjstest_perf_byte_array_text_codec);
+    g_test_add_func("/perf/gi/enum/lazy",
+                    gjstest_perf_enum_lazy);
+    g_test_add_func("/perf/gi/boxed/new-simple",
+                    gjstest_perf_boxed_new_simple);
+    g_test_add_func("/perf/gi/boxed/field-access",
+                    gjstest_perf_boxed_field_access);
+}
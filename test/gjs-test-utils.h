@@ -40,4 +40,6 @@ void gjs_test_add_tests_for_coverage ();
 
 void gjs_test_add_tests_for_parse_call_args(void);
 
+void gjs_test_add_tests_for_perf(void);
+
 #endif
@@ -22,13 +22,23 @@
  */
 
 #include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <utime.h>
+
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <glib-object.h>
 #include <util/glib.h>
 
 #include <gjs/context.h>
+#include "gi/function.h"
+#include "gjs/byteArray.h"
+#include "gjs/gc-scheduler.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/jsapi-wrapper.h"
+#include "gjs/mem.h"
 #include "gjs-test-utils.h"
 #include "util/error.h"
 
@@ -85,6 +95,424 @@ gjstest_test_func_gjs_context_exit(void)
     g_object_unref(context);
 }
 
+static void
+gjstest_test_func_gjs_context_typed_arrays(void)
+{
+    GjsContext *context = (GjsContext *) g_object_new(GJS_TYPE_CONTEXT,
+                                                      "typed-arrays", true,
+                                                      NULL);
+    GError *error = NULL;
+    int status;
+
+    bool ok = gjs_context_eval(context,
+                               "const GIMarshallingTests = imports.gi.GIMarshallingTests;"
+                               "let array = GIMarshallingTests.array_return();"
+                               "if (!(array instanceof Int32Array) ||"
+                               "    array.join() !== '-1,0,1,2')"
+                               "    throw new Error('Expected an Int32Array');",
+                               -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_object_unref(context);
+}
+
+static void
+gjstest_test_func_gjs_context_gc_stats(void)
+{
+    GjsContext *context = (GjsContext *) g_object_new(GJS_TYPE_CONTEXT,
+                                                      "gc-slice-budget", 1000,
+                                                      NULL);
+    const gssize native_size = 16 * 1024 * 1024;
+    GjsGcStats before, stats;
+
+    /* A collection that the scheduler did not start still resets the
+     * native memory counted since the last one */
+    gjs_context_get_gc_stats(context, &before);
+    gjs_context_gc(context);
+
+    gjs_context_get_gc_stats(context, &stats);
+    g_assert_cmpuint(stats.slice_budget_us, ==, 1000);
+    g_assert_cmpuint(stats.native_bytes_since_gc, ==, 0);
+    g_assert_cmpuint(stats.n_collections_started - before.n_collections_started, ==, 1);
+    g_assert_cmpuint(stats.n_collections_finished - before.n_collections_finished, ==, 1);
+    g_assert_cmpuint(stats.n_slices, ==, before.n_slices);
+
+    gjs_gc_track_native_memory(GJS_GC_NATIVE_BOXED, native_size);
+
+    gjs_context_get_gc_stats(context, &stats);
+    g_assert_cmpuint(stats.native_bytes_since_gc, ==, native_size);
+    g_assert_cmpuint(stats.native_bytes_boxed, >=, native_size);
+
+    /* More than the trigger, so the scheduler runs one slice of the
+     * budget */
+    gjs_context_maybe_gc(context);
+
+    gjs_context_get_gc_stats(context, &stats);
+    g_assert_cmpuint(stats.n_checks - before.n_checks, ==, 1);
+    g_assert_cmpint(stats.last_decision, ==, GJS_GC_DECISION_NATIVE_PRESSURE);
+    g_assert_cmpuint(stats.n_collections_started - before.n_collections_started, ==, 2);
+    g_assert_cmpuint(stats.n_slices - before.n_slices, ==, 1);
+
+    /* Finish that collection, if the first slice did not */
+    while (stats.collecting) {
+        gjs_context_gc_slice(context, 1000);
+        gjs_context_get_gc_stats(context, &stats);
+    }
+
+    g_assert_cmpuint(stats.n_collections_finished - before.n_collections_finished, ==, 2);
+    g_assert_cmpuint(stats.native_bytes_since_gc, ==, 0);
+
+    gjs_gc_track_native_memory(GJS_GC_NATIVE_BOXED, -native_size);
+
+    g_object_unref(context);
+}
+
+static void
+gjstest_test_func_gjs_context_gc_slice(void)
+{
+    GjsContext *context = gjs_context_new();
+    JSContext *cx = (JSContext *) gjs_context_get_native_context(context);
+    GjsGcStats before, stats;
+    GError *error = NULL;
+    bool finished;
+    int status, i;
+
+    /* Enough live objects that marking them takes longer than one slice */
+    bool ok = gjs_context_eval(context,
+                               "var objects = [];"
+                               "for (let i = 0; i < 500000; i++)"
+                               "    objects.push({ i: i, next: objects[i - 1] });",
+                               -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    gjs_context_get_gc_stats(context, &before);
+
+    finished = gjs_context_gc_slice(context, 1000);
+    g_assert_false(finished);
+    g_assert_true(JS::IsIncrementalGCInProgress(JS_GetRuntime(cx)));
+
+    gjs_context_get_gc_stats(context, &stats);
+    g_assert_true(stats.collecting);
+    g_assert_cmpuint(stats.n_slices - before.n_slices, ==, 1);
+    g_assert_cmpuint(stats.n_collections_started - before.n_collections_started, ==, 1);
+    g_assert_cmpuint(stats.n_collections_finished, ==, before.n_collections_finished);
+
+    for (i = 0; i < 10000 && !finished; i++)
+        finished = gjs_context_gc_slice(context, 1000);
+    g_assert_true(finished);
+    g_assert_false(JS::IsIncrementalGCInProgress(JS_GetRuntime(cx)));
+
+    gjs_context_get_gc_stats(context, &stats);
+    g_assert_false(stats.collecting);
+    g_assert_cmpuint(stats.n_collections_finished - before.n_collections_finished, ==, 1);
+    g_assert_cmpuint(stats.n_slices - before.n_slices, >, 1);
+
+    g_object_unref(context);
+}
+
+static void
+gjstest_test_func_gjs_byte_array_copy_on_write(void)
+{
+    GjsContext *context = gjs_context_new();
+    GjsByteArrayCopyStats before, after;
+    GError *error = NULL;
+    int status;
+
+    gjs_byte_array_get_copy_stats(&before);
+
+    /* Handing the data to GBytes and back shares it; only the write while
+     * the GBytes is still alive has to copy. b reads straight from the
+     * GBytes, so it shows what the GBytes holds; bytes.get_data() would
+     * make a copy of its own. */
+    bool ok = gjs_context_eval(context,
+                               "const ByteArray = imports.byteArray;"
+                               "let a = ByteArray.fromArray([1, 2, 3, 4]);"
+                               "let bytes = a.toGBytes();"
+                               "let b = ByteArray.fromGBytes(bytes);"
+                               "a[0] = 5;"
+                               "if (b[0] !== 1 || a[0] !== 5)"
+                               "    throw new Error('Write was shared');",
+                               -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    gjs_byte_array_get_copy_stats(&after);
+    g_assert_cmpuint(after.copies_avoided - before.copies_avoided, >=, 2);
+    g_assert_cmpuint(after.copies - before.copies, ==, 1);
+    g_assert_cmpuint(after.bytes_copied - before.bytes_copied, ==, 4);
+
+    g_object_unref(context);
+}
+
+static void
+eval_cached_module(const char *modules_dir,
+                   int         expected_answer)
+{
+    char *search_path[] = { (char *) modules_dir, NULL };
+    GjsContext *context = (GjsContext *) g_object_new(GJS_TYPE_CONTEXT,
+                                                      "search-path", search_path,
+                                                      "bytecode-cache", true,
+                                                      NULL);
+    char *script = g_strdup_printf("if (imports.cachedModule.answer() !== %d)"
+                                   "    throw new Error('Wrong answer');",
+                                   expected_answer);
+    GError *error = NULL;
+    int status;
+
+    bool ok = gjs_context_eval(context, script, -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_free(script);
+    g_object_unref(context);
+}
+
+#define CACHED_MODULE(a, b) \
+    "#!/usr/bin/env gjs\n" \
+    "function answer() {\n" \
+    "    return [" #a ", " #b "].reduce(function (a, b) {\n" \
+    "        return a * b;\n" \
+    "    });\n" \
+    "}\n"
+
+static void
+gjstest_test_func_gjs_context_bytecode_cache(void)
+{
+    char *modules_dir = g_dir_make_tmp("gjs-test-modules-XXXXXX", NULL);
+    char *cache_dir = g_dir_make_tmp("gjs-test-cache-XXXXXX", NULL);
+    char *module_path = g_build_filename(modules_dir, "cachedModule.js", NULL);
+    int hits = GJS_GET_COUNTER(bytecode_cache_hit);
+    int stale = GJS_GET_COUNTER(bytecode_cache_stale);
+    struct stat st;
+    struct utimbuf times;
+    FILE *file;
+    GDir *dir;
+    const char *name;
+    int n_cache_files = 0;
+
+    g_assert_true(g_file_set_contents(module_path, CACHED_MODULE(6, 7), -1,
+                                      NULL));
+    g_setenv("GJS_BYTECODE_CACHE_DIR", cache_dir, true);
+
+    /* First compiles and writes the cache, then loads from it */
+    eval_cached_module(modules_dir, 42);
+    g_assert_cmpint(GJS_GET_COUNTER(bytecode_cache_hit) - hits, ==, 0);
+    eval_cached_module(modules_dir, 42);
+    g_assert_cmpint(GJS_GET_COUNTER(bytecode_cache_hit) - hits, ==, 1);
+    g_assert_cmpint(GJS_GET_COUNTER(bytecode_cache_stale) - stale, ==, 0);
+
+    /* Rewrite the module in place with the same size, and set its mtime
+     * back to the same second, so that only the sub-second part of the
+     * mtime and the ctime tell that it changed */
+    g_assert_cmpint(g_stat(module_path, &st), ==, 0);
+    file = fopen(module_path, "r+");
+    g_assert_nonnull(file);
+    g_assert_cmpuint(fwrite(CACHED_MODULE(4, 6), 1,
+                            strlen(CACHED_MODULE(4, 6)), file), ==,
+                     strlen(CACHED_MODULE(4, 6)));
+    fclose(file);
+    times.actime = st.st_atime;
+    times.modtime = st.st_mtime;
+    g_assert_cmpint(g_utime(module_path, &times), ==, 0);
+
+    eval_cached_module(modules_dir, 24);
+    g_assert_cmpint(GJS_GET_COUNTER(bytecode_cache_stale) - stale, ==, 1);
+    g_assert_cmpint(GJS_GET_COUNTER(bytecode_cache_hit) - hits, ==, 1);
+
+    /* The entry was rewritten for the new contents */
+    eval_cached_module(modules_dir, 24);
+    g_assert_cmpint(GJS_GET_COUNTER(bytecode_cache_hit) - hits, ==, 2);
+
+    g_unsetenv("GJS_BYTECODE_CACHE_DIR");
+
+    dir = g_dir_open(cache_dir, 0, NULL);
+    g_assert_nonnull(dir);
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        char *path = g_build_filename(cache_dir, name, NULL);
+        g_unlink(path);
+        g_free(path);
+        n_cache_files++;
+    }
+    g_dir_close(dir);
+    g_assert_cmpint(n_cache_files, ==, 1);
+
+    g_unlink(module_path);
+    g_rmdir(modules_dir);
+    g_rmdir(cache_dir);
+    g_free(module_path);
+    g_free(modules_dir);
+    g_free(cache_dir);
+}
+
+#define LATE_MODULE_MISSING "\
+try { \
+    imports.lateModule; \
+    throw new Error('lateModule should not be found'); \
+} catch (e) { \
+    if (e.name !== 'ImportError') \
+        throw e; \
+} \
+"
+
+#define LATE_MODULE_FOUND "\
+if (imports.lateModule.answer !== 42) \
+    throw new Error('Wrong answer'); \
+"
+
+static void
+eval_late_module(GjsContext *context,
+                 const char *script)
+{
+    GError *error = NULL;
+    int status;
+
+    bool ok = gjs_context_eval(context, script, -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+}
+
+static void
+gjstest_test_func_gjs_context_import_caches(void)
+{
+    char *modules_dir = g_dir_make_tmp("gjs-test-modules-XXXXXX", NULL);
+    char *module_path = g_build_filename(modules_dir, "lateModule.js", NULL);
+    char *search_path[] = { modules_dir, NULL };
+    GjsContext *context = gjs_context_new_with_search_path(search_path);
+
+    eval_late_module(context, LATE_MODULE_MISSING);
+
+    /* Without a main loop the directory monitor cannot tell the importer
+     * about the new file, but the directory's mtime changed */
+    g_assert_true(g_file_set_contents(module_path, "var answer = 42;\n",
+                                      -1, NULL));
+    eval_late_module(context, LATE_MODULE_FOUND);
+
+    g_object_unref(context);
+
+    g_unlink(module_path);
+    g_rmdir(modules_dir);
+    g_free(module_path);
+    g_free(modules_dir);
+}
+
+#define PREPARSED_MODULES "\
+if (imports.preparsedA.answer() !== 42) \
+    throw new Error('Wrong answer from preparsedA'); \
+if (imports.preparsedB.answer() !== 43) \
+    throw new Error('Wrong answer from preparsedB'); \
+"
+
+static void
+gjstest_test_func_gjs_context_preparse(void)
+{
+    char *modules_dir = g_dir_make_tmp("gjs-test-modules-XXXXXX", NULL);
+    char *module_a = g_build_filename(modules_dir, "preparsedA.js", NULL);
+    char *module_b = g_build_filename(modules_dir, "preparsedB.js", NULL);
+    char *manifest = g_build_filename(modules_dir, "manifest", NULL);
+    char *search_path[] = { modules_dir, NULL };
+    GError *error = NULL;
+    int status;
+    int used = GJS_GET_COUNTER(preparsed_script_used);
+
+    g_assert_true(g_file_set_contents(module_a,
+                                      "#!/usr/bin/env gjs\n"
+                                      "function answer() { return 42; }\n",
+                                      -1, NULL));
+    g_assert_true(g_file_set_contents(module_b,
+                                      "function answer() {\n"
+                                      "    return imports.preparsedA.answer() + 1;\n"
+                                      "}\n", -1, NULL));
+    /* A missing module in the manifest must not break anything */
+    g_assert_true(g_file_set_contents(manifest,
+                                      "# modules used at startup\n"
+                                      "preparsedA.js\n"
+                                      "\n"
+                                      "  preparsedB.js  \n"
+                                      "doesNotExist.js\n", -1, NULL));
+
+    GjsContext *context = gjs_context_new_with_search_path(search_path);
+    g_assert_true(gjs_context_preparse_manifest(context, manifest, &error));
+    g_assert_no_error(error);
+
+    bool ok = gjs_context_eval(context, PREPARSED_MODULES, -1, "<input>",
+                               &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    /* Both modules came from the preparser, not the usual import path */
+    g_assert_cmpint(GJS_GET_COUNTER(preparsed_script_used) - used, ==, 2);
+
+    g_object_unref(context);
+
+    g_unlink(manifest);
+    g_unlink(module_b);
+    g_unlink(module_a);
+    g_rmdir(modules_dir);
+    g_free(manifest);
+    g_free(module_b);
+    g_free(module_a);
+    g_free(modules_dir);
+}
+
+static void
+gjstest_test_func_gjs_object_property_cache_stats(void)
+{
+    GjsContext *context = gjs_context_new();
+    GjsMemCacheStats *stats = gjs_memory_get_cache_stats("property_cache",
+                                                         "RegressTestObj");
+    int hits = stats->hits, misses = stats->misses;
+    GError *error = NULL;
+    int status;
+
+    /* some_int8 is a field, so it is looked up through the cache each time */
+    bool ok = gjs_context_eval(context,
+                               "const Regress = imports.gi.Regress;"
+                               "let obj = new Regress.TestObj({ int: 42 });"
+                               "for (let i = 0; i < 10; i++) {"
+                               "    if (obj.some_int8 !== 42)"
+                               "        throw new Error('Wrong field value');"
+                               "}",
+                               -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_assert_cmpint(stats->misses - misses, >=, 1);
+    g_assert_cmpint(stats->hits - hits, >=, 9);
+
+    g_object_unref(context);
+}
+
+static void
+gjstest_test_func_gjs_function_trampoline_pool(void)
+{
+    GjsContext *context = gjs_context_new();
+    int hits = GJS_GET_COUNTER(trampoline_pool_hit);
+    int misses = GJS_GET_COUNTER(trampoline_pool_miss);
+    GError *error = NULL;
+    int status;
+
+    /* The (scope call) trampoline goes back to the pool after each call,
+     * so only the first call has to prepare a closure */
+    bool ok = gjs_context_eval(context,
+                               "const Regress = imports.gi.Regress;"
+                               "for (let i = 0; i < 10; i++) {"
+                               "    if (Regress.test_callback(() => i) !== i)"
+                               "        throw new Error('Wrong callback result');"
+                               "}",
+                               -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_assert_cmpint(GJS_GET_COUNTER(trampoline_pool_miss) - misses, ==, 1);
+    g_assert_cmpint(GJS_GET_COUNTER(trampoline_pool_hit) - hits, ==, 9);
+    g_assert_cmpuint(gjs_callback_trampoline_pool_size(), ==, 1);
+
+    g_object_unref(context);
+
+    g_assert_cmpuint(gjs_callback_trampoline_pool_size(), ==, 0);
+}
+
 #define JS_CLASS "\
 const Lang    = imports.lang; \
 const GObject = imports.gi.GObject; \
@@ -130,6 +558,104 @@ gjstest_test_func_gjs_jsapi_util_string_js_string_utf8(GjsUnitTestFixture *fx,
     g_free(utf8_result);
 }
 
+static void
+check_utf8_round_trip(JSContext  *cx,
+                      const char *utf8_string)
+{
+    char *utf8_result;
+    JS::RootedValue js_string(cx);
+
+    g_assert_true(gjs_string_from_utf8(cx, utf8_string, -1, &js_string));
+    g_assert_true(js_string.isString());
+    g_assert_true(gjs_string_to_utf8(cx, js_string, &utf8_result));
+    g_assert_cmpstr(utf8_string, ==, utf8_result);
+    g_free(utf8_result);
+}
+
+static void
+gjstest_test_func_gjs_jsapi_util_string_utf8_fast_paths(GjsUnitTestFixture *fx,
+                                                        gconstpointer       unused)
+{
+    JS::RootedValue js_string(fx->cx);
+    char *utf8_result;
+    size_t len;
+
+    check_utf8_round_trip(fx->cx, "");
+    check_utf8_round_trip(fx->cx, "plain ASCII, longer than a machine word");
+    /* ASCII prefix longer than a word, followed by 2, 3 and 4-byte
+     * sequences */
+    check_utf8_round_trip(fx->cx, "/home/someone/Documents/caf\303\251 "
+                          "\342\202\254 \360\237\230\200");
+
+    g_assert_true(gjs_string_from_utf8(fx->cx, "\360\237\230\200", -1,
+                                       &js_string));
+    g_assert_true(JS_GetStringCharsAndLength(fx->cx, js_string.toString(),
+                                             &len) != NULL);
+    g_assert_cmpuint(len, ==, 2);
+
+    /* stops at an embedded nul, like g_utf8_to_utf16() */
+    g_assert_true(gjs_string_from_utf8(fx->cx, "ab\0cd", 5, &js_string));
+    g_assert_true(gjs_string_to_utf8(fx->cx, js_string, &utf8_result));
+    g_assert_cmpstr(utf8_result, ==, "ab");
+    g_free(utf8_result);
+
+    /* overlong, encoded surrogate, truncated sequence */
+    g_assert_false(gjs_string_from_utf8(fx->cx, "abc\300\257", -1, &js_string));
+    JS_ClearPendingException(fx->cx);
+    g_assert_false(gjs_string_from_utf8(fx->cx, "\355\240\200", -1, &js_string));
+    JS_ClearPendingException(fx->cx);
+    g_assert_false(gjs_string_from_utf8(fx->cx, "abcdefgh\342\202", -1,
+                                        &js_string));
+    JS_ClearPendingException(fx->cx);
+
+    /* an unpaired surrogate becomes U+FFFD */
+    const char16_t lone_surrogate[] = { 'a', 0xd800, 'b' };
+    js_string.setString(JS_NewUCStringCopyN(fx->cx, lone_surrogate, 3));
+    g_assert_true(gjs_string_to_utf8(fx->cx, js_string, &utf8_result));
+    g_assert_cmpstr(utf8_result, ==, "a\357\277\275b");
+    g_free(utf8_result);
+}
+
+static void
+gjstest_test_func_gjs_jsapi_util_string_id_borrow(GjsUnitTestFixture *fx,
+                                                  gconstpointer       unused)
+{
+    const char *name, *again;
+
+    JS::RootedId id(fx->cx, gjs_intern_string_to_id(fx->cx, "caf\303\251"));
+    g_assert_true(gjs_borrow_string_id(fx->cx, id, &name));
+    g_assert_cmpstr(name, ==, "caf\303\251");
+
+    /* The name is converted once and must survive a GC */
+    JS_GC(JS_GetRuntime(fx->cx));
+    g_assert_true(gjs_borrow_string_id(fx->cx, id, &again));
+    g_assert_true(again == name);
+    g_assert_cmpstr(again, ==, "caf\303\251");
+    gjs_release_string_id(fx->cx, again);
+
+    /* A borrowed name stays cached even if it is not looked up again */
+    JS_GC(JS_GetRuntime(fx->cx));
+    JS_GC(JS_GetRuntime(fx->cx));
+    g_assert_true(gjs_borrow_string_id(fx->cx, id, &again));
+    g_assert_true(again == name);
+    gjs_release_string_id(fx->cx, again);
+
+    GjsStringIdCache *cache =
+        gjs_runtime_get_string_id_cache(JS_GetRuntime(fx->cx));
+    unsigned size = gjs_string_id_cache_size(cache);
+    gjs_release_string_id(fx->cx, name);
+
+    /* Once released, it is dropped after a GC in which it was not used */
+    JS_GC(JS_GetRuntime(fx->cx));
+    JS_GC(JS_GetRuntime(fx->cx));
+    g_assert_cmpuint(gjs_string_id_cache_size(cache), <, size);
+
+    id = INT_TO_JSID(42);
+    g_assert_false(gjs_borrow_string_id(fx->cx, id, &name));
+    g_assert_null(name);
+    gjs_release_string_id(fx->cx, name);
+}
+
 static void
 gjstest_test_func_gjs_jsapi_util_error_throw(GjsUnitTestFixture *fx,
                                              gconstpointer       unused)
@@ -281,6 +807,15 @@ main(int    argc,
     g_test_add_func("/gjs/context/construct/destroy", gjstest_test_func_gjs_context_construct_destroy);
     g_test_add_func("/gjs/context/construct/eval", gjstest_test_func_gjs_context_construct_eval);
     g_test_add_func("/gjs/context/exit", gjstest_test_func_gjs_context_exit);
+    g_test_add_func("/gjs/context/typed_arrays", gjstest_test_func_gjs_context_typed_arrays);
+    g_test_add_func("/gjs/context/gc_stats", gjstest_test_func_gjs_context_gc_stats);
+    g_test_add_func("/gjs/context/gc_slice", gjstest_test_func_gjs_context_gc_slice);
+    g_test_add_func("/gjs/context/bytecode_cache", gjstest_test_func_gjs_context_bytecode_cache);
+    g_test_add_func("/gjs/context/import_caches", gjstest_test_func_gjs_context_import_caches);
+    g_test_add_func("/gjs/context/preparse", gjstest_test_func_gjs_context_preparse);
+    g_test_add_func("/gjs/byte_array/copy_on_write", gjstest_test_func_gjs_byte_array_copy_on_write);
+    g_test_add_func("/gjs/gobject/property_cache_stats", gjstest_test_func_gjs_object_property_cache_stats);
+    g_test_add_func("/gjs/function/trampoline_pool", gjstest_test_func_gjs_function_trampoline_pool);
     g_test_add_func("/gjs/gobject/js_defined_type", gjstest_test_func_gjs_gobject_js_defined_type);
     g_test_add_func("/gjs/jsutil/strip_shebang/no_shebang", gjstest_test_strip_shebang_no_advance_for_no_shebang);
     g_test_add_func("/gjs/jsutil/strip_shebang/have_shebang", gjstest_test_strip_shebang_advance_for_shebang);
@@ -297,11 +832,16 @@ main(int    argc,
                         gjstest_test_func_gjs_jsapi_util_error_throw);
     ADD_JSAPI_UTIL_TEST("string/js/string/utf8",
                         gjstest_test_func_gjs_jsapi_util_string_js_string_utf8);
+    ADD_JSAPI_UTIL_TEST("string/utf8/fast-paths",
+                        gjstest_test_func_gjs_jsapi_util_string_utf8_fast_paths);
+    ADD_JSAPI_UTIL_TEST("string/id/borrow",
+                        gjstest_test_func_gjs_jsapi_util_string_id_borrow);
 
 #undef ADD_JSAPI_UTIL_TEST
 
     gjs_test_add_tests_for_coverage ();
     gjs_test_add_tests_for_parse_call_args();
+    gjs_test_add_tests_for_perf();
 
     g_test_run();
 